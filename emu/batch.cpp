@@ -0,0 +1,280 @@
+/* emu-batch: runs a list of jobs, each on its own emulator, on all cores.
+ * Every line of the job list is
+ *
+ *      ROM FRAMES [MOVIE]
+ *
+ * (# starts a comment). A movie is the input of every frame, one per line:
+ *
+ *      BUTTONS [BUTTONS2]
+ *
+ * the buttons held on the first (and second) controller, as a hex mask of
+ * Core::Button, so 81 is A and Right. Nothing is held after its last frame.
+ * Jobs are spread over the threads with work stealing,
+ * and jobs with the same ROM share it: the ROM is read once, into an emulator
+ * that every job of that ROM is cloned from. With -o, every job writes its
+ * frame hashes (same format as --hash-log) and a dump of CPU RAM and PRG RAM
+ * at the end; a summary line per job goes to the standard output. */
+
+#include <array>
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <fmt/core.h>
+#include <emu/core/emulator.hpp>
+#include <emu/util/cmdline.hpp>
+#include <emu/util/debug.hpp>
+#include <emu/util/file.hpp>
+#include <emu/util/stringops.hpp>
+#include <emu/util/threadpool.hpp>
+#include <emu/video/video.hpp>
+
+struct Job {
+    std::string rom;
+    unsigned long frames;
+    std::string movie;
+};
+
+struct Result {
+    bool ok = false;
+    std::string messages;
+    Core::Emulator::FrameHash last = {};
+    double secs = 0.0;
+};
+
+/* The first emulator for each ROM, which the others are cloned from. The
+ * lock is only held to find a ROM's entry: the first job of a ROM loads it
+ * under the entry's once_flag, so jobs of other ROMs don't wait for it and
+ * jobs of the same ROM wait until it's there. Its messages go to that job. */
+class RomCache {
+    struct Entry {
+        std::once_flag loaded;
+        std::unique_ptr<Core::Emulator> emu;
+    };
+    std::mutex mtx;
+    // entries never move, so they can be used after unlocking
+    std::map<std::string, Entry> roms;
+
+    static std::unique_ptr<Core::Emulator> load(const std::string &path, std::string &messages)
+    {
+        auto emu = std::make_unique<Core::Emulator>();
+        emu->set_log([&messages](Util::Log::Level, std::string_view msg) { messages += msg; });
+        Util::File romfile(path, Util::File::Mode::READ);
+        if (!romfile)
+            messages += fmt::format("{}: {}\n", path, romfile.error_str());
+        if (!romfile || !emu->insert_rom(romfile))
+            return nullptr;
+        emu->set_log(nullptr);
+        emu->power();
+        return emu;
+    }
+
+public:
+    const Core::Emulator *get(const std::string &path, std::string &messages)
+    {
+        Entry *entry;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            entry = &roms[path];
+        }
+        std::call_once(entry->loaded, [&]() { entry->emu = load(path, messages); });
+        return entry->emu.get();
+    }
+};
+
+static std::vector<Job> read_jobs(Util::File &list, std::string_view name)
+{
+    std::vector<Job> jobs;
+    std::string line;
+    for (unsigned n = 1; list.getline(line); n++) {
+        line = line.substr(0, line.find('#'));
+        auto fields = Util::strsplit(line, ' ');
+        std::erase(fields, "");
+        if (fields.empty())
+            continue;
+        auto frames = fields.size() >= 2 ? Util::strconv<unsigned long>(fields[1], 10) : std::nullopt;
+        if (!frames || fields.size() > 3) {
+            warning("{}:{}: expected ROM FRAMES [MOVIE], skipping\n", name, n);
+            continue;
+        }
+        jobs.push_back({ fields[0], frames.value(), fields.size() == 3 ? fields[2] : "" });
+    }
+    return jobs;
+}
+
+using Movie = std::vector<std::array<uint8, 2>>;
+
+static bool read_movie(const std::string &path, Movie &movie, std::string &messages)
+{
+    Util::File file(path, Util::File::Mode::READ);
+    if (!file) {
+        messages += fmt::format("{}: {}\n", path, file.error_str());
+        return false;
+    }
+    std::string line;
+    for (unsigned n = 1; file.getline(line); n++) {
+        line = line.substr(0, line.find('#'));
+        auto fields = Util::strsplit(line, ' ');
+        std::erase(fields, "");
+        if (fields.empty())
+            continue;
+        std::array<uint8, 2> frame = {};
+        bool valid = fields.size() <= 2;
+        for (std::size_t i = 0; i < fields.size() && valid; i++) {
+            auto buttons = Util::strconv<unsigned>(fields[i], 16);
+            valid = buttons && buttons.value() <= 0xFF;
+            frame[i] = valid ? buttons.value() : 0;
+        }
+        if (!valid) {
+            messages += fmt::format("{}:{}: expected BUTTONS [BUTTONS2]\n", path, n);
+            return false;
+        }
+        movie.push_back(frame);
+    }
+    return true;
+}
+
+static Result run_job(const Job &job, unsigned id, RomCache &roms, const std::string &outdir)
+{
+    Result res;
+    const auto start = std::chrono::steady_clock::now();
+    Movie movie;
+    if (!job.movie.empty() && !read_movie(job.movie, movie, res.messages))
+        return res;
+    auto proto = roms.get(job.rom, res.messages);
+    auto emu = proto ? proto->clone() : nullptr;
+    if (!emu) {
+        res.messages += fmt::format("{}: can't load ROM\n", job.rom);
+        return res;
+    }
+    emu->set_log([&res](Util::Log::Level, std::string_view msg) { res.messages += msg; });
+    Video::Canvas screen { Core::SCREEN_WIDTH, Core::SCREEN_HEIGHT };
+    emu->set_screen(&screen);
+
+    Util::BufferedFile hashes;
+    const auto hashname = fmt::format("{}/{:04}.hashes", outdir, id);
+    if (!outdir.empty() && !hashes.open(hashname, Util::BufferedFile::Mode::WRITE)) {
+        res.messages += fmt::format("{}: {}\n", hashname, hashes.error_str());
+        return res;
+    }
+    for (unsigned long frame = 0; frame < job.frames; frame++) {
+        const auto input = frame < movie.size() ? movie[frame] : std::array<uint8, 2> {};
+        emu->set_buttons(0, input[0]);
+        emu->set_buttons(1, input[1]);
+        emu->run_frame();
+        res.last = emu->frame_hash();
+        if (hashes)
+            hashes.print("{} {:016X} {:016X}\n", frame, res.last.indexed, res.last.rgba);
+    }
+    if (!outdir.empty()) {
+        const auto ramname = fmt::format("{}/{:04}.ram", outdir, id);
+        Util::BufferedFile ram(ramname, Util::BufferedFile::Mode::WRITE);
+        if (!ram) {
+            res.messages += fmt::format("{}: {}\n", ramname, ram.error_str());
+            return res;
+        }
+        ram.write(emu->cpu_ram().data(), emu->cpu_ram().size());
+        ram.write(emu->prg_ram().data(), emu->prg_ram().size());
+        if (!hashes.close() || !ram.close()) {
+            res.messages += fmt::format("{}: can't write results\n", outdir);
+            return res;
+        }
+    }
+    res.ok = true;
+    res.secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return res;
+}
+
+// run_stealing() doesn't start more threads than there are jobs
+static unsigned threads_used(unsigned nthreads, std::size_t njobs)
+{
+    return std::max(1u, unsigned(std::min<std::size_t>(nthreads, njobs)));
+}
+
+static double run_all(const std::vector<Job> &jobs, unsigned nthreads, const std::string &outdir,
+                      std::vector<Result> &results, unsigned &stolen)
+{
+    RomCache roms;
+    results.assign(jobs.size(), {});
+    const auto start = std::chrono::steady_clock::now();
+    stolen = Util::run_stealing(nthreads, jobs.size(), [&](unsigned job, unsigned) {
+        results[job] = run_job(jobs[job], job, roms, outdir);
+    });
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static const Util::ValidArgStruct cmdflags = {
+    { 'h', "help",    "Print this help text and quit" },
+    { 'j', "threads", "Number of threads (default: one per core)",        Util::ParamType::MUST_HAVE },
+    { 'o', "output",  "Write frame hashes and RAM dumps to a directory", Util::ParamType::MUST_HAVE },
+    { 's', "scaling", "Run the jobs on 1, 2, 4 ... 32 threads and report how well it scales" },
+};
+
+int main(int argc, char *argv[])
+{
+    auto flags = Util::parse(argc, argv, cmdflags);
+    if (flags.has['h'] || flags.items.size() != 1) {
+        Util::print_usage("emu-batch", cmdflags);
+        fmt::print("JOBLIST has a job per line: ROM FRAMES [MOVIE]\n");
+        return flags.has['h'] ? 0 : 1;
+    }
+    unsigned nthreads = std::max(std::thread::hardware_concurrency(), 1u);
+    if (flags.has['j']) {
+        auto n = Util::strconv<unsigned>(std::string(flags.params['j']), 10);
+        if (!n || n.value() == 0) {
+            error("{}: invalid number of threads\n", flags.params['j']);
+            return 1;
+        }
+        nthreads = n.value();
+    }
+    std::string listname { flags.items[0] };
+    Util::File list(listname, Util::File::Mode::READ);
+    if (!list) {
+        error("{}: {}\n", listname, list.error_str());
+        return 1;
+    }
+    const auto jobs = read_jobs(list, listname);
+    std::vector<Result> results;
+    unsigned stolen;
+
+    if (flags.has['s']) {
+        double base = 0.0;
+        fmt::print("threads  seconds    jobs/s  speedup  efficiency  stolen\n");
+        for (unsigned n : { 1, 2, 4, 8, 16, 32 }) {
+            const unsigned used = threads_used(n, jobs.size());
+            const double secs = run_all(jobs, used, "", results, stolen);
+            if (n == 1)
+                base = secs;
+            fmt::print("{:7}  {:7.2f}  {:8.1f}  {:7.2f}  {:9.0f}%  {:6}\n",
+                       used, secs, jobs.size() / secs, base / secs, base / secs / used * 100.0, stolen);
+            // every job has a thread of its own already: more can't change anything
+            if (used == jobs.size())
+                break;
+        }
+        return 0;
+    }
+
+    std::string outdir = flags.has['o'] ? std::string(flags.params['o']) : "";
+    std::error_code ec;
+    if (!outdir.empty() && (std::filesystem::create_directories(outdir, ec), ec)) {
+        error("{}: {}\n", outdir, ec.message());
+        return 1;
+    }
+    const double secs = run_all(jobs, nthreads, outdir, results, stolen);
+    unsigned failed = 0;
+    for (std::size_t i = 0; i < jobs.size(); i++) {
+        const auto &r = results[i];
+        if (r.ok)
+            fmt::print("{:04} ok     {} {} {:016X} {:016X} {:.3f}s\n", i, jobs[i].rom, jobs[i].frames,
+                       r.last.indexed, r.last.rgba, r.secs);
+        else
+            fmt::print("{:04} failed {} {}\n", i, jobs[i].rom, jobs[i].frames);
+        fmt::print(stderr, "{}", r.messages);
+        failed += !r.ok;
+    }
+    fmt::print(stderr, "{} jobs ({} failed) on {} threads in {:.2f}s, {} stolen\n",
+               jobs.size(), failed, threads_used(nthreads, jobs.size()), secs, stolen);
+    return failed != 0;
+}
@@ -9,50 +9,78 @@ namespace Core {
 Bus & Bus::operator=(Bus &&b)
 {
     lookup = std::move(b.lookup);
-    for (int i = 0; i < TABSIZ; i++) {
-        readtab[i] = b.readtab[i];
-        writetab[i] = b.writetab[i];
-    }
+    len = b.len;
+    std::copy(b.tab, b.tab + TABSIZ, tab);
+    std::copy(b.areas, b.areas + TABSIZ, areas);
     std::memcpy(assigned, b.assigned, TABSIZ);
+    log = b.log;
     return *this;
 }
 
 void Bus::reset(const std::size_t newsize)
 {
-    lookup.reset(newsize);
+    lookup.reset(new unsigned[newsize]);
+    len = newsize;
+    std::fill(areas, areas + TABSIZ, Area {});
+    std::memset(assigned, 0, TABSIZ);
+}
+
+void Bus::share(const Bus &other)
+{
+    lookup = other.lookup;
+    len = other.len;
+    std::copy(other.areas, other.areas + TABSIZ, areas);
     std::memset(assigned, 0, TABSIZ);
 }
 
-void Bus::map(uint16 start, uint32 end, Reader reader, Writer writer)
+/* Areas before upto were mapped the same as in the table's other owners, but
+ * later ones may have painted over them in there: they go back on top. */
+void Bus::unshare(unsigned upto)
+{
+    std::shared_ptr<unsigned[]> own { new unsigned[len] };
+    std::copy(lookup.get(), lookup.get() + len, own.get());
+    lookup = std::move(own);
+    for (unsigned id = 0; id < upto; id++)
+        if (assigned[id])
+            std::fill(lookup.get() + areas[id].start, lookup.get() + areas[id].end, id);
+}
+
+void Bus::map(uint16 start, uint32 end, void *ctx, Reader reader, Writer writer)
 {
     int id = 0;
 
     // search for a new id
     while (assigned[id]) {
         if (++id > TABSIZ) {
-            error("mapping exausted\n");
+            log.error("mapping exausted\n");
             return;
         }
     }
     assigned[id] = true;
-    readtab[id] = reader;
-    writetab[id] = writer;
-    std::fill(lookup.begin() + start, lookup.begin() + end, id);
+    tab[id] = { reader, writer, ctx };
+    // a shared table already has this area in place if it got mapped the same way
+    const Area area { start, end };
+    if (lookup.use_count() > 1) {
+        if (areas[id] == area)
+            return;
+        unshare(id);
+    }
+    areas[id] = area;
+    std::fill(lookup.get() + start, lookup.get() + end, id);
 }
 
-void Bus::remap(uint16 start, uint32 end, Reader reader, Writer writer)
+void Bus::remap(uint16 start, uint32 end, void *ctx, Reader reader, Writer writer)
 {
     unsigned id = lookup[start];
     if (start != 0 && lookup[start-1] == id) {
-        warning("remap: {} is not the real start of the area\n", start);
+        log.warning("remap: {} is not the real start of the area\n", start);
         return;
     }
     if (lookup[end-1] != id) {
-        warning("remap: {} isn't the real end of the area\n", end);
+        log.warning("remap: {} isn't the real end of the area\n", end);
         return;
     }
-    readtab[id] = reader;
-    writetab[id] = writer;
+    tab[id] = { reader, writer, ctx };
 }
 
 } // namespace Core
@@ -1,21 +1,45 @@
 #ifndef CORE_BUS_HPP_INCLUDED
 #define CORE_BUS_HPP_INCLUDED
 
-#include <functional>
+#include <memory>
 #include <emu/util/unsigned.hpp>
-#include <emu/util/heaparray.hpp>
+#include <emu/util/debug.hpp>
 
 namespace Core {
 
+/* Handlers are plain functions that get back the context pointer given to
+ * map(), usually the component owning the memory. Nothing is captured, so
+ * components can find their state wherever it lives.
+ * The lookup table is the big part of a bus (256k for the CPU's), so buses
+ * mapped the same way can share one: see share(). */
 class Bus {
+public:
+    using Reader = uint8 (*)(void *ctx, uint16 addr);
+    using Writer = void (*)(void *ctx, uint16 addr, uint8 data);
+
+private:
     static const int TABSIZ = 16;
-    using Reader = std::function<uint8(uint16)>;
-    using Writer = std::function<void(uint16, uint8)>;
 
-    Util::HeapArray<unsigned> lookup;
-    Reader readtab[TABSIZ];
-    Writer writetab[TABSIZ];
+    struct Handler {
+        Reader read;
+        Writer write;
+        void *ctx;
+    };
+
+    struct Area {
+        uint32 start = 0, end = 0;
+        bool operator==(const Area &) const = default;
+    };
+
+    std::shared_ptr<unsigned[]> lookup;
+    std::size_t len = 0;
+    Handler tab[TABSIZ];
+    // what each id was mapped to, in the order map() gave them out
+    Area areas[TABSIZ];
     bool assigned[TABSIZ];
+    Util::Log log;
+
+    void unshare(unsigned upto);
 
 public:
     Bus() = default;
@@ -26,13 +50,27 @@ public:
     Bus & operator=(const Bus &) = delete;
     Bus & operator=(Bus &&b);
 
-    void map(uint16 start, uint32 end, Reader reader, Writer writer);
-    void remap(uint16 start, uint32 end, Reader reader, Writer writer);
+    void map(uint16 start, uint32 end, void *ctx, Reader reader, Writer writer);
+    void remap(uint16 start, uint32 end, void *ctx, Reader reader, Writer writer);
     void reset(const std::size_t newsize);
+    // uses other's lookup table, which gets copied only if this bus ends up
+    // mapped differently than other. Nothing is mapped after this either.
+    void share(const Bus &other);
+
+    uint8 read(const uint16 addr) const
+    {
+        const Handler &h = tab[lookup[addr]];
+        return h.read(h.ctx, addr);
+    }
+
+    void write(const uint16 addr, const uint8 data)
+    {
+        const Handler &h = tab[lookup[addr]];
+        h.write(h.ctx, addr, data);
+    }
 
-    uint8 read(const uint16 addr) const             { return readtab[lookup[addr]](addr); }
-    void write(const uint16 addr, const uint8 data) { writetab[lookup[addr]](addr, data); }
-    std::size_t size() const                        { return lookup.size(); }
+    std::size_t size() const                        { return len; }
+    void set_log(Util::Log::Sink sink)              { log.set_sink(std::move(sink)); }
 };
 
 } // namespace Core
@@ -1,10 +1,16 @@
 #include <emu/core/cartridge.hpp>
 
+#include <algorithm>
 #include <cassert>
+#include <filesystem>
 #include <fmt/core.h>
 #include <emu/core/bus.hpp>
+#include <emu/core/romdb.hpp>
 #include <emu/util/file.hpp>
 #include <emu/util/debug.hpp>
+#include <emu/util/hash.hpp>
+#include <emu/util/inflate.hpp>
+#include <emu/util/patch.hpp>
 
 namespace Core {
 
@@ -12,20 +18,36 @@ enum class Format {
     INVALID, INES, NES20,
 };
 
-bool Cartridge::parse(Util::File &romfile)
+/* NES 2.0 ROM sizes: the low byte comes from header[4]/[5], the high nibble
+ * from header[9]. A high nibble of F means the low byte is instead
+ * EEEEEEMM, for a size of 2^E * (MM*2+1) bytes. */
+static uint64 nes20_rom_size(uint8 lsb, uint8 msb, uint32 unit)
 {
-    if (!romfile)
-        return false;
-    name = romfile.filename();
+    if (msb == 0xF)
+        return (uint64(1) << (lsb >> 2)) * ((lsb & 3) * 2 + 1);
+    return (uint64(msb) << 8 | lsb) * unit;
+}
 
-    romfile.bread(header, HEADER_LEN);
+static uint32 nes20_ram_size(uint8 shift) { return shift == 0 ? 0 : 64u << shift; }
+
+// CHR is switched in 1k pages and the PPU sees 8k of it, so smaller sizes
+// (NES 2.0 allows 64 bytes and up) get rounded up.
+static uint32 chrram_pages(uint32 size) { return std::max((size + 0x3FF) & ~0x3FFu, 0x2000u); }
+
+bool Cartridge::parse_header(Util::FileView &&view, std::string_view filename)
+{
+    name = filename;
+    prgrom = chrrom = {};
+    in_db = false;
+    rom = std::make_shared<const Util::FileView>(std::move(view));
+    if (rom->size() < HEADER_LEN)
+        return false;
+    std::copy(rom->data(), rom->data() + HEADER_LEN, header);
 
     Format file_format = Format::INVALID;
     if (header[0] == 'N' && header[1] == 'E' && header[2] == 'S' && header[3] == 0x1A) {
-        if ((header[7] & 0xC) == 0x8)
-            return false; // NES 2.0 is not supported yet
-        file_format = Format::INES;
-        format = "iNES";
+        file_format = (header[7] & 0xC) == 0x8 ? Format::NES20 : Format::INES;
+        format      = file_format == Format::NES20 ? "NES 2.0" : "iNES";
     }
     if (file_format == Format::INVALID)
         return false;
@@ -34,80 +56,265 @@ bool Cartridge::parse(Util::File &romfile)
         nt_mirroring        = (header[6] & 1) == 0 ? Mirroring::HORZ : Mirroring::VERT;
         has.battery         = header[6] & 2;
         has.trainer         = header[6] & 4;
-        // has.fourscreenmode  = header[6] & 8;
+        has.fourscreen      = header[6] & 8;
         // console_type        = header[7] & 3;
-        mapper              = ((header[6] & 0xF0) >> 4) | (header[7] & 0xF0);
+        mapper_id           = ((header[6] & 0xF0) >> 4) | (header[7] & 0xF0);
+        submapper           = 0;
     };
     auto parse_ines = [this]() {
-        if (header[5] == 0)
-            has.chrram = true;
-        prgram_size = header[8];
+        prgrom_size = header[4] * 16384u;
+        chrrom_size = header[5] * 8192u;
+        has.chrram  = header[5] == 0;
+        // boards with PRG RAM almost always have 8k of it
+        prgram_size = std::max(header[8], uint8(1)) * 0x2000u;
+        chrram_size = has.chrram ? 0x2000 : 0;
         // region = header[9] & 1;
         // region = (header[10] & 3);
         has.prgram = header[10] & 0x10;
         // has.bus_conflicts = header[10] & 0x20;
     };
     auto parse_nes20 = [this]() {
-        panic("NES 2.0 isn't supported, this shouldn't be called\n");
+        mapper_id  |= (header[8] & 0x0F) << 8;
+        submapper   = header[8] >> 4;
+        prgrom_size = nes20_rom_size(header[4], header[9] & 0xF, 16384);
+        chrrom_size = nes20_rom_size(header[5], header[9] >> 4,  8192);
+        // volatile and battery backed RAM are mapped in the same place; no
+        // supported board has both.
+        prgram_size = nes20_ram_size(header[10] & 0xF) + nes20_ram_size(header[10] >> 4);
+        chrram_size = nes20_ram_size(header[11] & 0xF) + nes20_ram_size(header[11] >> 4);
+        has.prgram  = prgram_size != 0;
+        has.chrram  = chrrom_size == 0;
+        if (has.chrram)
+            chrram_size = chrram_pages(chrram_size);
+        // timing = header[12] & 3;
+        // vs_type = header[13];
+        // misc_roms = header[14] & 3;
+        // expansion_device = header[15] & 0x3F;
     };
     parse_common();
     file_format == Format::INES ? parse_ines() : parse_nes20();
 
-    if (has.trainer)
-        romfile.bread(trainer, TRAINER_LEN);
-    if (!has.prgram) {
-        prgrom.reset(header[4]*16384);
-        romfile.bread(prgrom.data(), prgrom.size());
+    // NES 2.0 sizes can be anything, but banks are switched in 8k of PRG and
+    // 1k of CHR: a partial page would be read past its end.
+    if (prgrom_size % 0x2000 != 0 || chrrom_size % 0x400 != 0) {
+        log.warning("{}: ROM sizes aren't whole banks ({} bytes of PRG, {} of CHR)\n",
+                    name, prgrom_size, chrrom_size);
+        return false;
+    }
+
+    std::size_t offset = HEADER_LEN;
+    if (has.trainer) {
+        auto t = rom->subspan(offset, TRAINER_LEN);
+        if (t.empty())
+            return false;
+        std::copy(t.begin(), t.end(), trainer);
+        offset += TRAINER_LEN;
+    }
+    prgrom = rom->subspan(offset, prgrom_size);
+    chrrom = rom->subspan(offset + prgrom.size(), chrrom_size);
+    if (prgrom.empty() || prgrom.size() != prgrom_size || chrrom.size() != chrrom_size) {
+        log.warning("{}: file is too short for its header\n", name);
+        return false;
+    }
+    crc = Util::crc32(prgrom.data(), prgrom.size());
+    crc = Util::crc32(chrrom.data(), chrrom.size(), crc);
+
+    // the sizes must match too, or a CRC collision could pick the wrong game.
+    if (auto info = romdb_lookup(crc); info && info->prgrom_size == prgrom_size
+                                            && info->chrrom_size == chrrom_size) {
+        in_db          = true;
+        mapper_id      = info->mapper;
+        submapper      = info->submapper;
+        nt_mirroring   = info->mirroring;
+        has.fourscreen = info->four_screen;
+        has.battery    = info->battery;
+        has.prgram     = info->prgram_size != 0;
+        prgram_size    = info->prgram_size;
+        if (has.chrram)
+            chrram_size = chrram_pages(info->chrram_size);
+    }
+    return true;
+}
+
+Util::FileView Cartridge::read_rom(Util::File &romfile, const Util::Log &log)
+{
+    auto view = romfile.view();
+    if (!Util::is_archive(view.span()))
+        return view;
+    static const unsigned char magic[] = { 'N', 'E', 'S', 0x1A };
+    std::string err;
+    auto unpacked = Util::unpack(view, magic, err);
+    if (!unpacked.data())
+        log.warning("{}: {}\n", romfile.filename(), err);
+    return unpacked;
+}
+
+bool Cartridge::parse(Util::File &romfile, std::span<const std::string> patches)
+{
+    if (!romfile)
+        return false;
+    auto view = read_rom(romfile, log);
+    if (!view.data())
+        return false;
+    for (const auto &path : patches) {
+        Util::File patchfile;
+        if (!patchfile.open(path, Util::File::Mode::READ)) {
+            log.warning("{}: {}\n", path, patchfile.error_str());
+            return false;
+        }
+        std::string err;
+        auto patched = Util::apply_patch(view, patchfile.view(), err);
+        if (!patched.data()) {
+            log.warning("{}: {}\n", path, err);
+            return false;
+        }
+        view = std::move(patched);
     }
-    if (!has.chrram) {
-        chrrom.reset(header[5]*8192);
-        romfile.bread(chrrom.data(), chrrom.size());
+    return load(std::move(view), romfile.filename());
+}
+
+bool Cartridge::load(Util::FileView &&view, std::string_view filename)
+{
+    if (!parse_header(std::move(view), filename))
+        return false;
+    if (has.fourscreen)
+        log.warning("{}: four screen mirroring isn't supported\n", name);
+
+    // PRG RAM is always there, since many boards without it don't say so;
+    // only the first 8k of bigger RAMs are reachable. Battery backed RAM
+    // is read from the save file next to the ROM, which stays mapped.
+    const std::size_t ramsize = std::max(prgram_size, uint32(0x2000));
+    save = {};
+    if (has.battery && !name.empty()) {
+        auto path = std::filesystem::path(name);
+        if (path.extension() == ".gz" || path.extension() == ".zip")
+            path.replace_extension();
+        auto savname = path.replace_extension(".sav").string();
+        if (!save.open(savname, ramsize))
+            log.warning("{}: {}, the game won't be saved\n", savname, save.error_str());
+    } else if (has.battery)
+        log.warning("ROM isn't from a file, the game won't be saved\n");
+    std::fill(std::begin(st->prgram), std::end(st->prgram), 0);
+    if (save.file_backed())
+        std::copy(save.data(), save.data() + PRGRAM_SIZE, st->prgram);
+    return create_mapper();
+}
+
+bool Cartridge::create_mapper()
+{
+    chrram.assign(has.chrram ? chrram_size : 0, 0);
+    mapper = has.chrram ? Mapper::create(mapper_id, prgrom, chrram, chrram)
+                        : Mapper::create(mapper_id, prgrom, chrrom, {});
+    if (!mapper) {
+        log.warning("{}: mapper {} isn't supported\n", name, mapper_id);
+        return false;
     }
+    mapper->attach_state(&st->mapper, {});
     return true;
 }
 
-uint8 Cartridge::read_prgrom(uint16 addr)
+/* Everything about the ROM is the same, and the ROM itself is shared. The
+ * save file isn't: two emulators writing the same save can only go wrong. */
+bool Cartridge::share(const Cartridge &other)
+{
+    name        = other.name;
+    format      = other.format;
+    rom         = other.rom;
+    prgrom      = other.prgrom;
+    chrrom      = other.chrrom;
+    save        = {};
+    std::copy(std::begin(other.header), std::end(other.header), header);
+    std::copy(std::begin(other.trainer), std::end(other.trainer), trainer);
+    mapper_id   = other.mapper_id;
+    submapper   = other.submapper;
+    prgrom_size = other.prgrom_size;
+    chrrom_size = other.chrrom_size;
+    prgram_size = other.prgram_size;
+    chrram_size = other.chrram_size;
+    crc         = other.crc;
+    in_db       = other.in_db;
+    nt_mirroring = other.nt_mirroring;
+    has         = other.has;
+    return create_mapper();
+}
+
+void Cartridge::take(Cartridge &&other)
 {
-    /* mapper defined function to convert addresses goes here */
-    uint16 offset = addr - 0x8000;
-    uint16 start = prgrom.size() - 0x8000;
-    uint16 eff_addr = start + offset;
-    return prgrom[eff_addr];
+    name        = std::move(other.name);
+    format      = std::move(other.format);
+    rom         = std::move(other.rom);
+    prgrom      = other.prgrom;
+    chrrom      = other.chrrom;
+    save        = std::move(other.save);
+    // the mapper points into chrram's buffer, which moves along with it
+    chrram      = std::move(other.chrram);
+    mapper      = std::move(other.mapper);
+    std::copy(std::begin(other.header), std::end(other.header), header);
+    std::copy(std::begin(other.trainer), std::end(other.trainer), trainer);
+    mapper_id   = other.mapper_id;
+    submapper   = other.submapper;
+    prgrom_size = other.prgrom_size;
+    chrrom_size = other.chrrom_size;
+    prgram_size = other.prgram_size;
+    chrram_size = other.chrram_size;
+    crc         = other.crc;
+    in_db       = other.in_db;
+    nt_mirroring = other.nt_mirroring;
+    has         = other.has;
+    *st = *other.st;
+    mapper->attach_state(&st->mapper, {});
 }
 
-uint8 Cartridge::read_chrrom(uint16 addr)
+void Cartridge::attach_state(State *state, std::span<uint8> ram, bool copy)
 {
-    return chrrom[addr];
+    if (copy && state != st)
+        *state = *st;
+    st = state;
+    if (mapper)
+        mapper->attach_state(&st->mapper, ram, copy);
+}
+
+void Cartridge::end_frame()
+{
+    if (save.file_backed()) {
+        save.assign(st->prgram);
+        save.sync();
+    }
+    mapper->end_frame();
 }
 
 std::string Cartridge::getinfo() const
 {
     return fmt::format(
-        "{}: {}, mapper {}, {}x16k PRG ROM, {}x8k CHR ROM, {} PRG RAM, "
-        "{} CHR RAM, {}-Mirror{}{}",
-        name, format, mapper,
-        header[4], header[5],
-        // chrrom.size(),
-        has.prgram ? prgram_size : 0,
-        has.chrram ? chrram_size : 0,
-        nt_mirroring == Mirroring::HORZ ? 'H' : 'V',
+        "{}: {}, mapper {}{}, {}k PRG ROM, {}k CHR ROM, {}k PRG RAM, "
+        "{}k CHR RAM, {}-Mirror{}{}, CRC32 {:08X}{}",
+        name, format, mapper_id,
+        submapper != 0 ? fmt::format(".{}", submapper) : "",
+        prgrom_size / 1024, chrrom_size / 1024,
+        has.prgram ? prgram_size / 1024 : 0,
+        has.chrram ? chrram_size / 1024 : 0,
+        has.fourscreen ? '4' : nt_mirroring == Mirroring::HORZ ? 'H' : 'V',
         has.battery ? ", contains SRAM" : "",
-        has.trainer ? ", contains Trainer" : ""
+        has.trainer ? ", contains Trainer" : "",
+        crc, in_db ? " (found in database)" : ""
     );
 }
 
 void Cartridge::attach_bus(Bus *rambus, Bus *vrambus)
 {
-    rambus->map(CARTRIDGE_START, 0x8000,
-            [this] (uint16 addr) { return 0; },
-            [this] (uint16 addr, uint8 data) { /***********/ });
-    rambus->map(0x8000, CPUBUS_SIZE,
-            [this] (uint16 addr) { return read_prgrom(addr); },
-            [this] (uint16 addr, uint8 data) { /***********/ });
-    vrambus->map(PT_START, NT_START,
-            [this] (uint16 addr) { return read_chrrom(addr); },
-            [this] (uint16 addr, uint8 data) { /***********/ });
+    rambus->map(CARTRIDGE_START, 0x6000, this,
+            [](void *, uint16 addr)             { return uint8(0); },
+            [](void *, uint16 addr, uint8 data) { /***********/ });
+    rambus->map(0x6000, 0x8000, this,
+            [](void *cart, uint16 addr)             { return static_cast<Cartridge *>(cart)->st->prgram[addr - 0x6000]; },
+            [](void *cart, uint16 addr, uint8 data) { static_cast<Cartridge *>(cart)->st->prgram[addr - 0x6000] = data; });
+    // writes to ROM are how mappers get programmed
+    rambus->map(0x8000, CPUBUS_SIZE, mapper.get(),
+            [](void *m, uint16 addr)             { return static_cast<Mapper *>(m)->read_prg(addr); },
+            [](void *m, uint16 addr, uint8 data) { static_cast<Mapper *>(m)->write_prg(addr, data); });
+    vrambus->map(PT_START, NT_START, mapper.get(),
+            [](void *m, uint16 addr)             { return static_cast<Mapper *>(m)->read_chr(addr); },
+            [](void *m, uint16 addr, uint8 data) { static_cast<Mapper *>(m)->write_chr(addr, data); });
 }
 
 } // namespace Core
-
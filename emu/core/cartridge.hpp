@@ -1,12 +1,16 @@
 #ifndef CORE_CARTRIDGE_HPP_INCLUDED
 #define CORE_CARTRIDGE_HPP_INCLUDED
 
+#include <memory>
+#include <span>
+#include <string>
 #include <string_view>
+#include <vector>
 #include <emu/core/const.hpp>
+#include <emu/core/mapper.hpp>
 #include <emu/util/unsigned.hpp>
-#include <emu/util/heaparray.hpp>
-
-namespace Util { class File; }
+#include <emu/util/file.hpp>
+#include <emu/util/debug.hpp>
 
 namespace Core {
 
@@ -15,16 +19,40 @@ class Bus;
 class Cartridge {
     static const int HEADER_LEN = 16;
     static const int TRAINER_LEN = 512;
+    static const int PRGRAM_SIZE = 0x2000;
+
+public:
+    struct State {
+        uint8 prgram[PRGRAM_SIZE] = {};
+        Mapper::State mapper;
+    };
 
+private:
+    State own{};
+    State *st = &own;
     std::string name, format;
-    Util::HeapArray<uint8> prgrom;
-    Util::HeapArray<uint8> chrrom;
+    // PRG ROM and CHR ROM point straight into the ROM file's contents,
+    // which clones share.
+    std::shared_ptr<const Util::FileView> rom;
+    std::span<const uint8> prgrom;
+    std::span<const uint8> chrrom;
+    // battery backed PRG RAM, mapped from the save file
+    Util::MappedMemory save;
+    // until attach_state() gives it a place in a state block
+    std::vector<uint8> chrram;
+    std::unique_ptr<Mapper> mapper;
+    Util::Log log;
     uint8 header[HEADER_LEN];
     uint8 trainer[TRAINER_LEN];
-    uint16 mapper = 0;
+    uint16 mapper_id = 0;
     uint8 submapper = 0;
+    uint64 prgrom_size = 0;
+    uint64 chrrom_size = 0;
     uint32 prgram_size = 0;
     uint32 chrram_size = 0;
+    // CRC-32 of PRG ROM and CHR ROM
+    uint32 crc = 0;
+    bool in_db = false;
     Mirroring nt_mirroring = Mirroring::VERT;
 
     struct {
@@ -32,18 +60,63 @@ class Cartridge {
         bool chrram  = false;
         bool battery = false;
         bool trainer = false;
+        bool fourscreen = false;
     } has;
 
+    bool create_mapper();
+
 public:
-    bool parse(Util::File &romfile);
-    uint8 read_prgrom(uint16 addr);
-    uint8 read_chrrom(uint16 addr);
+    // patches (IPS, UPS, BPS) are applied in order, in memory.
+    bool parse(Util::File &romfile, std::span<const std::string> patches = {});
+    // the same for a ROM already read (and patched). The save file goes next
+    // to filename; there's none if it's empty.
+    bool load(Util::FileView &&view, std::string_view filename);
+    // the file's contents; for .gz and .zip files, the ROM inside them.
+    // empty on errors.
+    static Util::FileView read_rom(Util::File &romfile, const Util::Log &log = {});
+    // reads the header and hashes the ROM, without setting up RAM or the
+    // mapper. Good for looking at many ROMs quickly.
+    bool parse_header(Util::FileView &&view, std::string_view filename);
+    // same ROM and mapper as other, for clones. Clones don't get the save file.
+    bool share(const Cartridge &other);
+    /* Everything from other, which must have loaded a ROM, but this one's
+     * log and place for its state. ROMs are loaded into a scratch Cartridge
+     * and then taken, so that one that fails to load changes nothing. */
+    void take(Cartridge &&other);
+    bool loaded() const         { return mapper != nullptr; }
+    // the current state is copied to state, CHR RAM to chrram, unless
+    // copy is false and they're taken as they are.
+    void attach_state(State *state, std::span<uint8> chrram, bool copy = true);
     void attach_bus(Bus *rambus, Bus *vrambus);
+    void set_log(Util::Log::Sink sink) { log.set_sink(std::move(sink)); }
     std::string getinfo() const;
+    void power()                { mapper->power(); }
+    // once per frame: writes saves back (only if the game wrote to its RAM)
+    // and updates the CHR RAM counters.
+    void end_frame();
+    // before CHR RAM is overwritten with ram, so that changed tiles count as rewritten.
+    void chrram_replaced(std::span<const uint8> ram) { mapper->chrram_replaced(ram); }
+    unsigned tiles_rewritten() const                 { return mapper->tiles_rewritten(); }
+    std::span<const uint32> tile_generations() const { return mapper->tile_generations(); }
+    uint32 chr_generation() const                    { return mapper->chr_generation(); }
+    void on_mirroring_change(Mapper::MirroringCallback callback) { mapper->on_mirroring_change(callback); }
+    void on_irq(Mapper::IrqCallback callback) { mapper->on_irq(callback); }
+    bool watches_a12() const    { return mapper->watches_a12(); }
+    void a12_rise()             { mapper->a12_rise(); }
 
-    uint16 mappertype() const   { return mapper; }
+    uint16 mappertype() const   { return mapper_id; }
+    uint8 submappertype() const { return submapper; }
+    uint32 crc32() const        { return crc; }
     bool hasprgram() const      { return has.prgram; }
     bool haschrram() const      { return has.chrram; }
+    bool hasbattery() const     { return has.battery; }
+    bool hasfourscreen() const  { return has.fourscreen; }
+    bool isnes20() const        { return format == "NES 2.0"; }
+    bool indatabase() const     { return in_db; }
+    uint64 prgromsize() const   { return prgrom_size; }
+    uint64 chrromsize() const   { return chrrom_size; }
+    uint32 prgramsize() const   { return has.prgram ? prgram_size : 0; }
+    uint32 chrramsize() const   { return has.chrram ? chrram_size : 0; }
     Mirroring mirroring() const { return nt_mirroring; }
 };
 
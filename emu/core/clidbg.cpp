@@ -256,7 +256,8 @@ static bool exec_command(Debugger &dbg, const Command cmd, const CmdArgs &args)
     }
 
     case Command::TRACE: {
-        Util::File f(args[0], Util::File::Mode::WRITE);
+        // traces get big fast and are rarely read back right away
+        Util::BufferedFile f(args[0], Util::BufferedFile::Mode::WRITE, Util::BufferedFile::NOCACHE);
         if (!f)
             fmt::print("{}\n", f.error_str());
         else
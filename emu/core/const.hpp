@@ -31,14 +31,31 @@ enum {
     // Screen contants, used by the PPU.
     SCREEN_WIDTH    = 256,
     SCREEN_HEIGHT   = 240,
-    LINE_MAX        = 262,
+    SCANLINE_MAX    = 262,
     CYCLE_MAX       = 341,
 };
 
+// standard controller buttons, in the order they're read out.
+enum Button : unsigned char {
+    BUTTON_A      = 1 << 0,
+    BUTTON_B      = 1 << 1,
+    BUTTON_SELECT = 1 << 2,
+    BUTTON_START  = 1 << 3,
+    BUTTON_UP     = 1 << 4,
+    BUTTON_DOWN   = 1 << 5,
+    BUTTON_LEFT   = 1 << 6,
+    BUTTON_RIGHT  = 1 << 7,
+};
+
+// frames per second of an NTSC NES.
+inline constexpr double NTSC_FPS = 60.0988;
+
 // OTHER is usually mapper defined.
 enum class Mirroring {
     VERT,
     HORZ,
+    SINGLE_LOW,     // every nametable shows the first 1k of VRAM
+    SINGLE_HIGH,    // same, with the second 1k
     OTHER,
 };
 
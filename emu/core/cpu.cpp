@@ -1,7 +1,7 @@
 #include <emu/core/cpu.hpp>
 
+#include <algorithm>
 #include <fmt/core.h>
-#include <emu/util/easyrandom.hpp>
 #include <emu/util/debug.hpp>
 
 namespace Core {
@@ -12,76 +12,110 @@ namespace Core {
 
 void CPU::run()
 {
-    if (execnmi) {
+    if (st->execnmi) {
         cycle();
         interrupt();
-        execnmi = false;
+        st->execnmi = false;
         return;
     }
-    if (execirq) {
+    if (st->execirq) {
         cycle();
         interrupt();
-        execirq = false;
+        st->execirq = false;
         return;
     }
     execute(fetch());
 }
 
-void CPU::power()
+void CPU::power(Util::Random *rng)
 {
-    r.acc = r.x = r.y = 0;
-    for (uint16 i = 0; i < 0x800; i++)
-        bus->write(i, 0); //Util::random8());
-    r.flags.reset();
+    st->r.acc = st->r.x = st->r.y = 0;
+    if (rng)
+        rng->fill(st->rammem);
+    else
+        std::fill(std::begin(st->rammem), std::end(st->rammem), 0);
+    st->r.flags.reset();
     // these are probably APU regs. i'll add them later. for now this is enough.
     bus->write(0x4017, 0);
     bus->write(0x4015, 0);
     for (uint16 i = 0x4000; i < 0x4013; i++)
         bus->write(i, 0);
-    r.sp = 0;
+    st->r.sp = 0;
     // an interrupt is performed during 6502 start up. this is why SP = $FD.
-    resetpending = true;
+    st->resetpending = true;
     interrupt();
 }
 
 void CPU::reset()
 {
     bus->write(0x4015, 0);
-    resetpending = true;
+    st->resetpending = true;
     interrupt();
 }
 
+/* A controller shifts out a button per read, A first; past the eighth read
+ * official ones return 1s. The top bits are open bus, usually $40. */
+uint8 CPU::read_apu_reg(uint16 addr)
+{
+    if (addr != 0x4016 && addr != 0x4017)
+        return 0;
+    const unsigned port = addr & 1;
+    if (st->pad_strobe)
+        return 0x40 | (pad_buttons[port] & 1);
+    const uint8 bit = st->pad_shift[port] & 1;
+    st->pad_shift[port] = st->pad_shift[port] >> 1 | 0x80;
+    return 0x40 | bit;
+}
+
+void CPU::write_apu_reg(uint16 addr, uint8 data)
+{
+    if (addr != 0x4016)
+        return;
+    st->pad_strobe = data & 1;
+    if (st->pad_strobe) {
+        st->pad_shift[0] = pad_buttons[0];
+        st->pad_shift[1] = pad_buttons[1];
+    }
+}
+
 void CPU::attach_bus(Bus *rambus)
 {
     bus = rambus;
-    bus->map(RAM_START, PPUREG_START,
-        [this](uint16 addr)             { return rammem[addr & 0x7FF]; },
-        [this](uint16 addr, uint8 data) { rammem[addr & 0x7FF] = data; });
-    bus->map(APU_START, CARTRIDGE_START,
-        [this](uint16 addr)             { return read_apu_reg(addr); },
-        [this](uint16 addr, uint8 data) { write_apu_reg(addr, data); });
+    bus->map(RAM_START, PPUREG_START, this,
+        [](void *cpu, uint16 addr)             { return static_cast<CPU *>(cpu)->st->rammem[addr & 0x7FF]; },
+        [](void *cpu, uint16 addr, uint8 data) { static_cast<CPU *>(cpu)->st->rammem[addr & 0x7FF] = data; });
+    bus->map(APU_START, CARTRIDGE_START, this,
+        [](void *cpu, uint16 addr)             { return static_cast<CPU *>(cpu)->read_apu_reg(addr); },
+        [](void *cpu, uint16 addr, uint8 data) { static_cast<CPU *>(cpu)->write_apu_reg(addr, data); });
 }
 
 /* Sends an IRQ signal. */
 void CPU::fire_irq()
 {
-    irqpending = true;
+    st->irqpending = true;
+}
+
+/* Takes back an IRQ signal that the CPU hasn't handled yet (for example,
+ * a mapper's IRQ being acknowledged before interrupts are enabled). */
+void CPU::clear_irq()
+{
+    st->irqpending = false;
 }
 
 /* Sends an NMI signal */
 void CPU::fire_nmi()
 {
-    nmipending = true;
+    st->nmipending = true;
 }
 
 CPU::Status CPU::status() const
 {
-    Status st;
-    st.regs = r;
-    st.instr.id      = bus->read(r.pc.full);
-    st.instr.op.low  = bus->read(r.pc.full+1);
-    st.instr.op.high = bus->read(r.pc.full+2);
-    return st;
+    Status ret;
+    ret.regs = st->r;
+    ret.instr.id      = bus->read(st->r.pc.full);
+    ret.instr.op.low  = bus->read(st->r.pc.full+1);
+    ret.instr.op.high = bus->read(st->r.pc.full+2);
+    return ret;
 }
 
 /* The method used here is emulating some risky instructions to find out the next
@@ -90,15 +124,15 @@ CPU::Status CPU::status() const
  * I prefer this method since this means the function can be const. */
 uint16 CPU::nextaddr() const
 {
-    uint16 id = bus->read(r.pc.full);
+    uint16 id = bus->read(st->r.pc.full);
     Reg16 op;
-    op.low  = bus->read(r.pc.full + 1);
-    op.high = bus->read(r.pc.full + 2);
+    op.low  = bus->read(st->r.pc.full + 1);
+    op.high = bus->read(st->r.pc.full + 2);
 
     switch (id) {
     case 0x00:
-        return resetpending ? RESET_VEC
-            :  nmipending   ? NMI_VEC
+        return st->resetpending ? RESET_VEC
+            :  st->nmipending   ? NMI_VEC
             :                 IRQ_BRK_VEC;
     case 0x20: case 0x4C:
         return op.full;
@@ -106,12 +140,12 @@ uint16 CPU::nextaddr() const
         return op.low == 0xFF ? bus->read(op.full) | bus->read(op.full & 0xFF00) << 8
                               : bus->read(op.full) | bus->read(op.full + 1)      << 8;
     case 0x60:
-        return 1 + (bus->read(r.sp + 1 + STACK_BASE) | bus->read(r.sp + 2 + STACK_BASE) << 8);
+        return 1 + (bus->read(st->r.sp + 1 + STACK_BASE) | bus->read(st->r.sp + 2 + STACK_BASE) << 8);
     case 0x40:
-        return      bus->read(r.sp + 1 + STACK_BASE) | bus->read(r.sp + 2 + STACK_BASE) << 8;
+        return      bus->read(st->r.sp + 1 + STACK_BASE) | bus->read(st->r.sp + 2 + STACK_BASE) << 8;
     default:
-        return took_branch(id, r.flags) ? branch_pointer(op.low, r.pc.full)
-                                        : r.pc.full + num_bytes(id);
+        return took_branch(id, st->r.flags) ? branch_pointer(op.low, st->r.pc.full)
+                                        : st->r.pc.full + num_bytes(id);
     }
 }
 
@@ -120,9 +154,9 @@ uint16 CPU::nextaddr() const
 uint8 CPU::fetch()
 {
     if (fetch_callback)
-        fetch_callback(status(), r.pc.full, 'x');
+        fetch_callback(status(), st->r.pc.full, 'x');
     cycle();
-    return bus->read(r.pc.full++);
+    return bus->read(st->r.pc.full++);
 }
 
 // This is here mostly so we can differentiate between actual instructions
@@ -130,7 +164,7 @@ uint8 CPU::fetch()
 uint8 CPU::fetchop()
 {
     cycle();
-    return bus->read(r.pc.full++);
+    return bus->read(st->r.pc.full++);
 }
 
 void CPU::execute(uint8 instr)
@@ -154,11 +188,11 @@ void CPU::execute(uint8 instr)
         INSTR_AMODE(0x0A, asl, accum, modify)
         INSTR_AMODE(0x0D, ora, abs, read)
         INSTR_AMODE(0x0E, asl, abs, modify)
-        INSTR_OTHER(0x10, branch, r.flags.neg == 0)     // bpl
+        INSTR_OTHER(0x10, branch, st->r.flags.neg == 0)     // bpl
         INSTR_AMODE(0x11, ora, indy, read)
         INSTR_AMODE(0x15, ora, zerox, read)
         INSTR_AMODE(0x16, asl, zerox, modify)
-        INSTR_OTHER(0x18, flag, r.flags.carry, false)   // clc
+        INSTR_OTHER(0x18, flag, st->r.flags.carry, false)   // clc
         INSTR_AMODE(0x19, ora, absy, read)
         INSTR_AMODE(0x1D, ora, absx, read)
         INSTR_AMODE(0x1E, asl, absx, modify)
@@ -173,11 +207,11 @@ void CPU::execute(uint8 instr)
         INSTR_AMODE(0x2C, bit, abs, read)
         INSTR_AMODE(0x2D, and, abs, read)
         INSTR_AMODE(0x2E, rol, abs, modify)
-        INSTR_OTHER(0x30, branch, r.flags.neg == 1)     // bmi
+        INSTR_OTHER(0x30, branch, st->r.flags.neg == 1)     // bmi
         INSTR_AMODE(0x31, and, indy, read)
         INSTR_AMODE(0x35, and, zerox, read)
         INSTR_AMODE(0x36, rol, zerox, modify)
-        INSTR_OTHER(0x38, flag, r.flags.carry, true)    //sec
+        INSTR_OTHER(0x38, flag, st->r.flags.carry, true)    //sec
         INSTR_AMODE(0x39, and, absy, read)
         INSTR_AMODE(0x3D, and, absx, read)
         INSTR_AMODE(0x3E, rol, absx, modify)
@@ -191,11 +225,11 @@ void CPU::execute(uint8 instr)
         INSTR_IMPLD(0x4C, jmp)
         INSTR_AMODE(0x4D, eor, abs, read)
         INSTR_AMODE(0x4E, lsr, abs, modify)
-        INSTR_OTHER(0x50, branch, r.flags.ov == 0)      // bvc
+        INSTR_OTHER(0x50, branch, st->r.flags.ov == 0)      // bvc
         INSTR_AMODE(0x51, eor, indy, read)
         INSTR_AMODE(0x55, eor, zerox, read)
         INSTR_AMODE(0x56, lsr, zerox, modify)
-        INSTR_OTHER(0x58, flag, r.flags.intdis, false)  //cli
+        INSTR_OTHER(0x58, flag, st->r.flags.intdis, false)  //cli
         INSTR_AMODE(0x59, eor, absy, read)
         INSTR_AMODE(0x5D, eor, absx, read)
         INSTR_AMODE(0x5E, lsr, absx, modify)
@@ -209,52 +243,52 @@ void CPU::execute(uint8 instr)
         INSTR_IMPLD(0x6C, jmp_ind)
         INSTR_AMODE(0x6D, adc, abs, read)
         INSTR_AMODE(0x6E, ror, abs, modify)
-        INSTR_OTHER(0x70, branch, r.flags.ov == 1)      // bvs
+        INSTR_OTHER(0x70, branch, st->r.flags.ov == 1)      // bvs
         INSTR_AMODE(0x71, adc, indy, read)
         INSTR_AMODE(0x75, adc, zerox, read)
         INSTR_AMODE(0x76, ror, zerox, modify)
-        INSTR_OTHER(0x78, flag, r.flags.intdis, true)   //sei
+        INSTR_OTHER(0x78, flag, st->r.flags.intdis, true)   //sei
         INSTR_AMODE(0x79, adc, absy, read)
         INSTR_AMODE(0x7D, adc, absx, read)
         INSTR_AMODE(0x7E, ror, absx, modify)
-        INSTR_WRITE(0x81, indx, r.acc)                      // sta
-        INSTR_WRITE(0x84, zero, r.y)                       // sty
-        INSTR_WRITE(0x85, zero, r.acc)                      // sta
-        INSTR_WRITE(0x86, zero, r.x)                       // stx
+        INSTR_WRITE(0x81, indx, st->r.acc)                      // sta
+        INSTR_WRITE(0x84, zero, st->r.y)                       // sty
+        INSTR_WRITE(0x85, zero, st->r.acc)                      // sta
+        INSTR_WRITE(0x86, zero, st->r.x)                       // stx
         INSTR_IMPLD(0x88, dey)
-        INSTR_OTHER(0x8A, transfer, r.x, r.acc)            // txa
-        INSTR_WRITE(0x8C, abs, r.y)                        // sty
-        INSTR_WRITE(0x8D, abs, r.acc)                       // sta
-        INSTR_WRITE(0x8E, abs, r.x)                        // stx
-        INSTR_OTHER(0x90, branch, r.flags.carry == 0)    // bcc
-        INSTR_WRITE(0x91, indy, r.acc)                      // sta
-        INSTR_WRITE(0x94, zerox, r.y)                      // sty
-        INSTR_WRITE(0x95, zerox, r.acc)                     // sta
-        INSTR_WRITE(0x96, zeroy, r.x)                      // stx
-        INSTR_OTHER(0x98, transfer, r.y, r.acc)            // tya
-        INSTR_WRITE(0x99, absy, r.acc)                      // sta
-        INSTR_OTHER(0x9A, transfer, r.x, r.sp)               // txs
-        INSTR_WRITE(0x9D, absx, r.acc)                      // sta
+        INSTR_OTHER(0x8A, transfer, st->r.x, st->r.acc)            // txa
+        INSTR_WRITE(0x8C, abs, st->r.y)                        // sty
+        INSTR_WRITE(0x8D, abs, st->r.acc)                       // sta
+        INSTR_WRITE(0x8E, abs, st->r.x)                        // stx
+        INSTR_OTHER(0x90, branch, st->r.flags.carry == 0)    // bcc
+        INSTR_WRITE(0x91, indy, st->r.acc)                      // sta
+        INSTR_WRITE(0x94, zerox, st->r.y)                      // sty
+        INSTR_WRITE(0x95, zerox, st->r.acc)                     // sta
+        INSTR_WRITE(0x96, zeroy, st->r.x)                      // stx
+        INSTR_OTHER(0x98, transfer, st->r.y, st->r.acc)            // tya
+        INSTR_WRITE(0x99, absy, st->r.acc)                      // sta
+        INSTR_OTHER(0x9A, transfer, st->r.x, st->r.sp)               // txs
+        INSTR_WRITE(0x9D, absx, st->r.acc)                      // sta
         INSTR_AMODE(0xA0, ldy, imm, read)
         INSTR_AMODE(0xA1, lda, indx, read)
         INSTR_AMODE(0xA2, ldx, imm, read)
         INSTR_AMODE(0xA4, ldy, zero, read)
         INSTR_AMODE(0xA5, lda, zero, read)
         INSTR_AMODE(0xA6, ldx, zero, read)
-        INSTR_OTHER(0xA8, transfer, r.acc, r.y)            // tay
+        INSTR_OTHER(0xA8, transfer, st->r.acc, st->r.y)            // tay
         INSTR_AMODE(0xA9, lda, imm, read)
-        INSTR_OTHER(0xAA, transfer, r.acc, r.x)            // tax
+        INSTR_OTHER(0xAA, transfer, st->r.acc, st->r.x)            // tax
         INSTR_AMODE(0xAC, ldy, abs, read)
         INSTR_AMODE(0xAD, lda, abs, read)
         INSTR_AMODE(0xAE, ldx, abs, read)
-        INSTR_OTHER(0xB0, branch, r.flags.carry == 1)    // bcs
+        INSTR_OTHER(0xB0, branch, st->r.flags.carry == 1)    // bcs
         INSTR_AMODE(0xB1, lda, indy, read)
         INSTR_AMODE(0xB4, ldy, zerox, read)
         INSTR_AMODE(0xB5, lda, zerox, read)
         INSTR_AMODE(0xB6, ldx, zeroy, read)
-        INSTR_OTHER(0xB8, flag, r.flags.ov, false)       // clv
+        INSTR_OTHER(0xB8, flag, st->r.flags.ov, false)       // clv
         INSTR_AMODE(0xB9, lda, absy, read)
-        INSTR_OTHER(0xBA, transfer, r.sp, r.x)               // tsx
+        INSTR_OTHER(0xBA, transfer, st->r.sp, st->r.x)               // tsx
         INSTR_AMODE(0xBC, ldy, absx, read)
         INSTR_AMODE(0xBD, lda, absx, read)
         INSTR_AMODE(0xBE, ldx, absy, read)
@@ -269,11 +303,11 @@ void CPU::execute(uint8 instr)
         INSTR_AMODE(0xCC, cpy, abs, read)
         INSTR_AMODE(0xCD, cmp, abs, read)
         INSTR_AMODE(0xCE, dec, abs, modify)
-        INSTR_OTHER(0xD0, branch, r.flags.zero == 0)    // bne
+        INSTR_OTHER(0xD0, branch, st->r.flags.zero == 0)    // bne
         INSTR_AMODE(0xD1, cmp, indy, read)
         INSTR_AMODE(0xD5, cmp, zerox, read)
         INSTR_AMODE(0xD6, dec, zerox, modify)
-        INSTR_OTHER(0xD8, flag, r.flags.decimal, false) //cld
+        INSTR_OTHER(0xD8, flag, st->r.flags.decimal, false) //cld
         INSTR_AMODE(0xD9, cmp, absy, read)
         INSTR_AMODE(0xDD, cmp, absx, read)
         INSTR_AMODE(0xDE, dec, absx, modify)
@@ -288,11 +322,11 @@ void CPU::execute(uint8 instr)
         INSTR_AMODE(0xEC, cpx, abs, read)
         INSTR_AMODE(0xED, sbc, abs, read)
         INSTR_AMODE(0xEE, inc, abs, modify)
-        INSTR_OTHER(0xF0, branch, r.flags.zero == 1)    // beq
+        INSTR_OTHER(0xF0, branch, st->r.flags.zero == 1)    // beq
         INSTR_AMODE(0xF1, sbc, indy, read)
         INSTR_AMODE(0xF5, sbc, zerox, read)
         INSTR_AMODE(0xF6, inc, zerox, modify)
-        INSTR_OTHER(0xF8, flag, r.flags.decimal, true)   // sed
+        INSTR_OTHER(0xF8, flag, st->r.flags.decimal, true)   // sed
         INSTR_AMODE(0xF9, sbc, absy, read)
         INSTR_AMODE(0xFD, sbc, absx, read)
         INSTR_AMODE(0xFE, inc, absx, modify)
@@ -310,46 +344,46 @@ void CPU::interrupt()
 {
     // one cycle for reading next instruction byte and throw away
     cycle();
-    push(r.pc.high);
-    push(r.pc.low);
-    push(r.flags);
+    push(st->r.pc.high);
+    push(st->r.pc.low);
+    push(st->r.flags);
     // reset this here just in case
-    r.flags.breakf = 0;
-    r.flags.intdis = 1;
+    st->r.flags.breakf = 0;
+    st->r.flags.intdis = 1;
     // interrupt hijacking
     // reset is put at the top so that it will always run. i'm not sure if
     // this is the actual behavior - nesdev says nothing about it.
     uint16 vec;
-    if (resetpending) {
-        resetpending = false;
+    if (st->resetpending) {
+        st->resetpending = false;
         vec = RESET_VEC;
-    } else if (nmipending) {
-        nmipending = false;
+    } else if (st->nmipending) {
+        st->nmipending = false;
         vec = NMI_VEC;
-    } else if (irqpending) {
-        irqpending = false;
+    } else if (st->irqpending) {
+        st->irqpending = false;
         vec = IRQ_BRK_VEC;
     } else
         vec = IRQ_BRK_VEC;
-    r.pc.low = readmem(vec);
-    r.pc.high = readmem(vec+1);
+    st->r.pc.low = readmem(vec);
+    st->r.pc.high = readmem(vec+1);
 }
 
 void CPU::push(uint8 val)
 {
-    writemem(r.sp + STACK_BASE, val);
-    r.sp--;
+    writemem(st->r.sp + STACK_BASE, val);
+    st->r.sp--;
 }
 
 uint8 CPU::pull()
 {
-    ++r.sp;
-    return readmem(r.sp + STACK_BASE);
+    ++st->r.sp;
+    return readmem(st->r.sp + STACK_BASE);
 }
 
 void CPU::cycle()
 {
-    r.cycles++;
+    st->r.cycles++;
 }
 
 // NOTE: doesn't increment cycles!
@@ -361,14 +395,14 @@ void CPU::last_cycle()
 
 void CPU::irqpoll()
 {
-    if (!execirq && !r.flags.intdis && irqpending)
-        execirq = true;
+    if (!st->execirq && !st->r.flags.intdis && st->irqpending)
+        st->execirq = true;
 }
 
 void CPU::nmipoll()
 {
-    if (!execnmi && nmipending)
-        execnmi = true;
+    if (!st->execnmi && st->nmipending)
+        st->execnmi = true;
 }
 
 uint8 CPU::readmem(uint16 addr)
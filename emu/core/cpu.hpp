@@ -7,12 +7,11 @@
 #include <emu/core/bus.hpp>
 #include <emu/core/instrinfo.hpp>
 #include <emu/util/unsigned.hpp>
+#include <emu/util/easyrandom.hpp>
 
 namespace Core {
 
 class CPU {
-    Bus *bus = nullptr;
-
     // registers
     struct Regs {
         Reg16 pc  = 0;
@@ -22,27 +21,62 @@ class CPU {
         uint8 sp  = 0;
         ProcStatus flags;
         unsigned long cycles = 0;
-    } r;
-
-    // interrupt signals
-    bool nmipending = false;
-    bool irqpending = false;
-    bool resetpending = false;
-    bool execnmi    = false;
-    bool execirq    = false;
+    };
 
-    // used in instructions.cpp
-    Reg16 opargs = 0;
+public:
+    /* Everything that changes while running, kept apart so that an
+     * emulator can have the state of all its parts in a single block (see
+     * Emulator::State). Until attach_state() the CPU uses its own. */
+    struct State {
+        Regs r;
+
+        // interrupt signals
+        bool nmipending = false;
+        bool irqpending = false;
+        bool resetpending = false;
+        bool execnmi    = false;
+        bool execirq    = false;
+
+        // used in instructions.cpp
+        Reg16 opargs = 0;
+
+        // controller shift registers, reloaded while strobe is on
+        uint8 pad_shift[2] = {};
+        bool pad_strobe = false;
+
+        uint8 rammem[RAM_SIZE] = {};
+    };
 
-    uint8 rammem[RAM_SIZE];
+private:
+    Bus *bus = nullptr;
+    State own{};
+    State *st = &own;
+    // buttons held down: input, not state
+    uint8 pad_buttons[2] = {};
 
 public:
+    CPU() = default;
+    CPU(const CPU &) = delete;
+    CPU & operator=(const CPU &) = delete;
+
+    // the current state is copied to state, which is used from then on.
+    // without copy, state is taken as it is.
+    void attach_state(State *state, bool copy = true)
+    {
+        if (copy && state != st)
+            *state = *st;
+        st = state;
+    }
     void run();
-    void power();
+    // with rng, RAM starts out random instead of zeroed.
+    void power(Util::Random *rng = nullptr);
     void reset();
     void attach_bus(Bus *rambus);
     void fire_irq();
+    void clear_irq();
     void fire_nmi();
+    // port 0 or 1, buttons is a mask of Button
+    void set_buttons(unsigned port, uint8 buttons) { pad_buttons[port & 1] = buttons; }
 
     struct Status {
         Regs regs;
@@ -60,7 +94,7 @@ public:
     Status status() const;
     uint16 nextaddr() const;
 
-    unsigned long get_cycles() { return r.cycles; }
+    unsigned long get_cycles() { return st->r.cycles; }
     void register_fetch_callback(auto &&callback) { fetch_callback = callback; }
 
 private:
@@ -154,8 +188,9 @@ private:
     uint8 readmem(uint16 addr);
     void writemem(uint16 addr, uint8 data);
 
-    uint8 read_apu_reg(uint16 addr) { return 0; }
-    void write_apu_reg(uint16 addr, uint8 data) { }
+    // only the controllers so far
+    uint8 read_apu_reg(uint16 addr);
+    void write_apu_reg(uint16 addr, uint8 data);
 
     friend class Debugger;
 };
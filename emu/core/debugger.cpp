@@ -12,7 +12,7 @@ void Debugger::fetch_callback(CPU::Status &&st, uint16 addr, char mode)
     if (quit)
         return;
     if (!callback) {
-        warning("No callback set in the debugger\n");
+        emu->log.warning("No callback set in the debugger\n");
         return;
     }
 
@@ -59,7 +59,7 @@ void Debugger::step()
 
 void Debugger::next()
 {
-    uint16 pc = emu->cpu.r.pc.full;
+    uint16 pc = emu->cpu.st->r.pc.full;
     uint8 id = emu->rambus.read(pc);
     // check for jumps and skip them, otherwise use nextaddr()
     nextstop = is_jump(id) ? pc + num_bytes(id)
@@ -88,7 +88,7 @@ void Debugger::write(uint16 addr, uint8 value)
     emu->rambus.write(addr, value);
 }
 
-void Debugger::start_tracing(Util::File &&f)
+void Debugger::start_tracing(Util::BufferedFile &&f)
 {
     stop_tracing();
     tracefile = std::move(f);
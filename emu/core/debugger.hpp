@@ -34,7 +34,7 @@ private:
     std::vector<Breakpoint> breakvec;
     std::optional<uint16> nextstop = 0;
     std::vector<CPU::Status> btrace;
-    Util::File tracefile;
+    Util::BufferedFile tracefile;
     bool quit = false;
 
 public:
@@ -47,7 +47,7 @@ public:
     void write(uint16 addr, uint8 value);
     CPU::Status cpu_status() const;
     PPU::Status ppu_status() const;
-    void start_tracing(Util::File &&f);
+    void start_tracing(Util::BufferedFile &&f);
 
     void register_callback(auto &&f)            { callback = f; }
     void continue_exec()                        { nextstop.reset(); }
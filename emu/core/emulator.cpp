@@ -1,39 +1,391 @@
 #include <emu/core/emulator.hpp>
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <new>
 #include <string_view>
+#include <utility>
 #include <fmt/core.h>
 #include <emu/util/unsigned.hpp>
 #include <emu/util/debug.hpp>
 #include <emu/util/file.hpp>
+#include <emu/util/hash.hpp>
+#include <emu/video/video.hpp>
 
 using namespace Core;
 
+// when profiling, only one step out of PROFILE_RATE is timed.
+static const unsigned PROFILE_RATE = 32;
+
+// bump the version whenever anything in a State changes.
+static const char STATE_MAGIC[8] = { 'Y', 'N', 'E', 'S', 'S', 'T', 'A', 'T' };
+static const uint32 STATE_VERSION = 3;
+
+struct StateHeader {
+    char magic[8];
+    uint32 version;
+    // the whole state, header included
+    uint32 size;
+    // of the ROM, see Cartridge::crc32()
+    uint32 crc;
+    uint32 reserved;
+};
+
 void Emulator::run()
 {
+    if (profiling && ++sample == PROFILE_RATE) {
+        sample = 0;
+        run_profiled();
+        return;
+    }
     cpu.run();
+    run_ppu();
+}
+
+/* Reading the clock around every instruction would cost more than the
+ * instruction itself, so steps are sampled instead and each sample is taken
+ * to stand for PROFILE_RATE steps. */
+void Emulator::run_profiled()
+{
+    using clock = std::chrono::steady_clock;
+    const auto t0 = clock::now();
+    cpu.run();
+    const auto t1 = clock::now();
+    run_ppu();
+    const auto t2 = clock::now();
+    prof.cpu += std::chrono::duration<double>(t1 - t0).count() * PROFILE_RATE;
+    prof.ppu += std::chrono::duration<double>(t2 - t1).count() * PROFILE_RATE;
+}
+
+void Emulator::run_ppu()
+{
     int curr_cycle = cpu.get_cycles();
-    int cycle_diff = curr_cycle - cycle;
+    int cycle_diff = curr_cycle - st->cycle;
     // run 3 ppu cycles for 1 cpu cycle
     for (int i = 0; i < cycle_diff*3; i++)
         ppu.run();
-    cycle = curr_cycle;
+    st->cycle = curr_cycle;
+}
+
+void Emulator::emulate_frame()
+{
+    while (!st->nmi)
+        run();
+    st->nmi = false;
+    st->frames++;
 }
 
 void Emulator::run_frame()
 {
     if (debugger_has_quit())
         return;
-    while (!nmi)
-        run();
-    nmi = false;
+    if (ahead == 0)
+        emulate_frame();
+    else if (second)
+        run_ahead_second();
+    else
+        run_ahead();
+    cartridge.end_frame();
+    if (rewinder && !std::exchange(rewound, false) && st->frames % rewind_every == 0)
+        rewinder->push(state_bytes());
+}
+
+Emulator::FrameHash Emulator::frame_hash() const
+{
+    return {
+        .indexed = Util::xxh64(frame().data(), frame().size()),
+        .rgba    = screen ? Util::xxh64(screen->data(), screen->size()) : 0,
+    };
+}
+
+Emulator::Emulator(const Emulator *parent)
+{
+    // children get their block from make_child() or fork()
+    if (parent) {
+        rambus.share(parent->rambus);
+        vrambus.share(parent->vrambus);
+    } else {
+        rambus.reset(CPUBUS_SIZE);
+        vrambus.reset(PPUBUS_SIZE);
+        alloc_state(0);
+    }
+    cpu.attach_bus(&rambus);
+    ppu.attach_bus(&vrambus, &rambus);
+    ppu.set_nmi_callback([this]() {
+        st->nmi = true;
+        cpu.fire_nmi();
+    });
+}
+
+/* The new block starts as a copy of the old one, so this can be called at any
+ * time, though it only is when the CHR RAM size changes. */
+void Emulator::alloc_state(std::size_t chrram_size)
+{
+    const std::size_t size = sizeof(State) + chrram_size;
+    auto newblock = Util::FileView::anonymous(size);
+    State *newst = new (newblock.writable_data()) State{};
+    if (st) {
+        newst->cycle  = st->cycle;
+        newst->frames = st->frames;
+        newst->nmi    = st->nmi;
+    }
+    attach_block(std::move(newblock), size, true);
 }
 
-bool Emulator::insert_rom(Util::File &romfile)
+void Emulator::attach_block(Util::FileView &&newblock, std::size_t size, bool copy)
 {
-    if (!cartridge.parse(romfile))
+    State *newst = reinterpret_cast<State *>(newblock.writable_data());
+    auto ram = std::span<uint8>(newblock.writable_data() + sizeof(State), size - sizeof(State));
+    cpu.attach_state(&newst->cpu, copy);
+    ppu.attach_state(&newst->ppu, copy);
+    cartridge.attach_state(&newst->cart, ram, copy);
+    block = std::move(newblock);
+    block_size = size;
+    st = newst;
+}
+
+void Emulator::set_log(Util::Log::Sink sink)
+{
+    log.set_sink(sink);
+    rambus.set_log(sink);
+    vrambus.set_log(sink);
+    cartridge.set_log(sink);
+    if (second)
+        second->set_log(sink);
+}
+
+void Emulator::set_screen(Video::Canvas *canvas)
+{
+    screen = canvas;
+    ppu.set_screen(canvas);
+    if (second)
+        second->set_screen(canvas);
+}
+
+void Emulator::set_buttons(unsigned port, uint8 buttons)
+{
+    cpu.set_buttons(port, buttons);
+    if (second)
+        second->set_buttons(port, buttons);
+}
+
+void Emulator::set_run_ahead(unsigned frames, bool second_instance)
+{
+    ahead = frames;
+    second = frames != 0 && second_instance ? clone() : nullptr;
+    pool   = second ? std::make_unique<Util::ThreadPool>(2) : nullptr;
+    if (second) {
+        second->set_screen(screen);
+        second->ppu.skip_output(true);
+    }
+    ppu.skip_output(second != nullptr);
+}
+
+/* The real frame comes first, so the state to go back to is the one after
+ * it; only the last frame ahead gets drawn. */
+void Emulator::run_ahead()
+{
+    ppu.skip_output(true);
+    emulate_frame();
+    ahead_save.assign(state_bytes().begin(), state_bytes().end());
+    for (unsigned i = 1; i < ahead; i++)
+        emulate_frame();
+    ppu.skip_output(false);
+    emulate_frame();
+    load_block(ahead_save);
+}
+
+/* Same thing, but the clone does the real frame and the frames ahead while
+ * the real one runs at the same time. The clone's frames come one after the
+ * other, so this takes as long as run_ahead(); it only skips going back. */
+void Emulator::run_ahead_second()
+{
+    second->copy_state(*this);
+    pool->parallel_for(2, [&](unsigned i) {
+        if (i == 0) {
+            emulate_frame();
+            return;
+        }
+        for (unsigned k = 0; k < ahead; k++)
+            second->emulate_frame();
+        second->ppu.skip_output(false);
+        second->emulate_frame();
+        second->ppu.skip_output(true);
+    });
+}
+
+// a ROM that doesn't load leaves the one inserted before running
+bool Emulator::insert_rom(Util::File &romfile, std::span<const std::string> patches)
+{
+    Cartridge cart;
+    cart.set_log(log.get_sink());
+    if (!cart.parse(romfile, patches))
         return false;
+    cartridge.take(std::move(cart));
+    setup_cartridge();
+    return true;
+}
+
+bool Emulator::insert_rom(std::span<const uint8> data, std::string_view name)
+{
+    Cartridge cart;
+    cart.set_log(log.get_sink());
+    if (!cart.load(Util::FileView::snapshot(data), name))
+        return false;
+    cartridge.take(std::move(cart));
+    setup_cartridge();
+    return true;
+}
+
+void Emulator::setup_cartridge()
+{
+    alloc_state(cartridge.chrramsize());
+    connect_cartridge();
+    // snapshots of the last ROM don't fit this one's state
+    if (rewinder)
+        rewinder->clear();
+    rewound = false;
+}
+
+void Emulator::connect_cartridge()
+{
     ppu.set_mirroring(cartridge.mirroring());
+    cartridge.on_mirroring_change([this](Mirroring m) { ppu.set_mirroring(m); });
+    cartridge.on_irq([this](bool line) { line ? cpu.fire_irq() : cpu.clear_irq(); });
+    if (cartridge.watches_a12())
+        ppu.set_a12_callback([this]() { cartridge.a12_rise(); });
+    else
+        ppu.set_a12_callback(nullptr);
     cartridge.attach_bus(&rambus, &vrambus);
+    if (ahead != 0)
+        set_run_ahead(ahead, second != nullptr);
+}
+
+bool Emulator::copy_state(const Emulator &other)
+{
+    if (other.block_size != block_size || other.cartridge.crc32() != cartridge.crc32())
+        return false;
+    return load_block(other.state_bytes());
+}
+
+bool Emulator::load_block(std::span<const uint8> data)
+{
+    if (data.size() != block_size)
+        return false;
+    cartridge.chrram_replaced(data.subspan(sizeof(State)));
+    std::memcpy(block.writable_data(), data.data(), block_size);
     return true;
 }
 
+std::unique_ptr<Emulator> Emulator::make_child(bool alloc) const
+{
+    auto emu = std::unique_ptr<Emulator>(new Emulator(this));
+    emu->set_log(log.get_sink());
+    emu->rng = rng;
+    emu->random_ram = random_ram;
+    if (!emu->cartridge.share(cartridge))
+        return nullptr;
+    if (alloc)
+        emu->setup_cartridge();
+    return emu;
+}
+
+std::unique_ptr<Emulator> Emulator::clone() const
+{
+    auto emu = make_child(true);
+    if (emu)
+        emu->copy_state(*this);
+    return emu;
+}
+
+/* The state goes into a snapshot once, and every fork maps it privately: the
+ * kernel does the copying, a page at a time, on the first write to it. */
+std::vector<std::unique_ptr<Emulator>> Emulator::fork(unsigned n) const
+{
+    std::vector<std::unique_ptr<Emulator>> forks;
+    const auto snapshot = Util::FileView::snapshot(state_bytes());
+    forks.reserve(n);
+    for (unsigned i = 0; i < n; i++) {
+        auto emu = make_child(false);
+        auto cow = snapshot.copy_on_write(block_size);
+        if (!emu || cow.size() != block_size || emu->cartridge.chrramsize() != block_size - sizeof(State))
+            return {};
+        emu->cartridge.chrram_replaced(snapshot.span().subspan(sizeof(State)));
+        emu->attach_block(std::move(cow), block_size, false);
+        emu->connect_cartridge();
+        forks.push_back(std::move(emu));
+    }
+    return forks;
+}
+
+std::size_t Emulator::state_size() const
+{
+    return sizeof(StateHeader) + block_size;
+}
+
+void Emulator::save_state(std::vector<uint8> &buf) const
+{
+    buf.resize(state_size());
+    save_state(std::span<uint8>(buf));
+}
+
+bool Emulator::save_state(std::span<uint8> buf) const
+{
+    StateHeader h = {};
+    std::memcpy(h.magic, STATE_MAGIC, sizeof(STATE_MAGIC));
+    h.version = STATE_VERSION;
+    h.size    = state_size();
+    h.crc     = cartridge.crc32();
+    if (buf.size() < h.size)
+        return false;
+    std::memcpy(buf.data(), &h, sizeof(h));
+    std::memcpy(buf.data() + sizeof(h), block.data(), block_size);
+    return true;
+}
+
+/* The header is checked before touching anything, so that a state for
+ * another ROM or another version can't leave the emulator half loaded. */
+bool Emulator::load_state(std::span<const uint8> state)
+{
+    StateHeader h;
+    if (state.size() < sizeof(h)) {
+        log.error("save state is too short\n");
+        return false;
+    }
+    std::memcpy(&h, state.data(), sizeof(h));
+    if (std::memcmp(h.magic, STATE_MAGIC, sizeof(STATE_MAGIC)) != 0) {
+        log.error("not a save state\n");
+        return false;
+    }
+    if (h.version != STATE_VERSION) {
+        log.error("save state is from a different version (got {}, expected {})\n", h.version, STATE_VERSION);
+        return false;
+    }
+    if (h.crc != cartridge.crc32()) {
+        log.error("save state is for a different ROM\n");
+        return false;
+    }
+    if (h.size != state.size() || h.size != state_size()) {
+        log.error("save state has the wrong size\n");
+        return false;
+    }
+    return load_block(state.subspan(sizeof(h)));
+}
+
+void Emulator::enable_rewind(std::size_t size, unsigned interval)
+{
+    rewinder = size != 0 ? std::make_unique<Rewinder>(size) : nullptr;
+    rewind_every = std::max(interval, 1u);
+}
+
+unsigned Emulator::rewind(unsigned steps)
+{
+    if (!rewinder || rewinder->empty())
+        return 0;
+    const unsigned done = rewinder->rewind(steps);
+    if (!load_block(rewinder->newest()))
+        return 0;
+    rewound = true;
+    return done;
+}
@@ -6,42 +6,119 @@
 #include <emu/core/ppu.hpp>
 #include <emu/core/cartridge.hpp>
 #include <emu/core/debugger.hpp>
+#include <emu/core/rewind.hpp>
+#include <emu/util/threadpool.hpp>
+#include <emu/util/debug.hpp>
+#include <emu/util/easyrandom.hpp>
+#include <emu/util/file.hpp>
+#include <memory>
+#include <vector>
 #include <fmt/core.h>
 
-namespace Util { class File; }
-
 namespace Core {
 
 class Emulator {
-    Bus rambus { CPUBUS_SIZE };
-    Bus vrambus { PPUBUS_SIZE };
+public:
+    /* Everything the emulation depends on is in a single block: this, then
+     * CHR RAM, if any. Nothing in it points anywhere (banks are offsets, bus
+     * handlers point to the components, not their state), so copying the
+     * block is all it takes to copy an emulator's state. */
+    struct State {
+        CPU::State cpu;
+        PPU::State ppu;
+        Cartridge::State cart;
+        int cycle = 0;
+        unsigned long frames = 0;
+        // this is internal to the emulator only and doesn't affect the cpu and ppu
+        bool nmi = false;
+    };
+
+private:
+    Bus rambus;
+    Bus vrambus;
     Cartridge cartridge;
     CPU cpu;
     PPU ppu;
     Debugger debugger {this};
-    int cycle = 0;
-    // this is internal to the emulator only and doesn't affect the cpu and ppu
-    bool nmi = false;
+    Video::Canvas *screen = nullptr;
+    // the State, then CHR RAM. Forks have a copy-on-write one.
+    Util::FileView block;
+    std::size_t block_size = 0;
+    State *st = nullptr;
+    bool profiling = false;
+    unsigned sample = 0;
+    // nothing in here is shared with other emulators
+    Util::Log log;
+    Util::Random rng;
+    bool random_ram = false;
+    std::unique_ptr<Rewinder> rewinder;
+    unsigned rewind_every = 1;
+    // the frame after a rewind isn't pushed, or with an interval of 1 it
+    // would be the snapshot the next rewind goes back to
+    bool rewound = false;
+    // run-ahead: the real state while running ahead, or the second instance
+    unsigned ahead = 0;
+    std::vector<uint8> ahead_save;
+    std::unique_ptr<Emulator> second;
+    std::unique_ptr<Util::ThreadPool> pool;
 
 public:
-    Emulator()
-    {
-        cpu.attach_bus(&rambus);
-        ppu.attach_bus(&vrambus, &rambus);
-        ppu.set_nmi_callback([this]() {
-            nmi = true;
-            cpu.fire_nmi();
-        });
-    }
+    /* Hashes of the last completed frame: one of the palette indexes output
+     * by the PPU, one of the RGBA pixels of the screen (0 if there's none). */
+    struct FrameHash {
+        uint64 indexed;
+        uint64 rgba;
+        bool operator==(const FrameHash &) const = default;
+    };
+
+    // time spent running the CPU and PPU, in seconds.
+    struct Profile {
+        double cpu = 0.0;
+        double ppu = 0.0;
+    };
+
+private:
+    Profile prof;
+    void run_ppu();
+    void run_profiled();
+    void emulate_frame();
+    void run_ahead();
+    void run_ahead_second();
+    void alloc_state(std::size_t chrram_size);
+    void attach_block(Util::FileView &&newblock, std::size_t size, bool copy);
+    void setup_cartridge();
+    void connect_cartridge();
+    bool load_block(std::span<const uint8> data);
+    std::span<uint8> state_bytes()             { return { block.writable_data(), block_size }; }
+    std::span<const uint8> state_bytes() const { return { block.data(), block_size }; }
+    // an emulator sharing parent's bus tables
+    explicit Emulator(const Emulator *parent);
+    // ... and ROM, with a state block only if alloc is true
+    std::unique_ptr<Emulator> make_child(bool alloc) const;
+
+public:
+
+    Emulator() : Emulator(nullptr) { }
+
+    // components point to each other and to the block
+    Emulator(const Emulator &) = delete;
+    Emulator & operator=(const Emulator &) = delete;
 
     void run();
     void run_frame();
-    bool insert_rom(Util::File &romfile);
+    /* On failure the ROM inserted before, if any, stays. Until a ROM is
+     * in, nothing but inserting one may be called. */
+    bool insert_rom(Util::File &romfile, std::span<const std::string> patches = {});
+    // a copy of data is kept; without a name there's no save file.
+    bool insert_rom(std::span<const uint8> data, std::string_view name = "");
+    bool has_rom() const                   { return cartridge.loaded(); }
 
     void power()
     {
-        cpu.power();
-        ppu.power();
+        // the cpu reads the reset vector, so banks must be in place first
+        cartridge.power();
+        cpu.power(random_ram ? &rng : nullptr);
+        ppu.power(random_ram ? &rng : nullptr);
     }
 
     void reset()
@@ -58,8 +135,81 @@ public:
         debugger.register_callback(callb);
     }
 
-    void set_screen(Video::Canvas *canvas) { ppu.set_screen(canvas); }
+    FrameHash frame_hash() const;
+
+    /* Save states are the state block with a header: about 20k for most
+     * games. A state only loads in the same build, with the same ROM
+     * inserted. save_state() reuses buf's memory, or with a span writes
+     * state_size() bytes into it, if they fit. */
+    void save_state(std::vector<uint8> &buf) const;
+    bool save_state(std::span<uint8> buf) const;
+    bool load_state(std::span<const uint8> state);
+    std::size_t state_size() const;
+
+    // a copy of other's state, which must be running the same ROM. Cheaper
+    // than a save state: no header, no checks beyond size and ROM.
+    bool copy_state(const Emulator &other);
+    // a new emulator, with the same ROM and state. Debugger, screen and
+    // save file aren't cloned.
+    std::unique_ptr<Emulator> clone() const;
+    /* n clones that share the state with this emulator as it is now, page
+     * by page, until they write to it: a fork only takes memory for the
+     * pages it touches (and its own framebuffer). ROM and bus tables are
+     * shared too. Empty if forking fails. */
+    std::vector<std::unique_ptr<Emulator>> fork(unsigned n) const;
+
+    /* Rewind history: every interval frames the state goes into a ring of
+     * size bytes, 0 turns it off. rewind() goes back steps snapshots (so
+     * steps * interval frames) and returns how many it could; the frame run
+     * right after it isn't recorded, so rewinding and running a frame over
+     * and over keeps going back. Inserting a ROM empties the history. */
+    void enable_rewind(std::size_t size, unsigned interval);
+    unsigned rewind(unsigned steps);
+    unsigned rewind_interval() const       { return rewind_every; }
+    Rewinder::Stats rewind_stats() const   { return rewinder ? rewinder->stats() : Rewinder::Stats {}; }
+
+    /* Run-ahead hides the lag between a game reading its input and showing
+     * the result: every run_frame() runs the real frame without output, then
+     * frames more on top of it, shows the last one and goes back to the real
+     * state, so a frame costs frames + 1 frames of emulation. With
+     * second_instance a clone runs the real frame again plus the frames
+     * ahead on another thread while this one runs the real frame: that is
+     * still frames + 1 frames one after the other, plus the copy and the
+     * handoff, and only saves restoring the state. 0 frames turns it off. */
+    void set_run_ahead(unsigned frames, bool second_instance);
+    unsigned run_ahead_frames() const      { return ahead; }
+
+    // where this emulator's errors and warnings go; stderr by default.
+    void set_log(Util::Log::Sink sink);
+    // this emulator's random numbers: the same seed gives the same run.
+    void seed(uint64 s)                    { rng.seed(s); }
+    Util::Random &random()                 { return rng; }
+    // power() fills RAM, VRAM, OAM and palette RAM from random() instead of
+    // zeroing them, like a real console. Some games misbehave either way.
+    void randomize_ram(bool enable)        { random_ram = enable; }
+
+    void enable_profiling(bool enable)     { profiling = enable; sample = 0; }
+    Profile profile() const                { return prof; }
+    void reset_profile()                   { prof = {}; }
+
+    void set_screen(Video::Canvas *canvas);
+    // what's held down on a controller (port 0 or 1) from now on, see Button
+    void set_buttons(unsigned port, uint8 buttons);
+    // palette indexes of the last frame, SCREEN_WIDTH * SCREEN_HEIGHT of them
+    std::span<const uint8> frame() const
+    {
+        return { second ? second->ppu.frame() : ppu.frame(), SCREEN_WIDTH*SCREEN_HEIGHT };
+    }
     std::string rominfo()                  { return cartridge.getinfo(); }
+    unsigned long frame_count() const      { return st->frames; }
+    std::span<const uint8> cpu_ram() const { return st->cpu.rammem; }
+    std::span<const uint8> prg_ram() const { return st->cart.prgram; }
+    std::span<const uint8> vram() const    { return st->ppu.vrammem; }
+    std::span<const uint8> oam() const     { return st->ppu.oammem; }
+    std::span<const uint8> palette_ram() const { return st->ppu.palmem; }
+    std::span<const uint8> chr_ram() const { return state_bytes().subspan(sizeof(State)); }
+    // CHR RAM tiles changed during the last frame
+    unsigned tiles_rewritten() const       { return cartridge.tiles_rewritten(); }
     bool debugger_has_quit() const         { return debugger.has_quit(); }
 
     friend class Debugger;
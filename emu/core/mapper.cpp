@@ -0,0 +1,286 @@
+#include <emu/core/mapper.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+namespace Core {
+
+// stands for missing PRG or CHR.
+static const uint8 open_bus[0x2000] = {};
+
+Mapper::Mapper(std::span<const uint8> prgrom, std::span<const uint8> chrmem, std::span<uint8> ram)
+    : prg(prgrom), chr(chrmem), chrram(ram), tile_gen(ram.size() / TILE_SIZE, 0)
+{
+    if (prg.empty()) prg = open_bus;
+    if (chr.empty()) chr = open_bus;
+}
+
+void Mapper::attach_state(State *state, std::span<uint8> ram, bool copy)
+{
+    if (copy && state != st)
+        *state = *st;
+    st = state;
+    if (!ram.empty() && ram.data() != chrram.data()) {
+        if (copy)
+            std::copy(chrram.begin(), chrram.begin() + std::min(chrram.size(), ram.size()), ram.begin());
+        chr = chrram = ram;
+        tile_gen.resize(ram.size() / TILE_SIZE, 0);
+    }
+}
+
+void Mapper::chrram_replaced(std::span<const uint8> ram)
+{
+    const std::size_t size = std::min(ram.size(), chrram.size());
+    for (std::size_t off = 0; off < size; off += TILE_SIZE) {
+        const std::size_t n = std::min<std::size_t>(TILE_SIZE, size - off);
+        if (std::memcmp(&chrram[off], &ram[off], n) == 0)
+            continue;
+        uint32 &gen = tile_gen[off / TILE_SIZE];
+        tiles_written += gen <= frame_gen;
+        gen = ++chr_gen;
+    }
+}
+
+static long wrap_page(int bank, unsigned pages, long total)
+{
+    return ((long(bank) * pages) % total + total) % total;
+}
+
+/* Maps pages number of pages starting at slot. A bank bigger than the whole
+ * ROM (for example 32k of a 16k ROM) mirrors what's there. */
+void Mapper::map_prg(unsigned slot, unsigned pages, int bank)
+{
+    const long total = prg.size() / PRG_PAGE;
+    if (total == 0)
+        return;
+    const long first = wrap_page(bank, pages, total);
+    for (unsigned i = 0; i < pages; i++)
+        st->prg_page[slot + i] = (first + i) % total * PRG_PAGE;
+}
+
+void Mapper::map_chr(unsigned slot, unsigned pages, int bank)
+{
+    const long total = chr.size() / CHR_PAGE;
+    if (total == 0)
+        return;
+    const long first = wrap_page(bank, pages, total);
+    for (unsigned i = 0; i < pages; i++)
+        st->chr_page[slot + i] = (first + i) % total * CHR_PAGE;
+}
+
+namespace {
+
+// mapper 0: no registers. 16k ROMs show up twice.
+class NROM : public Mapper {
+public:
+    using Mapper::Mapper;
+    void write_prg(uint16, uint8) override { }
+    void power() override
+    {
+        map_prg(0, 2, 0);
+        map_prg(2, 2, -1);
+        map_chr(0, 8, 0);
+    }
+};
+
+/* Mapper 1. Registers are written one bit at a time through a shift register;
+ * the fifth write picks the register from the address. On 512k boards
+ * (SUROM), bit 4 of the first CHR register selects which half of PRG is used.
+ * The CPU ignoring writes on consecutive cycles isn't emulated. */
+class MMC1 : public Mapper {
+    void update()
+    {
+        static const Mirroring modes[] = {
+            Mirroring::SINGLE_LOW, Mirroring::SINGLE_HIGH, Mirroring::VERT, Mirroring::HORZ,
+        };
+        const auto &r = st->mmc1;
+        set_mirroring(modes[r.control & 3]);
+        const int outer = prg.size() > 0x40000 ? (r.chr0 & 0x10) : 0;
+        switch (r.control >> 2 & 3) {
+        case 0: case 1:
+            map_prg(0, 4, (outer | (r.prgbank & 0xE)) >> 1);
+            break;
+        case 2:
+            map_prg(0, 2, outer);
+            map_prg(2, 2, outer | (r.prgbank & 0xF));
+            break;
+        case 3:
+            map_prg(0, 2, outer | (r.prgbank & 0xF));
+            map_prg(2, 2, outer | 0xF);
+            break;
+        }
+        if (r.control & 0x10) {
+            map_chr(0, 4, r.chr0);
+            map_chr(4, 4, r.chr1);
+        } else
+            map_chr(0, 8, r.chr0 >> 1);
+    }
+
+public:
+    using Mapper::Mapper;
+
+    void write_prg(uint16 addr, uint8 data) override
+    {
+        auto &r = st->mmc1;
+        if (data & 0x80) {
+            r.shift = r.count = 0;
+            r.control |= 0x0C;
+            update();
+            return;
+        }
+        r.shift |= (data & 1) << r.count;
+        if (++r.count < 5)
+            return;
+        switch (addr >> 13 & 3) {
+        case 0: r.control = r.shift; break;
+        case 1: r.chr0    = r.shift; break;
+        case 2: r.chr1    = r.shift; break;
+        case 3: r.prgbank = r.shift; break;
+        }
+        r.shift = r.count = 0;
+        update();
+    }
+
+    void power() override
+    {
+        auto &r = st->mmc1;
+        r.shift = r.count = 0;
+        r.control = 0x0C;
+        r.chr0 = r.chr1 = r.prgbank = 0;
+        update();
+    }
+};
+
+// mapper 2: 16k switchable at $8000, last 16k fixed at $C000.
+class UxROM : public Mapper {
+public:
+    using Mapper::Mapper;
+    void write_prg(uint16, uint8 data) override { map_prg(0, 2, data); }
+    void power() override
+    {
+        map_prg(0, 2, 0);
+        map_prg(2, 2, -1);
+        map_chr(0, 8, 0);
+    }
+};
+
+// mapper 3: 8k of CHR switchable, PRG like NROM.
+class CNROM : public Mapper {
+public:
+    using Mapper::Mapper;
+    void write_prg(uint16, uint8 data) override { map_chr(0, 8, data); }
+    void power() override
+    {
+        map_prg(0, 2, 0);
+        map_prg(2, 2, -1);
+        map_chr(0, 8, 0);
+    }
+};
+
+// mapper 7: 32k switchable, single screen mirroring chosen by bit 4.
+class AxROM : public Mapper {
+public:
+    using Mapper::Mapper;
+    void write_prg(uint16, uint8 data) override
+    {
+        map_prg(0, 4, data & 7);
+        set_mirroring(data & 0x10 ? Mirroring::SINGLE_HIGH : Mirroring::SINGLE_LOW);
+    }
+    void power() override
+    {
+        write_prg(0x8000, 0);
+        map_chr(0, 8, 0);
+    }
+};
+
+/* Mapper 4. $8000 selects which of the 8 bank registers is written by $8001,
+ * and the PRG and CHR layouts:
+ *          PRG mode 0  PRG mode 1          CHR mode 0  CHR mode 1
+ *  $8000   R6          -2                  $0000 R0    R2 R3 R4 R5
+ *  $A000   R7          R7                  $0800 R1
+ *  $C000   -2          R6                  $1000 R2-R5 R0
+ *  $E000   -1          -1                  $1800       R1
+ * R0 and R1 are 2k banks (the low bit is ignored), the rest 1k.
+ * The IRQ counter is clocked by rises of PPU A12; this is the behavior of the
+ * later (Sharp) chips, where a counter reloaded with 0 keeps firing. */
+class MMC3 : public Mapper {
+    void update()
+    {
+        const auto &r = st->mmc3;
+        const unsigned swap = r.bank_select & 0x40 ? 2 : 0;
+        map_prg(0 ^ swap, 1, r.regs[6]);
+        map_prg(1,        1, r.regs[7]);
+        map_prg(2 ^ swap, 1, -2);
+        map_prg(3,        1, -1);
+        const unsigned inv = r.bank_select & 0x80 ? 4 : 0;
+        map_chr(0 ^ inv, 2, r.regs[0] >> 1);
+        map_chr(2 ^ inv, 2, r.regs[1] >> 1);
+        for (unsigned i = 0; i < 4; i++)
+            map_chr((4 + i) ^ inv, 1, r.regs[2 + i]);
+    }
+
+public:
+    using Mapper::Mapper;
+
+    void write_prg(uint16 addr, uint8 data) override
+    {
+        auto &r = st->mmc3;
+        switch (addr & 0xE001) {
+        case 0x8000: r.bank_select = data;           update(); break;
+        case 0x8001: r.regs[r.bank_select & 7] = data; update(); break;
+        case 0xA000: set_mirroring(data & 1 ? Mirroring::HORZ : Mirroring::VERT); break;
+        // PRG RAM protection is ignored, as most emulators do.
+        case 0xA001: break;
+        case 0xC000: r.irq_latch = data; break;
+        case 0xC001: r.irq_counter = 0; r.irq_reload = true; break;
+        case 0xE000: r.irq_enabled = false; set_irq(false); break;
+        case 0xE001: r.irq_enabled = true; break;
+        }
+    }
+
+    void power() override
+    {
+        auto &r = st->mmc3;
+        r.bank_select = 0;
+        for (unsigned i = 0; i < 8; i++)
+            r.regs[i] = i < 6 ? 0 : i - 6;
+        r.irq_latch = r.irq_counter = 0;
+        r.irq_reload = r.irq_enabled = false;
+        update();
+    }
+
+    bool watches_a12() const override { return true; }
+
+    void a12_rise() override
+    {
+        auto &r = st->mmc3;
+        if (r.irq_counter == 0 || r.irq_reload) {
+            r.irq_counter = r.irq_latch;
+            r.irq_reload = false;
+        } else
+            r.irq_counter--;
+        if (r.irq_counter == 0 && r.irq_enabled)
+            set_irq(true);
+    }
+};
+
+} // namespace
+
+std::unique_ptr<Mapper> Mapper::create(unsigned number, std::span<const uint8> prgrom,
+                                       std::span<const uint8> chrmem, std::span<uint8> ram)
+{
+    std::unique_ptr<Mapper> m;
+    switch (number) {
+    case 0: m = std::make_unique<NROM>(prgrom, chrmem, ram);  break;
+    case 1: m = std::make_unique<MMC1>(prgrom, chrmem, ram);  break;
+    case 2: m = std::make_unique<UxROM>(prgrom, chrmem, ram); break;
+    case 3: m = std::make_unique<CNROM>(prgrom, chrmem, ram); break;
+    case 4: m = std::make_unique<MMC3>(prgrom, chrmem, ram);  break;
+    case 7: m = std::make_unique<AxROM>(prgrom, chrmem, ram); break;
+    default: return nullptr;
+    }
+    m->power();
+    return m;
+}
+
+} // namespace Core
@@ -0,0 +1,138 @@
+#ifndef CORE_MAPPER_HPP_INCLUDED
+#define CORE_MAPPER_HPP_INCLUDED
+
+#include <functional>
+#include <memory>
+#include <span>
+#include <vector>
+#include <emu/core/const.hpp>
+#include <emu/util/unsigned.hpp>
+
+namespace Core {
+
+/* A mapper decides which parts of PRG and CHR are visible to the CPU and the
+ * PPU. The CPU sees 4 pages of 8k at $8000-$FFFF, the PPU 8 pages of 1k at
+ * $0000-$1FFF; switching banks only changes the page offsets, so that a read
+ * is a couple of indexed loads.
+ * Writes to $8000-$FFFF go to write_prg(), which is where each mapper keeps
+ * its registers. */
+class Mapper {
+public:
+    using MirroringCallback = std::function<void(Mirroring)>;
+    // true asserts the IRQ line, false acknowledges it
+    using IrqCallback = std::function<void(bool)>;
+
+    /* Everything that changes while running, kept apart so that an
+     * emulator can have the state of all its parts in a single block (see
+     * Emulator::State). Until attach_state() a mapper uses its own.
+     * Pages are offsets into PRG and CHR, so the state can be copied
+     * anywhere. */
+    struct State {
+        uint32 prg_page[4] = {};
+        uint32 chr_page[8] = {};
+        // registers of the mapper in use
+        union {
+            struct {
+                uint8 shift, count;
+                uint8 control, chr0, chr1, prgbank;
+            } mmc1 = {};
+            struct {
+                uint8 bank_select;
+                uint8 regs[8];
+                uint8 irq_latch, irq_counter;
+                bool irq_reload, irq_enabled;
+            } mmc3;
+        };
+    };
+
+protected:
+    static const unsigned PRG_PAGE = 0x2000;
+    static const unsigned CHR_PAGE = 0x400;
+
+    std::span<const uint8> prg;
+    std::span<const uint8> chr;
+    // not empty when chr is actually writable RAM
+    std::span<uint8> chrram;
+    State own{};
+    State *st = &own;
+    // CHR RAM write tracking, see tile_generations()
+    std::vector<uint32> tile_gen;
+    uint32 chr_gen = 0;
+    uint32 frame_gen = 0;
+    unsigned tiles_written = 0;
+    unsigned last_tiles_written = 0;
+    MirroringCallback mirroring_callback;
+    IrqCallback irq_callback;
+
+    // bank numbers wrap around the size of the ROM, so -1 is the last bank.
+    void map_prg(unsigned slot, unsigned pages, int bank);
+    void map_chr(unsigned slot, unsigned pages, int bank);
+    void set_mirroring(Mirroring m) { if (mirroring_callback) mirroring_callback(m); }
+    void set_irq(bool line)         { if (irq_callback) irq_callback(line); }
+
+public:
+    Mapper(std::span<const uint8> prgrom, std::span<const uint8> chrmem, std::span<uint8> ram);
+    virtual ~Mapper() = default;
+
+    Mapper(const Mapper &) = delete;
+    Mapper & operator=(const Mapper &) = delete;
+
+    // the current state is copied to state. ram, when not empty, replaces
+    // the CHR RAM given at creation, contents included. Nothing is copied
+    // without copy.
+    void attach_state(State *state, std::span<uint8> ram, bool copy = true);
+
+    uint8 read_prg(uint16 addr) const { return prg[st->prg_page[addr >> 13 & 3] + (addr & (PRG_PAGE-1))]; }
+    uint8 read_chr(uint16 addr) const { return chr[st->chr_page[addr >> 10 & 7] + (addr & (CHR_PAGE-1))]; }
+    /* Writes that don't change anything are dropped, so that games clearing
+     * CHR RAM over and over don't look like they're changing tiles. */
+    void write_chr(uint16 addr, uint8 data)
+    {
+        // also drops writes to CHR ROM, where chrram is empty
+        const std::size_t off = st->chr_page[addr >> 10 & 7] + (addr & (CHR_PAGE-1));
+        if (off >= chrram.size() || chrram[off] == data)
+            return;
+        chrram[off] = data;
+        uint32 &gen = tile_gen[off / TILE_SIZE];
+        tiles_written += gen <= frame_gen;
+        gen = ++chr_gen;
+    }
+
+    /* Every 16 byte tile of CHR RAM has the generation of its last change,
+     * and chr_generation() is the latest one. Something caching decoded tiles
+     * can remember chr_generation() and later redo only the tiles with a
+     * bigger generation. Empty for CHR ROM, which never changes. */
+    static const unsigned TILE_SIZE = 16;
+    std::span<const uint32> tile_generations() const { return tile_gen; }
+    uint32 chr_generation() const                    { return chr_gen; }
+    // called once per frame, for the counter below.
+    void end_frame()
+    {
+        last_tiles_written = tiles_written;
+        tiles_written = 0;
+        frame_gen = chr_gen;
+    }
+    // how many different tiles were changed during the last frame.
+    unsigned tiles_rewritten() const { return last_tiles_written; }
+    // to be called before CHR RAM gets overwritten with ram (as when copying
+    // a whole state): tiles that are going to change get new generations.
+    void chrram_replaced(std::span<const uint8> ram);
+
+    virtual void write_prg(uint16 addr, uint8 data) = 0;
+    // puts every register back to its power-up state.
+    virtual void power() = 0;
+    // for mappers that count PPU A12 rises (see PPU::set_a12_callback).
+    virtual bool watches_a12() const { return false; }
+    virtual void a12_rise() { }
+
+    void on_mirroring_change(MirroringCallback callback) { mirroring_callback = callback; }
+    void on_irq(IrqCallback callback)                    { irq_callback = callback; }
+
+    // returns nullptr if the mapper isn't supported.
+    static std::unique_ptr<Mapper> create(unsigned number, std::span<const uint8> prgrom,
+                                          std::span<const uint8> chrmem, std::span<uint8> ram);
+};
+
+} // namespace Core
+
+#endif
@@ -1,103 +1,75 @@
 #include <emu/core/ppu.hpp>
 
+#include <algorithm>
 #include <cstdio>
 #include <cassert>
 #include <functional>
 #include <fmt/core.h>
 #include <emu/core/bus.hpp>
 #include <emu/util/file.hpp>
-#include <emu/util/easyrandom.hpp>
 #include <emu/util/debug.hpp>
 #include <emu/video/video.hpp>
 
 namespace Core {
 
+// how long A12 must stay low before a rise counts, in PPU cycles (~3 CPU cycles)
+static const unsigned long A12_FILTER = 10;
+
 #define INSIDE_PPU_CPP
 #include "ppumain.cpp"
 #undef INSIDE_PPU_CPP
 
-void PPU::power()
+void PPU::power(Util::Random *rng)
 {
-    vram.addr = 0;
-    vram.tmp = 0;
-    // PPUCTRL
-    io.vram_inc = 0;
-    io.sp_pt_addr = 0;
-    io.bg_pt_addr = 0;
-    io.sp_size = 0;
-    io.ext_bus_dir = 0;
-    io.nmi_enabled = 0;
-    // PPUMASK
-    io.grey = 0;
-    io.bg_show_left = 0;
-    io.sp_show_left = 0;
-    io.bg_show = 0;
-    io.sp_show = 0;
-    io.red = 0;
-    io.green = 0;
-    io.blue = 0;
+    // everything back to zero, but the mirroring, which the cartridge sets
+    const Mirroring mirroring = st->nt_mirroring;
+    *st = State{};
+    st->nt_mirroring = mirroring;
     // PPUSTATUS
-    io.sp_overflow = 1;
-    io.sp_zero_hit = 0;
-    io.vblank = 1;
-    // OAMADDR
-    io.oam_addr = 0;
-    // PPUSCROLL and PPUADDR
-    vram.tmp = 0;
-    vram.fine_x = 0;
-    io.scroll_latch = 0;
-    // PPUDATA
-    io.data_buf = 0;
-    // other
-    odd_frame = 0;
-    lines = cycles = 0;
-    for (unsigned i = 0; i < VRAM_SIZE; i++)
-        vrammem[i] = 0;
-    for (unsigned i = 0; i < OAM_SIZE; i++)
-        oammem[i] = 0;
-    for (unsigned i = 0; i < PAL_SIZE; i++)
-        palmem[i] = 0;
-    // randomize memory
-    // for (auto &cell : oammem)
-    //     cell = Util::random8();
-    // for (uint16 i = PAL_START; i < 0x3F20; i++)
-    //     bus->write(i, Util::random8());
-    // for (uint16 i = NT_START; i < 0x3000; i++)
-    //     bus->write(i, Util::random8());
+    st->io.sp_overflow = 1;
+    st->io.vblank = 1;
+    if (rng) {
+        rng->fill(st->vrammem);
+        rng->fill(st->oammem);
+        // palette entries are 6 bits
+        for (auto &entry : st->palmem)
+            entry = rng->random8() & 0x3F;
+    }
+    std::fill(framebuf, framebuf + SCREEN_WIDTH*SCREEN_HEIGHT, 0);
     // we should also randomize chr-ram
 }
 
 void PPU::reset()
 {
     // PPUCTRL
-    io.vram_inc = 0;
-    io.sp_pt_addr = 0;
-    io.bg_pt_addr = 0;
-    io.sp_size = 0;
-    io.ext_bus_dir = 0;
-    io.nmi_enabled = 0;
+    st->io.vram_inc = 0;
+    st->io.sp_pt_addr = 0;
+    st->io.bg_pt_addr = 0;
+    st->io.sp_size = 0;
+    st->io.ext_bus_dir = 0;
+    st->io.nmi_enabled = 0;
     // PPUMASK
-    io.grey = 0;
-    io.bg_show_left = 0;
-    io.sp_show_left = 0;
-    io.bg_show = 0;
-    io.sp_show = 0;
-    io.red = 0;
-    io.green = 0;
-    io.blue = 0;
+    st->io.grey = 0;
+    st->io.bg_show_left = 0;
+    st->io.sp_show_left = 0;
+    st->io.bg_show = 0;
+    st->io.sp_show = 0;
+    st->io.red = 0;
+    st->io.green = 0;
+    st->io.blue = 0;
     // PPUSTATUS
-    io.sp_overflow = 0; // Util::random_between(0, 1);
-    io.sp_zero_hit = 0; // Util::random_between(0, 1);
+    st->io.sp_overflow = 0; // Util::random_between(0, 1);
+    st->io.sp_zero_hit = 0; // Util::random_between(0, 1);
     // PPUSCROLL and PPUADDR
-    io.scroll_latch = 0;
-    vram.fine_x = 0;
+    st->io.scroll_latch = 0;
+    st->vram.fine_x = 0;
     // PPUDATA
-    io.data_buf = 0;
+    st->io.data_buf = 0;
     // other
-    odd_frame = 0;
-    lines = cycles = 0;
+    st->odd_frame = 0;
+    st->lines = st->cycles = 0;
     for (unsigned i = 0; i < OAM_SIZE; i++)
-        oammem[i] = 0;
+        st->oammem[i] = 0;
 }
 
 PPU::Status PPU::status() const
@@ -111,29 +83,46 @@ PPU::Status PPU::status() const
         .vram_scroll    = readreg_no_sideeff(0x2000),
         .vram_addr      = readreg_no_sideeff(0x2000),
         .vram_data      = readreg_no_sideeff(0x2000),
-        .vram           = vram,
-        .tile           = tile,
-        .shift          = shift,
-        .line           = lines,
-        .cycle          = cycles
+        .vram           = st->vram,
+        .tile           = st->tile,
+        .shift          = st->shift,
+        .line           = st->lines,
+        .cycle          = st->cycles
     };
 }
 
+// which 1k of VRAM each of the 4 nametables is, for every kind of mirroring.
+static const uint8 nt_pages[4][4] = {
+    { 0, 1, 0, 1 },     // VERT
+    { 0, 0, 1, 1 },     // HORZ
+    { 0, 0, 0, 0 },     // SINGLE_LOW
+    { 1, 1, 1, 1 },     // SINGLE_HIGH
+};
+
+uint16 PPU::nt_decode(uint16 addr) const
+{
+    return nt_pages[static_cast<unsigned>(st->nt_mirroring)][addr >> 10 & 3] << 10 | (addr & 0x3FF);
+}
+
 void PPU::attach_bus(Bus *vrambus, Bus *rambus)
 {
     bus = vrambus;
-    rambus->map(PPUREG_START, APU_START,
-            [this](uint16 addr)             { return readreg(0x2000 + (addr & 0x7)); },
-            [this](uint16 addr, uint8 data) { writereg(0x2000 + (addr & 0x7), data); });
-    bus->map(PAL_START, 0x4000,
-            [this](uint16 addr)             {
-                assert((addr & 0x1F) < PAL_SIZE);
-                return palmem[addr & 0x1F];
+    rambus->map(PPUREG_START, APU_START, this,
+            [](void *ppu, uint16 addr)             { return static_cast<PPU *>(ppu)->readreg(0x2000 + (addr & 0x7)); },
+            [](void *ppu, uint16 addr, uint8 data) { static_cast<PPU *>(ppu)->writereg(0x2000 + (addr & 0x7), data); });
+    bus->map(PAL_START, 0x4000, this,
+            [](void *ppu, uint16 addr)             { return static_cast<PPU *>(ppu)->st->palmem[addr & 0x1F]; },
+            [](void *ppu, uint16 addr, uint8 data) { static_cast<PPU *>(ppu)->st->palmem[addr & 0x1F] = data; });
+    // the mirroring is part of the state, so it's looked up on every access
+    bus->map(NT_START, PAL_START, this,
+            [](void *ppu, uint16 addr)             {
+                auto *p = static_cast<PPU *>(ppu);
+                return p->st->vrammem[p->nt_decode(addr)];
             },
-            [this](uint16 addr, uint8 data) { assert((addr & 0x1F) < PAL_SIZE); palmem[addr & 0x1F] = data; });
-    bus->map(NT_START, PAL_START,
-            [this](uint16 addr)             { return 0; },
-            [this](uint16 addr, uint8 data) { /*******/ });
+            [](void *ppu, uint16 addr, uint8 data) {
+                auto *p = static_cast<PPU *>(ppu);
+                p->st->vrammem[p->nt_decode(addr)] = data;
+            });
 }
 
 uint8 PPU::readreg(const uint16 which)
@@ -146,24 +135,25 @@ uint8 PPU::readreg(const uint16 which)
 
     // PPUSTATUS
     case 0x2002:
-        io.latch |= (io.vblank << 7 | io.sp_zero_hit << 6 | io.sp_overflow << 5);
-        io.vblank = 0;
-        io.scroll_latch = 0;
+        st->io.latch |= (st->io.vblank << 7 | st->io.sp_zero_hit << 6 | st->io.sp_overflow << 5);
+        st->io.vblank = 0;
+        st->io.scroll_latch = 0;
         break;
 
     // OAMDATA
     case 0x2004:
-        io.latch = 0;
+        st->io.latch = 0;
         break;
 
     // PPUDATA
     case 0x2007:
-        if (vram.addr < 0x3F00) {
-            io.latch = io.data_buf;
-            io.data_buf = bus->read(vram.addr);
+        watch_a12(st->vram.addr);
+        if (st->vram.addr < 0x3F00) {
+            st->io.latch = st->io.data_buf;
+            st->io.data_buf = bus->read(st->vram.addr);
         } else
-            io.latch = bus->read(vram.addr);
-        vram.addr += (1UL << 5*io.vram_inc);
+            st->io.latch = bus->read(st->vram.addr);
+        st->vram.addr += (1UL << 5*st->io.vram_inc);
         break;
 
 #ifdef DEBUG
@@ -172,35 +162,35 @@ uint8 PPU::readreg(const uint16 which)
         break;
 #endif
     }
-    return io.latch;
+    return st->io.latch;
 }
 
 void PPU::writereg(const uint16 which, const uint8 data)
 {
-    io.latch = data;
+    st->io.latch = data;
     switch (which) {
 
     // PPUCTRL
     case 0x2000:
-        vram.tmp.nt     = data & 0x03;
-        io.vram_inc     = data & 0x04;
-        io.sp_pt_addr   = data & 0x08;
-        io.bg_pt_addr   = data & 0x10;
-        io.sp_size      = data & 0x20;
-        io.ext_bus_dir  = data & 0x40;
-        io.nmi_enabled  = data & 0x80;
+        st->vram.tmp.nt     = data & 0x03;
+        st->io.vram_inc     = data & 0x04;
+        st->io.sp_pt_addr   = data & 0x08;
+        st->io.bg_pt_addr   = data & 0x10;
+        st->io.sp_size      = data & 0x20;
+        st->io.ext_bus_dir  = data & 0x40;
+        st->io.nmi_enabled  = data & 0x80;
         break;
 
     // PPUMASK
     case 0x2001:
-        io.grey          = data & 0x01;
-        io.bg_show_left  = data & 0x02;
-        io.sp_show_left  = data & 0x04;
-        io.bg_show       = data & 0x08;
-        io.sp_show       = data & 0x10;
-        io.red           = data & 0x20;
-        io.green         = data & 0x40;
-        io.blue          = data & 0x80;
+        st->io.grey          = data & 0x01;
+        st->io.bg_show_left  = data & 0x02;
+        st->io.sp_show_left  = data & 0x04;
+        st->io.bg_show       = data & 0x08;
+        st->io.sp_show       = data & 0x10;
+        st->io.red           = data & 0x20;
+        st->io.green         = data & 0x40;
+        st->io.blue          = data & 0x80;
         break;
 
     // PPUSTATUS
@@ -209,44 +199,46 @@ void PPU::writereg(const uint16 which, const uint8 data)
 
     // OAMADDR
     case 0x2003:
-        io.oam_addr = data;
+        st->io.oam_addr = data;
         break;
 
     // OAMDATA
     case 0x2004:
-        io.oam_addr++;
+        st->io.oam_addr++;
         break;
 
     // PPUSCROLL
     case 0x2005:
-        if (!io.scroll_latch) {
-            vram.tmp.coarse_x = data >> 3 & 0x1F;
-            vram.fine_x       = data & 0x7;
+        if (!st->io.scroll_latch) {
+            st->vram.tmp.coarse_x = data >> 3 & 0x1F;
+            st->vram.fine_x       = data & 0x7;
         } else {
-            vram.tmp.coarse_y = data >> 3 & 0x1F;
-            vram.tmp.fine_y   = data & 0x7;
+            st->vram.tmp.coarse_y = data >> 3 & 0x1F;
+            st->vram.tmp.fine_y   = data & 0x7;
         }
-        io.scroll_latch ^= 1;
+        st->io.scroll_latch ^= 1;
         break;
 
     // PPUADDR
     case 0x2006:
-        if (io.scroll_latch == 0) {
+        if (st->io.scroll_latch == 0) {
             // high byte
-            vram.tmp = Util::setbits(vram.tmp, 8, 6, data & 0x3F);
-            vram.tmp = Util::setbit(vram.tmp, 14, 0);
+            st->vram.tmp = Util::setbits(st->vram.tmp, 8, 6, data & 0x3F);
+            st->vram.tmp = Util::setbit(st->vram.tmp, 14, 0);
         } else {
             // low byte
-            vram.tmp = Util::setbits(vram.tmp, 0, 8, data);
-            vram.addr = vram.tmp;
+            st->vram.tmp = Util::setbits(st->vram.tmp, 0, 8, data);
+            st->vram.addr = st->vram.tmp;
+            watch_a12(st->vram.addr);
         }
-        io.scroll_latch ^= 1;
+        st->io.scroll_latch ^= 1;
         break;
 
     // PPUDATA
     case 0x2007:
-        bus->write(vram.addr, data);
-        vram.addr += (1UL << 5*io.vram_inc);
+        watch_a12(st->vram.addr);
+        bus->write(st->vram.addr, data);
+        st->vram.addr += (1UL << 5*st->io.vram_inc);
         break;
 
 #ifdef DEBUG
@@ -260,45 +252,42 @@ void PPU::writereg(const uint16 which, const uint8 data)
 uint8 PPU::readreg_no_sideeff(const uint16 which) const
 {
     switch (which) {
-    case 0x2000: return vram.tmp.nt
-                      | io.vram_inc    << 2
-                      | io.sp_pt_addr  << 3
-                      | io.bg_pt_addr  << 4
-                      | io.sp_size     << 5
-                      | io.ext_bus_dir << 6
-                      | io.nmi_enabled << 7;
-    case 0x2001: return io.grey
-                      | io.bg_show_left << 1
-                      | io.sp_show_left << 2
-                      | io.bg_show      << 3
-                      | io.sp_show      << 4
-                      | io.red          << 5
-                      | io.green        << 6
-                      | io.blue         << 7;
-    case 0x2002: return io.vblank << 7
-                      | io.sp_zero_hit << 6
-                      | io.sp_overflow << 5;
-    case 0x2003: return io.oam_addr;
+    case 0x2000: return st->vram.tmp.nt
+                      | st->io.vram_inc    << 2
+                      | st->io.sp_pt_addr  << 3
+                      | st->io.bg_pt_addr  << 4
+                      | st->io.sp_size     << 5
+                      | st->io.ext_bus_dir << 6
+                      | st->io.nmi_enabled << 7;
+    case 0x2001: return st->io.grey
+                      | st->io.bg_show_left << 1
+                      | st->io.sp_show_left << 2
+                      | st->io.bg_show      << 3
+                      | st->io.sp_show      << 4
+                      | st->io.red          << 5
+                      | st->io.green        << 6
+                      | st->io.blue         << 7;
+    case 0x2002: return st->io.vblank << 7
+                      | st->io.sp_zero_hit << 6
+                      | st->io.sp_overflow << 5;
+    case 0x2003: return st->io.oam_addr;
     case 0x2004: return 0;
-    case 0x2005: return !io.scroll_latch ? vram.fine_x     << 5 | vram.tmp.coarse_x
-                                         : vram.tmp.fine_y << 5 | vram.tmp.coarse_y;
-    case 0x2006: return !io.scroll_latch ? vram.tmp & 0xFF : vram.tmp >> 8 & 0xFF;
-    case 0x2007: return vram.addr < 0x3F00 ? io.data_buf
-                                           : bus->read(vram.addr);
+    case 0x2005: return !st->io.scroll_latch ? st->vram.fine_x     << 5 | st->vram.tmp.coarse_x
+                                         : st->vram.tmp.fine_y << 5 | st->vram.tmp.coarse_y;
+    case 0x2006: return !st->io.scroll_latch ? st->vram.tmp & 0xFF : st->vram.tmp >> 8 & 0xFF;
+    case 0x2007: return st->vram.addr < 0x3F00 ? st->io.data_buf
+                                           : bus->read(st->vram.addr);
     default: return 0xFF;
     }
 }
 
 void PPU::output()
 {
-    if (screen == nullptr)
+    if (hidden)
         return;
     const uint8 bgpixel = bg_output();
-    uint32 color = 0;
-    if (bgpixel == 0x30)
-        color = 0xFFFFFFFF;
-    const auto x = cycles % 341;
-    const auto y = lines % 262;
+    const auto x = st->cycles % 341;
+    const auto y = st->lines % 262;
     assert((y <= 239 || y == 261) && x <= 256);
     // is there any fucking document that says when i have to output pixels
     // and doesn't have a shitty explanation?
@@ -306,6 +295,12 @@ void PPU::output()
         return;
     if (y == 261)
         return;
+    framebuf[y*SCREEN_WIDTH + x] = bgpixel;
+    if (screen == nullptr)
+        return;
+    uint32 color = 0;
+    if (bgpixel == 0x30)
+        color = 0xFFFFFFFF;
     screen->drawpixel(x, y, color);
 }
 
@@ -322,33 +317,24 @@ uint8 PPU::getcolor(bool select, uint8 pal, uint8 palind)
 
 void PPU::set_mirroring(Mirroring mirroring)
 {
-    std::function<uint16(uint16)> decode;
-
-    switch (mirroring) {
-    case Mirroring::HORZ:
-        decode = [](uint16 addr) {
-            auto tmp = addr & 0xFFF;
-            auto bits = Util::getbits(tmp, 10, 2) >> 1;
-            return Util::setbits(tmp, 10, 2, bits);
-        };
-        break;
-    case Mirroring::VERT:
-        decode = [](uint16 addr) { return addr & 0x7FF; };
-        break;
-    default:
-        assert(false);
-    }
-    bus->remap(NT_START, PAL_START,
-            [=, this](uint16 addr)             {
-                addr = decode(addr);
-                assert(addr < VRAM_SIZE);
-                return vrammem[addr];
-            },
-            [=, this](uint16 addr, uint8 data) {
-                addr = decode(addr);
-                assert(addr < VRAM_SIZE);
-                vrammem[addr] = data;
-            });
+    assert(mirroring < Mirroring::OTHER);
+    st->nt_mirroring = mirroring;
+}
+
+/* Mappers like MMC3 count scanlines by watching A12 of the PPU address bus.
+ * Like on the real boards, a rise only counts when A12 stayed low for a few
+ * CPU cycles: during rendering this filters out the nametable fetches
+ * between pattern fetches, so the callback runs about once per line. */
+void PPU::watch_a12(uint16 addr)
+{
+    const bool high = addr & 0x1000;
+    if (high == st->a12)
+        return;
+    st->a12 = high;
+    if (!high)
+        st->a12_fall = st->dots;
+    else if (st->dots - st->a12_fall >= A12_FILTER && a12_callback)
+        a12_callback();
 }
 
 /* The VRAM address has the following components:
@@ -359,50 +345,50 @@ void PPU::set_mirroring(Mirroring mirroring)
  * Y : N YYYYY FFF (where N is the second bit of NN and FFF is fine_y) */
 void PPU::inc_v_horzpos()
 {
-    if (!io.bg_show)
+    if (!st->io.bg_show)
         return;
-    if (vram.addr.coarse_x == 31) {
-        vram.addr.coarse_x = 0;
-        vram.addr.nt ^= 1;
+    if (st->vram.addr.coarse_x == 31) {
+        st->vram.addr.coarse_x = 0;
+        st->vram.addr.nt ^= 1;
     } else
-        ++vram.addr.coarse_x;
+        ++st->vram.addr.coarse_x;
 }
 
 void PPU::inc_v_vertpos()
 {
-    if (!io.bg_show)
+    if (!st->io.bg_show)
         return;
-    if (vram.addr.fine_y < 7)
-        ++vram.addr.fine_y;
+    if (st->vram.addr.fine_y < 7)
+        ++st->vram.addr.fine_y;
     else {
-        vram.addr.fine_y = 0;
-        uint16 y = vram.addr.coarse_y;
+        st->vram.addr.fine_y = 0;
+        uint16 y = st->vram.addr.coarse_y;
         if (y == 29) {
             y = 0;
-            vram.addr.nt ^= 2;
+            st->vram.addr.nt ^= 2;
         } else if (y == 31)
             y = 0;
         else
             y += 1;
-        vram.addr.coarse_y = y;
+        st->vram.addr.coarse_y = y;
     }
 }
 
 void PPU::copy_v_horzpos()
 {
-    if (!io.bg_show)
+    if (!st->io.bg_show)
         return;
-    vram.addr.coarse_x = vram.tmp.coarse_x;
-    vram.addr.nt = Util::setbit(vram.addr.nt, 0, vram.tmp.nt & 1);
+    st->vram.addr.coarse_x = st->vram.tmp.coarse_x;
+    st->vram.addr.nt = Util::setbit(st->vram.addr.nt, 0, st->vram.tmp.nt & 1);
 }
 
 void PPU::copy_v_vertpos()
 {
-    if (!io.bg_show)
+    if (!st->io.bg_show)
         return;
-    vram.addr.coarse_y = vram.tmp.coarse_y;
-    vram.addr.fine_y = vram.tmp.fine_y;
-    vram.addr.nt = Util::setbit(vram.addr.nt, 1, vram.tmp.nt >> 1 & 1);
+    st->vram.addr.coarse_y = st->vram.tmp.coarse_y;
+    st->vram.addr.fine_y = st->vram.tmp.fine_y;
+    st->vram.addr.nt = Util::setbit(st->vram.addr.nt, 1, st->vram.tmp.nt >> 1 & 1);
 }
 
 void PPU::fetch_nt(bool dofetch)
@@ -414,7 +400,9 @@ void PPU::fetch_nt(bool dofetch)
      * this is how the vram address can return to the same tile for 8 lines:
      * in rendering, you can think of the fine y and the rest of the address
      * as separate, where fine y of course indicates the row of the tile. */
-    tile.nt = bus->read(0x2000 | (vram.addr & 0x0FFF));
+    st->tile.nt = bus->read(0x2000 | (st->vram.addr & 0x0FFF));
+    if (rendering())
+        watch_a12(0x2000);
 }
 
 void PPU::fetch_attr(bool dofetch)
@@ -424,10 +412,10 @@ void PPU::fetch_attr(bool dofetch)
     // where YYY/XXX are the highest bits of coarse x/y.
     if (!dofetch)
         return;
-    tile.attr = bus->read(0x23C0
-                       |  uint16(vram.addr.nt) << 10
-                       | (uint16(vram.addr.coarse_y) & 0x1C) << 1
-                       | (uint16(vram.addr.coarse_x) & 0x1C) >> 2);
+    st->tile.attr = bus->read(0x23C0
+                       |  uint16(st->vram.addr.nt) << 10
+                       | (uint16(st->vram.addr.coarse_y) & 0x1C) << 1
+                       | (uint16(st->vram.addr.coarse_x) & 0x1C) >> 2);
 }
 
 /* A pattern table address is formed this way:
@@ -441,51 +429,53 @@ void PPU::fetch_lowbg(bool dofetch)
 {
     if (!dofetch)
         return;
-    uint16 lowbg_addr = (io.bg_pt_addr << 12)
-                      | (tile.nt       << 4)
-                      | vram.addr.fine_y;
-    tile.low = bus->read(lowbg_addr);
+    uint16 lowbg_addr = (st->io.bg_pt_addr << 12)
+                      | (st->tile.nt       << 4)
+                      | st->vram.addr.fine_y;
+    st->tile.low = bus->read(lowbg_addr);
+    if (rendering())
+        watch_a12(lowbg_addr);
 }
 
 void PPU::fetch_highbg(bool dofetch)
 {
     if (!dofetch)
         return;
-    uint16 highbg_addr = (io.bg_pt_addr << 12)
-                       | (tile.nt       << 4)
+    uint16 highbg_addr = (st->io.bg_pt_addr << 12)
+                       | (st->tile.nt       << 4)
                        | (1UL           << 3) // or otherwise... add 8
-                       | vram.addr.fine_y;
-    tile.high = bus->read(highbg_addr);
+                       | st->vram.addr.fine_y;
+    st->tile.high = bus->read(highbg_addr);
 }
 
 void PPU::shift_run()
 {
-    shift.tlow  >>= 1;
-    shift.thigh >>= 1;
-    shift.ahigh >>= 1;
-    shift.alow  >>= 1;
-    shift.ahigh = Util::setbit(shift.ahigh, 7, shift.feed_high);
-    shift.ahigh = Util::setbit(shift.alow,  7, shift.feed_low );
+    st->shift.tlow  >>= 1;
+    st->shift.thigh >>= 1;
+    st->shift.ahigh >>= 1;
+    st->shift.alow  >>= 1;
+    st->shift.ahigh = Util::setbit(st->shift.ahigh, 7, st->shift.feed_high);
+    st->shift.ahigh = Util::setbit(st->shift.alow,  7, st->shift.feed_low );
 }
 
 void PPU::shift_fill()
 {
-    shift.tlow  = Util::setbits(shift.tlow,  8, 8, tile.low);
-    shift.thigh = Util::setbits(shift.thigh, 8, 8, tile.high);
+    st->shift.tlow  = Util::setbits(st->shift.tlow,  8, 8, st->tile.low);
+    st->shift.thigh = Util::setbits(st->shift.thigh, 8, 8, st->tile.high);
     // TODO: this is definitely fucking wrong
-    uint16 v = vram.addr;
+    uint16 v = st->vram.addr;
     uint8 attr_mask = 0b11 << (~((v >> 1 & 1) | (v >> 6 & 1)))*2;
-    shift.feed_high = tile.attr & attr_mask;
-    shift.feed_low  = tile.attr & attr_mask;
+    st->shift.feed_high = st->tile.attr & attr_mask;
+    st->shift.feed_low  = st->tile.attr & attr_mask;
 }
 
 uint8 PPU::bg_output()
 {
-    uint8 mask      = 1UL << vram.fine_x;
-    bool lowbit     = shift.tlow  & mask;
-    bool hibit      = shift.thigh & mask;
-    bool at1        = shift.ahigh & mask;
-    bool at2        = shift.alow  & mask;
+    uint8 mask      = 1UL << st->vram.fine_x;
+    bool lowbit     = st->shift.tlow  & mask;
+    bool hibit      = st->shift.thigh & mask;
+    bool at1        = st->shift.ahigh & mask;
+    bool at2        = st->shift.alow  & mask;
     uint8 pal       = at1   << 1 | at2;
     uint8 palind    = hibit << 1 | lowbit;
     return getcolor(0, pal, palind);
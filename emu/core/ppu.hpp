@@ -6,6 +6,8 @@
 #include <emu/core/const.hpp>
 #include <emu/util/unsigned.hpp>
 #include <emu/util/bits.hpp>
+#include <emu/util/file.hpp>
+#include <emu/util/easyrandom.hpp>
 
 namespace Video { class Canvas; }
 
@@ -14,16 +16,6 @@ namespace Core {
 class Bus;
 
 class PPU {
-    Bus *bus;
-    Video::Canvas *screen;
-    uint8 vrammem[VRAM_SIZE];
-    uint8 oammem[OAM_SIZE];
-    uint8 palmem[PAL_SIZE];
-    unsigned long cycles = 0;
-    unsigned long lines  = 0;
-    std::function<void(void)> nmi_callback;
-    bool odd_frame;
-
     union VRAMAddress {
         uint16 value = 0;
         Util::BitField<uint16, 12, 3> fine_y;
@@ -44,69 +36,124 @@ class PPU {
 
         // PPUCTRL
         // nt addr is the most significant bits of vram.addr/vram.tmp
-        bool vram_inc;
-        bool sp_pt_addr;
-        bool bg_pt_addr;
-        bool sp_size;
+        bool vram_inc = 0;
+        bool sp_pt_addr = 0;
+        bool bg_pt_addr = 0;
+        bool sp_size = 0;
         // i can't find explanations for this one
-        bool ext_bus_dir;
+        bool ext_bus_dir = 0;
         // whether the ppu can go into vblank (leftmost bit of PPUCTRL)
-        bool nmi_enabled;
+        bool nmi_enabled = 0;
 
         // PPUMASK
-        bool grey;
-        bool bg_show_left;
-        bool sp_show_left;
-        bool bg_show;
-        bool sp_show;
-        bool red;
-        bool green;
-        bool blue;
+        bool grey = 0;
+        bool bg_show_left = 0;
+        bool sp_show_left = 0;
+        bool bg_show = 0;
+        bool sp_show = 0;
+        bool red = 0;
+        bool green = 0;
+        bool blue = 0;
 
         // PPUSTATUS
-        bool sp_overflow;
-        bool sp_zero_hit;
-        bool vblank;
+        bool sp_overflow = 0;
+        bool sp_zero_hit = 0;
+        bool vblank = 0;
 
         // OAMADDR
-        uint8 oam_addr;
+        uint8 oam_addr = 0;
 
         // PPUSCROLL, PPUADDR
-        bool scroll_latch;
+        bool scroll_latch = 0;
 
         // PPUDATA
-        uint8 data_buf;
-    } io;
+        uint8 data_buf = 0;
+    };
 
     struct VRAM {
         VRAMAddress addr;
         VRAMAddress tmp;
-        uint8 fine_x;
+        uint8 fine_x = 0;
         // 10 bit numbers?
         uint16 vx() const { return fine_x      | addr.coarse_x << 3 | (addr.nt & 1) << 8; }
         uint8 vy() const  { return addr.fine_y | addr.coarse_y << 3 | (addr.nt & 2) << 8; }
-    } vram;
+    };
 
     struct Tile {
-        uint8 nt;
-        uint8 attr;
-        uint8 low;
-        uint8 high;
-    } tile;
+        uint8 nt   = 0;
+        uint8 attr = 0;
+        uint8 low  = 0;
+        uint8 high = 0;
+    };
 
     struct Shift {
-        uint16 tlow, thigh;
-        uint8  alow, ahigh;
-        bool feed_low, feed_high;
-    } shift;
+        uint16 tlow = 0, thigh = 0;
+        uint8  alow = 0, ahigh = 0;
+        bool feed_low = false, feed_high = false;
+    };
 
     struct OAM {
-        uint8 shifts[8], latches[8], counters[8];
-    } oam;
+        uint8 shifts[8] = {}, latches[8] = {}, counters[8] = {};
+    };
 
 public:
+    /* Everything that changes while running, kept apart so that an
+     * emulator can have the state of all its parts in a single block (see
+     * Emulator::State). Until attach_state() the PPU uses its own.
+     * The frame buffer isn't part of it: it's output, fully redrawn by the
+     * next frame. */
+    struct State {
+        uint8 vrammem[VRAM_SIZE] = {};
+        uint8 oammem[OAM_SIZE] = {};
+        uint8 palmem[PAL_SIZE] = {};
+        unsigned long cycles = 0;
+        unsigned long lines  = 0;
+        bool odd_frame = false;
+        // state of address line 12, for mappers that count its rises
+        bool a12 = false;
+        unsigned long dots = 0;
+        unsigned long a12_fall = 0;
+        Mirroring nt_mirroring = Mirroring::VERT;
+        IO io;
+        VRAM vram;
+        Tile tile;
+        Shift shift;
+        OAM oam;
+    };
 
-    void power();
+private:
+    Bus *bus;
+    Video::Canvas *screen = nullptr;
+    // for frames nobody sees: no pixels, not even in framebuf
+    bool hidden = false;
+    std::function<void(void)> nmi_callback;
+    std::function<void(void)> a12_callback;
+    State own{};
+    State *st = &own;
+    /* palette index of every pixel output, independent of any screen. Its
+     * pages come zeroed and only take memory once drawn on, which matters
+     * for emulators that are never shown (forks, run-ahead). */
+    Util::FileView fbmem = Util::FileView::anonymous(SCREEN_WIDTH*SCREEN_HEIGHT);
+    uint8 *framebuf = fbmem.writable_data();
+
+    uint16 nt_decode(uint16 addr) const;
+
+public:
+    PPU() = default;
+    PPU(const PPU &) = delete;
+    PPU & operator=(const PPU &) = delete;
+
+    // the current state is copied to state, which is used from then on.
+    // without copy, state is taken as it is.
+    void attach_state(State *state, bool copy = true)
+    {
+        if (copy && state != st)
+            *state = *st;
+        st = state;
+    }
+
+    // with rng, VRAM, OAM and palette RAM start out random instead of zeroed.
+    void power(Util::Random *rng = nullptr);
     void reset();
     void attach_bus(Bus *vrambus, Bus *rambus);
     void set_mirroring(Mirroring m);
@@ -132,15 +179,24 @@ public:
     Status status() const;
 
     void set_screen(Video::Canvas *canvas) { screen = canvas; }
+    const uint8 *frame() const             { return framebuf; }
+    void skip_output(bool skip)            { hidden = skip; }
     void set_nmi_callback(auto &&callback) { nmi_callback = callback; }
+    // called when A12 rises after staying low for a while (about once per scanline)
+    void set_a12_callback(auto &&callback) { a12_callback = callback; }
 
     // these shouldn't be called outside ppumain.cpp
     template <unsigned int Cycle> void ccycle();
     template <unsigned int Line> void lcycle(unsigned int cycle);
     template <unsigned Cycle> void background_cycle();
     void cycle_idle();
+    void cycle_fetchsprite_nt();
+    void cycle_fetchsprite_pt();
 
 private:
+    bool rendering() const { return st->io.bg_show || st->io.sp_show; }
+    void watch_a12(uint16 addr);
+
     uint8 readreg(const uint16 which);
     void writereg(const uint16 which, const uint8 data);
     uint8 readreg_no_sideeff(const uint16 which) const;
@@ -12,15 +12,15 @@ void PPU::cycle_idle()
 // called at (340, 261)
 void PPU::begin_frame()
 {
-    assert(lines%262 == 261 && cycles%341 == 340);
-    if (odd_frame) {
-        lines = 0;
-        cycles = 0;
+    assert(st->lines%262 == 261 && st->cycles%341 == 340);
+    if (st->odd_frame) {
+        st->lines = 0;
+        st->cycles = 0;
         dbgputc('\n');
     } else {
         dbgputc('0');
     }
-    odd_frame^=1;
+    st->odd_frame^=1;
 }
 
 void PPU::cycle_fetchnt(bool cycle)
@@ -47,6 +47,23 @@ void PPU::cycle_fetchhighbg(bool cycle)
     dbgputc('h');
 }
 
+/* Sprites aren't drawn yet, but their fetches in cycles 257-320 still
+ * happen: mappers watching A12 depend on them. With 8x16 sprites, empty
+ * slots use tile $FF, which lives in the $1000 table. */
+void PPU::cycle_fetchsprite_nt()
+{
+    if (rendering())
+        watch_a12(0x2000);
+    dbgputc('s');
+}
+
+void PPU::cycle_fetchsprite_pt()
+{
+    if (rendering())
+        watch_a12(st->io.sp_size ? 0x1000 : st->io.sp_pt_addr << 12);
+    dbgputc('p');
+}
+
 void PPU::cycle_incvhorz()
 {
     inc_v_horzpos();
@@ -83,16 +100,16 @@ void PPU::cycle_fillshifts()
 
 void PPU::vblank_begin()
 {
-    io.vblank = 1;
+    st->io.vblank = 1;
     nmi_callback();
     dbgputc('v');
 }
 
 void PPU::vblank_end()
 {
-    io.vblank  = 0;
-    io.sp_zero_hit = 0;
-    io.sp_overflow  = 0;
+    st->io.vblank  = 0;
+    st->io.sp_zero_hit = 0;
+    st->io.sp_overflow  = 0;
     dbgputc('e');
 }
 
@@ -146,6 +163,8 @@ using LineFunc  = void (PPU::*)(unsigned);
 
 #define CCYCLE &PPU::ccycle
 #define IDLE &PPU::cycle_idle
+#define SPNT &PPU::cycle_fetchsprite_nt
+#define SPPT &PPU::cycle_fetchsprite_pt
 static constexpr std::array<CycleFunc, 341> cycletab = {
     IDLE,        CCYCLE<1>,   CCYCLE<2>,   CCYCLE<3>,   CCYCLE<4>,   CCYCLE<5>,   CCYCLE<6>,   CCYCLE<7>,
     CCYCLE<8>,   CCYCLE<9>,   CCYCLE<10>,  CCYCLE<11>,  CCYCLE<12>,  CCYCLE<13>,  CCYCLE<14>,  CCYCLE<15>,
@@ -179,20 +198,22 @@ static constexpr std::array<CycleFunc, 341> cycletab = {
     CCYCLE<232>, CCYCLE<233>, CCYCLE<234>, CCYCLE<235>, CCYCLE<236>, CCYCLE<237>, CCYCLE<238>, CCYCLE<239>,
     CCYCLE<240>, CCYCLE<241>, CCYCLE<242>, CCYCLE<243>, CCYCLE<244>, CCYCLE<245>, CCYCLE<246>, CCYCLE<247>,
     CCYCLE<248>, CCYCLE<249>, CCYCLE<250>, CCYCLE<251>, CCYCLE<252>, CCYCLE<253>, CCYCLE<254>, CCYCLE<255>,
-    CCYCLE<256>, CCYCLE<257>, IDLE,        IDLE,        IDLE,        IDLE,        IDLE,        IDLE,
-    IDLE,        IDLE,        IDLE,        IDLE,        IDLE,        IDLE,        IDLE,        IDLE,
-    IDLE,        IDLE,        IDLE,        IDLE,        IDLE,        IDLE,        IDLE,        IDLE,
-    IDLE,        IDLE,        IDLE,        IDLE,        IDLE,        IDLE,        IDLE,        IDLE,
-    IDLE,        IDLE,        IDLE,        IDLE,        IDLE,        IDLE,        IDLE,        IDLE,
-    IDLE,        IDLE,        IDLE,        IDLE,        IDLE,        IDLE,        IDLE,        IDLE,
-    IDLE,        IDLE,        IDLE,        IDLE,        IDLE,        IDLE,        IDLE,        IDLE,
-    IDLE,        IDLE,        IDLE,        IDLE,        IDLE,        IDLE,        IDLE,        IDLE,
+    CCYCLE<256>, CCYCLE<257>, SPNT,        IDLE,        IDLE,        IDLE,        SPPT,        IDLE,
+    IDLE,        IDLE,        SPNT,        IDLE,        IDLE,        IDLE,        SPPT,        IDLE,
+    IDLE,        IDLE,        SPNT,        IDLE,        IDLE,        IDLE,        SPPT,        IDLE,
+    IDLE,        IDLE,        SPNT,        IDLE,        IDLE,        IDLE,        SPPT,        IDLE,
+    IDLE,        IDLE,        SPNT,        IDLE,        IDLE,        IDLE,        SPPT,        IDLE,
+    IDLE,        IDLE,        SPNT,        IDLE,        IDLE,        IDLE,        SPPT,        IDLE,
+    IDLE,        IDLE,        SPNT,        IDLE,        IDLE,        IDLE,        SPPT,        IDLE,
+    IDLE,        IDLE,        SPNT,        IDLE,        IDLE,        IDLE,        SPPT,        IDLE,
     IDLE,        CCYCLE<321>, CCYCLE<322>, CCYCLE<323>, CCYCLE<324>, CCYCLE<325>, CCYCLE<326>, CCYCLE<327>,
     CCYCLE<328>, CCYCLE<329>, CCYCLE<330>, CCYCLE<331>, CCYCLE<332>, CCYCLE<333>, CCYCLE<334>, CCYCLE<335>,
     CCYCLE<336>, CCYCLE<337>, CCYCLE<338>, CCYCLE<339>, CCYCLE<340>,
 };
 #undef CCYCLE
 #undef IDLE
+#undef SPNT
+#undef SPPT
 
 template <unsigned int Line>
 void PPU::lcycle(unsigned int cycle)
@@ -259,9 +280,10 @@ static constexpr std::array<LineFunc, 262> linetab = {
 
 void PPU::run()
 {
-    const auto linefunc = linetab[lines % 262];
-    (this->*linefunc)(cycles % 341);
-    cycles++;
-    lines += (cycles % 341 == 0);
+    const auto linefunc = linetab[st->lines % 262];
+    (this->*linefunc)(st->cycles % 341);
+    st->cycles++;
+    st->dots++;
+    st->lines += (st->cycles % 341 == 0);
 }
 
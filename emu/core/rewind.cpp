@@ -0,0 +1,146 @@
+#include <emu/core/rewind.hpp>
+
+#include <cstring>
+
+namespace Core {
+
+// equal bytes needed to end a literal run; shorter gaps are cheaper kept in it
+static const std::size_t MIN_ZEROS = 4;
+
+static uint8 *put_varint(uint8 *out, std::size_t n)
+{
+    while (n >= 0x80) {
+        *out++ = uint8(n & 0x7F) | 0x80;
+        n >>= 7;
+    }
+    *out++ = uint8(n);
+    return out;
+}
+
+static const uint8 *get_varint(const uint8 *in, std::size_t &n)
+{
+    n = 0;
+    for (int shift = 0; ; shift += 7) {
+        n |= std::size_t(*in & 0x7F) << shift;
+        if (!(*in++ & 0x80))
+            return in;
+    }
+}
+
+/* A delta is a list of (zeros, length, bytes): skip zeros bytes, then XOR
+ * the next length ones. Counts are varints. */
+static uint8 *encode(const uint8 *a, const uint8 *b, std::size_t n, uint8 *out)
+{
+    std::size_t i = 0;
+    while (i < n) {
+        std::size_t z = i;
+        for (uint64 x, y; z + 8 <= n; z += 8) {
+            std::memcpy(&x, a + z, 8);
+            std::memcpy(&y, b + z, 8);
+            if (x != y)
+                break;
+        }
+        while (z < n && a[z] == b[z])
+            z++;
+        std::size_t end = z, e = z;
+        while (e < n && e - end < MIN_ZEROS) {
+            if (a[e] != b[e])
+                end = e + 1;
+            e++;
+        }
+        out = put_varint(out, z - i);
+        out = put_varint(out, end - z);
+        for (std::size_t k = z; k < end; k++)
+            *out++ = a[k] ^ b[k];
+        i = end;
+    }
+    return out;
+}
+
+static void apply(const uint8 *in, const uint8 *end, uint8 *state)
+{
+    std::size_t pos = 0;
+    while (in < end) {
+        std::size_t zeros, len;
+        in = get_varint(in, zeros);
+        in = get_varint(in, len);
+        pos += zeros;
+        for (std::size_t k = 0; k < len; k++)
+            state[pos + k] ^= in[k];
+        in  += len;
+        pos += len;
+    }
+}
+
+void Rewinder::drop_oldest()
+{
+    used_bytes -= entries.front().size;
+    entries.pop_front();
+}
+
+/* Deltas are laid out in the ring in order, each one contiguous; when one
+ * doesn't fit before the end it goes at the start, and the space left at the
+ * end stays unused until the next time around. */
+std::size_t Rewinder::make_room(std::size_t size)
+{
+    std::size_t pos = entries.empty() ? 0 : entries.back().offset + entries.back().size;
+    if (pos + size > ring.size()) {
+        while (!entries.empty() && entries.front().offset >= pos)
+            drop_oldest();
+        pos = 0;
+    }
+    while (!entries.empty() && entries.front().offset >= pos && entries.front().offset < pos + size)
+        drop_oldest();
+    return pos;
+}
+
+void Rewinder::push(std::span<const uint8> state)
+{
+    if (current.size() != state.size()) {
+        clear();
+        current.assign(state.begin(), state.end());
+        return;
+    }
+    // worst case: one zero between every two bytes
+    scratch.resize(state.size() * 2 + 16);
+    const std::size_t size = encode(current.data(), state.data(), state.size(), scratch.data()) - scratch.data();
+    if (size <= ring.size()) {
+        const std::size_t pos = make_room(size);
+        std::memcpy(ring.data() + pos, scratch.data(), size);
+        entries.push_back({ pos, size });
+        used_bytes += size;
+    } else
+        clear();
+    current.assign(state.begin(), state.end());
+}
+
+unsigned Rewinder::rewind(unsigned steps)
+{
+    unsigned done = 0;
+    for ( ; done < steps && !entries.empty(); done++) {
+        const auto e = entries.back();
+        apply(ring.data() + e.offset, ring.data() + e.offset + e.size, current.data());
+        used_bytes -= e.size;
+        entries.pop_back();
+    }
+    return done;
+}
+
+void Rewinder::clear()
+{
+    entries.clear();
+    current.clear();
+    used_bytes = 0;
+}
+
+Rewinder::Stats Rewinder::stats() const
+{
+    return {
+        .snapshots = entries.size() + !current.empty(),
+        .memory    = used_bytes + current.size(),
+        .capacity  = ring.size(),
+        .ratio     = used_bytes ? double(entries.size() * current.size()) / used_bytes : 1.0,
+    };
+}
+
+} // namespace Core
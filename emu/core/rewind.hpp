@@ -0,0 +1,60 @@
+#ifndef CORE_REWIND_HPP_INCLUDED
+#define CORE_REWIND_HPP_INCLUDED
+
+#include <cstddef>
+#include <deque>
+#include <span>
+#include <vector>
+#include <emu/util/unsigned.hpp>
+
+namespace Core {
+
+/* Rewind history: a fixed size ring of snapshots of the emulator's state
+ * block. Only the newest snapshot is kept whole; every other one is stored as
+ * the XOR with the snapshot after it, run length encoded. Consecutive states
+ * differ in a few hundred bytes out of ~20k, so the XOR is mostly zeros and
+ * the runs make it small. Going back one snapshot is XORing one delta into
+ * the newest, which only touches the bytes that changed. When the ring is
+ * full the oldest snapshots are dropped. */
+class Rewinder {
+    struct Entry {
+        std::size_t offset;
+        std::size_t size;
+    };
+
+    std::vector<uint8> ring;
+    std::deque<Entry> entries;
+    std::vector<uint8> current;
+    std::vector<uint8> scratch;
+    // by the deltas in the ring
+    std::size_t used_bytes = 0;
+
+    std::size_t make_room(std::size_t size);
+    void drop_oldest();
+
+public:
+    struct Stats {
+        std::size_t snapshots;
+        // bytes used in the ring, including the newest snapshot
+        std::size_t memory;
+        std::size_t capacity;
+        // uncompressed size over compressed size
+        double ratio;
+    };
+
+    explicit Rewinder(std::size_t capacity) : ring(capacity) { }
+
+    // state must always be the same size.
+    void push(std::span<const uint8> state);
+    // goes back up to steps snapshots (dropping them), returning how many
+    // it went. The state it went back to is then newest().
+    unsigned rewind(unsigned steps);
+    std::span<const uint8> newest() const { return current; }
+    bool empty() const                    { return current.empty(); }
+    void clear();
+    Stats stats() const;
+};
+
+} // namespace Core
+
+#endif
@@ -0,0 +1,57 @@
+#include <emu/core/romdb.hpp>
+
+namespace Core {
+
+namespace {
+
+/* 12 bytes per game. ROM sizes are counted in the units of the iNES header,
+ * RAM sizes are stored as in NES 2.0, that is 64 << n bytes, or none for 0.
+ * Empty slots have prg == 0; there's always at least one. */
+struct Entry {
+    uint32 crc;
+    uint16 prg;         // 16k units
+    uint16 chr;         // 8k units
+    uint16 mapper;      // mapper | submapper << 12
+    uint8 ram;          // prg ram | chr ram << 4
+    uint8 flags;
+};
+
+enum EntryFlags : uint8 {
+    FLAG_VERT       = 1,
+    FLAG_FOURSCREEN = 2,
+    FLAG_BATTERY    = 4,
+};
+
+// tests build this again with a table of their own
+#ifdef ROMDB_TABLE
+#include ROMDB_TABLE
+#else
+#include <emu/core/romdb_table.inc>
+#endif
+
+uint32 ram_size(unsigned shift) { return shift == 0 ? 0 : 64u << shift; }
+
+} // namespace
+
+std::optional<RomInfo> romdb_lookup(uint32 crc)
+{
+    const uint16 seed = romdb_seeds[romdb_hash(crc, 0) % ROMDB_BUCKETS];
+    const Entry &e = romdb_entries[romdb_hash(crc, seed) % ROMDB_SLOTS];
+    if (e.crc != crc || e.prg == 0)
+        return std::nullopt;
+    return RomInfo {
+        .prgrom_size = e.prg * 0x4000u,
+        .chrrom_size = e.chr * 0x2000u,
+        .prgram_size = ram_size(e.ram & 0xF),
+        .chrram_size = ram_size(e.ram >> 4),
+        .mapper      = uint16(e.mapper & 0xFFF),
+        .submapper   = uint8(e.mapper >> 12),
+        .mirroring   = e.flags & FLAG_VERT ? Mirroring::VERT : Mirroring::HORZ,
+        .four_screen = bool(e.flags & FLAG_FOURSCREEN),
+        .battery     = bool(e.flags & FLAG_BATTERY),
+    };
+}
+
+unsigned romdb_size() { return ROMDB_SIZE; }
+
+} // namespace Core
@@ -0,0 +1,51 @@
+#ifndef CORE_ROMDB_HPP_INCLUDED
+#define CORE_ROMDB_HPP_INCLUDED
+
+/* A built-in database of known ROMs, used to fix bad headers. Entries are
+ * keyed by the CRC-32 of PRG ROM followed by CHR ROM (header and trainer
+ * excluded), same as the NES 2.0 database.
+ * The table lives in romdb_table.inc, which is generated by tools/romdb_gen
+ * from data/romdb.txt. It's a perfect hash: every key is placed so that a
+ * lookup is two hashes and a single compare, with no probing.
+ * There's no SHA-1: a CRC-32 hit only counts if the ROM sizes match too.
+ * The table isn't compressed either, at 12 bytes per game it's used in
+ * place, straight from the binary. */
+
+#include <optional>
+#include <emu/core/const.hpp>
+#include <emu/util/unsigned.hpp>
+
+namespace Core {
+
+struct RomInfo {
+    uint32 prgrom_size;
+    uint32 chrrom_size;
+    uint32 prgram_size;     // battery backed or not
+    uint32 chrram_size;
+    uint16 mapper;
+    uint8 submapper;
+    Mirroring mirroring;
+    bool four_screen;
+    bool battery;
+};
+
+std::optional<RomInfo> romdb_lookup(uint32 crc);
+// number of entries, mostly useful for checking the table got built.
+unsigned romdb_size();
+
+// shared by the lookup and the generator. seed 0 picks the bucket, the
+// bucket's seed picks the slot.
+inline uint32 romdb_hash(uint32 key, uint32 seed)
+{
+    uint32 x = (key ^ (seed * 0x9E3779B9u)) & 0xFFFFFFFF;
+    x ^= x >> 16;
+    x  = (x * 0x85EBCA6Bu) & 0xFFFFFFFF;
+    x ^= x >> 13;
+    x  = (x * 0xC2B2AE35u) & 0xFFFFFFFF;
+    x ^= x >> 16;
+    return x;
+}
+
+} // namespace Core
+
+#endif
@@ -0,0 +1,182 @@
+#include <emu/core/romindex.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+#include <vector>
+#include <emu/core/cartridge.hpp>
+#include <emu/util/debug.hpp>
+#include <emu/util/threadpool.hpp>
+
+namespace fs = std::filesystem;
+
+namespace Core {
+
+static const char MAGIC[8] = { 'Y', 'N', 'E', 'S', 'I', 'D', 'X', '1' };
+
+static_assert(sizeof(RomIndex::Header) == 16);
+static_assert(sizeof(RomIndex::Entry)  == 48);
+
+bool RomIndex::open(const std::string &filename)
+{
+    entries = {};
+    strings = {};
+    Util::File f;
+    if (!f.open(filename, Util::File::Mode::READ))
+        return false;
+    file = f.view();
+    if (file.size() < sizeof(Header))
+        return false;
+    Header h;
+    std::memcpy(&h, file.data(), sizeof(h));
+    const std::size_t entries_end = sizeof(Header) + std::size_t(h.count) * sizeof(Entry);
+    if (std::memcmp(h.magic, MAGIC, sizeof(MAGIC)) != 0
+     || entries_end + h.strings_size != file.size()
+     || (h.strings_size != 0 && file.data()[file.size() - 1] != '\0'))
+        return false;
+    // a view that had to be copied isn't necessarily aligned
+    if (reinterpret_cast<std::uintptr_t>(file.data()) % alignof(Entry) != 0)
+        return false;
+    auto e = reinterpret_cast<const Entry *>(file.data() + sizeof(Header));
+    for (uint32_t i = 0; i < h.count; i++)
+        if (e[i].path >= h.strings_size)
+            return false;
+    entries = { e, h.count };
+    strings = { reinterpret_cast<const char *>(file.data() + entries_end), h.strings_size };
+    return true;
+}
+
+const RomIndex::Entry *RomIndex::find(std::string_view p) const
+{
+    auto it = std::lower_bound(begin(), end(), p, [this](const Entry &e, std::string_view p) {
+        return path(e) < p;
+    });
+    return it != end() && path(*it) == p ? it : nullptr;
+}
+
+namespace {
+
+struct Found {
+    std::string path;       // relative to the scanned directory
+    RomIndex::Entry entry;
+    bool scanned;
+};
+
+void scan_one(const fs::path &dir, Found &f)
+{
+    auto &e = f.entry;
+    Util::File romfile;
+    if (!romfile.open((dir / f.path).string(), Util::File::Mode::READ))
+        return;
+    Cartridge cart;
+    if (!cart.parse_header(Cartridge::read_rom(romfile), f.path))
+        return;
+    e.crc         = cart.crc32();
+    e.prgrom_size = cart.prgromsize();
+    e.chrrom_size = cart.chrromsize();
+    e.prgram_size = cart.prgramsize();
+    e.chrram_size = cart.chrramsize();
+    e.mapper      = cart.mappertype();
+    e.submapper   = cart.submappertype();
+    e.flags       = RomIndex::VALID
+                  | (cart.mirroring() == Mirroring::VERT ? RomIndex::VERT : 0)
+                  | (cart.hasfourscreen() ? RomIndex::FOURSCREEN : 0)
+                  | (cart.hasbattery()    ? RomIndex::BATTERY    : 0)
+                  | (cart.isnes20()       ? RomIndex::NES20      : 0)
+                  | (cart.indatabase()    ? RomIndex::IN_DB      : 0);
+}
+
+bool is_rom(const fs::path &p)
+{
+    auto ext = p.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return std::tolower(c); });
+    return ext == ".nes" || ext == ".zip" || ext == ".gz";
+}
+
+} // namespace
+
+bool scan_roms(const std::string &dir, const std::string &index_path, Util::ThreadPool &pool, ScanStats &stats)
+{
+    stats = {};
+    std::vector<Found> found;
+    std::error_code ec;
+    for (auto it = fs::recursive_directory_iterator(dir, fs::directory_options::skip_permission_denied, ec);
+         it != fs::recursive_directory_iterator(); it.increment(ec)) {
+        if (ec)
+            break;
+        if (it->is_regular_file(ec) && is_rom(it->path()))
+            found.push_back({ .path = fs::relative(it->path(), dir, ec).generic_string(), .entry = {}, .scanned = false });
+    }
+    if (ec) {
+        error("{}: {}\n", dir, ec.message());
+        return false;
+    }
+    std::sort(found.begin(), found.end(), [](const Found &a, const Found &b) { return a.path < b.path; });
+
+    RomIndex old;
+    old.open(index_path);
+    const fs::path root = dir;
+    // stat()ing is as slow as reading a header on a cold cache, so it's done
+    // in the pool too.
+    pool.parallel_for(found.size(), [&](unsigned i) {
+        auto &f = found[i];
+        std::error_code ec;
+        const auto path = root / f.path;
+        f.entry.size  = fs::file_size(path, ec);
+        f.entry.mtime = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            fs::last_write_time(path, ec).time_since_epoch()).count();
+        if (auto *prev = old.find(f.path); prev && prev->size == f.entry.size && prev->mtime == f.entry.mtime) {
+            f.entry = *prev;
+            return;
+        }
+        scan_one(root, f);
+        f.scanned = true;
+    });
+
+    std::string strings;
+    std::vector<RomIndex::Entry> entries;
+    entries.reserve(found.size());
+    for (auto &f : found) {
+        f.entry.path = strings.size();
+        entries.push_back(f.entry);
+        strings.append(f.path);
+        strings.push_back('\0');
+        stats.scanned += f.scanned;
+        stats.reused  += !f.scanned;
+        stats.invalid += !(f.entry.flags & RomIndex::VALID);
+    }
+    stats.files = found.size();
+
+    // the old index might still be mapped, so write a new file and rename.
+    const std::string tmp = index_path + ".tmp";
+    Util::BufferedFile out;
+    if (!out.open(tmp, Util::BufferedFile::Mode::WRITE)) {
+        error("{}: {}\n", tmp, out.error_str());
+        return false;
+    }
+    RomIndex::Header h;
+    std::memcpy(h.magic, MAGIC, sizeof(MAGIC));
+    h.count        = found.size();
+    h.strings_size = strings.size();
+    auto bytes = [](auto s) {
+        return std::span { reinterpret_cast<const unsigned char *>(s.data()), s.size_bytes() };
+    };
+    const std::span<const unsigned char> parts[] = {
+        bytes(std::span { &h, 1 }),
+        bytes(std::span { entries }),
+        bytes(std::span { strings }),
+    };
+    bool ok = out.writev(parts) && out.close();
+    if (ok)
+        fs::rename(tmp, index_path, ec);
+    if (!ok || ec) {
+        error("{}: can't write index\n", index_path);
+        fs::remove(tmp, ec);
+        return false;
+    }
+    return true;
+}
+
+} // namespace Core
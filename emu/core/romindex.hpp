@@ -0,0 +1,87 @@
+#ifndef CORE_ROMINDEX_HPP_INCLUDED
+#define CORE_ROMINDEX_HPP_INCLUDED
+
+/* An index of a ROM library. scan_roms() walks a directory tree, looks at
+ * every .nes, .zip and .gz file in it with a pool of threads and writes what it found to a
+ * binary file:
+ *
+ *      header      Header, magic "YNESIDX" + version
+ *      entries     RomIndex::Entry * count, sorted by path
+ *      strings     the paths, relative to the scanned directory, each
+ *                  followed by a NUL
+ *
+ * All fields are little endian and naturally aligned, so the file is used
+ * as is after mapping it (RomIndex::open). A rescan reuses the entries of
+ * files whose size and modification time didn't change; files that aren't
+ * valid ROMs get an entry too, so they aren't looked at again. */
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <emu/util/file.hpp>
+
+namespace Util { class ThreadPool; }
+
+namespace Core {
+
+class RomIndex {
+public:
+    enum Flags : uint8_t {
+        VALID      = 1 << 0,    // the rest is garbage if not set
+        VERT       = 1 << 1,    // else horizontal
+        FOURSCREEN = 1 << 2,
+        BATTERY    = 1 << 3,
+        NES20      = 1 << 4,
+        IN_DB      = 1 << 5,    // corrected by the ROM database
+    };
+
+    struct Header {
+        char magic[8];
+        uint32_t count;
+        uint32_t strings_size;
+    };
+
+    struct Entry {
+        int64_t mtime;          // nanoseconds, as std::filesystem reports them
+        uint64_t size;
+        uint32_t path;          // offset in the string table
+        uint32_t crc;
+        uint32_t prgrom_size;
+        uint32_t chrrom_size;
+        uint32_t prgram_size;
+        uint32_t chrram_size;
+        uint16_t mapper;
+        uint8_t submapper;
+        uint8_t flags;
+        uint32_t reserved;
+    };
+
+private:
+    Util::FileView file;
+    std::span<const Entry> entries;
+    std::string_view strings;
+
+public:
+    // false if the file is missing or isn't a valid index.
+    bool open(const std::string &filename);
+
+    std::size_t size() const             { return entries.size(); }
+    const Entry *begin() const           { return entries.data(); }
+    const Entry *end() const             { return entries.data() + entries.size(); }
+    std::string_view path(const Entry &e) const { return strings.data() + e.path; }
+    // binary search by path; nullptr if not there.
+    const Entry *find(std::string_view path) const;
+};
+
+struct ScanStats {
+    std::size_t files, scanned, reused, invalid;
+};
+
+/* Scans dir and writes the index to index_path. If index_path already has
+ * an index, unchanged files are taken from it. */
+bool scan_roms(const std::string &dir, const std::string &index_path, Util::ThreadPool &pool, ScanStats &stats);
+
+} // namespace Core
+
+#endif
@@ -0,0 +1,91 @@
+#include <emu/core/vecemulator.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+namespace Core {
+
+static unsigned pool_size(unsigned threads)
+{
+    return threads != 0 ? threads : std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+static void downsample(std::span<const uint8> frame, unsigned factor, uint8 *out)
+{
+    for (unsigned y = 0; y < SCREEN_HEIGHT; y += factor)
+        for (unsigned x = 0; x < SCREEN_WIDTH; x += factor)
+            *out++ = frame[y * SCREEN_WIDTH + x];
+}
+
+VecEmulator::VecEmulator(const Emulator &from, unsigned n, const Config &config)
+    : conf(config), pool(pool_size(config.threads))
+{
+    conf.downsample = std::max(conf.downsample, 1u);
+    width  = (SCREEN_WIDTH  + conf.downsample - 1) / conf.downsample;
+    height = (SCREEN_HEIGHT + conf.downsample - 1) / conf.downsample;
+    start_ram.assign(from.cpu_ram().begin(), from.cpu_ram().end());
+    start_frame.resize(width * height);
+    downsample(from.frame(), conf.downsample, start_frame.data());
+}
+
+std::unique_ptr<VecEmulator> VecEmulator::create(const Emulator &from, unsigned n, const Config &config)
+{
+    auto vec = std::unique_ptr<VecEmulator>(new VecEmulator(from, n, config));
+    vec->start = from.clone();
+    if (!vec->start)
+        return nullptr;
+    for (unsigned i = 0; i < n; i++) {
+        vec->envs.push_back(vec->start->clone());
+        if (!vec->envs.back())
+            return nullptr;
+    }
+    vec->elapsed.assign(n, 0);
+    vec->obs.resize(n * (RAM_SIZE + vec->width * vec->height + 1));
+    vec->reset();
+    return vec;
+}
+
+void VecEmulator::observe(unsigned i)
+{
+    std::memcpy(obs.data() + i * RAM_SIZE, envs[i]->cpu_ram().data(), RAM_SIZE);
+    downsample(envs[i]->frame(), conf.downsample, obs.data() + ram().size() + i * width * height);
+}
+
+void VecEmulator::restart(unsigned i)
+{
+    envs[i]->copy_state(*start);
+    elapsed[i] = 0;
+    std::memcpy(obs.data() + i * RAM_SIZE, start_ram.data(), RAM_SIZE);
+    std::memcpy(obs.data() + ram().size() + i * width * height, start_frame.data(), start_frame.size());
+}
+
+/* Environments are split into a contiguous range per thread: they all take
+ * about as long, and each thread only writes its own part of obs. */
+void VecEmulator::step(std::span<const uint8> actions)
+{
+    const unsigned n = size(), parts = std::min(pool.size(), n);
+    uint8 *done = obs.data() + ram().size() + frames().size();
+    pool.parallel_for(parts, [&](unsigned part) {
+        for (unsigned i = n * part / parts; i < n * (part + 1) / parts; i++) {
+            envs[i]->set_buttons(0, i < actions.size() ? actions[i] : 0);
+            envs[i]->run_frame();
+            elapsed[i]++;
+            done[i] = (conf.max_frames != 0 && elapsed[i] >= conf.max_frames)
+                   || (conf.done && conf.done(envs[i]->cpu_ram()));
+            if (done[i])
+                restart(i);
+            else
+                observe(i);
+        }
+    });
+}
+
+void VecEmulator::reset()
+{
+    for (unsigned i = 0; i < size(); i++)
+        restart(i);
+    std::fill(obs.end() - size(), obs.end(), 0);
+}
+
+} // namespace Core
@@ -0,0 +1,84 @@
+#ifndef CORE_VECEMULATOR_HPP_INCLUDED
+#define CORE_VECEMULATOR_HPP_INCLUDED
+
+#include <functional>
+#include <memory>
+#include <span>
+#include <vector>
+#include <emu/core/emulator.hpp>
+#include <emu/util/threadpool.hpp>
+#include <emu/util/unsigned.hpp>
+
+namespace Core {
+
+/* Many emulators stepped in lock-step, a frame at a time, for training
+ * agents. Every environment is a clone of the emulator it's created from,
+ * whose state is also where environments go back to when their episode ends.
+ *
+ * Observations of all environments are in one buffer, each kind an array
+ * over environments:
+ *
+ *      ram()       n x RAM_SIZE                    CPU RAM
+ *      frames()    n x frame_height() x frame_width()
+ *                  palette indexes (0-63), every downsample'th pixel
+ *      dones()     n                               1 if the episode ended
+ *
+ * When an episode ends (done returns true or it's max_frames long) the
+ * environment restores the start state at once, and its observation is the
+ * start one. */
+class VecEmulator {
+public:
+    using Done = std::function<bool(std::span<const uint8> ram)>;
+
+    struct Config {
+        unsigned downsample = 2;
+        // 0 is no limit
+        unsigned long max_frames = 0;
+        // called on the threads doing the stepping
+        Done done = nullptr;
+        // 0 is one per core
+        unsigned threads = 0;
+    };
+
+private:
+    std::unique_ptr<Emulator> start;
+    std::vector<std::unique_ptr<Emulator>> envs;
+    std::vector<unsigned long> elapsed;
+    Config conf;
+    unsigned width, height;
+    std::vector<uint8> obs;
+    // what an environment looks like right after a reset
+    std::vector<uint8> start_ram, start_frame;
+    Util::ThreadPool pool;
+
+    VecEmulator(const Emulator &from, unsigned n, const Config &config);
+    void observe(unsigned i);
+    void restart(unsigned i);
+
+public:
+    // nullptr if from can't be cloned (no ROM in it, say)
+    static std::unique_ptr<VecEmulator> create(const Emulator &from, unsigned n, const Config &config);
+    static std::unique_ptr<VecEmulator> create(const Emulator &from, unsigned n) { return create(from, n, Config {}); }
+
+    VecEmulator(const VecEmulator &) = delete;
+    VecEmulator & operator=(const VecEmulator &) = delete;
+
+    // runs a frame on every environment, with actions[i] (a mask of Button)
+    // held down on the first controller of environment i.
+    void step(std::span<const uint8> actions);
+    // every environment back to the start.
+    void reset();
+
+    unsigned size() const                    { return envs.size(); }
+    unsigned frame_width() const             { return width; }
+    unsigned frame_height() const            { return height; }
+    std::span<const uint8> observations() const { return obs; }
+    std::span<const uint8> ram() const       { return { obs.data(), size() * std::size_t(RAM_SIZE) }; }
+    std::span<const uint8> frames() const    { return { ram().data() + ram().size(), size() * std::size_t(width * height) }; }
+    std::span<const uint8> dones() const     { return { frames().data() + frames().size(), size() }; }
+    Emulator &env(unsigned i)                { return *envs[i]; }
+};
+
+} // namespace Core
+
+#endif
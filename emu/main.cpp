@@ -1,32 +1,105 @@
+#include <chrono>
 #include <fmt/core.h>
 #include <SDL2/SDL.h>
 #include <emu/version.hpp>
 #include <emu/core/emulator.hpp>
 #include <emu/core/clidbg.hpp>
+#include <emu/core/romindex.hpp>
 #include <emu/util/cmdline.hpp>
 #include <emu/util/easyrandom.hpp>
 #include <emu/util/debug.hpp>
 #include <emu/util/file.hpp>
+#include <emu/util/stringops.hpp>
+#include <emu/util/threadpool.hpp>
 #include <emu/video/video.hpp>
+#include <emu/video/hud.hpp>
 
-static Core::Emulator emu;
 static Video::Context context;
 static Util::ArgResult flags;
 
-void mainloop()
+// keys for the first controller
+static const struct { SDL_Keycode key; Core::Button button; } KEYMAP[] = {
+    { SDLK_x,      Core::BUTTON_A      },
+    { SDLK_z,      Core::BUTTON_B      },
+    { SDLK_RSHIFT, Core::BUTTON_SELECT },
+    { SDLK_RETURN, Core::BUTTON_START  },
+    { SDLK_UP,     Core::BUTTON_UP     },
+    { SDLK_DOWN,   Core::BUTTON_DOWN   },
+    { SDLK_LEFT,   Core::BUTTON_LEFT   },
+    { SDLK_RIGHT,  Core::BUTTON_RIGHT  },
+};
+
+// rewind history, in MB, and how often it takes a snapshot, in frames
+static const std::size_t REWIND_MB = 64;
+static const unsigned REWIND_INTERVAL = 2;
+
+/* Collects the numbers shown by the HUD. A frame is counted as dropped when
+ * it took more than one and a half times as long as on a real NES. */
+struct PerfMeter {
+    using clock = std::chrono::steady_clock;
+    static constexpr double PERIOD = 0.5;
+    Video::Hud hud;
+    clock::time_point window_start = clock::now();
+    unsigned window_frames = 0;
+    unsigned long dropped = 0;
+
+    void frame(double secs, Core::Emulator &emu)
+    {
+        hud.frame_time(float(secs * 1000.0));
+        if (secs > 1.5 / Core::NTSC_FPS)
+            dropped++;
+        window_frames++;
+        const double elapsed = std::chrono::duration<double>(clock::now() - window_start).count();
+        if (elapsed < PERIOD)
+            return;
+        const auto prof = emu.profile();
+        const double fps = window_frames / elapsed;
+        hud.set_stats({
+            .fps       = fps,
+            .speed     = fps / Core::NTSC_FPS,
+            .cpu_share = prof.cpu + prof.ppu > 0.0 ? prof.cpu / (prof.cpu + prof.ppu) : 0.0,
+            .dropped   = dropped,
+            .chr_tiles = emu.tiles_rewritten(),
+        });
+        emu.reset_profile();
+        window_start = clock::now();
+        window_frames = 0;
+    }
+};
+
+void mainloop(Core::Emulator &emu)
 {
     Video::Canvas screen { context, Core::SCREEN_WIDTH, Core::SCREEN_HEIGHT };
+    PerfMeter perf;
     bool running = true;
+    if (flags.has['f']) {
+        auto mode = Video::parse_filter(flags.params['f']);
+        if (!mode || !screen.set_filter(mode->filter, mode->factor))
+            warning("{}: invalid filter, not using any\n", flags.params['f']);
+    }
     SDL_Event ev;
     Core::CliDebugger clidbg;
+    // backspace held down
+    bool rewinding = false;
+    uint8 buttons = 0;
 
-    Util::seed();
+    if (!flags.has['R'])
+        emu.random().seed_random();
     emu.set_screen(&screen);
     if (flags.has['d']) {
         emu.enable_debugger([&clidbg](Core::Debugger &db, Core::Debugger::Event &&ev) {
             clidbg.repl(db, std::move(ev));
         });
     }
+    std::size_t rewind_mb = REWIND_MB;
+    if (flags.has['r']) {
+        auto mb = Util::strconv<std::size_t>(std::string(flags.params['r']), 10);
+        if (mb)
+            rewind_mb = mb.value();
+        else
+            warning("{}: invalid rewind size, using {} MB\n", flags.params['r'], REWIND_MB);
+    }
+    emu.enable_rewind(rewind_mb * 1024 * 1024, REWIND_INTERVAL);
     emu.power();
     fmt::print(stderr, "{}\n", emu.rominfo());
     while (running) {
@@ -38,20 +111,153 @@ void mainloop()
             case SDL_WINDOWEVENT:
                 if (ev.window.event == SDL_WINDOWEVENT_RESIZED)
                     context.resize(ev.window.data1, ev.window.data2);
+                break;
+            case SDL_KEYDOWN:
+                // F1 toggles the performance HUD
+                if (ev.key.keysym.sym == SDLK_F1 && !ev.key.repeat) {
+                    const bool show = !screen.has_overlay();
+                    emu.enable_profiling(show);
+                    emu.reset_profile();
+                    if (show)
+                        screen.set_overlay([&perf](uint32_t *top, std::ptrdiff_t stride, std::size_t w, std::size_t h) {
+                            return perf.hud.draw(top, stride, w, h);
+                        });
+                    else
+                        screen.set_overlay(nullptr);
+                }
+                if (ev.key.keysym.sym == SDLK_BACKSPACE)
+                    rewinding = true;
+                for (auto k : KEYMAP)
+                    if (ev.key.keysym.sym == k.key)
+                        buttons |= k.button;
+                break;
+            case SDL_KEYUP:
+                if (ev.key.keysym.sym == SDLK_BACKSPACE)
+                    rewinding = false;
+                for (auto k : KEYMAP)
+                    if (ev.key.keysym.sym == k.key)
+                        buttons &= ~k.button;
+                break;
             }
         }
         if (emu.debugger_has_quit())
             running = false;
+        const auto start = PerfMeter::clock::now();
+        // going back one snapshot, then running a frame to show it, rewinds
+        // at REWIND_INTERVAL times the normal speed
+        if (rewinding)
+            emu.rewind(1);
+        emu.set_buttons(0, buttons);
         emu.run_frame();
         screen.update();
         context.draw();
+        perf.frame(std::chrono::duration<double>(PerfMeter::clock::now() - start).count(), emu);
+    }
+    const auto factor = screen.filter().factor;
+    const double full = screen.size() * factor * factor;
+    fmt::print(stderr, "average texture upload: {:.0f} bytes/frame ({:.1f}% of a full frame)\n",
+               screen.avg_upload(), screen.avg_upload() * 100.0 / full);
+    if (auto rs = emu.rewind_stats(); rs.snapshots != 0)
+        fmt::print(stderr, "rewind history: {} snapshots ({:.1f}s), {:.1f} of {:.1f} MB, compressed {:.1f}:1\n",
+                   rs.snapshots, rs.snapshots * emu.rewind_interval() / Core::NTSC_FPS,
+                   rs.memory / 1048576.0, rs.capacity / 1048576.0, rs.ratio);
+}
+
+/* Runs without any video output, hashing every frame. With --hash-log the
+ * hashes are written to a file, one line per frame; with --hash-check they're
+ * compared against a previous log and the run stops at the first frame that
+ * differs. */
+int run_headless(Core::Emulator &emu)
+{
+    Video::Canvas screen { Core::SCREEN_WIDTH, Core::SCREEN_HEIGHT };
+    const bool writing = flags.has['l'];
+    unsigned long maxframes = ~0UL;
+
+    if (flags.has['n']) {
+        auto n = Util::strconv<unsigned long>(std::string(flags.params['n']), 10);
+        if (!n) {
+            error("{}: invalid number of frames\n", flags.params['n']);
+            return 1;
+        }
+        maxframes = n.value();
+    } else if (writing) {
+        error("--hash-log needs --frames\n");
+        return 1;
+    }
+    auto logname = writing ? flags.params['l'] : flags.params['c'];
+    Util::BufferedFile log(logname, writing ? Util::BufferedFile::Mode::WRITE : Util::BufferedFile::Mode::READ);
+    if (!log) {
+        error("{}: {}\n", logname, log.error_str());
+        return 1;
     }
+
+    emu.set_screen(&screen);
+    emu.power();
+    for (unsigned long frame = 0; frame < maxframes; frame++) {
+        emu.run_frame();
+        auto hash = emu.frame_hash();
+        if (writing) {
+            log.print("{} {:016X} {:016X}\n", frame, hash.indexed, hash.rgba);
+            continue;
+        }
+        std::string line;
+        if (!log.getline(line) && line.empty()) {
+            fmt::print(stderr, "{} frames checked, no differences\n", frame);
+            return 0;
+        }
+        auto fields = Util::strsplit(line, ' ');
+        auto indexed = fields.size() == 3 ? Util::strconv<uint64>(fields[1], 16) : std::nullopt;
+        auto rgba    = fields.size() == 3 ? Util::strconv<uint64>(fields[2], 16) : std::nullopt;
+        if (!indexed || !rgba) {
+            error("{}: invalid line for frame {}\n", logname, frame);
+            return 1;
+        }
+        if (hash != Core::Emulator::FrameHash { indexed.value(), rgba.value() }) {
+            error("frame {} differs: expected {:016X} {:016X}, got {:016X} {:016X}\n",
+                  frame, indexed.value(), rgba.value(), hash.indexed, hash.rgba);
+            return 1;
+        }
+    }
+    if (writing && !log.close()) {
+        error("{}: {}\n", logname, log.error_str());
+        return 1;
+    }
+    if (!writing)
+        fmt::print(stderr, "{} frames checked, no differences\n", maxframes);
+    return 0;
+}
+
+/* Indexes every ROM under a directory. The index goes to the item given on
+ * the command line, or to yanesemu.idx inside the directory. */
+int scan_library()
+{
+    const std::string dir { flags.params['S'] };
+    const std::string index = flags.items.empty() ? dir + "/yanesemu.idx" : std::string(flags.items[0]);
+    Util::ThreadPool pool;
+    Core::ScanStats stats;
+    const auto start = std::chrono::steady_clock::now();
+    if (!Core::scan_roms(dir, index, pool, stats))
+        return 1;
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    fmt::print(stderr, "{}: {} files ({} scanned, {} unchanged, {} not valid ROMs) in {:.2f}s\n",
+               index, stats.files, stats.scanned, stats.reused, stats.invalid, elapsed.count());
+    return 0;
 }
 
 static const Util::ValidArgStruct cmdflags = {
-    { 'h',  "help",     "Print this help text and quit" },
-    { 'v',  "version",  "Shows the program's version"   },
-    { 'd',  "debugger", "Use command-line debugger"     },
+    { 'h',  "help",       "Print this help text and quit" },
+    { 'v',  "version",    "Shows the program's version"   },
+    { 'd',  "debugger",   "Use command-line debugger"     },
+    { 'f',  "filter",     "Scale the screen with a filter (nearest2x-4x, scale2x-4x, blend2x)", Util::ParamType::MUST_HAVE },
+    { 'l',  "hash-log",   "Run headless, writing the hash of every frame to a file",         Util::ParamType::MUST_HAVE },
+    { 'c',  "hash-check", "Run headless, checking frame hashes against a log",               Util::ParamType::MUST_HAVE },
+    { 'n',  "frames",     "Number of frames to run when headless",                           Util::ParamType::MUST_HAVE },
+    { 's',  "software",   "Render without OpenGL" },
+    { 'p',  "patch",      "Apply IPS, UPS or BPS patches (comma separated) to the ROM",   Util::ParamType::MUST_HAVE },
+    { 'a',  "run-ahead",  "Run this many frames ahead, to hide the game's input lag",   Util::ParamType::MUST_HAVE },
+    { 'r',  "rewind",     "Size of the rewind history (held down with Backspace), in MB; 0 turns it off", Util::ParamType::MUST_HAVE },
+    { 'R',  "random-ram", "Start with random RAM, from this seed; the same seed gives the same run", Util::ParamType::MUST_HAVE },
+    { 'S',  "scan",       "Index the ROMs in a directory, to the file given or DIR/yanesemu.idx", Util::ParamType::MUST_HAVE },
 };
 
 int main(int argc, char *argv[])
@@ -70,6 +276,8 @@ int main(int argc, char *argv[])
     flags = Util::parse(argc, argv, cmdflags);
     if (flags.has['h']) { Util::print_usage(progname, cmdflags); return 0; }
     if (flags.has['v']) { Util::print_version(progname, version); return 0; }
+    if (flags.has['S'])
+        return scan_library();
 
     // open rom file
     if (flags.items.size() == 0) {
@@ -77,24 +285,53 @@ int main(int argc, char *argv[])
         return 1;
     } else if (flags.items.size() > 1)
         warning("Multiple ROM files specified, only the first will be chosen\n");
-    Util::File romfile(flags.items[0], Util::File::Mode::READ);
+    // "-" reads the ROM from the standard input
+    Core::Emulator emu;
+    Util::File romfile;
+    if (flags.items[0] == "-")
+        romfile.assoc(stdin);
+    else
+        romfile.open(flags.items[0], Util::File::Mode::READ);
     if (!romfile) {
         error("{}: {}\n", flags.items[0], romfile.error_str());
         return 1;
     }
-    if (!emu.insert_rom(romfile)) {
+    // patches are a comma separated list, applied in order
+    const auto patches = flags.has['p'] ? Util::strsplit(std::string(flags.params['p'])) : std::vector<std::string> {};
+    if (!emu.insert_rom(romfile, patches)) {
         error("invalid ROM format\n");
         return 1;
     }
     romfile.close();
+    // on a single instance: a second one doesn't make the frame any shorter
+    if (flags.has['a']) {
+        auto frames = Util::strconv<unsigned>(std::string(flags.params['a']), 10);
+        if (!frames) {
+            error("{}: invalid number of frames\n", flags.params['a']);
+            return 1;
+        }
+        emu.set_run_ahead(frames.value(), false);
+    }
+    if (flags.has['R']) {
+        auto seed = Util::strconv<uint64>(std::string(flags.params['R']), 10);
+        if (!seed) {
+            error("{}: invalid seed\n", flags.params['R']);
+            return 1;
+        }
+        emu.seed(seed.value());
+        emu.randomize_ram(true);
+    }
+
+    if (flags.has['l'] || flags.has['c'])
+        return run_headless(emu);
 
     // initialize video subsystem
-    if (!context.init(Video::Context::Type::OPENGL)) {
+    if (!context.init(flags.has['s'] ? Video::Context::Type::SOFTWARE : Video::Context::Type::OPENGL)) {
         error("can't initialize video\n");
         return 1;
     }
 
-    mainloop();
+    mainloop(emu);
 
     return 0;
 }
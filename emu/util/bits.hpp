@@ -51,6 +51,11 @@ constexpr inline uint32_t rotr32(const uint32_t x, const int k)
     return (x >> k) | (x << (32 - k));
 }
 
+constexpr inline uint64_t rotl64(const uint64_t x, const int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
 /* A struct for portable bit-fields. Use it like so:
  * union {
  *     uint16_t full
@@ -34,15 +34,15 @@ ArgResult parse(int argc, char *argv[], const ValidArgStruct &valid_args)
     while (++argv, --argc > 0) {
         std::string_view currarg = argv[0];
         const char *nextarg = argv[1];
-        // is currarg a real arg?
-        if (currarg[0] != '-') {
+        // is currarg a real arg? (a lone "-" usually stands for stdin)
+        if (currarg[0] != '-' || currarg.size() == 1) {
             res.items.push_back(currarg);
             continue;
         }
         // is currarg a valid argument according to valid_args?
         auto argp = currarg[1] != '-' && currarg.size() == 2 ?
                         is_valid(currarg[1], valid_args)     :
-                        is_valid(*(currarg.begin() + 2), valid_args);
+                        is_valid(currarg.substr(2), valid_args);
         if (argp == valid_args.end()) {
             warning("%s: not a valid argument\n", currarg.data());
             continue;
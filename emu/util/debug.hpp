@@ -5,6 +5,10 @@
 #ifndef UTIL_DEBUG_HPP_INCLUDED
 #define UTIL_DEBUG_HPP_INCLUDED
 
+#include <functional>
+#include <string>
+#include <string_view>
+#include <utility>
 #include <fmt/core.h>
 
 template <typename... T>
@@ -29,6 +33,46 @@ inline void panic(std::string &&fmt, T... args)
     std::exit(1);
 }
 
+namespace Util {
+
+/* Same as error() and warning(), but the messages can be sent somewhere
+ * else than stderr: each emulator has its own, so that many of them can run
+ * in the same process without mixing their messages. */
+class Log {
+public:
+    enum class Level { WARNING, ERROR };
+    using Sink = std::function<void(Level, std::string_view)>;
+
+private:
+    Sink sink;
+
+public:
+    void set_sink(Sink s) { sink = std::move(s); }
+    const Sink &get_sink() const { return sink; }
+
+    void write(Level level, std::string_view msg) const
+    {
+        if (sink)
+            sink(level, msg);
+        else
+            fmt::print(stderr, "{}: {}", level == Level::ERROR ? "error" : "warning", msg);
+    }
+
+    template <typename... T>
+    void error(std::string_view fmt, T... args) const
+    {
+        write(Level::ERROR, fmt::vformat(fmt, fmt::make_format_args(args...)));
+    }
+
+    template <typename... T>
+    void warning(std::string_view fmt, T... args) const
+    {
+        write(Level::WARNING, fmt::vformat(fmt, fmt::make_format_args(args...)));
+    }
+};
+
+} // namespace Util
+
 #ifdef DEBUG
 template <typename... T>
 inline void dbgprint(const char *file, int line, std::string &&fmt, T... args)
@@ -1,26 +1,41 @@
 #include "easyrandom.hpp"
 
 #include <random>
-#include <mutex>
 
 namespace Util {
 
-using GenType = std::mt19937;
-GenType generator;
-std::uniform_int_distribution<uint8_t> dist8;
-std::mutex rnd_mutex;
+void Random::seed(uint64_t seed_value)
+{
+    // SplitMix64, so that close seeds (0, 1, 2...) give unrelated states
+    for (auto &word : s) {
+        uint64_t z = (seed_value += 0x9E3779B97F4A7C15);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+        word = z ^ (z >> 31);
+    }
+}
 
-void seed()
+void Random::seed_random()
 {
     std::random_device rd;
-    generator.seed(rd());
+    seed(uint64_t(rd()) << 32 | rd());
 }
 
-uint8_t random8()
+void Random::fill(std::span<uint8_t> out)
 {
-    std::lock_guard<std::mutex> lock(rnd_mutex);
-    return dist8(generator);
+    // byte by byte, so it's the same on big endian machines. compilers turn
+    // the inner loop into a single store.
+    std::size_t i = 0;
+    for ( ; i + 8 <= out.size(); i += 8) {
+        const uint64_t x = next();
+        for (unsigned b = 0; b < 8; b++)
+            out[i + b] = uint8_t(x >> (b * 8));
+    }
+    if (i < out.size()) {
+        const uint64_t x = next();
+        for (unsigned b = 0; i < out.size(); i++, b++)
+            out[i] = uint8_t(x >> (b * 8));
+    }
 }
 
 } // namespace Util
-
@@ -1,16 +1,52 @@
 #ifndef UTIL_EASYRANDOM_HPP_INCLUDED
 #define UTIL_EASYRANDOM_HPP_INCLUDED
 
-/* Basically a wrapper API around <random>.
- * It's thread-safe, or at least it's supposed to be.
- * Call seed() in main().  */
+/* Random numbers from xoshiro256**, seeded with SplitMix64. It's much smaller
+ * and faster than anything in <random>, and gives the same numbers everywhere.
+ * Each emulator has its own generator, so there's nothing to share between
+ * threads: a generator must only be used by one thread at a time. The same
+ * seed gives the same numbers. */
 
 #include <cstdint>
+#include <span>
 
 namespace Util {
 
-void seed();
-uint8_t random8();
+class Random {
+    uint64_t s[4];
+
+    static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+public:
+    explicit Random(uint64_t seed_value = 0) { seed(seed_value); }
+
+    void seed(uint64_t seed_value);
+    // from std::random_device, for numbers that differ on every run.
+    void seed_random();
+
+    uint64_t next()
+    {
+        const uint64_t result = rotl(s[1] * 5, 7) * 9;
+        const uint64_t t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotl(s[3], 45);
+        return result;
+    }
+
+    // the high bits are the better ones
+    uint8_t random8()          { return uint8_t(next() >> 56); }
+    // in [lo, hi]
+    int random_between(int lo, int hi)
+    {
+        return lo + int(((next() >> 32) * (uint64_t(hi - lo) + 1)) >> 32);
+    }
+    // fills out with random bytes, 8 at a time.
+    void fill(std::span<uint8_t> out);
+};
 
 } // namespace Util
 
@@ -1,7 +1,19 @@
 #include <emu/util/file.hpp>
 
+#include <algorithm>
+#include <bit>
+#include <cstdlib>
 #include <cstring>
 #include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#else
+#include <io.h>
+#endif
 
 namespace Util {
 
@@ -82,5 +94,571 @@ std::string File::getall()
     return str;
 }
 
-} // namespace Util
+void FileView::unmap()
+{
+#ifndef _WIN32
+    if (map_base)
+        munmap(map_base, map_len);
+    if (map_fd >= 0)
+        ::close(map_fd);
+#endif
+    map_base = nullptr;
+    map_fd = -1;
+}
+
+FileView::Identity FileView::identity() const
+{
+    Identity id;
+#ifndef _WIN32
+    struct stat st;
+    if (map_fd >= 0 && fstat(map_fd, &st) == 0) {
+        id.dev   = st.st_dev;
+        id.ino   = st.st_ino;
+        id.size  = st.st_size;
+        id.mtime = std::uint64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    }
+#endif
+    return id;
+}
 
+/* The copy is an anonymous mapping big enough for all of it, with the file
+ * mapped privately over its start: pages past the end of the file are
+ * plain zeroes, the rest are shared with the page cache until written. */
+FileView FileView::copy_on_write(std::size_t size) const
+{
+    FileView v;
+    v.writable = true;
+#ifndef _WIN32
+    if (map_fd >= 0 || (!ptr && size > 0)) {
+        static const std::size_t page = sysconf(_SC_PAGESIZE);
+        const std::size_t off   = ptr - static_cast<const unsigned char *>(map_base);
+        const std::size_t total = (off + size + page - 1) / page * page;
+        const std::size_t from_file = std::min(total, (map_len + page - 1) / page * page);
+        void *p = total == 0 ? MAP_FAILED
+                : mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p != MAP_FAILED && map_fd >= 0
+         && mmap(p, from_file, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, map_fd, 0) == MAP_FAILED) {
+            munmap(p, total);
+            p = MAP_FAILED;
+        }
+        if (p != MAP_FAILED) {
+            v.map_base = p;
+            v.map_len  = total;
+            v.ptr      = static_cast<unsigned char *>(p) + off;
+            v.len      = size;
+            return v;
+        }
+    }
+#endif
+    v.copy.assign(ptr, ptr + std::min(len, size));
+    v.copy.resize(size, 0);
+    v.ptr = v.copy.data();
+    v.len = v.copy.size();
+    return v;
+}
+
+/* memfd where there is one, or else an unlinked temporary file; either way
+ * it's gone once the last mapping of it is. Without mmap it's a plain copy. */
+FileView FileView::snapshot(std::span<const unsigned char> data)
+{
+    FileView v;
+#ifndef _WIN32
+#  ifdef MFD_CLOEXEC
+    int fd = memfd_create("snapshot", MFD_CLOEXEC);
+#  else
+    int fd = -1;
+    if (std::FILE *f = std::tmpfile()) {
+        fd = dup(fileno(f));
+        std::fclose(f);
+    }
+#  endif
+    void *p = MAP_FAILED;
+    if (fd >= 0 && !data.empty() && ::pwrite(fd, data.data(), data.size(), 0) == long(data.size()))
+        p = mmap(nullptr, data.size(), PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p != MAP_FAILED) {
+        v.map_base = p;
+        v.map_len  = data.size();
+        v.map_fd   = fd;
+        v.ptr      = static_cast<unsigned char *>(p);
+        v.len      = data.size();
+        return v;
+    }
+    if (fd >= 0)
+        ::close(fd);
+#endif
+    v.copy.assign(data.begin(), data.end());
+    v.ptr = v.copy.data();
+    v.len = v.copy.size();
+    return v;
+}
+
+/* The whole file gets mapped (offsets passed to mmap must be page aligned)
+ * and the view starts at the current position. The file position is moved
+ * to the end either way, as if everything had been read. */
+FileView File::view()
+{
+    FileView v;
+    if (!filbuf)
+        return v;
+#ifndef _WIN32
+    struct stat st;
+    const long pos = std::ftell(filbuf);
+    if (pos >= 0 && fstat(fd(), &st) == 0 && S_ISREG(st.st_mode) && st.st_size > pos) {
+        void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd(), 0);
+        if (p != MAP_FAILED) {
+            v.map_base = p;
+            v.map_len  = st.st_size;
+            v.map_fd   = dup(fd());
+            v.ptr      = static_cast<unsigned char *>(p) + pos;
+            v.len      = st.st_size - pos;
+            std::fseek(filbuf, 0, SEEK_END);
+            return v;
+        }
+    }
+#endif
+    // pipes and such: read straight into the vector, doubling it as needed
+    std::size_t n = 0;
+    v.copy.resize(64 * 1024);
+    while (std::size_t r = bread(v.copy.data() + n, v.copy.size() - n)) {
+        n += r;
+        if (n == v.copy.size())
+            v.copy.resize(n * 2);
+    }
+    v.copy.resize(n);
+    v.ptr = v.copy.data();
+    v.len = v.copy.size();
+    return v;
+}
+
+void MappedMemory::assign(std::span<const unsigned char> src)
+{
+    const std::size_t n = std::min(src.size(), len);
+    for (std::size_t off = 0; off < n; off += PAGE) {
+        const std::size_t k = std::min(PAGE, n - off);
+        if (std::memcmp(ptr + off, src.data() + off, k) == 0)
+            continue;
+        std::memcpy(ptr + off, src.data() + off, k);
+        dirty[off / PAGE / 64] |= std::uint64_t(1) << (off / PAGE % 64);
+        any_dirty = true;
+    }
+}
+
+bool MappedMemory::allocate(std::size_t size)
+{
+    release();
+#ifndef _WIN32
+    void *p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        errstr = get_errstr();
+        return false;
+    }
+    ptr = static_cast<unsigned char *>(p);
+#else
+    buf.assign(size, 0);
+    ptr = buf.data();
+#endif
+    len = size;
+    dirty.assign((size + PAGE*64 - 1) / (PAGE*64), 0);
+    return true;
+}
+
+bool MappedMemory::open(std::string_view pathname, std::size_t size)
+{
+    release();
+    const std::string name { pathname };
+#ifndef _WIN32
+    int fd = ::open(name.c_str(), O_RDWR | O_CREAT, 0644);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        errstr = get_errstr();
+        if (fd >= 0)
+            ::close(fd);
+        return false;
+    }
+    const std::size_t total = std::max<std::size_t>(st.st_size, size);
+    void *p = MAP_FAILED;
+    if (std::size_t(st.st_size) >= total || ftruncate(fd, total) == 0)
+        p = mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED)
+        errstr = get_errstr();
+    // the mapping keeps the file open
+    ::close(fd);
+    if (p == MAP_FAILED)
+        return false;
+    ptr = static_cast<unsigned char *>(p);
+    len = total;
+#else
+    buf.assign(size, 0);
+    if (FILE *f = std::fopen(name.c_str(), "rb")) {
+        unsigned char tmp[4096];
+        buf.clear();
+        for (std::size_t n; (n = std::fread(tmp, 1, sizeof(tmp), f)) > 0; )
+            buf.insert(buf.end(), tmp, tmp + n);
+        std::fclose(f);
+        if (buf.size() < size)
+            buf.resize(size, 0);
+    }
+    path = name;
+    ptr = buf.data();
+    len = buf.size();
+#endif
+    backed = true;
+    dirty.assign((len + PAGE*64 - 1) / (PAGE*64), 0);
+    return true;
+}
+
+void MappedMemory::sync(bool wait)
+{
+    if (!backed || !any_dirty)
+        return;
+#ifndef _WIN32
+    // msync wants addresses aligned to the system's pages, which may be
+    // bigger than ours.
+    static const std::size_t sys_page = sysconf(_SC_PAGESIZE);
+    for (std::size_t w = 0; w < dirty.size(); w++) {
+        for (std::uint64_t bits = dirty[w]; bits != 0; bits &= bits - 1) {
+            const std::size_t off   = (w * 64 + std::countr_zero(bits)) * PAGE;
+            const std::size_t start = off / sys_page * sys_page;
+            msync(ptr + start, std::min(off + PAGE, len) - start, wait ? MS_SYNC : MS_ASYNC);
+        }
+    }
+#else
+    if (FILE *f = std::fopen(path.c_str(), "wb")) {
+        std::fwrite(ptr, 1, len, f);
+        std::fclose(f);
+    }
+#endif
+    std::fill(dirty.begin(), dirty.end(), 0);
+    any_dirty = false;
+}
+
+void MappedMemory::release()
+{
+    if (!ptr)
+        return;
+    sync(true);
+#ifndef _WIN32
+    munmap(ptr, len);
+#endif
+    ptr = nullptr;
+    len = 0;
+    backed = any_dirty = false;
+    dirty.clear();
+}
+
+#ifndef _WIN32
+static long sys_readv(int fd, iovec *v, int n)  { return ::readv(fd, v, n); }
+static long sys_writev(int fd, iovec *v, int n) { return ::writev(fd, v, n); }
+#else
+struct iovec {
+    void *iov_base;
+    std::size_t iov_len;
+};
+
+static long sys_readv(int fd, iovec *v, int n)
+{
+    long total = 0;
+    for (int i = 0; i < n; i++) {
+        int r = _read(fd, v[i].iov_base, v[i].iov_len);
+        if (r < 0)
+            return total ? total : -1;
+        total += r;
+        if (std::size_t(r) < v[i].iov_len)
+            break;
+    }
+    return total;
+}
+
+static long sys_writev(int fd, iovec *v, int n)
+{
+    long total = 0;
+    for (int i = 0; i < n; i++) {
+        int r = _write(fd, v[i].iov_base, v[i].iov_len);
+        if (r < 0)
+            return total ? total : -1;
+        total += r;
+    }
+    return total;
+}
+#endif
+
+// writes everything, going on after partial writes. v gets modified.
+static bool writev_all(int fd, iovec *v, int n)
+{
+    while (n > 0) {
+        long r = sys_writev(fd, v, std::min(n, 64));
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r < 0)
+            return false;
+        for (std::size_t left = r; n > 0 && left >= v->iov_len; n--, v++)
+            left -= v->iov_len, r = left;
+        if (n > 0) {
+            v->iov_base = static_cast<unsigned char *>(v->iov_base) + r;
+            v->iov_len -= r;
+        }
+    }
+    return true;
+}
+
+void BufferedFile::set_error()
+{
+    failed = true;
+    errstr = get_errstr();
+}
+
+bool BufferedFile::open(std::string_view pathname, Mode filemode, unsigned fileflags, std::size_t bufsize)
+{
+    close();
+    const std::string name { pathname };
+    int oflags = filemode == Mode::READ   ? O_RDONLY
+               : filemode == Mode::APPEND ? O_WRONLY | O_CREAT | O_APPEND
+               :                            O_WRONLY | O_CREAT | O_TRUNC;
+#ifdef _WIN32
+    oflags |= O_BINARY;
+#endif
+    direct = false;
+#ifdef O_DIRECT
+    if ((fileflags & DIRECT) && filemode != Mode::APPEND) {
+        fd = ::open(name.c_str(), oflags | O_DIRECT, 0644);
+        direct = fd >= 0;
+    }
+#endif
+    if (fd < 0)
+        fd = ::open(name.c_str(), oflags, 0644);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        set_error();
+        close();
+        return false;
+    }
+    mode     = filemode;
+    flags    = fileflags;
+    filesize = st.st_size;
+    offset   = filemode == Mode::APPEND ? filesize : 0;
+    cap      = std::max((bufsize + ALIGN - 1) / ALIGN * ALIGN, ALIGN);
+    buf      = static_cast<unsigned char *>(std::aligned_alloc(ALIGN, cap));
+    head = tail = 0;
+    failed = false;
+    filname = name;
+#ifdef POSIX_FADV_SEQUENTIAL
+    if (filemode == Mode::READ)
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    return true;
+}
+
+bool BufferedFile::close()
+{
+    if (fd < 0)
+        return !failed;
+    if (mode != Mode::READ) {
+        flush();
+        drain();
+    }
+    ::close(fd);
+    std::free(buf);
+    fd = -1;
+    buf = nullptr;
+    cap = head = tail = 0;
+    filesize = offset = 0;
+    filname.erase();
+    return !failed;
+}
+
+bool BufferedFile::refill()
+{
+    head = tail = 0;
+    long r;
+    do
+        r = ::read(fd, buf, cap);
+    while (r < 0 && errno == EINTR);
+    if (r < 0)
+        set_error();
+    if (r <= 0)
+        return false;
+    tail = r;
+    offset += r;
+    return true;
+}
+
+std::size_t BufferedFile::read(void *dst, std::size_t n)
+{
+    std::span<unsigned char> one { static_cast<unsigned char *>(dst), n };
+    return readv({ &one, 1 });
+}
+
+/* What's buffered is handed out first; the rest is read in one readv(),
+ * together with the next buffer-full of data. */
+std::size_t BufferedFile::readv(std::span<const std::span<unsigned char>> bufs)
+{
+    if (fd < 0 || mode != Mode::READ)
+        return 0;
+    std::size_t total = 0;
+    std::vector<iovec> iov;
+    for (auto b : bufs) {
+        const std::size_t k = std::min(b.size(), tail - head);
+        if (k == 0 && b.size() == 0)
+            continue;
+        std::memcpy(b.data(), buf + head, k);
+        head += k;
+        total += k;
+        if (k < b.size())
+            iov.push_back({ b.data() + k, b.size() - k });
+    }
+    if (iov.empty())
+        return total;
+    if (direct) {
+        // O_DIRECT only takes aligned transfers, so go through the buffer
+        for (auto &v : iov) {
+            for (std::size_t done = 0; done < v.iov_len; ) {
+                if (head == tail && !refill())
+                    return total;
+                const std::size_t k = std::min(v.iov_len - done, tail - head);
+                std::memcpy(static_cast<unsigned char *>(v.iov_base) + done, buf + head, k);
+                head += k;
+                done += k;
+                total += k;
+            }
+        }
+        return total;
+    }
+    head = tail = 0;
+    iov.push_back({ buf, cap });
+    const std::size_t nuser = iov.size() - 1;
+    for (std::size_t i = 0; i < nuser; ) {
+        long r = sys_readv(fd, iov.data() + i, std::min<std::size_t>(iov.size() - i, 64));
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r < 0)
+            set_error();
+        if (r <= 0)
+            break;
+        offset += r;
+        for (std::size_t left = r; left > 0; ) {
+            if (i == nuser) {
+                // ran into the buffer: the user's part is done
+                tail = left;
+                break;
+            }
+            const std::size_t k = std::min(left, iov[i].iov_len);
+            iov[i].iov_base = static_cast<unsigned char *>(iov[i].iov_base) + k;
+            iov[i].iov_len -= k;
+            total += k;
+            left  -= k;
+            if (iov[i].iov_len == 0)
+                i++;
+        }
+    }
+    return total;
+}
+
+bool BufferedFile::getline(std::string &str)
+{
+    str.erase();
+    for (;;) {
+        if (head == tail && (mode != Mode::READ || !refill()))
+            return !str.empty();
+        const char *start = reinterpret_cast<const char *>(buf + head);
+        const char *nl = static_cast<const char *>(std::memchr(start, '\n', tail - head));
+        if (nl) {
+            str.append(start, nl);
+            head += nl - start + 1;
+            return true;
+        }
+        str.append(start, tail - head);
+        head = tail;
+    }
+}
+
+// n more bytes went out at offset.
+void BufferedFile::written(std::size_t n)
+{
+#ifdef POSIX_FADV_DONTNEED
+    if (flags & NOCACHE) {
+#ifdef SYNC_FILE_RANGE_WRITE
+        // start writeback now, so that the pages can actually be dropped
+        sync_file_range(fd, offset, n, SYNC_FILE_RANGE_WRITE);
+#endif
+        posix_fadvise(fd, 0, offset, POSIX_FADV_DONTNEED);
+    }
+#endif
+    offset += n;
+}
+
+// writes the first n bytes of the buffer.
+bool BufferedFile::write_out(std::size_t n)
+{
+    if (n == 0)
+        return true;
+    iovec v { buf, n };
+    if (!writev_all(fd, &v, 1)) {
+        set_error();
+        return false;
+    }
+    written(n);
+    std::memmove(buf, buf + n, tail - n);
+    tail -= n;
+    return true;
+}
+
+bool BufferedFile::write(const void *src, std::size_t n)
+{
+    std::span<const unsigned char> one { static_cast<const unsigned char *>(src), n };
+    return writev({ &one, 1 });
+}
+
+bool BufferedFile::writev(std::span<const std::span<const unsigned char>> bufs)
+{
+    if (fd < 0 || mode == Mode::READ)
+        return false;
+    std::size_t n = 0;
+    for (auto b : bufs)
+        n += b.size();
+    if (tail + n <= cap || direct) {
+        for (auto b : bufs) {
+            for (std::size_t done = 0; done < b.size(); ) {
+                const std::size_t k = std::min(b.size() - done, cap - tail);
+                std::memcpy(buf + tail, b.data() + done, k);
+                tail += k;
+                done += k;
+                if (tail == cap && !write_out(cap))
+                    return false;
+            }
+        }
+    } else {
+        std::vector<iovec> iov;
+        iov.push_back({ buf, tail });
+        for (auto b : bufs)
+            iov.push_back({ const_cast<unsigned char *>(b.data()), b.size() });
+        if (!writev_all(fd, iov.data(), iov.size())) {
+            set_error();
+            return false;
+        }
+        written(tail + n);
+        tail = 0;
+    }
+    filesize = std::max(filesize, offset + tail);
+    return true;
+}
+
+/* With O_DIRECT only whole blocks can go out, the rest waits for close(). */
+bool BufferedFile::flush()
+{
+    if (fd < 0 || mode == Mode::READ)
+        return !failed;
+    return write_out(direct ? tail / ALIGN * ALIGN : tail);
+}
+
+bool BufferedFile::drain()
+{
+#ifdef O_DIRECT
+    if (direct && tail > 0) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT);
+        direct = false;
+    }
+#endif
+    return write_out(tail);
+}
+
+} // namespace Util
@@ -1,13 +1,158 @@
 #ifndef UTIL_FILE_HPP_INCLUDED
 #define UTIL_FILE_HPP_INCLUDED
 
+#include <compare>
+#include <cstdint>
 #include <cstdio>
+#include <iterator>
+#include <span>
 #include <string>
 #include <string_view>
+#include <vector>
 #include <fmt/core.h>
 
 namespace Util {
 
+/* A read-only view of the contents of a file, made by File::view(). Regular
+ * files are memory mapped, so that views of the same file (even across
+ * processes) share the same physical pages. Anything that can't be mapped
+ * (stdin, pipes) is read into memory instead. The view stays valid after the
+ * File is closed.
+ * copy_on_write() makes a private, writable copy: for a mapped file that's
+ * another mapping of it, so only the pages that get written to take memory. */
+class FileView {
+    unsigned char *ptr = nullptr;
+    std::size_t len = 0;
+    void *map_base = nullptr;
+    std::size_t map_len = 0;
+    int map_fd = -1;
+    bool writable = false;
+    std::vector<unsigned char> copy;
+
+    void unmap();
+public:
+    FileView() = default;
+    ~FileView() { unmap(); }
+
+    FileView(const FileView &) = delete;
+    FileView & operator=(const FileView &) = delete;
+
+    FileView(FileView &&v) { operator=(std::move(v)); }
+    FileView & operator=(FileView &&v)
+    {
+        std::swap(ptr, v.ptr);
+        std::swap(len, v.len);
+        std::swap(map_base, v.map_base);
+        std::swap(map_len, v.map_len);
+        std::swap(map_fd, v.map_fd);
+        std::swap(writable, v.writable);
+        std::swap(copy, v.copy);
+        return *this;
+    }
+
+    const unsigned char *data() const { return ptr; }
+    std::size_t size() const          { return len; }
+    bool empty() const                { return len == 0; }
+    bool mapped() const               { return map_base != nullptr; }
+    std::span<const unsigned char> span() const { return { ptr, len }; }
+    // an empty span if out of bounds.
+    std::span<const unsigned char> subspan(std::size_t offset, std::size_t count) const
+    {
+        return offset + count <= len ? std::span<const unsigned char> { ptr + offset, count }
+                                     : std::span<const unsigned char> {};
+    }
+
+    // a copy cut or zero extended to size bytes. empty if it can't be made.
+    FileView copy_on_write(std::size_t size) const;
+    // a writable view of size zero bytes, not backed by any file.
+    static FileView anonymous(std::size_t size) { return FileView().copy_on_write(size); }
+    // a read-only copy of data in a file of its own, in memory, so that
+    // copy_on_write() of it shares pages just like for a real file.
+    static FileView snapshot(std::span<const unsigned char> data);
+    // nullptr unless the view came from copy_on_write().
+    unsigned char *writable_data() { return writable ? ptr : nullptr; }
+
+    // tells if two views are of the same, unchanged file. all zero if the
+    // view isn't mapped.
+    struct Identity {
+        std::uint64_t dev = 0, ino = 0, size = 0, mtime = 0;
+        auto operator<=>(const Identity &) const = default;
+    };
+    Identity identity() const;
+
+    friend class File;
+};
+
+/* Writable memory, optionally backed by a file. With open() the file is
+ * mapped shared, so writes land in the page cache and the kernel writes them
+ * back on its own; allocate() gives plain anonymous memory. write() marks the
+ * page it touches as dirty and sync() flushes only dirty pages, which makes
+ * calling it often (say, once per frame) cheap. Everything is flushed when
+ * the memory is released. */
+class MappedMemory {
+    unsigned char *ptr = nullptr;
+    std::size_t len = 0;
+    bool backed = false;
+    bool any_dirty = false;
+    std::vector<std::uint64_t> dirty;
+    std::string errstr;
+#ifdef _WIN32
+    // no mmap here: the file is read at open and written back by sync().
+    std::vector<unsigned char> buf;
+    std::string path;
+#endif
+
+    void release();
+public:
+    static constexpr std::size_t PAGE = 4096;
+
+    MappedMemory() = default;
+    ~MappedMemory() { release(); }
+
+    MappedMemory(const MappedMemory &) = delete;
+    MappedMemory & operator=(const MappedMemory &) = delete;
+
+    MappedMemory(MappedMemory &&m) { operator=(std::move(m)); }
+    MappedMemory & operator=(MappedMemory &&m)
+    {
+        std::swap(ptr, m.ptr);
+        std::swap(len, m.len);
+        std::swap(backed, m.backed);
+        std::swap(any_dirty, m.any_dirty);
+        std::swap(dirty, m.dirty);
+        std::swap(errstr, m.errstr);
+#ifdef _WIN32
+        std::swap(buf, m.buf);
+        std::swap(path, m.path);
+#endif
+        return *this;
+    }
+
+    // the file is created or grown to size bytes if needed, never shrunk.
+    bool open(std::string_view pathname, std::size_t size);
+    bool allocate(std::size_t size);
+
+    unsigned char read(std::size_t off) const { return ptr[off]; }
+    void write(std::size_t off, unsigned char data)
+    {
+        ptr[off] = data;
+        dirty[off / PAGE / 64] |= std::uint64_t(1) << (off / PAGE % 64);
+        any_dirty = true;
+    }
+    // copies src over the start of the memory; only pages that actually
+    // change become dirty.
+    void assign(std::span<const unsigned char> src);
+    // with wait, returns only when the data is on disk.
+    void sync(bool wait = false);
+    // whether the page holding off was written since the last sync()
+    bool dirty_at(std::size_t off) const { return dirty[off / PAGE / 64] >> (off / PAGE % 64) & 1; }
+
+    unsigned char *data()       { return ptr; }
+    std::size_t size() const    { return len; }
+    bool file_backed() const    { return backed; }
+    std::string error_str()     { return errstr; }
+};
+
 class File {
     FILE *filbuf = nullptr;
     std::string filname = "";
@@ -88,9 +233,11 @@ public:
     bool getword(std::string &str);
     bool getline(std::string &str, int delim = '\n');
     std::string getall();
+    // everything from the current position to the end of the file.
+    FileView view();
 
     // write functions
-    std::size_t bwrite(void *buf, std::size_t nb) { return std::fwrite(buf, 1, nb, filbuf); }
+    std::size_t bwrite(const void *buf, std::size_t nb) { return std::fwrite(buf, 1, nb, filbuf); }
     int putc(char c)                              { return std::fputc(c, filbuf); }
 
     template <typename T> void print(const T &&obj)
@@ -104,6 +251,110 @@ public:
     }
 };
 
+/* Binary I/O for streaming data in and out (traces, logs, indexes), going
+ * around stdio. Data goes through one big buffer, aligned to ALIGN, and on
+ * to the kernel in few system calls: a write that doesn't fit is sent along
+ * with what's buffered in a single writev(), and a big read goes straight
+ * to the caller's memory, refilling the buffer in the same readv().
+ * The file size is read once at open and kept up to date by writes.
+ * Flags:
+ *  - DIRECT opens with O_DIRECT where available, skipping the page cache.
+ *    Transfers are then done in whole ALIGN blocks; the last partial block
+ *    is written normally at close. Ignored for APPEND.
+ *  - NOCACHE tells the kernel to drop written data from the page cache
+ *    once it's on its way, so that big traces don't push out everything
+ *    else.
+ * Files opened for reading are hinted as sequential. */
+class BufferedFile {
+public:
+    enum class Mode { READ, WRITE, APPEND };
+    enum Flags : unsigned {
+        DIRECT  = 1 << 0,
+        NOCACHE = 1 << 1,
+    };
+    static constexpr std::size_t ALIGN = 4096;
+    static constexpr std::size_t DEFAULT_BUFFER = 256 * 1024;
+
+private:
+    int fd = -1;
+    Mode mode = Mode::READ;
+    unsigned flags = 0;
+    bool direct = false;
+    bool failed = false;
+    unsigned char *buf = nullptr;
+    std::size_t cap = 0;
+    // for reading, [head, tail) of buf is yet to be read; for writing,
+    // [0, tail) is yet to be written.
+    std::size_t head = 0, tail = 0;
+    std::uint64_t filesize = 0;
+    // where the file descriptor is
+    std::uint64_t offset = 0;
+    std::string filname, errstr, line;
+
+    bool refill();
+    void written(std::size_t n);
+    bool write_out(std::size_t n);
+    bool drain();
+    void set_error();
+public:
+    BufferedFile() = default;
+    BufferedFile(std::string_view pathname, Mode filemode, unsigned fileflags = 0, std::size_t bufsize = DEFAULT_BUFFER)
+    {
+        open(pathname, filemode, fileflags, bufsize);
+    }
+    ~BufferedFile() { close(); }
+
+    BufferedFile(const BufferedFile &) = delete;
+    BufferedFile & operator=(const BufferedFile &) = delete;
+
+    BufferedFile(BufferedFile &&f) { operator=(std::move(f)); }
+    BufferedFile & operator=(BufferedFile &&f)
+    {
+        std::swap(fd, f.fd);
+        std::swap(mode, f.mode);
+        std::swap(flags, f.flags);
+        std::swap(direct, f.direct);
+        std::swap(failed, f.failed);
+        std::swap(buf, f.buf);
+        std::swap(cap, f.cap);
+        std::swap(head, f.head);
+        std::swap(tail, f.tail);
+        std::swap(filesize, f.filesize);
+        std::swap(offset, f.offset);
+        std::swap(filname, f.filname);
+        std::swap(errstr, f.errstr);
+        return *this;
+    }
+
+    bool open(std::string_view pathname, Mode filemode, unsigned fileflags = 0, std::size_t bufsize = DEFAULT_BUFFER);
+    // false if anything failed to be written.
+    bool close();
+
+    explicit operator bool() const { return fd >= 0; }
+    std::uint64_t size() const     { return filesize; }
+    std::uint64_t tell() const     { return mode == Mode::READ ? offset - (tail - head) : offset + tail; }
+    bool error() const             { return failed; }
+    std::string error_str() const  { return errstr; }
+    std::string filename() const   { return filname; }
+
+    // these return how much was read, less than asked only at the end of the file.
+    std::size_t read(void *dst, std::size_t n);
+    std::size_t readv(std::span<const std::span<unsigned char>> bufs);
+    // without the newline. false at the end of the file.
+    bool getline(std::string &str);
+
+    bool write(const void *src, std::size_t n);
+    bool writev(std::span<const std::span<const unsigned char>> bufs);
+    bool flush();
+
+    template <typename... T> void print(std::string &&fmt, T... args)
+    {
+        line.clear();
+        fmt::format_to(std::back_inserter(line), fmt, args...);
+        write(line.data(), line.size());
+    }
+};
+
 } // namespace Util
 
 #endif
@@ -0,0 +1,117 @@
+#include <emu/util/hash.hpp>
+
+#include <array>
+#include <cstring>
+#include <emu/util/bits.hpp>
+
+namespace Util {
+
+static const uint64 PRIME64_1 = 0x9E3779B185EBCA87ULL;
+static const uint64 PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64 PRIME64_3 = 0x165667B19E3779F9ULL;
+static const uint64 PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+static const uint64 PRIME64_5 = 0x27D4EB2F165667C5ULL;
+
+// this code is affected by endianness; XXH64 is defined on little endian reads.
+static inline uint64 read64(const uint8 *p) { uint64 v; std::memcpy(&v, p, 8); return v; }
+static inline uint32 read32(const uint8 *p) { uint32 v; std::memcpy(&v, p, 4); return v; }
+
+static inline uint64 xxh64_round(uint64 acc, uint64 input)
+{
+    acc += input * PRIME64_2;
+    acc  = rotl64(acc, 31);
+    return acc * PRIME64_1;
+}
+
+static inline uint64 xxh64_merge(uint64 acc, uint64 val)
+{
+    acc ^= xxh64_round(0, val);
+    return acc * PRIME64_1 + PRIME64_4;
+}
+
+uint64 xxh64(const void *data, std::size_t len, uint64 seed)
+{
+    const uint8 *p   = static_cast<const uint8 *>(data);
+    const uint8 *end = p + len;
+    uint64 h;
+
+    if (len >= 32) {
+        uint64 v1 = seed + PRIME64_1 + PRIME64_2;
+        uint64 v2 = seed + PRIME64_2;
+        uint64 v3 = seed;
+        uint64 v4 = seed - PRIME64_1;
+        for ( ; p + 32 <= end; p += 32) {
+            v1 = xxh64_round(v1, read64(p));
+            v2 = xxh64_round(v2, read64(p+8));
+            v3 = xxh64_round(v3, read64(p+16));
+            v4 = xxh64_round(v4, read64(p+24));
+        }
+        h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+        h = xxh64_merge(h, v1);
+        h = xxh64_merge(h, v2);
+        h = xxh64_merge(h, v3);
+        h = xxh64_merge(h, v4);
+    } else
+        h = seed + PRIME64_5;
+
+    h += len;
+    for ( ; p + 8 <= end; p += 8) {
+        h ^= xxh64_round(0, read64(p));
+        h  = rotl64(h, 27) * PRIME64_1 + PRIME64_4;
+    }
+    if (p + 4 <= end) {
+        h ^= uint64(read32(p)) * PRIME64_1;
+        h  = rotl64(h, 23) * PRIME64_2 + PRIME64_3;
+        p += 4;
+    }
+    for ( ; p < end; p++) {
+        h ^= *p * PRIME64_5;
+        h  = rotl64(h, 11) * PRIME64_1;
+    }
+
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+/* Slicing-by-8: table[k][b] is the CRC of byte b followed by k zero bytes, so
+ * 8 input bytes can be folded in with 8 independent lookups. (The crc32
+ * instruction of SSE4.2 is no use here: it computes CRC-32C, a different
+ * polynomial.) */
+static constexpr std::array<std::array<uint32, 256>, 8> make_crc_table()
+{
+    std::array<std::array<uint32, 256>, 8> t = {};
+    for (uint32 b = 0; b < 256; b++) {
+        uint32 c = b;
+        for (int i = 0; i < 8; i++)
+            c = c & 1 ? (c >> 1) ^ 0xEDB88320 : c >> 1;
+        t[0][b] = c;
+    }
+    for (uint32 b = 0; b < 256; b++)
+        for (int k = 1; k < 8; k++)
+            t[k][b] = (t[k-1][b] >> 8) ^ t[0][t[k-1][b] & 0xFF];
+    return t;
+}
+
+static constexpr auto crc_table = make_crc_table();
+
+uint32 crc32(const void *data, std::size_t len, uint32 crc)
+{
+    const uint8 *p = static_cast<const uint8 *>(data);
+    uint32 c = ~crc & 0xFFFFFFFF;
+    for ( ; len >= 8; p += 8, len -= 8) {
+        uint32 lo = c ^ (p[0] | p[1] << 8 | p[2] << 16 | uint32(p[3]) << 24);
+        c = crc_table[7][lo       & 0xFF] ^ crc_table[6][lo >>  8 & 0xFF]
+          ^ crc_table[5][lo >> 16 & 0xFF] ^ crc_table[4][lo >> 24]
+          ^ crc_table[3][p[4]] ^ crc_table[2][p[5]]
+          ^ crc_table[1][p[6]] ^ crc_table[0][p[7]];
+    }
+    for ( ; len > 0; p++, len--)
+        c = (c >> 8) ^ crc_table[0][(c ^ *p) & 0xFF];
+    return ~c & 0xFFFFFFFF;
+}
+
+} // namespace Util
@@ -0,0 +1,22 @@
+#ifndef UTIL_HASH_HPP_INCLUDED
+#define UTIL_HASH_HPP_INCLUDED
+
+/* Non-cryptographic hash functions.
+ * xxh64() is an implementation of XXH64. Its main loop keeps four independent
+ * accumulators over 32-byte stripes, so it runs at memory speed on any
+ * modern CPU. Use it for comparing large buffers (e.g. frames).
+ * crc32() is the usual zlib/PNG CRC-32, which is what ROM databases and patch
+ * formats use for checksums. It's table driven, 8 bytes at a time. Pass the
+ * previous result as crc to continue over more data. */
+
+#include <cstddef>
+#include <emu/util/unsigned.hpp>
+
+namespace Util {
+
+uint64 xxh64(const void *data, std::size_t len, uint64 seed = 0);
+uint32 crc32(const void *data, std::size_t len, uint32 crc = 0);
+
+} // namespace Util
+
+#endif
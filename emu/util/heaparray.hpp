@@ -2,6 +2,7 @@
 #define UTIL_HEAPARRAY_HPP_INCLUDED
 
 #include <iterator>
+#include <utility>
 
 namespace Util {
 
@@ -34,16 +35,27 @@ public:
             arrptr[i++] = x;
     }
 
-    HeapArray(const HeapArray &a) { operator=(a); }
+    HeapArray(const HeapArray &a) : HeapArray() { operator=(a); }
+    HeapArray(HeapArray &&a) : HeapArray() { operator=(std::move(a)); }
+    ~HeapArray() { delete[] arrptr; }
 
     T & operator[](std::size_t i) const { return arrptr[i]; }
 
     HeapArray<T> & operator=(const HeapArray<T> &arr)
     {
+        if (this == &arr)
+            return *this;
         std::size_t size = arr.size();
         reset(size);
         for (std::size_t i = 0; i != size; i++)
-            arrptr[i] = std::move(arr[i]);
+            arrptr[i] = arr[i];
+        return *this;
+    }
+
+    HeapArray<T> & operator=(HeapArray<T> &&arr)
+    {
+        std::swap(len, arr.len);
+        std::swap(arrptr, arr.arrptr);
         return *this;
     }
 
@@ -67,6 +79,7 @@ public:
 
     inline void reset(std::size_t newlen)
     {
+        delete[] arrptr;
         len = newlen;
         arrptr = new T[len];
     }
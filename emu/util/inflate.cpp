@@ -0,0 +1,433 @@
+#include <emu/util/inflate.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <emu/util/hash.hpp>
+#include <emu/util/unsigned.hpp>
+
+namespace Util {
+
+static const std::size_t MAX_SIZE = 64 * 1024 * 1024;
+
+namespace {
+
+const unsigned MAX_BITS  = 15;
+const unsigned FAST_BITS = 9;
+
+/* A canonical Huffman code. Codes up to FAST_BITS long are decoded with a
+ * single lookup in fast (indexed by the next bits of input, entries are
+ * symbol << 4 | length); longer ones are walked one bit at a time through
+ * count and symbol, the way puff.c does it. */
+struct Huffman {
+    uint16 count[MAX_BITS + 1];
+    uint16 symbol[288];
+    uint16 fast[1 << FAST_BITS];
+
+    // false for over-subscribed codes. incomplete ones are fine until an
+    // unused code shows up.
+    bool build(const uint8 *lengths, unsigned n)
+    {
+        std::fill(std::begin(count), std::end(count), 0);
+        for (unsigned i = 0; i < n; i++)
+            count[lengths[i]]++;
+        count[0] = 0;
+        int left = 1;
+        for (unsigned len = 1; len <= MAX_BITS; len++) {
+            left = (left << 1) - count[len];
+            if (left < 0)
+                return false;
+        }
+        uint16 offs[MAX_BITS + 2] = { 0, 0 };
+        for (unsigned len = 1; len <= MAX_BITS; len++)
+            offs[len + 1] = offs[len] + count[len];
+        for (unsigned sym = 0; sym < n; sym++)
+            if (lengths[sym] != 0)
+                symbol[offs[lengths[sym]]++] = sym;
+
+        std::fill(std::begin(fast), std::end(fast), 0);
+        unsigned code = 0, index = 0;
+        for (unsigned len = 1; len <= FAST_BITS; len++, code <<= 1) {
+            for (unsigned i = 0; i < count[len]; i++, code++) {
+                // codes are sent starting from their top bit
+                unsigned rev = 0;
+                for (unsigned b = 0; b < len; b++)
+                    rev |= (code >> b & 1) << (len - 1 - b);
+                for (unsigned r = rev; r < (1u << FAST_BITS); r += 1u << len)
+                    fast[r] = symbol[index] << 4 | len;
+                index++;
+            }
+        }
+        return true;
+    }
+};
+
+const uint16 LENGTH_BASE[] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258,
+};
+const uint8 LENGTH_EXTRA[] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0,
+};
+const uint16 DIST_BASE[] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577,
+};
+const uint8 DIST_EXTRA[] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13,
+};
+
+class Inflater {
+    const unsigned char *in, *in_end;
+    unsigned char *out_start, *out, *out_end;
+    uint64 bitbuf = 0;
+    unsigned bitcnt = 0;
+    // zero bytes made up past the end of the input
+    unsigned overrun = 0;
+
+    void refill()
+    {
+        while (bitcnt <= 56) {
+            uint64 b = 0;
+            if (in < in_end)
+                b = *in++;
+            else
+                overrun++;
+            bitbuf |= b << bitcnt;
+            bitcnt += 8;
+        }
+    }
+
+    unsigned bits(unsigned n)
+    {
+        if (bitcnt < n)
+            refill();
+        const unsigned v = bitbuf & ((uint64(1) << n) - 1);
+        bitbuf >>= n;
+        bitcnt -= n;
+        return v;
+    }
+
+    // true if bits that weren't in the input were used
+    bool past_end() const { return bitcnt < overrun * 8; }
+
+    int decode(const Huffman &h)
+    {
+        if (bitcnt < MAX_BITS)
+            refill();
+        const uint16 e = h.fast[bitbuf & ((1u << FAST_BITS) - 1)];
+        if (e != 0) {
+            bitbuf >>= e & 15;
+            bitcnt -= e & 15;
+            return e >> 4;
+        }
+        int code = 0, first = 0, index = 0;
+        for (unsigned len = 1; len <= MAX_BITS; len++) {
+            code |= bitbuf >> (len - 1) & 1;
+            const int count = h.count[len];
+            if (code - count < first) {
+                bitbuf >>= len;
+                bitcnt -= len;
+                return h.symbol[index + (code - first)];
+            }
+            index += count;
+            first  = (first + count) << 1;
+            code <<= 1;
+        }
+        return -1;
+    }
+
+    InflateStatus stored()
+    {
+        // back to byte alignment, then give back the bytes still buffered
+        bits(bitcnt % 8);
+        const unsigned buffered = bitcnt / 8;
+        if (buffered < overrun)
+            return InflateStatus::ERROR;
+        in -= buffered - overrun;
+        bitbuf = bitcnt = overrun = 0;
+        if (in_end - in < 4)
+            return InflateStatus::ERROR;
+        const unsigned len  = in[0] | in[1] << 8;
+        const unsigned nlen = in[2] | in[3] << 8;
+        in += 4;
+        if (len != (~nlen & 0xFFFF) || unsigned(in_end - in) < len)
+            return InflateStatus::ERROR;
+        const std::size_t n = std::min<std::size_t>(len, out_end - out);
+        if (n != 0)
+            std::memcpy(out, in, n);
+        out += n;
+        in  += n;
+        return n < len ? InflateStatus::FULL : InflateStatus::DONE;
+    }
+
+    InflateStatus codes(const Huffman &lit, const Huffman &dist)
+    {
+        for (;;) {
+            int sym = decode(lit);
+            if (sym < 0 || past_end())
+                return InflateStatus::ERROR;
+            if (sym < 256) {
+                if (out == out_end)
+                    return InflateStatus::FULL;
+                *out++ = sym;
+                continue;
+            }
+            if (sym == 256)
+                return InflateStatus::DONE;
+            sym -= 257;
+            if (sym >= 29)
+                return InflateStatus::ERROR;
+            const unsigned len = LENGTH_BASE[sym] + bits(LENGTH_EXTRA[sym]);
+            const int dsym = decode(dist);
+            if (dsym < 0 || dsym >= 30)
+                return InflateStatus::ERROR;
+            const std::size_t d = DIST_BASE[dsym] + bits(DIST_EXTRA[dsym]);
+            if (d > std::size_t(out - out_start) || past_end())
+                return InflateStatus::ERROR;
+            const std::size_t n = std::min<std::size_t>(len, out_end - out);
+            // may overlap, which repeats the last d bytes
+            const unsigned char *from = out - d;
+            for (std::size_t i = 0; i < n; i++)
+                out[i] = from[i];
+            out += n;
+            if (n < len)
+                return InflateStatus::FULL;
+        }
+    }
+
+    static const Huffman &fixed_lit()
+    {
+        static const Huffman h = []() {
+            uint8 lengths[288];
+            std::fill(lengths,       lengths + 144, 8);
+            std::fill(lengths + 144, lengths + 256, 9);
+            std::fill(lengths + 256, lengths + 280, 7);
+            std::fill(lengths + 280, lengths + 288, 8);
+            Huffman h;
+            h.build(lengths, 288);
+            return h;
+        }();
+        return h;
+    }
+
+    static const Huffman &fixed_dist()
+    {
+        static const Huffman h = []() {
+            uint8 lengths[30];
+            std::fill(lengths, lengths + 30, 5);
+            Huffman h;
+            h.build(lengths, 30);
+            return h;
+        }();
+        return h;
+    }
+
+    InflateStatus dynamic()
+    {
+        static const uint8 order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+        const unsigned nlen  = bits(5) + 257;
+        const unsigned ndist = bits(5) + 1;
+        const unsigned ncode = bits(4) + 4;
+        if (nlen > 286 || ndist > 30)
+            return InflateStatus::ERROR;
+        uint8 lengths[286 + 30] = {};
+        for (unsigned i = 0; i < ncode; i++)
+            lengths[order[i]] = bits(3);
+        Huffman lencode, lit, dist;
+        if (!lencode.build(lengths, 19))
+            return InflateStatus::ERROR;
+        for (unsigned i = 0; i < nlen + ndist; ) {
+            int sym = decode(lencode);
+            if (sym < 0 || past_end())
+                return InflateStatus::ERROR;
+            if (sym < 16) {
+                lengths[i++] = sym;
+                continue;
+            }
+            unsigned value = 0, repeat;
+            if (sym == 16) {
+                if (i == 0)
+                    return InflateStatus::ERROR;
+                value  = lengths[i - 1];
+                repeat = 3 + bits(2);
+            } else
+                repeat = sym == 17 ? 3 + bits(3) : 11 + bits(7);
+            if (i + repeat > nlen + ndist)
+                return InflateStatus::ERROR;
+            while (repeat--)
+                lengths[i++] = value;
+        }
+        // no end of block code means no way out
+        if (lengths[256] == 0)
+            return InflateStatus::ERROR;
+        if (!lit.build(lengths, nlen) || !dist.build(lengths + nlen, ndist))
+            return InflateStatus::ERROR;
+        return codes(lit, dist);
+    }
+
+public:
+    Inflater(std::span<const unsigned char> src, std::span<unsigned char> dst)
+        : in(src.data()), in_end(src.data() + src.size()),
+          out_start(dst.data()), out(dst.data()), out_end(dst.data() + dst.size())
+    { }
+
+    InflateStatus run()
+    {
+        for (bool last = false; !last; ) {
+            last = bits(1);
+            InflateStatus st;
+            switch (bits(2)) {
+            case 0:  st = stored();                        break;
+            case 1:  st = codes(fixed_lit(), fixed_dist()); break;
+            case 2:  st = dynamic();                       break;
+            default: st = InflateStatus::ERROR;            break;
+            }
+            if (st != InflateStatus::DONE)
+                return st;
+            if (past_end())
+                return InflateStatus::ERROR;
+        }
+        return InflateStatus::DONE;
+    }
+
+    std::size_t written() const { return out - out_start; }
+};
+
+uint32 le16(const unsigned char *p) { return p[0] | p[1] << 8; }
+uint32 le32(const unsigned char *p) { return p[0] | p[1] << 8 | p[2] << 16 | uint32(p[3]) << 24; }
+
+bool is_gzip(std::span<const unsigned char> d) { return d.size() >= 18 && d[0] == 0x1F && d[1] == 0x8B && d[2] == 8; }
+bool is_zip(std::span<const unsigned char> d)  { return d.size() >= 22 && le32(d.data()) == 0x04034B50; }
+
+FileView unpack_gzip(std::span<const unsigned char> d, std::string &err)
+{
+    const unsigned flags = d[3];
+    std::size_t pos = 10;
+    if (flags & 4)
+        pos += 2 + (pos + 2 <= d.size() ? le16(&d[pos]) : 0);
+    for (unsigned f : { 8, 16 })    // name and comment
+        if (flags & f)
+            while (pos < d.size() && d[pos++] != 0)
+                ;
+    if (flags & 2)
+        pos += 2;
+    if (pos + 8 > d.size()) {
+        err = "gzip file is cut short";
+        return FileView();
+    }
+    const unsigned char *trailer = d.data() + d.size() - 8;
+    // sizes over 4G wrap around, but MAX_SIZE is way under that
+    const std::size_t size = le32(trailer + 4);
+    if (size > MAX_SIZE) {
+        err = "file is too big";
+        return FileView();
+    }
+    auto out = FileView::anonymous(size);
+    std::size_t written;
+    auto st = inflate(d.subspan(pos, d.size() - 8 - pos), { out.writable_data(), size }, written);
+    if (st != InflateStatus::DONE || written != size || crc32(out.data(), size) != le32(trailer)) {
+        err = "gzip data is corrupted";
+        return FileView();
+    }
+    return out;
+}
+
+struct ZipEntry {
+    unsigned method;
+    uint32 crc;
+    std::size_t csize, usize;
+    std::span<const unsigned char> data;
+};
+
+// false for anything that can't be read (zip64, encryption, bad offsets).
+bool zip_entry(std::span<const unsigned char> d, std::size_t cd, ZipEntry &e)
+{
+    const unsigned char *c = d.data() + cd;
+    const unsigned flags = le16(c + 8);
+    e.method = le16(c + 10);
+    e.crc    = le32(c + 16);
+    e.csize  = le32(c + 20);
+    e.usize  = le32(c + 24);
+    const std::size_t local = le32(c + 42);
+    if ((flags & 1) || e.csize == 0xFFFFFFFF || e.usize == 0xFFFFFFFF || local + 30 > d.size()
+     || le32(d.data() + local) != 0x04034B50)
+        return false;
+    const std::size_t start = local + 30 + le16(&d[local + 26]) + le16(&d[local + 28]);
+    if (start > d.size() || e.csize > d.size() - start)
+        return false;
+    e.data = d.subspan(start, e.csize);
+    return e.method == 0 || e.method == 8;
+}
+
+bool zip_extract(const ZipEntry &e, std::span<unsigned char> out, bool whole)
+{
+    if (e.method == 0) {
+        std::memcpy(out.data(), e.data.data(), std::min(out.size(), e.csize));
+        return out.size() <= e.csize;
+    }
+    std::size_t written;
+    auto st = inflate(e.data, out, written);
+    return whole ? st == InflateStatus::DONE && written == out.size()
+                 : st != InflateStatus::ERROR && written == out.size();
+}
+
+FileView unpack_zip(std::span<const unsigned char> d, std::span<const unsigned char> magic, std::string &err)
+{
+    // the end of central directory record is at the end, before a comment
+    // of up to 64k.
+    std::size_t eocd = d.size() - 22;
+    const std::size_t stop = d.size() > 22 + 0xFFFF ? d.size() - 22 - 0xFFFF : 0;
+    while (eocd > stop && le32(&d[eocd]) != 0x06054B50)
+        eocd--;
+    if (le32(&d[eocd]) != 0x06054B50) {
+        err = "zip file has no central directory";
+        return FileView();
+    }
+    const unsigned count = le16(&d[eocd + 10]);
+    std::size_t cd = le32(&d[eocd + 16]);
+    for (unsigned i = 0; i < count; i++) {
+        if (cd + 46 > d.size() || le32(&d[cd]) != 0x02014B50)
+            break;
+        const std::size_t next = cd + 46 + le16(&d[cd + 28]) + le16(&d[cd + 30]) + le16(&d[cd + 32]);
+        ZipEntry e;
+        std::vector<unsigned char> head(magic.size());
+        if (zip_entry(d, cd, e) && e.usize >= magic.size() && e.usize <= MAX_SIZE
+         && zip_extract(e, head, false) && std::equal(head.begin(), head.end(), magic.begin())) {
+            auto out = FileView::anonymous(e.usize);
+            if (!zip_extract(e, { out.writable_data(), e.usize }, true) || crc32(out.data(), e.usize) != e.crc) {
+                err = "zip data is corrupted";
+                return FileView();
+            }
+            return out;
+        }
+        cd = next;
+    }
+    err = "no ROM found in zip file";
+    return FileView();
+}
+
+} // namespace
+
+InflateStatus inflate(std::span<const unsigned char> in, std::span<unsigned char> out, std::size_t &written)
+{
+    Inflater s { in, out };
+    auto st = s.run();
+    written = s.written();
+    return st;
+}
+
+bool is_archive(std::span<const unsigned char> data)
+{
+    return is_gzip(data) || is_zip(data);
+}
+
+FileView unpack(const FileView &archive, std::span<const unsigned char> magic, std::string &err)
+{
+    return is_gzip(archive.span()) ? unpack_gzip(archive.span(), err)
+         : is_zip(archive.span())  ? unpack_zip(archive.span(), magic, err)
+         : FileView();
+}
+
+} // namespace Util
@@ -0,0 +1,35 @@
+#ifndef UTIL_INFLATE_HPP_INCLUDED
+#define UTIL_INFLATE_HPP_INCLUDED
+
+/* A self-contained decompressor for deflate (RFC 1951) and for the two
+ * containers ROMs usually come in, gzip and zip.
+ * unpack() decompresses straight into the buffer of the FileView it returns,
+ * in a single pass; the uncompressed size is known in advance from the gzip
+ * trailer or the zip directory. When a zip holds several files, the one
+ * whose first bytes match magic is picked. */
+
+#include <span>
+#include <string>
+#include <emu/util/file.hpp>
+
+namespace Util {
+
+enum class InflateStatus {
+    DONE,       // reached the end of the stream
+    FULL,       // out is full, the stream goes on
+    ERROR,
+};
+
+/* Raw deflate data. written is set to the number of bytes put in out, which
+ * may be less than out.size() only on DONE or ERROR. */
+InflateStatus inflate(std::span<const unsigned char> in, std::span<unsigned char> out, std::size_t &written);
+
+bool is_archive(std::span<const unsigned char> data);
+
+/* The contents of a .gz, or of the first file in a .zip starting with magic.
+ * Returns an empty view on failure, with the reason in err. */
+FileView unpack(const FileView &archive, std::span<const unsigned char> magic, std::string &err);
+
+} // namespace Util
+
+#endif
@@ -0,0 +1,297 @@
+#include <emu/util/patch.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <set>
+#include <utility>
+#include <emu/util/hash.hpp>
+#include <emu/util/unsigned.hpp>
+
+namespace Util {
+
+// nothing the NES can address comes close; this only stops broken patches
+// from asking for gigabytes.
+static const uint64 MAX_SIZE = 64 * 1024 * 1024;
+
+namespace {
+
+struct Reader {
+    std::span<const unsigned char> d;
+    std::size_t pos = 0;
+    bool bad = false;
+
+    std::size_t left() const { return pos < d.size() ? d.size() - pos : 0; }
+
+    unsigned byte()
+    {
+        if (pos >= d.size()) {
+            bad = true;
+            return 0;
+        }
+        return d[pos++];
+    }
+
+    unsigned be(unsigned n)
+    {
+        unsigned v = 0;
+        while (n--)
+            v = v << 8 | byte();
+        return v;
+    }
+
+    // the number encoding of UPS and BPS: 7 bits at a time, low first, with
+    // an offset added at each step so that every number has one encoding.
+    uint64 number()
+    {
+        uint64 data = 0, shift = 1;
+        for (;;) {
+            const unsigned x = byte();
+            if (bad || shift > (uint64(1) << 56)) {
+                bad = true;
+                return 0;
+            }
+            data += (x & 0x7F) * shift;
+            if (x & 0x80)
+                return data;
+            shift <<= 7;
+            data += shift;
+        }
+    }
+};
+
+uint32 le32(const unsigned char *p)
+{
+    return p[0] | p[1] << 8 | p[2] << 16 | uint32(p[3]) << 24;
+}
+
+// writing only what differs keeps untouched pages shared with the file.
+inline void put(unsigned char *out, std::size_t i, unsigned char v)
+{
+    if (out[i] != v)
+        out[i] = v;
+}
+
+/* Patches whose CRCs were already checked, by the identity of the ROM and
+ * the patch file. */
+std::mutex verified_lock;
+std::set<std::pair<FileView::Identity, FileView::Identity>> verified;
+
+bool is_verified(const FileView &rom, const FileView &patch)
+{
+    const auto key = std::make_pair(rom.identity(), patch.identity());
+    if (key.first == FileView::Identity {} || key.second == FileView::Identity {})
+        return false;
+    std::lock_guard lock { verified_lock };
+    return verified.count(key) != 0;
+}
+
+void set_verified(const FileView &rom, const FileView &patch)
+{
+    const auto key = std::make_pair(rom.identity(), patch.identity());
+    if (key.first == FileView::Identity {} || key.second == FileView::Identity {})
+        return;
+    std::lock_guard lock { verified_lock };
+    verified.insert(key);
+}
+
+/* A record is a 3 byte offset and a 2 byte length followed by the data; a
+ * length of 0 means a run instead: 2 bytes of length, 1 of value. After the
+ * "EOF" marker there may be 3 more bytes, the size to truncate to. */
+FileView apply_ips(const FileView &rom, std::span<const unsigned char> patch, std::string &err)
+{
+    uint64 end = rom.size();
+    int64_t truncate = -1;
+    for (Reader r { .d = patch, .pos = 5 }; ; ) {
+        if (r.left() >= 3 && std::memcmp(patch.data() + r.pos, "EOF", 3) == 0) {
+            r.pos += 3;
+            if (r.left() == 3)
+                truncate = r.be(3);
+            break;
+        }
+        const unsigned off = r.be(3);
+        unsigned len = r.be(2);
+        if (len == 0) {
+            len = r.be(2);
+            r.byte();
+        } else
+            r.pos += len;
+        if (r.bad || r.pos > patch.size()) {
+            err = "IPS patch is cut short";
+            return FileView();
+        }
+        end = std::max<uint64>(end, off + len);
+    }
+    auto out = rom.copy_on_write(truncate >= 0 ? truncate : end);
+    unsigned char *p = out.writable_data();
+    for (Reader r { .d = patch, .pos = 5 }; std::memcmp(patch.data() + r.pos, "EOF", 3) != 0; ) {
+        const unsigned off = r.be(3);
+        unsigned len = r.be(2);
+        const bool run = len == 0;
+        const unsigned char value = run ? (len = r.be(2), r.byte()) : 0;
+        for (unsigned i = 0; i < len; i++)
+            if (off + i < out.size())
+                put(p, off + i, run ? value : patch[r.pos + i]);
+        if (!run)
+            r.pos += len;
+    }
+    return out;
+}
+
+/* After the sizes, hunks of: bytes to skip, then bytes to XOR with the
+ * source, ended by a 0. */
+FileView apply_ups(const FileView &rom, std::span<const unsigned char> patch, bool checked, std::string &err)
+{
+    Reader r { .d = patch.first(patch.size() - 12), .pos = 4 };
+    const uint64 src_size = r.number();
+    const uint64 dst_size = r.number();
+    if (r.bad || dst_size > MAX_SIZE) {
+        err = "UPS patch has a bad header";
+        return FileView();
+    }
+    const unsigned char *footer = patch.data() + patch.size() - 12;
+    if (!checked && (src_size != rom.size() || crc32(rom.data(), rom.size()) != le32(footer))) {
+        err = "UPS patch is for a different ROM";
+        return FileView();
+    }
+    auto out = rom.copy_on_write(dst_size);
+    unsigned char *p = out.writable_data();
+    for (uint64 pos = 0; r.left() > 0; ) {
+        pos += r.number();
+        for (unsigned x; (x = r.byte()) != 0 && !r.bad; pos++)
+            if (pos < dst_size)
+                put(p, pos, p[pos] ^ x);
+        pos++;
+    }
+    if (r.bad) {
+        err = "UPS patch is cut short";
+        return FileView();
+    }
+    if (!checked && crc32(out.data(), out.size()) != le32(footer + 4)) {
+        err = "UPS patch gives the wrong result";
+        return FileView();
+    }
+    return out;
+}
+
+/* Actions are: copy from the source at the same offset, copy from the patch,
+ * copy from the source or from the output at a relative offset.
+ * Since the output starts out as a copy of the source and is only written
+ * at the current position, which only moves forward, the first action is a
+ * no-op; the source for the third one is the original view. */
+FileView apply_bps(const FileView &rom, std::span<const unsigned char> patch, bool checked, std::string &err)
+{
+    Reader r { .d = patch.first(patch.size() - 12), .pos = 4 };
+    const uint64 src_size = r.number();
+    const uint64 dst_size = r.number();
+    r.pos += r.number();    // metadata
+    if (r.bad || dst_size > MAX_SIZE) {
+        err = "BPS patch has a bad header";
+        return FileView();
+    }
+    const unsigned char *footer = patch.data() + patch.size() - 12;
+    if (!checked && (src_size != rom.size() || crc32(rom.data(), rom.size()) != le32(footer))) {
+        err = "BPS patch is for a different ROM";
+        return FileView();
+    }
+    auto out = rom.copy_on_write(dst_size);
+    unsigned char *p = out.writable_data();
+    const unsigned char *src = rom.data();
+    uint64 pos = 0;
+    int64_t src_rel = 0, dst_rel = 0;
+    auto offset = [&r]() {
+        const uint64 d = r.number();
+        return d & 1 ? -int64_t(d >> 1) : int64_t(d >> 1);
+    };
+    while (r.left() > 0 && !r.bad) {
+        const uint64 data = r.number();
+        const uint64 len = (data >> 2) + 1;
+        if (pos + len > dst_size) {
+            r.bad = true;
+            break;
+        }
+        switch (data & 3) {
+        case 0:
+            if (pos + len > src_size)
+                r.bad = true;
+            break;
+        case 1:
+            if (r.left() < len) {
+                r.bad = true;
+                break;
+            }
+            for (uint64 i = 0; i < len; i++)
+                put(p, pos + i, patch[r.pos + i]);
+            r.pos += len;
+            break;
+        case 2:
+            src_rel += offset();
+            if (src_rel < 0 || uint64(src_rel) + len > src_size) {
+                r.bad = true;
+                break;
+            }
+            for (uint64 i = 0; i < len; i++)
+                put(p, pos + i, src[src_rel + i]);
+            src_rel += len;
+            break;
+        case 3:
+            dst_rel += offset();
+            // may overlap the bytes being written, which repeats them
+            if (dst_rel < 0 || uint64(dst_rel) >= pos) {
+                r.bad = true;
+                break;
+            }
+            for (uint64 i = 0; i < len; i++)
+                put(p, pos + i, p[dst_rel + i]);
+            dst_rel += len;
+            break;
+        }
+        pos += len;
+    }
+    if (r.bad || pos != dst_size) {
+        err = "BPS patch is broken";
+        return FileView();
+    }
+    if (!checked && crc32(out.data(), out.size()) != le32(footer + 4)) {
+        err = "BPS patch gives the wrong result";
+        return FileView();
+    }
+    return out;
+}
+
+} // namespace
+
+PatchFormat patch_format(std::span<const unsigned char> patch)
+{
+    auto magic = [&](const char *m, std::size_t min_size) {
+        return patch.size() >= min_size && std::memcmp(patch.data(), m, std::strlen(m)) == 0;
+    };
+    return magic("PATCH", 8) ? PatchFormat::IPS
+         : magic("UPS1", 16) ? PatchFormat::UPS
+         : magic("BPS1", 19) ? PatchFormat::BPS
+         : PatchFormat::INVALID;
+}
+
+FileView apply_patch(const FileView &rom, const FileView &patch, std::string &err)
+{
+    const auto format = patch_format(patch.span());
+    if (format == PatchFormat::INVALID) {
+        err = "not an IPS, UPS or BPS patch";
+        return FileView();
+    }
+    if (format == PatchFormat::IPS)
+        return apply_ips(rom, patch.span(), err);
+
+    const bool checked = is_verified(rom, patch);
+    if (!checked && crc32(patch.data(), patch.size() - 4) != le32(patch.data() + patch.size() - 4)) {
+        err = "patch is corrupted (bad CRC)";
+        return FileView();
+    }
+    auto out = format == PatchFormat::UPS ? apply_ups(rom, patch.span(), checked, err)
+                                          : apply_bps(rom, patch.span(), checked, err);
+    if (!checked && out.data())
+        set_verified(rom, patch);
+    return out;
+}
+
+} // namespace Util
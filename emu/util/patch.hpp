@@ -0,0 +1,29 @@
+#ifndef UTIL_PATCH_HPP_INCLUDED
+#define UTIL_PATCH_HPP_INCLUDED
+
+/* ROM patches in IPS, UPS or BPS format, applied in memory. The patched
+ * image is a FileView::copy_on_write() of the original, so pages the patch
+ * doesn't touch stay shared with the original file.
+ * UPS and BPS carry CRC-32s of the source, the target and the patch, which
+ * are checked; once a pair of files has been checked, the result is
+ * remembered (for as long as the program runs and neither file changes), so
+ * applying the same patch again skips hashing. IPS has no checksums. */
+
+#include <span>
+#include <string>
+#include <emu/util/file.hpp>
+
+namespace Util {
+
+enum class PatchFormat {
+    INVALID, IPS, UPS, BPS,
+};
+
+PatchFormat patch_format(std::span<const unsigned char> patch);
+
+/* Returns an empty view on failure, with the reason in err. */
+FileView apply_patch(const FileView &rom, const FileView &patch, std::string &err);
+
+} // namespace Util
+
+#endif
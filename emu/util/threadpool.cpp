@@ -0,0 +1,129 @@
+#include <emu/util/threadpool.hpp>
+
+#include <atomic>
+#include <deque>
+#include <algorithm>
+
+namespace Util {
+
+ThreadPool::ThreadPool(unsigned nthreads)
+{
+    for (unsigned i = 1; i < nthreads; i++)
+        workers.emplace_back([this]() { work_loop(); });
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stop = true;
+    }
+    start_cv.notify_all();
+    for (auto &t : workers)
+        t.join();
+}
+
+// must be called with the lock held; it is released while a job runs.
+void ThreadPool::take_jobs(std::unique_lock<std::mutex> &lock)
+{
+    const Job *fn = job;
+    while (next < njobs) {
+        unsigned i = next++;
+        running++;
+        lock.unlock();
+        (*fn)(i);
+        lock.lock();
+        running--;
+    }
+    if (running == 0)
+        done_cv.notify_all();
+}
+
+void ThreadPool::work_loop()
+{
+    unsigned long seen = 0;
+    std::unique_lock<std::mutex> lock(mtx);
+    for (;;) {
+        start_cv.wait(lock, [&]() { return stop || generation != seen; });
+        if (stop)
+            return;
+        seen = generation;
+        take_jobs(lock);
+    }
+}
+
+void ThreadPool::parallel_for(unsigned n, const Job &fn)
+{
+    if (workers.empty() || n <= 1) {
+        for (unsigned i = 0; i < n; i++)
+            fn(i);
+        return;
+    }
+    std::unique_lock<std::mutex> lock(mtx);
+    job = &fn;
+    njobs = n;
+    next = 0;
+    generation++;
+    start_cv.notify_all();
+    take_jobs(lock);
+    done_cv.wait(lock, [&]() { return next == njobs && running == 0; });
+    job = nullptr;
+}
+
+namespace {
+
+struct JobQueue {
+    std::mutex mtx;
+    std::deque<unsigned> jobs;
+};
+
+} // namespace
+
+/* Jobs here last milliseconds at least, so a lock per queue costs nothing
+ * next to them. */
+unsigned run_stealing(unsigned nthreads, unsigned njobs,
+                      const std::function<void(unsigned job, unsigned thread)> &fn)
+{
+    nthreads = std::max(1u, std::min(nthreads, njobs));
+    std::vector<JobQueue> queues(nthreads);
+    for (unsigned t = 0; t < nthreads; t++)
+        for (unsigned j = njobs * t / nthreads; j < njobs * (t+1) / nthreads; j++)
+            queues[t].jobs.push_back(j);
+    std::atomic<unsigned> stolen = 0;
+
+    auto take = [&](unsigned t, unsigned &job) {
+        {
+            std::lock_guard<std::mutex> lock(queues[t].mtx);
+            if (!queues[t].jobs.empty()) {
+                job = queues[t].jobs.back();
+                queues[t].jobs.pop_back();
+                return true;
+            }
+        }
+        for (unsigned i = 1; i < nthreads; i++) {
+            auto &victim = queues[(t + i) % nthreads];
+            std::lock_guard<std::mutex> lock(victim.mtx);
+            if (!victim.jobs.empty()) {
+                job = victim.jobs.front();
+                victim.jobs.pop_front();
+                stolen++;
+                return true;
+            }
+        }
+        return false;
+    };
+
+    auto work = [&](unsigned t) {
+        for (unsigned job; take(t, job); )
+            fn(job, t);
+    };
+    std::vector<std::thread> threads;
+    for (unsigned t = 1; t < nthreads; t++)
+        threads.emplace_back(work, t);
+    work(0);
+    for (auto &t : threads)
+        t.join();
+    return stolen;
+}
+
+} // namespace Util
@@ -0,0 +1,60 @@
+#ifndef UTIL_THREADPOOL_HPP_INCLUDED
+#define UTIL_THREADPOOL_HPP_INCLUDED
+
+/* A small pool of worker threads for splitting a job into independent parts.
+ * Use it like so:
+ *
+ *      Util::ThreadPool pool { 4 };
+ *      pool.parallel_for(nbands, [&](unsigned band) {
+ *          // process band...
+ *      });
+ *
+ * parallel_for() blocks until every part has been processed. The calling
+ * thread works on the parts too, so a pool of N threads spawns N-1 workers. */
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Util {
+
+class ThreadPool {
+    using Job = std::function<void(unsigned)>;
+
+    std::vector<std::thread> workers;
+    std::mutex mtx;
+    std::condition_variable start_cv, done_cv;
+    const Job *job = nullptr;
+    unsigned njobs = 0;
+    unsigned next = 0;
+    unsigned running = 0;
+    unsigned long generation = 0;
+    bool stop = false;
+
+    void work_loop();
+    void take_jobs(std::unique_lock<std::mutex> &lock);
+
+public:
+    explicit ThreadPool(unsigned nthreads = std::thread::hardware_concurrency());
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool & operator=(const ThreadPool &) = delete;
+
+    void parallel_for(unsigned n, const Job &fn);
+    unsigned size() const { return workers.size() + 1; }
+};
+
+/* For many jobs of very different lengths (whole emulator runs, say), on
+ * threads of their own: each thread starts with a contiguous share of the
+ * jobs, takes them from the back, and when it runs out steals from the front
+ * of the others' shares. fn gets the job and the thread running it.
+ * Returns how many jobs were stolen. */
+unsigned run_stealing(unsigned nthreads, unsigned njobs,
+                      const std::function<void(unsigned job, unsigned thread)> &fn);
+
+} // namespace Util
+
+#endif
@@ -0,0 +1,134 @@
+#include <emu/video/video.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <thread>
+#include <emu/util/threadpool.hpp>
+
+/* Canvas only; it's kept apart from the contexts so that it can be used
+ * without a window (and without SDL or OpenGL to link to). */
+
+namespace Video {
+
+Canvas::Canvas(Context &ctx, std::size_t width, std::size_t height)
+    : tex(ctx, width, height), frame(new unsigned char[width*height*4]()), w(width), h(height),
+      dirty(height, 1)
+{ }
+
+Canvas::Canvas(std::size_t width, std::size_t height)
+    : frame(new unsigned char[width*height*4]()), w(width), h(height), dirty(height, 1)
+{ }
+
+Canvas::~Canvas()
+{
+    if (frame)
+        delete[] frame;
+}
+
+void Canvas::drawpixel(std::size_t x, std::size_t y, uint32_t color)
+{
+    auto real_y = h-1 - y;
+    auto pos = (real_y * w + x) * 4;
+    assert(pos > 0 && pos < w * h * 4);
+    // this code is probably affected by endianness.
+    const unsigned char pixel[4] = {
+        static_cast<unsigned char>(color >> 24 & 0xFF),
+        static_cast<unsigned char>(color >> 16 & 0xFF),
+        static_cast<unsigned char>(color >> 8  & 0xFF),
+        static_cast<unsigned char>(color       & 0xFF),
+    };
+    if (std::memcmp(&frame[pos], pixel, 4) != 0) {
+        std::memcpy(&frame[pos], pixel, 4);
+        dirty[real_y] = 1;
+    }
+}
+
+/* Changing the filter changes the size of the texture, so a new one is
+ * created. Filtering is done by a few threads, started the first time a
+ * filter that actually scales is chosen. */
+bool Canvas::set_filter(Filter filter, unsigned factor)
+{
+    if (!filter_supported(filter, factor) || !tex.context())
+        return false;
+    mode = { filter, factor };
+    scaled.resize(factor == 1 ? 0 : w*factor * h*factor);
+    if (factor != 1 && !pool)
+        pool = std::make_unique<Util::ThreadPool>(std::clamp(std::thread::hardware_concurrency(), 1u, 4u));
+    tex = Texture(*tex.context(), w*factor, h*factor);
+    mark_all_dirty();
+    return true;
+}
+
+void Canvas::set_overlay(Overlay fn)
+{
+    overlay = std::move(fn);
+    composed.clear();
+    overlay_area = { 0, 0, 0, 0 };
+    mark_all_dirty();
+}
+
+// marks the rows of an area given from the top of the screen.
+void Canvas::mark_area(const Rect &r)
+{
+    for (std::size_t y = r.y; y < std::min(r.y + r.h, h); y++)
+        dirty[h-1 - y] = 1;
+}
+
+/* The overlay is drawn on a copy of the frame, so what the PPU drew (and its
+ * hash) stays the same. The rows it covers are uploaded every frame, along
+ * with the ones it covered the last time, in case it shrank. */
+unsigned char *Canvas::compose()
+{
+    composed.assign(frame, frame + size());
+    auto *top = reinterpret_cast<uint32_t *>(composed.data()) + (h-1)*w;
+    auto area = overlay(top, -std::ptrdiff_t(w), w, h);
+    mark_area(overlay_area);
+    mark_area(area);
+    overlay_area = area;
+    return composed.data();
+}
+
+/* Only the rows that changed since the last update are uploaded. Runs of
+ * dirty rows become rectangles; filters other than nearest neighbor look at
+ * the rows around each pixel, so those rectangles grow by one source row. */
+void Canvas::update()
+{
+    if (!tex.context())
+        return;
+    unsigned char *src = overlay ? compose() : frame;
+    const std::size_t f = mode.factor;
+    const std::size_t margin = mode.filter == Filter::NEAREST ? 0 : 1;
+    rects.clear();
+    for (std::size_t y = 0; y < h; ) {
+        if (!dirty[y]) {
+            y++;
+            continue;
+        }
+        const std::size_t start = y;
+        while (y < h && dirty[y])
+            y++;
+        const std::size_t y0 = start >= margin ? start - margin : 0;
+        const std::size_t y1 = std::min(y + margin, h);
+        if (!rects.empty() && rects.back().y + rects.back().h >= y0*f)
+            rects.back().h = y1*f - rects.back().y;
+        else
+            rects.push_back({ 0, y0*f, w*f, (y1 - y0)*f });
+    }
+    std::fill(dirty.begin(), dirty.end(), 0);
+    upload_frames++;
+    if (rects.empty())
+        return;
+    for (const auto &r : rects)
+        upload_bytes += r.w * r.h * 4;
+
+    if (f == 1) {
+        tex.update(src, rects);
+        return;
+    }
+    apply_filter(mode.filter, mode.factor, reinterpret_cast<const uint32_t *>(src), w, h,
+                 scaled.data(), pool.get());
+    tex.update(reinterpret_cast<unsigned char *>(scaled.data()), rects);
+}
+
+} // namespace Video
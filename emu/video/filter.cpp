@@ -0,0 +1,278 @@
+#include <emu/video/filter.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <vector>
+#include <emu/util/threadpool.hpp>
+
+namespace Video {
+
+static const std::size_t BAND_ROWS = 16;
+
+static void for_each_band(std::size_t height, Util::ThreadPool *pool, auto &&fn)
+{
+    const unsigned nbands = (height + BAND_ROWS - 1) / BAND_ROWS;
+    const std::function<void(unsigned)> band = [&](unsigned i) {
+        fn(i * BAND_ROWS, std::min((i+1) * BAND_ROWS, height));
+    };
+    if (pool)
+        pool->parallel_for(nbands, band);
+    else
+        for (unsigned i = 0; i < nbands; i++)
+            band(i);
+}
+
+/* Nearest neighbor: write the first line of every output block, then copy it
+ * over the other lines. Templated on the factor so that the inner loop is
+ * fully unrolled. */
+template <unsigned F>
+static void nearest_line(const uint32_t *src, uint32_t *dst, std::size_t width)
+{
+    for (std::size_t x = 0; x < width; x++)
+        for (unsigned k = 0; k < F; k++)
+            dst[x*F + k] = src[x];
+}
+
+static void nearest_rows(const uint32_t *src, std::size_t width, uint32_t *dst, unsigned factor,
+                         std::size_t y0, std::size_t y1)
+{
+    const std::size_t dw = width * factor;
+    for (std::size_t y = y0; y < y1; y++) {
+        const uint32_t *s = src + y*width;
+        uint32_t *d = dst + y*factor*dw;
+        switch (factor) {
+        case 2: nearest_line<2>(s, d, width); break;
+        case 3: nearest_line<3>(s, d, width); break;
+        case 4: nearest_line<4>(s, d, width); break;
+        default:
+            for (std::size_t x = 0; x < width; x++)
+                for (unsigned k = 0; k < factor; k++)
+                    d[x*factor + k] = s[x];
+        }
+        for (unsigned k = 1; k < factor; k++)
+            std::memcpy(d + k*dw, d, dw * sizeof(uint32_t));
+    }
+}
+
+/* Scale2x/Scale3x (also known as AdvMAME2x/3x). The neighbors of E are named
+ * this way:
+ *      A B C
+ *      D E F
+ *      G H I
+ * Pixels outside the image are clamped to the nearest edge. */
+static void scale2x_rows(const uint32_t *src, std::size_t width, std::size_t height, uint32_t *dst,
+                         std::size_t y0, std::size_t y1)
+{
+    const std::size_t dw = width * 2;
+    for (std::size_t y = y0; y < y1; y++) {
+        const uint32_t *up   = src + (y == 0          ? y : y-1) * width;
+        const uint32_t *cur  = src + y * width;
+        const uint32_t *down = src + (y == height - 1 ? y : y+1) * width;
+        uint32_t *d0 = dst + y*2*dw;
+        uint32_t *d1 = d0 + dw;
+        auto pixel = [&](std::size_t x, std::size_t xl, std::size_t xr) {
+            const uint32_t B = up[x], D = cur[xl], E = cur[x], F = cur[xr], H = down[x];
+            const bool edge = B != H && D != F;
+            d0[x*2  ] = edge && D == B ? D : E;
+            d0[x*2+1] = edge && B == F ? F : E;
+            d1[x*2  ] = edge && D == H ? D : E;
+            d1[x*2+1] = edge && H == F ? F : E;
+        };
+        pixel(0, 0, std::min<std::size_t>(1, width-1));
+        for (std::size_t x = 1; x + 1 < width; x++)
+            pixel(x, x-1, x+1);
+        if (width > 1)
+            pixel(width-1, width-2, width-1);
+    }
+}
+
+static void scale3x_rows(const uint32_t *src, std::size_t width, std::size_t height, uint32_t *dst,
+                         std::size_t y0, std::size_t y1)
+{
+    const std::size_t dw = width * 3;
+    for (std::size_t y = y0; y < y1; y++) {
+        const uint32_t *up   = src + (y == 0          ? y : y-1) * width;
+        const uint32_t *cur  = src + y * width;
+        const uint32_t *down = src + (y == height - 1 ? y : y+1) * width;
+        uint32_t *d0 = dst + y*3*dw;
+        uint32_t *d1 = d0 + dw;
+        uint32_t *d2 = d1 + dw;
+        auto pixel = [&](std::size_t x, std::size_t xl, std::size_t xr) {
+            const uint32_t A = up[xl],   B = up[x],   C = up[xr],
+                           D = cur[xl],  E = cur[x],  F = cur[xr],
+                           G = down[xl], H = down[x], I = down[xr];
+            const bool edge = B != H && D != F;
+            d0[x*3  ] = edge && D == B ? D : E;
+            d0[x*3+1] = edge && ((D == B && E != C) || (B == F && E != A)) ? B : E;
+            d0[x*3+2] = edge && B == F ? F : E;
+            d1[x*3  ] = edge && ((D == B && E != G) || (D == H && E != A)) ? D : E;
+            d1[x*3+1] = E;
+            d1[x*3+2] = edge && ((B == F && E != I) || (H == F && E != C)) ? F : E;
+            d2[x*3  ] = edge && D == H ? D : E;
+            d2[x*3+1] = edge && ((D == H && E != I) || (H == F && E != G)) ? H : E;
+            d2[x*3+2] = edge && H == F ? F : E;
+        };
+        pixel(0, 0, std::min<std::size_t>(1, width-1));
+        for (std::size_t x = 1; x + 1 < width; x++)
+            pixel(x, x-1, x+1);
+        if (width > 1)
+            pixel(width-1, width-2, width-1);
+    }
+}
+
+/* Blend2x, a simplified HQ2x. Pixels are compared in YUV space using the
+ * usual hqx thresholds, but instead of HQ2x's 256-pattern lookup table, each
+ * output quadrant is computed from the three source pixels touching its
+ * corner:
+ *  - if both edge neighbors differ from E but match each other, an edge
+ *    crosses the corner and the three pixels are blended;
+ *  - otherwise, if the corner pixel differs from E, it is blended in slightly;
+ *  - otherwise E is used as-is.
+ * Edges come out smoother than with Scale2x, but the output isn't HQ2x's:
+ * there are no wider blends along shallow lines, for one. */
+static inline uint32_t to_yuv(uint32_t p)
+{
+    const int r = p & 0xFF, g = p >> 8 & 0xFF, b = p >> 16 & 0xFF;
+    const int y = (r + g + b) >> 2;
+    const int u = 128 + ((r - b) >> 2);
+    const int v = 128 + ((2*g - r - b) >> 3);
+    return y << 16 | u << 8 | v;
+}
+
+static inline bool yuv_diff(uint32_t a, uint32_t b)
+{
+    const int dy = int(a >> 16)        - int(b >> 16);
+    const int du = int(a >> 8  & 0xFF) - int(b >> 8  & 0xFF);
+    const int dv = int(a       & 0xFF) - int(b       & 0xFF);
+    return std::abs(dy) > 48 || std::abs(du) > 7 || std::abs(dv) > 6;
+}
+
+// blends 3 colors channel by channel, two channels at a time. wa+wb+wc must be 4.
+static inline uint32_t blend(uint32_t a, uint32_t b, uint32_t c, unsigned wa, unsigned wb, unsigned wc)
+{
+    const uint32_t m = 0x00FF00FF;
+    const uint32_t lo = ((a      & m)*wa + (b      & m)*wb + (c      & m)*wc) >> 2 & m;
+    const uint32_t hi = ((a >> 8 & m)*wa + (b >> 8 & m)*wb + (c >> 8 & m)*wc) >> 2 & m;
+    return lo | hi << 8;
+}
+
+static inline uint32_t blend2x_corner(uint32_t e, uint32_t ye, uint32_t b, uint32_t yb,
+                                      uint32_t d, uint32_t yd, uint32_t a, uint32_t ya)
+{
+    const bool db = b != e && yuv_diff(ye, yb);
+    const bool dd = d != e && yuv_diff(ye, yd);
+    const bool bd = b != d && yuv_diff(yb, yd);
+    if (db && dd && !bd)
+        return blend(e, b, d, 2, 1, 1);
+    if (a != e && yuv_diff(ye, ya))
+        return blend(e, a, e, 3, 1, 0);
+    return e;
+}
+
+static void blend2x_rows(const uint32_t *src, const uint32_t *yuv, std::size_t width, std::size_t height,
+                         uint32_t *dst, std::size_t y0, std::size_t y1)
+{
+    const std::size_t dw = width * 2;
+    for (std::size_t y = y0; y < y1; y++) {
+        const std::size_t ru = (y == 0          ? y : y-1) * width;
+        const std::size_t rc = y * width;
+        const std::size_t rd = (y == height - 1 ? y : y+1) * width;
+        uint32_t *d0 = dst + y*2*dw;
+        uint32_t *d1 = d0 + dw;
+        for (std::size_t x = 0; x < width; x++) {
+            const std::size_t xl = x == 0         ? x : x-1;
+            const std::size_t xr = x == width - 1 ? x : x+1;
+            const uint32_t e = src[rc+x], ye = yuv[rc+x];
+            d0[x*2  ] = blend2x_corner(e, ye, src[ru+x],  yuv[ru+x],  src[rc+xl], yuv[rc+xl], src[ru+xl], yuv[ru+xl]);
+            d0[x*2+1] = blend2x_corner(e, ye, src[ru+x],  yuv[ru+x],  src[rc+xr], yuv[rc+xr], src[ru+xr], yuv[ru+xr]);
+            d1[x*2  ] = blend2x_corner(e, ye, src[rd+x],  yuv[rd+x],  src[rc+xl], yuv[rc+xl], src[rd+xl], yuv[rd+xl]);
+            d1[x*2+1] = blend2x_corner(e, ye, src[rd+x],  yuv[rd+x],  src[rc+xr], yuv[rc+xr], src[rd+xr], yuv[rd+xr]);
+        }
+    }
+}
+
+bool filter_supported(Filter filter, unsigned factor)
+{
+    switch (filter) {
+    case Filter::NEAREST: return factor >= 1;
+    case Filter::SCALE:   return factor >= 2 && factor <= 4;
+    case Filter::BLEND:   return factor == 2;
+    default:              return false;
+    }
+}
+
+std::string_view filter_name(Filter filter)
+{
+    switch (filter) {
+    case Filter::NEAREST: return "nearest";
+    case Filter::SCALE:   return "scale";
+    case Filter::BLEND:   return "blend";
+    default:              return "unknown";
+    }
+}
+
+std::optional<FilterMode> parse_filter(std::string_view str)
+{
+    if (str.size() < 3 || str.back() != 'x')
+        return std::nullopt;
+    const char digit = str[str.size() - 2];
+    if (digit < '1' || digit > '9')
+        return std::nullopt;
+    const unsigned factor = digit - '0';
+    const auto name = str.substr(0, str.size() - 2);
+    for (auto f : { Filter::NEAREST, Filter::SCALE, Filter::BLEND })
+        if (filter_name(f) == name && filter_supported(f, factor))
+            return FilterMode { f, factor };
+    return std::nullopt;
+}
+
+void apply_filter(Filter filter, unsigned factor, const uint32_t *src, std::size_t width,
+                  std::size_t height, uint32_t *dst, Util::ThreadPool *pool)
+{
+    // intermediate buffers, reused between frames
+    thread_local std::vector<uint32_t> tmp;
+
+    switch (filter) {
+    case Filter::NEAREST:
+        for_each_band(height, pool, [&](std::size_t y0, std::size_t y1) {
+            nearest_rows(src, width, dst, factor, y0, y1);
+        });
+        break;
+    case Filter::SCALE:
+        if (factor == 3) {
+            for_each_band(height, pool, [&](std::size_t y0, std::size_t y1) {
+                scale3x_rows(src, width, height, dst, y0, y1);
+            });
+        } else if (factor == 2) {
+            for_each_band(height, pool, [&](std::size_t y0, std::size_t y1) {
+                scale2x_rows(src, width, height, dst, y0, y1);
+            });
+        } else if (factor == 4) {
+            tmp.resize(width * height * 4);
+            uint32_t *mid = tmp.data();
+            for_each_band(height, pool, [&](std::size_t y0, std::size_t y1) {
+                scale2x_rows(src, width, height, mid, y0, y1);
+            });
+            for_each_band(height*2, pool, [&](std::size_t y0, std::size_t y1) {
+                scale2x_rows(mid, width*2, height*2, dst, y0, y1);
+            });
+        }
+        break;
+    case Filter::BLEND: {
+        tmp.resize(width * height);
+        uint32_t *yuv = tmp.data();
+        for_each_band(height, pool, [&](std::size_t y0, std::size_t y1) {
+            for (std::size_t i = y0*width; i < y1*width; i++)
+                yuv[i] = to_yuv(src[i]);
+        });
+        for_each_band(height, pool, [&](std::size_t y0, std::size_t y1) {
+            blend2x_rows(src, yuv, width, height, dst, y0, y1);
+        });
+        break;
+    }
+    }
+}
+
+} // namespace Video
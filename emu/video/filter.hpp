@@ -0,0 +1,41 @@
+#ifndef VIDEO_FILTER_HPP_INCLUDED
+#define VIDEO_FILTER_HPP_INCLUDED
+
+/* Software scaling filters, applied by a Canvas before its texture is
+ * uploaded. Every filter reads 32-bit pixels of a w*h image and writes a
+ * (w*factor)*(h*factor) image. The work is split into bands of rows; when a
+ * ThreadPool is given, the bands are spread across its threads.
+ * The inner loops are branch-free and work on whole rows, so that the
+ * compiler can vectorize them. */
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+namespace Util { class ThreadPool; }
+
+namespace Video {
+
+enum class Filter {
+    NEAREST,    // integer nearest neighbor, any factor
+    SCALE,      // Scale2x/Scale3x; 4x is Scale2x applied twice
+    BLEND,      // Blend2x, a simplified HQ2x, 2x only
+};
+
+struct FilterMode {
+    Filter filter;
+    unsigned factor;
+};
+
+bool filter_supported(Filter filter, unsigned factor);
+std::string_view filter_name(Filter filter);
+// parses strings such as "nearest3x", "scale2x", "blend2x".
+std::optional<FilterMode> parse_filter(std::string_view str);
+
+void apply_filter(Filter filter, unsigned factor, const uint32_t *src, std::size_t width,
+                  std::size_t height, uint32_t *dst, Util::ThreadPool *pool = nullptr);
+
+} // namespace Video
+
+#endif
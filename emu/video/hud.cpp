@@ -0,0 +1,141 @@
+#include <emu/video/hud.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <fmt/core.h>
+
+namespace Video {
+
+static const unsigned GLYPH_W = 3, GLYPH_H = 5;
+static const unsigned CELL_W = GLYPH_W + 1, CELL_H = GLYPH_H + 1;
+static const unsigned MARGIN = 2, PADDING = 2;
+static const unsigned GRAPH_H = 16;
+static const float GRAPH_MAX_MS = 33.3f;
+
+/* 3x5 font. Every glyph is 5 rows of 3 bits, top row in the highest bits,
+ * leftmost pixel in the highest bit of each row. */
+#define GLYPH(a, b, c, d, e) ((0##a << 12) | (0##b << 9) | (0##c << 6) | (0##d << 3) | 0##e)
+// rows written in octal, e.g. 7 = 111, 5 = 101, 2 = 010
+static uint16_t glyph(char c)
+{
+    switch (c) {
+    case '0': case 'O': return GLYPH(7, 5, 5, 5, 7);
+    case '1': return GLYPH(2, 6, 2, 2, 7);
+    case '2': return GLYPH(7, 1, 7, 4, 7);
+    case '3': return GLYPH(7, 1, 7, 1, 7);
+    case '4': return GLYPH(5, 5, 7, 1, 1);
+    case '5': case 'S': return GLYPH(7, 4, 7, 1, 7);
+    case '6': return GLYPH(7, 4, 7, 5, 7);
+    case '7': return GLYPH(7, 1, 1, 1, 1);
+    case '8': return GLYPH(7, 5, 7, 5, 7);
+    case '9': return GLYPH(7, 5, 7, 1, 7);
+    case 'A': return GLYPH(7, 5, 7, 5, 5);
+    case 'C': return GLYPH(7, 4, 4, 4, 7);
+    case 'D': return GLYPH(6, 5, 5, 5, 6);
+    case 'E': return GLYPH(7, 4, 7, 4, 7);
+    case 'F': return GLYPH(7, 4, 7, 4, 4);
+    case 'H': return GLYPH(5, 5, 7, 5, 5);
+    case 'M': return GLYPH(5, 7, 7, 5, 5);
+    case 'P': return GLYPH(7, 5, 7, 4, 4);
+    case 'R': return GLYPH(7, 5, 6, 5, 5);
+    case 'T': return GLYPH(7, 2, 2, 2, 2);
+    case 'U': return GLYPH(5, 5, 5, 5, 7);
+    case '%': return GLYPH(5, 1, 2, 4, 5);
+    case '.': return GLYPH(0, 0, 0, 0, 2);
+    case ':': return GLYPH(0, 2, 0, 2, 0);
+    case '/': return GLYPH(1, 1, 2, 4, 4);
+    case '-': return GLYPH(0, 0, 7, 0, 0);
+    default:  return 0;
+    }
+}
+#undef GLYPH
+
+// pixels in a Canvas are R, G, B, A bytes in memory order.
+static uint32_t rgb(uint8_t r, uint8_t g, uint8_t b)
+{
+    const unsigned char bytes[4] = { r, g, b, 0xFF };
+    uint32_t p;
+    std::memcpy(&p, bytes, 4);
+    return p;
+}
+
+/* Blends color over a row of pixels with alpha in [0, 256]. Each channel gets
+ * 16 bits of room inside a 32-bit word, so two channels are done with a
+ * single multiply; the loop has no branches and gets vectorized. */
+static void blend_span(uint32_t *row, std::size_t n, uint32_t color, unsigned alpha)
+{
+    const uint32_t m = 0x00FF00FF;
+    const uint32_t src_lo = (color & m) * alpha, src_hi = (color >> 8 & m) * alpha;
+    const unsigned inv = 256 - alpha;
+    for (std::size_t i = 0; i < n; i++) {
+        const uint32_t p = row[i];
+        const uint32_t lo = ((p      & m) * inv + src_lo) >> 8 & m;
+        const uint32_t hi = ((p >> 8 & m) * inv + src_hi) >> 8 & m;
+        row[i] = lo | hi << 8;
+    }
+}
+
+static void draw_text(uint32_t *top, std::ptrdiff_t stride, std::size_t x, std::size_t y,
+                      std::string_view text, uint32_t color)
+{
+    for (char c : text) {
+        const uint16_t g = glyph(c);
+        for (unsigned gy = 0; gy < GLYPH_H; gy++) {
+            uint32_t *row = top + std::ptrdiff_t(y + gy) * stride + x;
+            const unsigned bits = g >> (GLYPH_H-1 - gy) * GLYPH_W & 7;
+            for (unsigned gx = 0; gx < GLYPH_W; gx++)
+                if (bits & (4 >> gx))
+                    row[gx] = color;
+        }
+        x += CELL_W;
+    }
+}
+
+void Hud::set_stats(const Stats &stats)
+{
+    lines[0] = fmt::format("FPS {:.1f} SPD {:.0f}%", stats.fps, stats.speed * 100.0);
+    lines[1] = fmt::format("CPU {:.0f}% PPU {:.0f}%", stats.cpu_share * 100.0,
+                           (1.0 - stats.cpu_share) * 100.0);
+    lines[2] = fmt::format("DROP {} CHR {}", stats.dropped, stats.chr_tiles);
+}
+
+/* The panel sits in the top left corner: three lines of text, then a graph
+ * of the last HISTORY frame times. Bars taller than the 60 fps line are
+ * colored yellow, those past 30 fps red. */
+Rect Hud::draw(uint32_t *top, std::ptrdiff_t stride, std::size_t width, std::size_t height) const
+{
+    std::size_t text_w = 0;
+    for (const auto &l : lines)
+        text_w = std::max(text_w, l.size() * CELL_W);
+    const std::size_t panel_w = std::max<std::size_t>(text_w, HISTORY) + PADDING*2;
+    const std::size_t panel_h = std::size(lines) * CELL_H + GRAPH_H + PADDING*2;
+    if (MARGIN + panel_w > width || MARGIN + panel_h > height)
+        return { 0, 0, 0, 0 };
+
+    for (std::size_t y = 0; y < panel_h; y++)
+        blend_span(top + std::ptrdiff_t(MARGIN + y) * stride + MARGIN, panel_w, rgb(0, 0, 0), 160);
+
+    const std::size_t x0 = MARGIN + PADDING;
+    std::size_t y0 = MARGIN + PADDING;
+    for (const auto &l : lines) {
+        draw_text(top, stride, x0, y0, l, rgb(0xFF, 0xFF, 0xFF));
+        y0 += CELL_H;
+    }
+
+    const uint32_t green = rgb(0x40, 0xE0, 0x40), yellow = rgb(0xF0, 0xE0, 0x30), red = rgb(0xF0, 0x40, 0x30);
+    const std::size_t base = y0 + GRAPH_H - 1;
+    for (unsigned i = 0; i < HISTORY; i++) {
+        const float ms = times[(head + i) % HISTORY];
+        const unsigned bar = std::clamp<unsigned>(unsigned(ms / GRAPH_MAX_MS * GRAPH_H + 0.5f), ms > 0.0f, GRAPH_H);
+        const uint32_t color = ms > 33.4f ? red : ms > 16.7f ? yellow : green;
+        for (unsigned k = 0; k < bar; k++)
+            top[std::ptrdiff_t(base - k) * stride + x0 + i] = color;
+    }
+    // 60 fps line
+    const std::size_t line_y = base - std::size_t(16.7f / GRAPH_MAX_MS * GRAPH_H);
+    blend_span(top + std::ptrdiff_t(line_y) * stride + x0, HISTORY, rgb(0xFF, 0xFF, 0xFF), 96);
+
+    return { MARGIN, MARGIN, panel_w, panel_h };
+}
+
+} // namespace Video
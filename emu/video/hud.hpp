@@ -0,0 +1,47 @@
+#ifndef VIDEO_HUD_HPP_INCLUDED
+#define VIDEO_HUD_HPP_INCLUDED
+
+/* A small performance overlay. It's drawn as a Canvas overlay, that is, on
+ * top of the finished frame just before it's uploaded:
+ *
+ *      canvas.set_overlay([&](uint32_t *top, std::ptrdiff_t stride, std::size_t w, std::size_t h) {
+ *          return hud.draw(top, stride, w, h);
+ *      });
+ *
+ * The numbers shown are pushed with set_stats() and frame_time(). Text uses
+ * a built-in 3x5 font; the background is alpha blended two channels at a
+ * time. */
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <emu/video/video.hpp>
+
+namespace Video {
+
+class Hud {
+    static const unsigned HISTORY = 64;
+
+    std::array<float, HISTORY> times = {};
+    unsigned head = 0;
+    std::string lines[3];
+
+public:
+    struct Stats {
+        double fps;         // frames emulated per second
+        double speed;       // compared to a real NES, 1.0 = 100%
+        double cpu_share;   // fraction of emulation time spent in the CPU
+        unsigned long dropped;
+        unsigned chr_tiles;   // CHR RAM tiles rewritten in the last frame
+    };
+
+    void set_stats(const Stats &stats);
+    void frame_time(float ms) { times[head] = ms; head = (head + 1) % HISTORY; }
+    // draws the overlay; returns the area that was drawn on.
+    Rect draw(uint32_t *top, std::ptrdiff_t stride, std::size_t width, std::size_t height) const;
+};
+
+} // namespace Video
+
+#endif
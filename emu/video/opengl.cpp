@@ -140,10 +140,15 @@ unsigned OpenGL::create_texture(std::size_t texw, std::size_t texh, unsigned cha
     return id;
 }
 
-void OpenGL::update_texture(unsigned id, std::size_t texw, std::size_t texh, unsigned char *data)
+void OpenGL::update_texture(unsigned id, std::size_t texw, std::size_t texh, unsigned char *data,
+                            std::span<const Rect> rects)
 {
     use_texture(id);
-    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, texw, texh, GL_RGBA, GL_UNSIGNED_BYTE, data);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, texw);
+    for (const auto &r : rects)
+        glTexSubImage2D(GL_TEXTURE_2D, 0, r.x, r.y, r.w, r.h, GL_RGBA, GL_UNSIGNED_BYTE,
+                        data + (r.y * texw + r.x) * 4);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
 }
 
 void OpenGL::use_texture(unsigned id)
@@ -22,7 +22,8 @@ public:
     bool init();
     void resize(int width, int height);
     unsigned create_texture(std::size_t texw, std::size_t texh, unsigned char *data = nullptr);
-    void update_texture(unsigned id, std::size_t texw, std::size_t texh, unsigned char *data);
+    void update_texture(unsigned id, std::size_t texw, std::size_t texh, unsigned char *data,
+                        std::span<const Rect> rects);
     void use_texture(unsigned id);
     void draw();
 };
@@ -0,0 +1,151 @@
+#include <emu/video/software.hpp>
+
+#include <cstring>
+#include <emu/util/debug.hpp>
+
+namespace Video {
+
+Software::~Software()
+{
+    if (!initialized)
+        return;
+    initialized = false;
+    SDL_DestroyWindow(window);
+    SDL_Quit();
+}
+
+bool Software::init()
+{
+    if (SDL_Init(SDL_INIT_VIDEO) < 0) {
+        error("can't initialize video, SDL2 error: {}\n", SDL_GetError());
+        return false;
+    }
+    window = SDL_CreateWindow("Window", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
+                              Context::DEF_WIDTH, Context::DEF_HEIGTH,
+                              SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE);
+    SDL_Surface *surface = window ? SDL_GetWindowSurface(window) : nullptr;
+    if (!surface || surface->format->BytesPerPixel != 4) {
+        error("can't initialize video: no 32-bit window surface ({})\n", SDL_GetError());
+        if (window)
+            SDL_DestroyWindow(window);
+        SDL_Quit();
+        return false;
+    }
+    rshift = surface->format->Rshift;
+    gshift = surface->format->Gshift;
+    bshift = surface->format->Bshift;
+    ashift = surface->format->Ashift;
+    alpha  = surface->format->Amask != 0;
+    initialized = true;
+    return true;
+}
+
+// the window surface is fetched again by draw(), nothing to do here
+void Software::resize(int newwidth, int newheight) { }
+
+uint32_t Software::convert(const unsigned char *rgba) const
+{
+    return uint32_t(rgba[0]) << rshift
+         | uint32_t(rgba[1]) << gshift
+         | uint32_t(rgba[2]) << bshift
+         | (alpha ? uint32_t(rgba[3]) << ashift : 0);
+}
+
+unsigned Software::create_texture(std::size_t texw, std::size_t texh, unsigned char *data)
+{
+    textures.push_back({ texw, texh, std::vector<uint32_t>(texw * texh) });
+    unsigned id = textures.size();
+    if (data) {
+        const Rect all = { 0, 0, texw, texh };
+        update_texture(id, texw, texh, data, std::span { &all, 1 });
+    }
+    return id;
+}
+
+void Software::update_texture(unsigned id, std::size_t texw, std::size_t texh, unsigned char *data,
+                              std::span<const Rect> rects)
+{
+    auto &tex = textures[id-1];
+    if (tex.w != texw || tex.h != texh) {
+        tex.w = texw;
+        tex.h = texh;
+        tex.pixels.resize(texw * texh);
+    }
+    for (const auto &r : rects) {
+        for (std::size_t y = r.y; y < r.y + r.h; y++) {
+            const unsigned char *src = data + (y * texw + r.x) * 4;
+            uint32_t *dst = &tex.pixels[y * texw + r.x];
+            for (std::size_t x = 0; x < r.w; x++)
+                dst[x] = convert(src + x*4);
+        }
+    }
+}
+
+void Software::use_texture(unsigned id)
+{
+    current = id;
+}
+
+/* Scales a texture to the whole window, like the OpenGL context does.
+ * Texture row 0 is the bottom of the image (as in OpenGL), so rows are
+ * flipped. Every window row is either a copy of the previous one (when the
+ * vertical scale repeats a texture row) or built from the texture row
+ * through a column map; integer horizontal factors get unrolled loops. */
+void Software::blit(const Tex &tex, SDL_Surface *surface)
+{
+    const std::size_t winw = surface->w, winh = surface->h;
+    if (map_texw != tex.w || map_winw != winw) {
+        xmap.resize(winw);
+        for (std::size_t x = 0; x < winw; x++)
+            xmap[x] = x * tex.w / winw;
+        map_texw = tex.w;
+        map_winw = winw;
+    }
+    const std::size_t factor = winw % tex.w == 0 ? winw / tex.w : 0;
+    auto *pixels = static_cast<unsigned char *>(surface->pixels);
+    std::size_t prev_row = ~std::size_t(0);
+
+    for (std::size_t y = 0; y < winh; y++) {
+        const std::size_t row = tex.h - 1 - y * tex.h / winh;
+        auto *dst = reinterpret_cast<uint32_t *>(pixels + y * surface->pitch);
+        if (row == prev_row) {
+            std::memcpy(dst, pixels + (y-1) * surface->pitch, winw * 4);
+            continue;
+        }
+        prev_row = row;
+        const uint32_t *src = &tex.pixels[row * tex.w];
+        auto replicate = [&]<std::size_t F>() {
+            for (std::size_t x = 0; x < tex.w; x++)
+                for (std::size_t k = 0; k < F; k++)
+                    dst[x*F + k] = src[x];
+        };
+        switch (factor) {
+        case 1: std::memcpy(dst, src, winw * 4);         break;
+        case 2: replicate.template operator()<2>();      break;
+        case 3: replicate.template operator()<3>();      break;
+        case 4: replicate.template operator()<4>();      break;
+        default:
+            for (std::size_t x = 0; x < winw; x++)
+                dst[x] = src[xmap[x]];
+        }
+    }
+}
+
+void Software::draw()
+{
+    SDL_Surface *surface = SDL_GetWindowSurface(window);
+    if (!surface)
+        return;
+    if (SDL_MUSTLOCK(surface))
+        SDL_LockSurface(surface);
+    if (current != 0)
+        blit(textures[current-1], surface);
+    else
+        for (int y = 0; y < surface->h; y++)
+            std::memset(static_cast<unsigned char *>(surface->pixels) + y * surface->pitch, 0, surface->w * 4);
+    if (SDL_MUSTLOCK(surface))
+        SDL_UnlockSurface(surface);
+    SDL_UpdateWindowSurface(window);
+}
+
+} // namespace Video
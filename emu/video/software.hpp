@@ -0,0 +1,47 @@
+#ifndef VIDEO_SOFTWARE_HPP_INCLUDED
+#define VIDEO_SOFTWARE_HPP_INCLUDED
+
+#include <vector>
+#include <SDL2/SDL.h>
+#include <emu/video/video.hpp>
+
+namespace Video {
+
+/* A Context that doesn't need any graphics library: textures are kept in
+ * memory, already converted to the pixel format of the window, and draw()
+ * scales the current one straight into the window surface. */
+class Software : public Context::Impl {
+    struct Tex {
+        std::size_t w, h;
+        std::vector<uint32_t> pixels;
+    };
+
+    bool initialized = false;
+    SDL_Window *window = nullptr;
+    std::vector<Tex> textures;
+    unsigned current = 0;
+    // maps a column of the window to a column of the texture
+    std::vector<uint32_t> xmap;
+    std::size_t map_texw = 0, map_winw = 0;
+    // where each channel goes in a pixel of the window surface
+    unsigned rshift, gshift, bshift, ashift;
+    bool alpha;
+
+    uint32_t convert(const unsigned char *rgba) const;
+    void blit(const Tex &tex, SDL_Surface *surface);
+
+public:
+    ~Software();
+
+    bool init();
+    void resize(int width, int height);
+    unsigned create_texture(std::size_t texw, std::size_t texh, unsigned char *data = nullptr);
+    void update_texture(unsigned id, std::size_t texw, std::size_t texh, unsigned char *data,
+                        std::span<const Rect> rects);
+    void use_texture(unsigned id);
+    void draw();
+};
+
+} // namespace Video
+
+#endif
@@ -1,5 +1,6 @@
 #include <emu/video/video.hpp>
 
+#include <algorithm>
 #include <cassert>
 #include <fmt/core.h>
 // I wish I didn't have to do this...
@@ -12,33 +13,28 @@
 #include <emu/util/debug.hpp>
 
 #include "opengl.hpp"
+#include "software.hpp"
 
 namespace Video {
 
 bool Context::init(Type type)
 {
     switch (type) {
-    case Type::OPENGL: ptr = std::make_unique<Video::OpenGL>(); break;
-    default:           error("unknown type\n");     break;
+    case Type::OPENGL:   ptr = std::make_unique<Video::OpenGL>();   break;
+    case Type::SOFTWARE: ptr = std::make_unique<Video::Software>(); break;
+    default:             error("unknown type\n");                  break;
     }
-    return ptr->init();
-        // initialized = true;
+    if (ptr->init())
+        return true;
+    if (type == Type::OPENGL) {
+        warning("can't use OpenGL, falling back to software rendering\n");
+        return init(Type::SOFTWARE);
+    }
+    return false;
 }
 
 void Context::reset() { }
 
-void Canvas::drawpixel(std::size_t x, std::size_t y, uint32_t color)
-{
-    auto real_y = tex.height()-1 - y;
-    auto pos = (real_y * tex.width() + x) * 4;
-    assert(pos > 0 && pos < tex.width() * tex.height() * 4);
-    // this code is probably affected by endianness.
-    frame[pos  ] = color >> 24 & 0xFF;
-    frame[pos+1] = color >> 16 & 0xFF;
-    frame[pos+2] = color >> 8  & 0xFF;
-    frame[pos+3] = color       & 0xFF;
-}
-
 ImageTexture::ImageTexture(const char *pathname, Context &ctx)
 {
     int width, height, channels;
@@ -1,15 +1,26 @@
 #ifndef VIDEO_HPP_INCLUDED
 #define VIDEO_HPP_INCLUDED
 
+#include <algorithm>
 #include <cstdint>
+#include <functional>
 #include <memory>
+#include <span>
 #include <string_view>
+#include <vector>
+#include <emu/video/filter.hpp>
+
+namespace Util { class ThreadPool; }
 
 namespace Video {
 
 class Canvas;
 class ImageTexture;
 
+struct Rect {
+    std::size_t x, y, w, h;
+};
+
 struct Context {
     struct Impl {
         virtual ~Impl() { }
@@ -17,13 +28,16 @@ struct Context {
         virtual void resize(int newwidth, int newheight) = 0;
         // these 3 methods should only be called by Texture
         virtual unsigned create_texture(std::size_t texw, std::size_t texh, unsigned char *data = nullptr) = 0;
-        virtual void update_texture(unsigned id, std::size_t texw, std::size_t texh, unsigned char *data) = 0;
+        // data always points to the whole texture, only the parts in rects are uploaded
+        virtual void update_texture(unsigned id, std::size_t texw, std::size_t texh, unsigned char *data,
+                                    std::span<const Rect> rects) = 0;
         virtual void use_texture(unsigned id) = 0;
         virtual void draw() = 0;
     };
 
     enum class Type {
         OPENGL,
+        SOFTWARE,
     };
 
     static const unsigned DEF_WIDTH  = 512;
@@ -76,10 +90,19 @@ public:
         ctx = &c;
         id = ctx->ptr->create_texture(tw, th, data);
     }
+    Context *context() const         { return ctx; }
     unsigned tid() const             { return id; }
     unsigned width() const           { return tw; }
     unsigned height() const          { return th; }
-    void update(unsigned char *data) { ctx->ptr->update_texture(id, tw, th, data); }
+    void update(unsigned char *data)
+    {
+        const Rect all = { 0, 0, tw, th };
+        update(data, std::span { &all, 1 });
+    }
+    void update(unsigned char *data, std::span<const Rect> rects)
+    {
+        ctx->ptr->update_texture(id, tw, th, data, rects);
+    }
     void update(std::size_t width, std::size_t height, unsigned char *data)
     {
         tw = width;
@@ -90,18 +113,37 @@ public:
 };
 
 class Canvas {
+public:
+    /* Draws on top of a finished frame, right before it's uploaded. top points
+     * to the first pixel of the top row, moving down a row means adding
+     * stride. Returns the area drawn on, in pixels from the top left. */
+    using Overlay = std::function<Rect(uint32_t *top, std::ptrdiff_t stride, std::size_t w, std::size_t h)>;
+
+private:
     Texture tex;
     unsigned char *frame;
+    std::size_t w, h;
+    FilterMode mode = { Filter::NEAREST, 1 };
+    std::vector<uint32_t> scaled;
+    std::unique_ptr<Util::ThreadPool> pool;
+    // one flag for each row of frame, set when a pixel in it changes
+    std::vector<uint8_t> dirty;
+    std::vector<Rect> rects;
+    unsigned long long upload_bytes = 0;
+    unsigned long upload_frames = 0;
+    Overlay overlay;
+    // the frame with the overlay drawn on top; frame itself is left untouched
+    std::vector<unsigned char> composed;
+    Rect overlay_area = { 0, 0, 0, 0 };
+
+    void mark_all_dirty() { std::fill(dirty.begin(), dirty.end(), 1); }
+    void mark_area(const Rect &r);
+    unsigned char *compose();
 public:
-    Canvas(Context &ctx, std::size_t width, std::size_t height)
-        : tex(ctx, width, height), frame(new unsigned char[width*height*4])
-    { }
-
-    ~Canvas()
-    {
-        if (frame)
-            delete[] frame;
-    }
+    Canvas(Context &ctx, std::size_t width, std::size_t height);
+    // a headless canvas: pixels are kept in memory but never uploaded anywhere
+    Canvas(std::size_t width, std::size_t height);
+    ~Canvas();
 
     Canvas(const Canvas &) = delete;
     Canvas(Canvas &&) = default;
@@ -109,11 +151,19 @@ public:
     Canvas & operator=(Canvas &&) = default;
 
     void drawpixel(std::size_t x, std::size_t y, uint32_t color);
-
-    unsigned width() const  { return tex.width(); }
-    unsigned height() const { return tex.height(); }
-    void update()           { tex.update(frame); }
-    void reset(Context &c)  { tex.reset(c); }
+    bool set_filter(Filter filter, unsigned factor);
+    void set_overlay(Overlay fn);
+    void update();
+
+    unsigned width() const      { return w; }
+    unsigned height() const     { return h; }
+    FilterMode filter() const   { return mode; }
+    bool has_overlay() const    { return bool(overlay); }
+    const unsigned char *data() const { return frame; }
+    std::size_t size() const    { return w*h*4; }
+    void reset(Context &c)      { tex.reset(c); mark_all_dirty(); }
+    // average number of bytes sent to the texture by update()
+    double avg_upload() const   { return upload_frames == 0 ? 0.0 : double(upload_bytes) / upload_frames; }
 };
 
 class ImageTexture {
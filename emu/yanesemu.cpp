@@ -0,0 +1,131 @@
+/* The C API, see yanesemu.h. Everything here is a thin wrapper: the calls
+ * made every frame must stay as cheap as calling the Emulator directly. */
+
+#include <emu/yanesemu.h>
+
+#include <new>
+#include <string>
+#include <emu/core/emulator.hpp>
+
+static_assert(unsigned(YANESEMU_BUTTON_A) == Core::BUTTON_A && unsigned(YANESEMU_BUTTON_RIGHT) == Core::BUTTON_RIGHT);
+static_assert(int(YANESEMU_WIDTH) == Core::SCREEN_WIDTH && int(YANESEMU_HEIGHT) == Core::SCREEN_HEIGHT);
+
+struct yanesemu {
+    Core::Emulator emu;
+    std::string errors;
+
+    yanesemu()
+    {
+        emu.set_log([this](Util::Log::Level, std::string_view msg) { errors += msg; });
+    }
+};
+
+extern "C" {
+
+unsigned yanesemu_api_version(void)
+{
+    return YANESEMU_API_VERSION;
+}
+
+yanesemu *yanesemu_create(void)
+{
+    try {
+        return new yanesemu;
+    } catch (const std::bad_alloc &) {
+        return nullptr;
+    }
+}
+
+void yanesemu_destroy(yanesemu *emu)
+{
+    delete emu;
+}
+
+const char *yanesemu_last_error(const yanesemu *emu)
+{
+    return emu->errors.c_str();
+}
+
+int yanesemu_load_rom(yanesemu *emu, const void *data, size_t size)
+{
+    emu->errors.clear();
+    try {
+        return emu->emu.insert_rom({ static_cast<const uint8 *>(data), size });
+    } catch (const std::bad_alloc &) {
+        emu->errors += "out of memory\n";
+        return 0;
+    }
+}
+
+void yanesemu_power(yanesemu *emu)
+{
+    if (emu->emu.has_rom())
+        emu->emu.power();
+}
+
+void yanesemu_reset(yanesemu *emu)
+{
+    if (emu->emu.has_rom())
+        emu->emu.reset();
+}
+
+void yanesemu_run_frames(yanesemu *emu, unsigned frames)
+{
+    if (!emu->emu.has_rom())
+        return;
+    for (unsigned i = 0; i < frames; i++)
+        emu->emu.run_frame();
+}
+
+uint64_t yanesemu_frame_count(const yanesemu *emu)
+{
+    return emu->emu.frame_count();
+}
+
+void yanesemu_set_buttons(yanesemu *emu, unsigned port, uint8_t buttons)
+{
+    emu->emu.set_buttons(port, buttons);
+}
+
+const uint8_t *yanesemu_frame(const yanesemu *emu)
+{
+    return emu->emu.frame().data();
+}
+
+const uint8_t *yanesemu_memory(const yanesemu *emu, enum yanesemu_memory mem, size_t *size)
+{
+    std::span<const uint8> m;
+    switch (mem) {
+    case YANESEMU_CPU_RAM: m = emu->emu.cpu_ram();     break;
+    case YANESEMU_PRG_RAM: m = emu->emu.prg_ram();     break;
+    case YANESEMU_VRAM:    m = emu->emu.vram();        break;
+    case YANESEMU_OAM:     m = emu->emu.oam();         break;
+    case YANESEMU_PALETTE: m = emu->emu.palette_ram(); break;
+    case YANESEMU_CHR_RAM: m = emu->emu.chr_ram();     break;
+    }
+    if (size)
+        *size = m.size();
+    return m.data();
+}
+
+size_t yanesemu_state_size(const yanesemu *emu)
+{
+    return emu->emu.has_rom() ? emu->emu.state_size() : 0;
+}
+
+int yanesemu_save_state(const yanesemu *emu, void *buf, size_t size)
+{
+    return emu->emu.has_rom() && emu->emu.save_state(std::span<uint8>(static_cast<uint8 *>(buf), size));
+}
+
+int yanesemu_load_state(yanesemu *emu, const void *buf, size_t size)
+{
+    emu->errors.clear();
+    if (!emu->emu.has_rom()) {
+        emu->errors += "no ROM loaded\n";
+        return 0;
+    }
+    return emu->emu.load_state({ static_cast<const uint8 *>(buf), size });
+}
+
+} // extern "C"
@@ -0,0 +1,109 @@
+#ifndef YANESEMU_H_INCLUDED
+#define YANESEMU_H_INCLUDED
+
+/* libyanesemu: the emulator as a C library, for use from other languages.
+ *
+ *      yanesemu *emu = yanesemu_create();
+ *      if (!yanesemu_load_rom(emu, rom, rom_size))
+ *          fprintf(stderr, "%s", yanesemu_last_error(emu));
+ *      yanesemu_power(emu);
+ *      for (;;) {
+ *          yanesemu_set_buttons(emu, 0, YANESEMU_BUTTON_A);
+ *          yanesemu_run_frames(emu, 1);
+ *          const uint8_t *pixels = yanesemu_frame(emu);
+ *          ...
+ *      }
+ *      yanesemu_destroy(emu);
+ *
+ * Instances are independent: each one can be used on a thread of its own,
+ * but a single one isn't safe to use from two threads at once.
+ * Pointers returned into an instance (frame, memory) stay valid, and see every
+ * change, until the next yanesemu_load_rom() or yanesemu_destroy(). Nothing
+ * but creating, loading a ROM and errors allocates memory.
+ *
+ * The API only ever grows; YANESEMU_API_VERSION goes up when it does. */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define YANESEMU_API_VERSION 1
+
+#if defined(_WIN32) && defined(YANESEMU_BUILD)
+#  define YANESEMU_API __declspec(dllexport)
+#elif defined(__GNUC__)
+#  define YANESEMU_API __attribute__((visibility("default")))
+#else
+#  define YANESEMU_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct yanesemu yanesemu;
+
+enum yanesemu_button {
+    YANESEMU_BUTTON_A      = 1 << 0,
+    YANESEMU_BUTTON_B      = 1 << 1,
+    YANESEMU_BUTTON_SELECT = 1 << 2,
+    YANESEMU_BUTTON_START  = 1 << 3,
+    YANESEMU_BUTTON_UP     = 1 << 4,
+    YANESEMU_BUTTON_DOWN   = 1 << 5,
+    YANESEMU_BUTTON_LEFT   = 1 << 6,
+    YANESEMU_BUTTON_RIGHT  = 1 << 7,
+};
+
+enum yanesemu_memory {
+    YANESEMU_CPU_RAM,       /* 2k */
+    YANESEMU_PRG_RAM,       /* 8k, battery backed or not */
+    YANESEMU_VRAM,          /* 2k of nametables */
+    YANESEMU_OAM,           /* 256 bytes of sprites */
+    YANESEMU_PALETTE,       /* 32 bytes */
+    YANESEMU_CHR_RAM,       /* 0 bytes for cartridges with CHR ROM */
+};
+
+enum {
+    YANESEMU_WIDTH  = 256,
+    YANESEMU_HEIGHT = 240,
+};
+
+/* the YANESEMU_API_VERSION the library was built with */
+YANESEMU_API unsigned yanesemu_api_version(void);
+
+/* NULL if out of memory */
+YANESEMU_API yanesemu *yanesemu_create(void);
+YANESEMU_API void yanesemu_destroy(yanesemu *emu);
+/* errors and warnings since the last call that could fail; "" if none */
+YANESEMU_API const char *yanesemu_last_error(const yanesemu *emu);
+
+/* a ROM file's contents (iNES, NES 2.0, or a .gz or .zip of one), copied.
+ * Returns 0 on failure, and the ROM loaded before, if any, keeps running.
+ * Games aren't saved. Until a ROM is loaded, power, reset and running
+ * frames do nothing, there's no state (its size is 0) and the frame and
+ * memory are all zeroes. */
+YANESEMU_API int yanesemu_load_rom(yanesemu *emu, const void *data, size_t size);
+YANESEMU_API void yanesemu_power(yanesemu *emu);
+YANESEMU_API void yanesemu_reset(yanesemu *emu);
+
+YANESEMU_API void yanesemu_run_frames(yanesemu *emu, unsigned frames);
+YANESEMU_API uint64_t yanesemu_frame_count(const yanesemu *emu);
+/* port is 0 or 1, buttons a mask of yanesemu_button held from now on */
+YANESEMU_API void yanesemu_set_buttons(yanesemu *emu, unsigned port, uint8_t buttons);
+
+/* the last frame: YANESEMU_WIDTH * YANESEMU_HEIGHT palette indexes (0-63),
+ * rows top to bottom */
+YANESEMU_API const uint8_t *yanesemu_frame(const yanesemu *emu);
+/* a pointer to the memory, its size in *size */
+YANESEMU_API const uint8_t *yanesemu_memory(const yanesemu *emu, enum yanesemu_memory mem, size_t *size);
+
+/* states only load in the same version of the library, with the same ROM.
+ * Both return 0 on failure (size too small, or a bad state). */
+YANESEMU_API size_t yanesemu_state_size(const yanesemu *emu);
+YANESEMU_API int yanesemu_save_state(const yanesemu *emu, void *buf, size_t size);
+YANESEMU_API int yanesemu_load_state(yanesemu *emu, const void *buf, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,163 @@
+/* A C client of libyanesemu: checks that the calls made every frame don't
+ * allocate (where malloc can be counted, which is glibc without
+ * AddressSanitizer) and times each call, to see what going through the C API
+ * costs. Also checks that an instance without a ROM, or whose last load
+ * failed, can still be called.
+ * Runs the ROM given on the command line, or a tiny built-in one.
+ * Usage: capi_bench [ROM]. Exits with 1 on failure. */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <emu/yanesemu.h>
+
+#define N 200000
+
+static unsigned long allocations;
+
+#if defined(__GLIBC__) && !defined(__SANITIZE_ADDRESS__)
+extern void *__libc_malloc(size_t size);
+
+void *malloc(size_t size)
+{
+    allocations++;
+    return __libc_malloc(size);
+}
+#endif
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* 16k PRG, 8k CHR RAM, NROM: turn on nmi and loop */
+static unsigned char *builtin_rom(size_t *size)
+{
+    static const unsigned char program[] = {
+        0xA9, 0x80,             /* lda #$80 */
+        0x8D, 0x00, 0x20,       /* sta $2000 */
+        0xE6, 0x10,             /* inc $10 */
+        0x4C, 0x05, 0xC0,       /* jmp $C005 */
+        0x40,                   /* rti */
+    };
+    static const unsigned char vectors[] = { 0x0A, 0xC0, 0x00, 0xC0, 0x0A, 0xC0 };
+    unsigned char *rom = calloc(1, 16 + 0x4000);
+    memcpy(rom, "NES\x1A\x01", 5);
+    memcpy(rom + 16, program, sizeof(program));
+    memcpy(rom + 16 + 0x3FFA, vectors, sizeof(vectors));
+    *size = 16 + 0x4000;
+    return rom;
+}
+
+static unsigned char *read_file(const char *path, size_t *size)
+{
+    FILE *f = fopen(path, "rb");
+    unsigned char *data = NULL;
+    long n;
+    if (!f)
+        return NULL;
+    if (fseek(f, 0, SEEK_END) == 0 && (n = ftell(f)) > 0 && fseek(f, 0, SEEK_SET) == 0) {
+        data = malloc(n);
+        if (data && fread(data, 1, n, f) != (size_t) n) {
+            free(data);
+            data = NULL;
+        }
+        *size = n;
+    }
+    fclose(f);
+    return data;
+}
+
+#define TIME(what, n, call)                                                       \
+    do {                                                                          \
+        unsigned long before = allocations;                                       \
+        double start = now();                                                     \
+        for (long i = 0; i < (n); i++)                                            \
+            call;                                                                 \
+        double ns = (now() - start) * 1e9 / (n);                                  \
+        int allocates = allocations != before;                                    \
+        printf("%-24s %10.1f ns %s\n", what, ns, allocates ? "ALLOCATES" : "");   \
+        failures += allocates;                                                    \
+    } while (0)
+
+int main(int argc, char *argv[])
+{
+    int failures = 0;
+    size_t size = 0, memsize;
+    volatile const unsigned char *sink;
+    unsigned char *rom = argc > 1 ? read_file(argv[1], &size) : builtin_rom(&size);
+    yanesemu *emu = yanesemu_create();
+    if (!rom || !emu) {
+        printf("can't load ROM\n");
+        return 1;
+    }
+
+    /* nothing to run yet */
+    yanesemu_power(emu);
+    yanesemu_run_frames(emu, 2);
+    if (yanesemu_frame_count(emu) != 0 || yanesemu_state_size(emu) != 0 || yanesemu_save_state(emu, rom, size)
+     || yanesemu_load_state(emu, rom, size)) {
+        printf("FAIL: an instance without a ROM does nothing\n");
+        failures++;
+    }
+
+    if (!yanesemu_load_rom(emu, rom, size)) {
+        printf("can't load ROM: %s\n", yanesemu_last_error(emu));
+        return 1;
+    }
+    /* mapper 5 isn't supported: the ROM already loaded goes on */
+    unsigned char mapper = rom[6];
+    yanesemu_power(emu);
+    yanesemu_run_frames(emu, 2);
+    rom[6] = 0x50;
+    if (yanesemu_load_rom(emu, rom, size) || yanesemu_last_error(emu)[0] == '\0') {
+        printf("FAIL: an unsupported mapper gives an error\n");
+        failures++;
+    }
+    rom[6] = mapper;
+    yanesemu_run_frames(emu, 2);
+    if (yanesemu_frame_count(emu) != 4) {
+        printf("FAIL: a failed load keeps the ROM running\n");
+        failures++;
+    }
+    free(rom);
+    yanesemu_power(emu);
+    yanesemu_run_frames(emu, 60);
+    unsigned char *state = malloc(yanesemu_state_size(emu));
+    if (yanesemu_api_version() != YANESEMU_API_VERSION) {
+        printf("FAIL: built with API version %u\n", yanesemu_api_version());
+        failures++;
+    }
+
+    TIME("yanesemu_set_buttons", N, yanesemu_set_buttons(emu, 0, (uint8_t) i));
+    TIME("yanesemu_frame_count", N, sink = (const unsigned char *) (size_t) yanesemu_frame_count(emu));
+    TIME("yanesemu_frame", N, sink = yanesemu_frame(emu));
+    TIME("yanesemu_memory", N, sink = yanesemu_memory(emu, YANESEMU_CPU_RAM, &memsize));
+    TIME("yanesemu_save_state", N, yanesemu_save_state(emu, state, yanesemu_state_size(emu)));
+    TIME("yanesemu_load_state", N, yanesemu_load_state(emu, state, yanesemu_state_size(emu)));
+    TIME("yanesemu_run_frames(1)", 120, yanesemu_run_frames(emu, 1));
+
+    /* a state taken now must bring back this frame */
+    yanesemu_save_state(emu, state, yanesemu_state_size(emu));
+    unsigned long frames = yanesemu_frame_count(emu);
+    yanesemu_run_frames(emu, 10);
+    if (!yanesemu_load_state(emu, state, yanesemu_state_size(emu)) || yanesemu_frame_count(emu) != frames) {
+        printf("FAIL: loading a state\n");
+        failures++;
+    }
+    if (yanesemu_load_state(emu, state, 8) || yanesemu_last_error(emu)[0] == '\0') {
+        printf("FAIL: a bad state gives an error\n");
+        failures++;
+    }
+    (void) sink;
+    free(state);
+    yanesemu_destroy(emu);
+    if (failures == 0)
+        printf("all tests passed\n");
+    return failures != 0;
+}
@@ -0,0 +1,87 @@
+/* NES 2.0 ROM sizes: PRG and CHR ROM must be whole banks (8k and 1k) or the
+ * ROM is rejected, and CHR RAM of any size must end up as whole 1k pages,
+ * at least 8k, so that writes through $2007 all the way to $1FFF land inside
+ * it. Runs built-in ROMs. Exits with 1 on failure. */
+
+#include <algorithm>
+#include <iterator>
+#include <vector>
+#include <fmt/core.h>
+#include <emu/core/emulator.hpp>
+#include <tests/check.hpp>
+
+using namespace Core;
+
+// writes 0-31 through $2007 from PPU address $1FF0 on, then loops
+static const uint8 program[] = {
+    0xA9, 0x1F,             // lda #$1F
+    0x8D, 0x06, 0x20,       // sta $2006
+    0xA9, 0xF0,             // lda #$F0
+    0x8D, 0x06, 0x20,       // sta $2006
+    0xA2, 0x00,             // ldx #0
+    0x8A,                   // txa
+    0x8D, 0x07, 0x20,       // sta $2007
+    0xE8,                   // inx
+    0xE0, 0x20,             // cpx #$20
+    0xD0, 0xF7,             // bne $C00C
+    0x4C, 0x15, 0xC0,       // jmp $C015
+    0x40,                   // rti
+};
+
+/* A NES 2.0 NROM image. prg and chr are header bytes 4 and 5, sizes their
+ * high nibbles in byte 9, chrram byte 11. The file has prgsize bytes of
+ * PRG, with the program and vectors at the end of it, and chrsize of CHR. */
+static std::vector<uint8> nes20(uint8 prg, uint8 chr, uint8 sizes, uint8 chrram,
+                                std::size_t prgsize, std::size_t chrsize)
+{
+    std::vector<uint8> rom = { 'N', 'E', 'S', 0x1A, prg, chr, 0, 0x08, 0, sizes, 0, chrram, 0, 0, 0, 0 };
+    rom.resize(16 + prgsize + chrsize);
+    if (prgsize >= 0x4000) {
+        const std::size_t bank = 16 + prgsize - 0x4000;
+        std::copy(std::begin(program), std::end(program), rom.begin() + bank);
+        const uint8 vectors[] = { 0x18, 0xC0, 0x00, 0xC0, 0x18, 0xC0 };
+        std::copy(std::begin(vectors), std::end(vectors), rom.begin() + bank + 0x3FFA);
+    }
+    return rom;
+}
+
+static bool loads(const std::vector<uint8> &rom)
+{
+    Emulator emu;
+    emu.set_log([](Util::Log::Level, std::string_view) { });
+    return emu.insert_rom(rom);
+}
+
+int main()
+{
+    // 128 bytes of CHR RAM
+    Emulator emu;
+    check(emu.insert_rom(nes20(1, 0, 0, 0x01, 0x4000, 0)), "tiny CHR RAM loads");
+    check(emu.chr_ram().size() == 0x2000, "tiny CHR RAM is rounded up to 8k");
+    emu.power();
+    emu.run_frame();
+    emu.run_frame();
+    auto chr = emu.chr_ram();
+    bool written = true;
+    for (unsigned i = 0; i < 16; i++)
+        written = written && chr.size() == 0x2000 && chr[0x1FF0 + i] == i;
+    check(written, "writes up to $1FFF land in CHR RAM");
+    // and the rest went on to the nametables
+    check(emu.vram()[0] == 16 && emu.vram()[15] == 31, "writes past $1FFF go to the nametables");
+
+    // 8k of CHR RAM and 128 bytes battery backed: whole pages
+    Emulator emu2;
+    check(emu2.insert_rom(nes20(1, 0, 0, 0x17, 0x4000, 0)), "odd CHR RAM loads");
+    check(emu2.chr_ram().size() == 0x2400, "odd CHR RAM is rounded up to a whole page");
+
+    // exponent sizes, 2^E * (MM*2+1): E is the top 6 bits, MM the bottom 2
+    check(!loads(nes20(12 << 2, 0, 0x0F, 0, 0x1000, 0)), "4k of PRG is rejected");
+    check(!loads(nes20(1, 9 << 2, 0xF0, 0, 0x4000, 0x200)), "512 bytes of CHR is rejected");
+    check(loads(nes20(1, 10 << 2 | 1, 0xF0, 0, 0x4000, 0xC00)), "3k of CHR is whole pages");
+    check(loads(nes20(14 << 2, 0, 0x0F, 0, 0x4000, 0)), "16k of PRG as an exponent loads");
+    check(loads(nes20(13 << 2 | 1, 0, 0x0F, 0, 0x6000, 0)), "24k of PRG loads");
+
+    if (failures == 0)
+        fmt::print("all tests passed\n");
+    return failures != 0;
+}
@@ -0,0 +1,20 @@
+#ifndef TESTS_CHECK_HPP_INCLUDED
+#define TESTS_CHECK_HPP_INCLUDED
+
+/* How the tests report: check() prints what failed and counts it, and main()
+ * ends with "all tests passed" when nothing did, returning failures != 0. */
+
+#include <string_view>
+#include <fmt/core.h>
+
+inline int failures = 0;
+
+inline void check(bool cond, std::string_view what)
+{
+    if (!cond) {
+        fmt::print("FAIL: {}\n", what);
+        failures++;
+    }
+}
+
+#endif
@@ -0,0 +1,73 @@
+/* Times cloning an emulator and copying one's state into another, which
+ * should both be about the cost of copying the state block. Also checks
+ * that a clone runs the same frames as the original.
+ * Runs the ROM given on the command line, or a tiny built-in one. */
+
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <fmt/core.h>
+#include <emu/core/emulator.hpp>
+#include <emu/util/file.hpp>
+#include <tests/testrom.hpp>
+
+using namespace Core;
+
+static const int N = 20000;
+
+// NROM: turn on nmi and loop
+static const unsigned char program[] = {
+    0xA9, 0x80,             // lda #$80
+    0x8D, 0x00, 0x20,       // sta $2000
+    0xE6, 0x10,             // inc $10
+    0x4C, 0x05, 0xC0,       // jmp $C005
+    0x40,                   // rti
+};
+
+template <typename F>
+static void bench(const char *what, F &&fn)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < N; i++)
+        fn();
+    std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+    fmt::print("{:>12}  {:8.3f} us\n", what, elapsed.count() / N);
+}
+
+int main(int argc, char *argv[])
+{
+    Util::File romfile;
+    if (argc > 1)
+        romfile.open(argv[1], Util::File::Mode::READ);
+    else
+        romfile.assoc(test_rom_file(test_rom(program, { .nmi = 0xC00A, .reset = 0xC000, .irq = 0xC00A })));
+    Emulator emu;
+    if (!emu.insert_rom(romfile)) {
+        fmt::print("can't load ROM\n");
+        return 1;
+    }
+    emu.power();
+    for (int i = 0; i < 60; i++)
+        emu.run_frame();
+
+    auto copy = emu.clone();
+    if (!copy) {
+        fmt::print("can't clone\n");
+        return 1;
+    }
+    for (int i = 0; i < 30; i++) {
+        emu.run_frame();
+        copy->run_frame();
+    }
+    if (!(emu.frame_hash() == copy->frame_hash())) {
+        fmt::print("FAIL: the clone runs different frames\n");
+        return 1;
+    }
+
+    fmt::print("state size {} bytes\n", emu.state_size());
+    bench("clone()", [&] { copy = emu.clone(); });
+    bench("copy_state()", [&] { copy->copy_state(emu); });
+    std::vector<uint8> buf;
+    bench("save_state()", [&] { emu.save_state(buf); });
+    bench("load_state()", [&] { copy->load_state(buf); });
+}
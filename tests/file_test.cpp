@@ -0,0 +1,210 @@
+/* Util::BufferedFile: random writes and reads, with write() and writev(),
+ * read() and readv(), pieces smaller and larger than the buffer, and every
+ * flag, must give back exactly what went in, with tell() and size() right
+ * after every call. The sizes aren't multiples of ALIGN, so with DIRECT the
+ * last block goes out through drain() at close. Lines longer than the
+ * buffer must come back whole from getline(), and APPEND must go on from
+ * the end. Everything runs twice: the second time readv() and writev() are
+ * replaced with ones that move only a few hundred bytes per call, so that
+ * writev_all() goes on after partial writes and readv() stops anywhere in
+ * the user's buffers or the refill buffer. Exits with 1 on failure. */
+
+#include <filesystem>
+#include <span>
+#include <string>
+#include <vector>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <fmt/core.h>
+#include <emu/util/easyrandom.hpp>
+#include <emu/util/file.hpp>
+#include <tests/check.hpp>
+
+using Bytes = std::vector<unsigned char>;
+using Util::BufferedFile;
+
+// when not 0, readv() and writev() move at most this many bytes per call.
+// O_DIRECT transfers are left whole, since they must stay aligned.
+static std::size_t short_io = 0;
+static unsigned short_calls = 0;
+
+static int shorten(int fd, const iovec *v, int n, std::vector<iovec> &out)
+{
+    if (short_io == 0 || (fcntl(fd, F_GETFL) & O_DIRECT))
+        return -1;
+    std::size_t limit = 1 + short_calls++ * 7919 % short_io;
+    out.clear();
+    for (int i = 0; i < n && limit > 0; i++) {
+        out.push_back({ v[i].iov_base, std::min(v[i].iov_len, limit) });
+        limit -= out.back().iov_len;
+    }
+    return out.size();
+}
+
+extern "C" ssize_t readv(int fd, const iovec *v, int n)
+{
+    std::vector<iovec> cut;
+    if (int k = shorten(fd, v, n, cut); k >= 0)
+        return syscall(SYS_readv, fd, cut.data(), k);
+    return syscall(SYS_readv, fd, v, n);
+}
+
+extern "C" ssize_t writev(int fd, const iovec *v, int n)
+{
+    std::vector<iovec> cut;
+    if (int k = shorten(fd, v, n, cut); k >= 0)
+        return syscall(SYS_writev, fd, cut.data(), k);
+    return syscall(SYS_writev, fd, v, n);
+}
+
+// mostly small, sometimes around the buffer's size or a few times over it
+static std::size_t piece(Util::Random &rng, std::size_t bufsize)
+{
+    switch (rng.random_between(0, 3)) {
+    case 0:  return rng.random_between(0, 16);
+    case 1:  return rng.random_between(0, 5000);
+    case 2:  return rng.random_between(bufsize - 100, bufsize + 100);
+    default: return rng.random_between(0, 3 * bufsize);
+    }
+}
+
+static Bytes contents(const std::string &path)
+{
+    Util::File f(path, Util::File::Mode::READ);
+    Bytes out;
+    unsigned char tmp[64 * 1024];
+    while (std::size_t n = f.bread(tmp, sizeof(tmp)))
+        out.insert(out.end(), tmp, tmp + n);
+    return out;
+}
+
+static void write_file(const std::string &path, BufferedFile::Mode mode, unsigned flags, std::size_t bufsize,
+                       std::span<const unsigned char> data, Util::Random &rng, const std::string &what)
+{
+    BufferedFile f(path, mode, flags, bufsize);
+    check(bool(f), what + ": opens for writing");
+    const std::uint64_t start = f.size();
+    check(f.tell() == start, what + ": starts at the end");
+    bool ok = true, tells = true;
+    for (std::size_t pos = 0; pos < data.size(); ) {
+        std::vector<std::span<const unsigned char>> bufs;
+        for (int n = rng.random_between(1, 4); n > 0; n--) {
+            const std::size_t k = std::min(piece(rng, bufsize), data.size() - pos);
+            bufs.push_back(data.subspan(pos, k));
+            pos += k;
+        }
+        ok = ok && (bufs.size() == 1 ? f.write(bufs[0].data(), bufs[0].size()) : f.writev(bufs));
+        if (rng.random_between(0, 15) == 0)
+            ok = ok && f.flush();
+        tells = tells && f.tell() == start + pos && f.size() == start + pos;
+    }
+    ok = f.close() && ok;
+    check(ok, what + ": writes");
+    check(tells, what + ": tell() and size() follow the writes");
+}
+
+static void read_file(const std::string &path, unsigned flags, std::size_t bufsize,
+                      std::span<const unsigned char> data, Util::Random &rng, const std::string &what)
+{
+    BufferedFile f(path, BufferedFile::Mode::READ, flags, bufsize);
+    check(bool(f) && f.size() == data.size(), what + ": opens for reading");
+    Bytes got;
+    bool tells = true;
+    for (;;) {
+        std::vector<Bytes> pieces(rng.random_between(1, 4));
+        std::vector<std::span<unsigned char>> bufs;
+        std::size_t asked = 0;
+        for (auto &p : pieces) {
+            p.resize(piece(rng, bufsize));
+            bufs.push_back(p);
+            asked += p.size();
+        }
+        const std::size_t n = bufs.size() == 1 ? f.read(bufs[0].data(), bufs[0].size()) : f.readv(bufs);
+        for (std::size_t i = 0, left = n; i < pieces.size() && left > 0; i++) {
+            const std::size_t k = std::min(left, pieces[i].size());
+            got.insert(got.end(), pieces[i].begin(), pieces[i].begin() + k);
+            left -= k;
+        }
+        tells = tells && f.tell() == got.size();
+        if (n < asked)
+            break;
+    }
+    check(got == Bytes(data.begin(), data.end()), what + ": reads back the same bytes");
+    check(tells, what + ": tell() follows the reads");
+    check(!f.error(), what + ": no read errors");
+}
+
+static void test_lines(const std::string &path, unsigned flags, std::size_t bufsize, Util::Random &rng,
+                       const std::string &what)
+{
+    std::vector<std::string> lines;
+    std::string text;
+    for (unsigned i = 0; i < 200; i++) {
+        lines.emplace_back(piece(rng, bufsize) % (2 * bufsize + 50), char('a' + i % 26));
+        text += lines.back();
+        text += '\n';
+    }
+    // the last line has no newline
+    lines.emplace_back(bufsize + 1, 'z');
+    text += lines.back();
+    write_file(path, BufferedFile::Mode::WRITE, flags, bufsize,
+               { reinterpret_cast<const unsigned char *>(text.data()), text.size() }, rng, what + ", lines");
+
+    BufferedFile f(path, BufferedFile::Mode::READ, flags, bufsize);
+    std::vector<std::string> got;
+    std::string line;
+    while (f.getline(line))
+        got.push_back(line);
+    check(got == lines, what + ": getline() gives every line");
+    check(f.tell() == text.size(), what + ": getline() reaches the end");
+}
+
+int main()
+{
+    const std::string path = (std::filesystem::temp_directory_path() / fmt::format("file_test.{}", getpid())).string();
+    if (int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_DIRECT, 0644); fd >= 0)
+        ::close(fd);
+    else
+        fmt::print("no O_DIRECT in {}, DIRECT is plain I/O\n", path);
+
+    Util::Random rng(1);
+    Bytes data(700 * 1000 + 1234);
+    rng.fill(data);
+
+    const char *flag_names[] = { "no flags", "DIRECT", "NOCACHE", "DIRECT|NOCACHE" };
+    for (std::size_t limit : { 0u, 600u }) {
+        short_io = limit;
+        for (unsigned flags : { 0u, 1u, 2u, 3u }) {
+            for (std::size_t bufsize : { 4096u, 64u * 1024 }) {
+                const std::string what = fmt::format("{}, {}k buffer{}", flag_names[flags], bufsize / 1024,
+                                                     limit ? ", short I/O" : "");
+                write_file(path, BufferedFile::Mode::WRITE, flags, bufsize, data, rng, what);
+                check(contents(path) == data, what + ": the file has what was written");
+                read_file(path, flags, bufsize, data, rng, what);
+
+                // less than a block, for DIRECT
+                const auto small = std::span(data).first(1000);
+                write_file(path, BufferedFile::Mode::WRITE, flags, bufsize, small, rng, what + ", small");
+                check(contents(path) == Bytes(small.begin(), small.end()), what + ", small: the file has it");
+                read_file(path, flags, bufsize, small, rng, what + ", small");
+
+                const auto half = std::span(data).first(data.size() / 2);
+                write_file(path, BufferedFile::Mode::WRITE, flags, bufsize, half, rng, what + ", half");
+                write_file(path, BufferedFile::Mode::APPEND, flags, bufsize, std::span(data).subspan(half.size()),
+                           rng, what + ", append");
+                check(contents(path) == data, what + ", append: the file has both halves");
+
+                test_lines(path, flags, bufsize, rng, what);
+            }
+        }
+    }
+    check(short_calls > 1000, "short I/O happened");
+    std::filesystem::remove(path);
+
+    if (failures == 0)
+        fmt::print("all tests passed\n");
+    return failures != 0;
+}
@@ -0,0 +1,56 @@
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <fmt/core.h>
+#include <emu/video/filter.hpp>
+#include <emu/util/threadpool.hpp>
+
+static const std::size_t WIDTH  = 256;
+static const std::size_t HEIGHT = 240;
+static const int FRAMES = 200;
+
+// a frame made of 8x8 tiles with a handful of colors, roughly what the ppu outputs.
+static std::vector<uint32_t> make_frame()
+{
+    static const uint32_t colors[] = { 0xFF000000, 0xFFFCFCFC, 0xFF2038EC, 0xFF0058F8, 0xFF00A800 };
+    std::vector<uint32_t> frame(WIDTH * HEIGHT);
+    uint32_t state = 1;
+    for (std::size_t ty = 0; ty < HEIGHT/8; ty++) {
+        for (std::size_t tx = 0; tx < WIDTH/8; tx++) {
+            state = state * 1103515245 + 12345;
+            for (std::size_t y = 0; y < 8; y++)
+                for (std::size_t x = 0; x < 8; x++)
+                    frame[(ty*8 + y) * WIDTH + tx*8 + x] = colors[(state >> (x + y) % 16) % 5];
+        }
+    }
+    return frame;
+}
+
+static void bench(Video::Filter filter, unsigned factor, const std::vector<uint32_t> &src,
+                  Util::ThreadPool *pool)
+{
+    std::vector<uint32_t> dst(WIDTH*factor * HEIGHT*factor);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < FRAMES; i++)
+        Video::apply_filter(filter, factor, src.data(), WIDTH, HEIGHT, dst.data(), pool);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    double per_frame = elapsed.count() / FRAMES;
+    fmt::print("{:>8}{}x  {:>2} threads  {:8.3f} ms/frame  {:8.1f} Mpixel/s out\n",
+               Video::filter_name(filter), factor, pool ? pool->size() : 1,
+               per_frame * 1000.0, WIDTH*factor * HEIGHT*factor / per_frame / 1e6);
+}
+
+int main()
+{
+    auto frame = make_frame();
+    Util::ThreadPool pool { std::max(std::thread::hardware_concurrency(), 1u) };
+    for (auto filter : { Video::Filter::NEAREST, Video::Filter::SCALE, Video::Filter::BLEND }) {
+        for (unsigned factor : { 2, 3, 4 }) {
+            if (!Video::filter_supported(filter, factor))
+                continue;
+            bench(filter, factor, frame, nullptr);
+            if (pool.size() > 1)
+                bench(filter, factor, frame, &pool);
+        }
+    }
+}
@@ -0,0 +1,97 @@
+/* Forks: children of a running emulator must run the same frames as it
+ * does, and not see each other's writes. Times forking 1000 of them and
+ * reports the memory they take, before and after running a frame each
+ * (only the pages they touch should count).
+ * Usage: fork_bench ROM [forks]. Exits with 1 on failure. */
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <fmt/core.h>
+#include <emu/core/emulator.hpp>
+#include <emu/util/file.hpp>
+#include <tests/check.hpp>
+
+using namespace Core;
+
+// resident memory of the process, 0 where there's no /proc
+static long resident()
+{
+    long pages = 0, rss = 0;
+    if (std::FILE *f = std::fopen("/proc/self/statm", "r")) {
+        if (std::fscanf(f, "%ld %ld", &pages, &rss) != 2)
+            rss = 0;
+        std::fclose(f);
+    }
+    return rss * sysconf(_SC_PAGESIZE);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        fmt::print("usage: {} ROM [forks]\n", argv[0]);
+        return 1;
+    }
+    const unsigned n = argc > 2 ? std::stoul(argv[2]) : 1000;
+    Util::File romfile(argv[1], Util::File::Mode::READ);
+    Emulator emu;
+    if (!emu.insert_rom(romfile)) {
+        fmt::print("can't load ROM\n");
+        return 1;
+    }
+    emu.power();
+    for (int i = 0; i < 120; i++)
+        emu.run_frame();
+    std::vector<uint8> at_fork;
+    emu.save_state(at_fork);
+
+    // warm up the allocator, so that it's not what gets timed
+    emu.fork(n);
+    const long before = resident();
+    const auto start = std::chrono::steady_clock::now();
+    auto forks = emu.fork(n);
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    const long forked = resident();
+    if (forks.size() != n) {
+        fmt::print("FAIL: can't fork\n");
+        return 1;
+    }
+    fmt::print("{} forks in {:.2f} ms: {:.0f} forks/s, state {} bytes\n",
+               n, elapsed.count() * 1000, n / elapsed.count(), emu.state_size());
+
+    std::vector<uint8> state;
+    forks[1]->save_state(state);
+    check(state == at_fork, "a fork starts with the parent's state");
+
+    for (auto &f : forks)
+        f->run_frame();
+    const long ran = resident();
+    emu.run_frame();
+    std::vector<uint8> one_frame;
+    emu.save_state(one_frame);
+    if (before != 0)
+        fmt::print("bytes per fork: {} after forking, {} after running a frame\n",
+                   (forked - before) / long(n), (ran - before) / long(n));
+
+    // the parent and a fork go on the same way, the others stay put
+    std::vector<uint8> expected;
+    for (int i = 0; i < 60; i++) {
+        emu.run_frame();
+        forks[0]->run_frame();
+    }
+    check(emu.frame_hash() == forks[0]->frame_hash(), "a fork runs the same frames as the parent");
+    emu.save_state(expected);
+    forks[0]->save_state(state);
+    check(state == expected, "a fork ends up with the same state as the parent");
+    forks[n-1]->save_state(state);
+    check(state == one_frame, "forks don't see each other's writes");
+    auto second = forks[n-1]->fork(1);
+    check(second.size() == 1 && (second[0]->save_state(expected), expected == state), "forks can be forked");
+
+    if (failures == 0)
+        fmt::print("all tests passed\n");
+    return failures != 0;
+}
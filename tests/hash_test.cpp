@@ -0,0 +1,82 @@
+/* Util::xxh64 and Util::crc32 against published values: the XXH64 vectors
+ * from xxhsum's sanity check and the usual CRC-32 check values, at lengths
+ * that aren't a multiple of 8 or 32 so that every tail path runs. Then the
+ * same bytes must hash the same at any alignment, and a CRC continued over
+ * two pieces must equal the CRC of the whole. Exits with 1 on failure. */
+
+#include <cstring>
+#include <string_view>
+#include <vector>
+#include <fmt/core.h>
+#include <emu/util/hash.hpp>
+#include <tests/check.hpp>
+
+// xxhsum's sanity buffer
+static std::vector<unsigned char> sanity_buffer(std::size_t len)
+{
+    std::vector<unsigned char> buf(len);
+    uint64 gen = 2654435761u;
+    for (auto &b : buf) {
+        b = gen >> 56;
+        gen *= 11400714785074694797u;
+    }
+    return buf;
+}
+
+int main()
+{
+    const uint64 prime32 = 2654435761u;
+    const auto buf = sanity_buffer(2367);
+
+    struct { std::size_t len; uint64 seed, hash; } xxh_vectors[] = {
+        {   0, 0,       0xEF46DB3751D8E999 },
+        {   0, prime32, 0xAC75FDA2929B17EF },
+        {   1, 0,       0xE934A84ADB052768 },
+        {   1, prime32, 0x5014607643A9B4C3 },
+        {  14, 0,       0x8282DCC4994E35C8 },
+        {  14, prime32, 0xC3BD6BF63DEB6DF0 },
+        { 222, 0,       0xB641AE8CB691C174 },
+        { 222, prime32, 0x20CB8AB7AE10C14A },
+    };
+    for (auto v : xxh_vectors)
+        check(Util::xxh64(buf.data(), v.len, v.seed) == v.hash,
+              fmt::format("xxh64 of {} bytes, seed {:#x}", v.len, v.seed));
+    check(Util::xxh64("a", 1) == 0xD24EC4F1A98C6E5B, "xxh64(\"a\")");
+    check(Util::xxh64("abc", 3) == 0x44BC2CF5AD770999, "xxh64(\"abc\")");
+
+    struct { std::size_t len; uint32 crc; } crc_vectors[] = {
+        { 0, 0 }, { 1, 0xD202EF8D }, { 14, 0xD3BFF2E7 }, { 222, 0x7092EB16 }, { 2367, 0x41F39444 },
+    };
+    for (auto v : crc_vectors)
+        check(Util::crc32(buf.data(), v.len) == v.crc, fmt::format("crc32 of {} bytes", v.len));
+    check(Util::crc32("123456789", 9) == 0xCBF43926, "crc32 check value");
+    check(Util::crc32("a", 1) == 0xE8B7BE43, "crc32(\"a\")");
+    const std::string_view fox = "The quick brown fox jumps over the lazy dog";
+    check(Util::crc32(fox.data(), fox.size()) == 0x414FA339, "crc32 of the quick brown fox");
+
+    // copies at every offset within 8 bytes
+    bool aligned_xxh = true, aligned_crc = true;
+    std::vector<unsigned char> copy(300 + 8);
+    for (std::size_t len = 0; len < 300; len++) {
+        const uint64 hash = Util::xxh64(buf.data(), len, 7);
+        const uint32 crc = Util::crc32(buf.data(), len);
+        for (std::size_t off = 1; off < 8; off++) {
+            std::memcpy(copy.data() + off, buf.data(), len);
+            aligned_xxh = aligned_xxh && Util::xxh64(copy.data() + off, len, 7) == hash;
+            aligned_crc = aligned_crc && Util::crc32(copy.data() + off, len) == crc;
+        }
+    }
+    check(aligned_xxh, "xxh64 doesn't depend on alignment");
+    check(aligned_crc, "crc32 doesn't depend on alignment");
+
+    bool continued = true;
+    const uint32 whole = Util::crc32(buf.data(), 222);
+    for (std::size_t split = 0; split <= 222; split++)
+        continued = continued
+                 && Util::crc32(buf.data() + split, 222 - split, Util::crc32(buf.data(), split)) == whole;
+    check(continued, "crc32 continues over pieces");
+
+    if (failures == 0)
+        fmt::print("all tests passed\n");
+    return failures != 0;
+}
@@ -0,0 +1,353 @@
+/* The deflate decoder and its containers, against streams made by zlib
+ * (through Python's zlib, gzip and zipfile modules): stored, fixed and
+ * dynamic blocks, matches overlapping their own output and a full flush
+ * in the middle must all give the original data back. Truncated and
+ * corrupted streams, bad CRCs and bad block headers must fail without
+ * reading or writing out of bounds (run it under ASan for that). Zip files
+ * must be found with a comment after the directory.
+ * Exits with 1 on failure. */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <fmt/core.h>
+#include <emu/util/file.hpp>
+#include <emu/util/inflate.hpp>
+#include <tests/check.hpp>
+
+using Bytes = std::vector<unsigned char>;
+
+/* the data the streams below were made from: random words, which the same
+ * generator in Python also made. */
+static Bytes text(std::size_t n, uint32_t seed)
+{
+    static const char *words[] = { "mario ", "link ", "samus ", "zelda ", "the ", "of ", "a ", "castle\n" };
+    Bytes out;
+    uint32_t x = seed;
+    while (out.size() < n) {
+        x = x * 1103515245 + 12345;
+        const char *w = words[x >> 16 & 7];
+        out.insert(out.end(), w, w + std::strlen(w));
+    }
+    out.resize(n);
+    return out;
+}
+
+// raw deflate: text(200, 1) at level 0
+static const unsigned char stored[] = {
+    0x01, 0xC8, 0x00, 0x37, 0xFF, 0x61, 0x20, 0x61, 0x20, 0x6C, 0x69, 0x6E, 0x6B, 0x20, 0x7A, 0x65,
+    0x6C, 0x64, 0x61, 0x20, 0x7A, 0x65, 0x6C, 0x64, 0x61, 0x20, 0x7A, 0x65, 0x6C, 0x64, 0x61, 0x20,
+    0x73, 0x61, 0x6D, 0x75, 0x73, 0x20, 0x7A, 0x65, 0x6C, 0x64, 0x61, 0x20, 0x74, 0x68, 0x65, 0x20,
+    0x61, 0x20, 0x6F, 0x66, 0x20, 0x63, 0x61, 0x73, 0x74, 0x6C, 0x65, 0x0A, 0x74, 0x68, 0x65, 0x20,
+    0x74, 0x68, 0x65, 0x20, 0x6C, 0x69, 0x6E, 0x6B, 0x20, 0x63, 0x61, 0x73, 0x74, 0x6C, 0x65, 0x0A,
+    0x6C, 0x69, 0x6E, 0x6B, 0x20, 0x63, 0x61, 0x73, 0x74, 0x6C, 0x65, 0x0A, 0x6C, 0x69, 0x6E, 0x6B,
+    0x20, 0x61, 0x20, 0x61, 0x20, 0x73, 0x61, 0x6D, 0x75, 0x73, 0x20, 0x63, 0x61, 0x73, 0x74, 0x6C,
+    0x65, 0x0A, 0x63, 0x61, 0x73, 0x74, 0x6C, 0x65, 0x0A, 0x63, 0x61, 0x73, 0x74, 0x6C, 0x65, 0x0A,
+    0x61, 0x20, 0x63, 0x61, 0x73, 0x74, 0x6C, 0x65, 0x0A, 0x6C, 0x69, 0x6E, 0x6B, 0x20, 0x73, 0x61,
+    0x6D, 0x75, 0x73, 0x20, 0x6D, 0x61, 0x72, 0x69, 0x6F, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6C, 0x69,
+    0x6E, 0x6B, 0x20, 0x73, 0x61, 0x6D, 0x75, 0x73, 0x20, 0x61, 0x20, 0x7A, 0x65, 0x6C, 0x64, 0x61,
+    0x20, 0x7A, 0x65, 0x6C, 0x64, 0x61, 0x20, 0x73, 0x61, 0x6D, 0x75, 0x73, 0x20, 0x6F, 0x66, 0x20,
+    0x6C, 0x69, 0x6E, 0x6B, 0x20, 0x6D, 0x61, 0x72, 0x69, 0x6F, 0x20, 0x74, 0x68,
+};
+
+// text(600, 2) with Z_FIXED
+static const unsigned char fixed[] = {
+    0x2B, 0xC9, 0x48, 0x55, 0xC8, 0xC9, 0xCC, 0xCB, 0x56, 0x48, 0x4E, 0x2C, 0x2E, 0xC9, 0x49, 0xE5,
+    0x2A, 0x4E, 0xCC, 0x2D, 0x2D, 0x56, 0xC8, 0x4F, 0x83, 0xF1, 0x73, 0x13, 0x8B, 0x32, 0xF3, 0x21,
+    0x2A, 0x12, 0x15, 0xAA, 0x52, 0x73, 0x52, 0x12, 0x41, 0x92, 0x10, 0x46, 0x09, 0x50, 0x2F, 0x84,
+    0x85, 0xCE, 0x07, 0x41, 0xA8, 0x01, 0x20, 0x41, 0xA0, 0x8E, 0x44, 0x05, 0x88, 0x49, 0x40, 0x26,
+    0x84, 0x81, 0x6E, 0x11, 0x3A, 0x1F, 0xD9, 0x38, 0x74, 0x8B, 0x20, 0x6A, 0x21, 0x24, 0x92, 0x03,
+    0xC1, 0x04, 0x48, 0x2D, 0x44, 0x0C, 0xA2, 0x16, 0x2E, 0x88, 0x30, 0x1A, 0xC8, 0x02, 0x09, 0xA0,
+    0xDB, 0x00, 0x95, 0x45, 0xF1, 0x38, 0x44, 0x16, 0x2A, 0x04, 0x36, 0x0A, 0xEC, 0x17, 0x14, 0x37,
+    0x97, 0xA0, 0x05, 0x21, 0xC2, 0x05, 0x60, 0x51, 0x08, 0x13, 0xD5, 0x70, 0xA0, 0x21, 0x48, 0x72,
+    0x48, 0x4C, 0x88, 0x7D, 0xF0, 0xA0, 0x82, 0x2A, 0x87, 0x87, 0x3B, 0x72, 0xD0, 0x41, 0x48, 0xB8,
+    0x14, 0x42, 0x35, 0xD8, 0x38, 0x0C, 0x6F, 0x21, 0x85, 0x06, 0xB2, 0x29, 0xE8, 0xF1, 0x07, 0xF6,
+    0x1E, 0x34, 0xBA, 0x13, 0x51, 0x1C, 0x85, 0x3B, 0x90, 0x90, 0x23, 0x02, 0xAA, 0x39, 0x19, 0x00,
+};
+
+// text(2000, 3) at level 9
+static const unsigned char dynamic[] = {
+    0x75, 0x95, 0xDB, 0x4E, 0xC3, 0x30, 0x0C, 0x86, 0xEF, 0x79, 0x8A, 0xBE, 0x9A, 0x05, 0x45, 0x4C,
+    0x74, 0x4C, 0xA2, 0xE3, 0xA6, 0x4F, 0x0F, 0x8D, 0x4F, 0x9F, 0x1D, 0xAA, 0x69, 0x99, 0x13, 0x3B,
+    0x3E, 0xFC, 0xF9, 0xED, 0x1D, 0xEB, 0xF6, 0x26, 0xCB, 0x31, 0xD6, 0xC7, 0xFB, 0x72, 0x97, 0xEF,
+    0xDB, 0x63, 0x91, 0xE5, 0xF9, 0xB1, 0x9E, 0xDB, 0x57, 0xD9, 0x9F, 0xDB, 0xFA, 0xA2, 0xA7, 0xB6,
+    0xF9, 0x3B, 0x1E, 0xA6, 0xDB, 0xED, 0xEB, 0x33, 0xAF, 0x9C, 0x17, 0xCE, 0xAF, 0x7A, 0xD2, 0x33,
+    0xCA, 0xA7, 0x2E, 0xA5, 0x5D, 0xEE, 0x3F, 0xFB, 0x90, 0xDC, 0xCB, 0x29, 0x67, 0x00, 0xD5, 0xEB,
+    0xAA, 0x5E, 0x3C, 0xC7, 0x61, 0xAF, 0xA2, 0xE5, 0x68, 0x97, 0x87, 0x22, 0x17, 0x55, 0x98, 0xC7,
+    0xD0, 0x6B, 0x06, 0x8C, 0xC9, 0x1C, 0xE7, 0x32, 0xBD, 0x2A, 0xB7, 0xD0, 0x8C, 0x1C, 0x24, 0xF7,
+    0x73, 0x00, 0x43, 0x29, 0x36, 0x7A, 0x37, 0xE1, 0x92, 0x52, 0xD9, 0xA9, 0xB1, 0x68, 0xAD, 0xAC,
+    0xB1, 0x75, 0x23, 0x75, 0x92, 0xC9, 0xA6, 0xC4, 0x50, 0xB8, 0xC2, 0x7C, 0x0C, 0x24, 0x16, 0x38,
+    0x83, 0x0B, 0xF0, 0xCD, 0x9E, 0xB0, 0x10, 0x60, 0xBD, 0xA5, 0xE0, 0x06, 0x69, 0x86, 0xC6, 0xEE,
+    0xF7, 0x37, 0x0F, 0x23, 0x15, 0x12, 0xDC, 0xCE, 0xAE, 0x84, 0x1A, 0x0F, 0x6D, 0x16, 0xCC, 0xD5,
+    0x51, 0x31, 0x55, 0x09, 0x5B, 0xD8, 0xD8, 0xD9, 0x06, 0xB4, 0xF5, 0xA0, 0x6C, 0x00, 0xC1, 0x25,
+    0x25, 0xFC, 0xBD, 0x81, 0x84, 0xBB, 0x4E, 0xE2, 0xD1, 0xB6, 0xE0, 0xE7, 0xAC, 0x31, 0x03, 0x41,
+    0x6A, 0xAD, 0xA6, 0xD6, 0x00, 0xEC, 0xC9, 0x2C, 0x2A, 0x20, 0x55, 0x23, 0xA3, 0x57, 0x20, 0x40,
+    0x0E, 0xD0, 0x0D, 0xE5, 0xC2, 0x63, 0x62, 0x9F, 0x51, 0x2A, 0xCA, 0x99, 0x41, 0x41, 0x90, 0x51,
+    0x92, 0x50, 0x33, 0x17, 0x81, 0x5B, 0x10, 0xCA, 0xBB, 0xC6, 0x4A, 0x92, 0xF1, 0x61, 0x09, 0x00,
+    0x52, 0x8A, 0xB7, 0xDA, 0x6F, 0xEC, 0x52, 0xF3, 0x05, 0xFF, 0x70, 0x02, 0xB8, 0xCA, 0xE3, 0xF6,
+    0xF4, 0x03, 0x94, 0x96, 0x6A, 0xE1, 0x31, 0x23, 0xC5, 0xBB, 0x7A, 0xB2, 0x05, 0xA3, 0xFA, 0x13,
+    0x2F, 0x1C, 0xC2, 0xC5, 0xD3, 0xB5, 0xD6, 0x95, 0xEB, 0xDE, 0xAE, 0x63, 0xB2, 0x31, 0xAA, 0xB7,
+    0x98, 0xB1, 0x85, 0x9C, 0xAA, 0xC3, 0x16, 0x28, 0x39, 0xEB, 0x71, 0xD4, 0x7B, 0xB7, 0xBA, 0xC7,
+    0xFC, 0x8D, 0x06, 0x68, 0x63, 0x20, 0xF3, 0x67, 0xF0, 0xFF, 0x09, 0xC7, 0x56, 0xC0, 0x71, 0xC0,
+    0x8D, 0x17, 0xAE, 0xFF, 0x23, 0x57, 0x94, 0xAC, 0x21, 0xFA, 0xB8, 0x66, 0x45, 0x83, 0x90, 0xAD,
+    0x06, 0xE2, 0x3B, 0x0D, 0x0D, 0xE4, 0x02, 0x5D, 0x09, 0x2B, 0xFE, 0x87, 0x20, 0xD3, 0x38, 0xAF,
+    0x33, 0x63, 0x1E, 0x3D, 0xB9, 0x04, 0xCC, 0x53, 0x11, 0xBF,
+};
+
+// 300 a, 150 ab, 100 abc, then text(100, 4), with Z_FIXED: matches at
+// distances 1 to 3 overlap what they copy
+static const unsigned char overlap[] = {
+    0x4B, 0x4C, 0x1C, 0x05, 0x44, 0x83, 0xA4, 0x51, 0x48, 0x3C, 0x4C, 0x1E, 0x45, 0x44, 0xA2, 0x9C,
+    0xCC, 0xBC, 0x6C, 0x85, 0x44, 0x85, 0xAA, 0xD4, 0x9C, 0x94, 0x44, 0x85, 0xE4, 0xC4, 0xE2, 0x92,
+    0x9C, 0x54, 0x2E, 0x28, 0x95, 0x9B, 0x58, 0x94, 0x99, 0xAF, 0x50, 0x9C, 0x98, 0x5B, 0x5A, 0xAC,
+    0x90, 0x9F, 0x06, 0x65, 0x40, 0x14, 0x02, 0xB9, 0x60, 0x8D, 0x40, 0x1A, 0x55, 0x0F, 0x50, 0x00,
+    0x88, 0x20, 0x8A, 0x20, 0xFA, 0x81, 0xEA, 0x00,
+};
+
+// text(1000, 5), with a Z_FULL_FLUSH after 400 bytes: an empty stored block
+// between two dynamic ones
+static const unsigned char flushed[] = {
+    0x6C, 0x8F, 0x4B, 0x0E, 0x80, 0x20, 0x0C, 0x44, 0xF7, 0x9E, 0xA2, 0x57, 0x9B, 0x20, 0x46, 0x22,
+    0x48, 0x22, 0xB8, 0xF1, 0xF4, 0x02, 0xAD, 0x01, 0x84, 0x90, 0x40, 0xE7, 0xD1, 0xDF, 0x28, 0x84,
+    0x68, 0xF5, 0x62, 0xCD, 0x79, 0x90, 0xC3, 0x65, 0x3C, 0xF9, 0x8D, 0x8A, 0x8A, 0xBB, 0x16, 0xF2,
+    0x68, 0xBB, 0xA2, 0xD1, 0x29, 0x23, 0x8B, 0xF4, 0x7C, 0xB9, 0xE5, 0x42, 0xAD, 0x0B, 0x70, 0x77,
+    0x20, 0xC5, 0xBD, 0x53, 0x12, 0xEB, 0x7E, 0x48, 0xC3, 0x54, 0xB3, 0x44, 0x83, 0x39, 0xC4, 0x74,
+    0x13, 0x08, 0x81, 0xFC, 0xD7, 0x1F, 0x8E, 0xF2, 0x49, 0x43, 0xD4, 0x60, 0x4F, 0xC8, 0x44, 0x0C,
+    0x4E, 0x40, 0x63, 0xDD, 0xE0, 0x44, 0x38, 0x66, 0xED, 0x79, 0x95, 0xAE, 0x92, 0xD1, 0xDF, 0x4D,
+    0x8D, 0x5E, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0x6D, 0x52, 0x41, 0x12, 0x83, 0x30, 0x08, 0xBC, 0xFB,
+    0x0A, 0xBE, 0xC6, 0xD4, 0x38, 0x75, 0x1A, 0xCD, 0x8C, 0xB1, 0x97, 0xBE, 0xBE, 0x31, 0x0B, 0x02,
+    0x4E, 0x2E, 0x18, 0xC8, 0x2E, 0x0B, 0x1B, 0xCB, 0x42, 0x95, 0xB7, 0x6F, 0xA5, 0xF3, 0x9D, 0xE8,
+    0x97, 0xF2, 0xCC, 0xEE, 0xC4, 0xB4, 0xF1, 0xB1, 0x16, 0x2A, 0x4B, 0x2F, 0x5E, 0x85, 0x17, 0xD7,
+    0x33, 0xA7, 0xA9, 0x55, 0xF2, 0xBA, 0x7F, 0x34, 0xB5, 0x16, 0x20, 0xF4, 0xBB, 0x1E, 0x14, 0x88,
+    0x86, 0xDA, 0x36, 0x66, 0xC6, 0x6B, 0x68, 0xD5, 0x44, 0x04, 0x44, 0x54, 0xE4, 0xE3, 0x85, 0x6F,
+    0x9A, 0x29, 0x5E, 0xDD, 0x06, 0x04, 0x20, 0x6D, 0x50, 0x5D, 0xA8, 0x71, 0x05, 0x06, 0x2D, 0x20,
+    0x64, 0x63, 0x24, 0x1E, 0x14, 0xB0, 0x61, 0x3A, 0xB3, 0x0D, 0xB1, 0x71, 0x70, 0xF0, 0xFB, 0xDC,
+    0x68, 0xF6, 0x4E, 0x79, 0xDC, 0x68, 0xE3, 0xC7, 0x64, 0x4E, 0xD0, 0x73, 0x70, 0x8F, 0xD8, 0xDB,
+    0xFA, 0x82, 0x3D, 0x6D, 0x70, 0x2E, 0xBC, 0xDF, 0x48, 0x40, 0xAD, 0x85, 0x5D, 0x62, 0x8B, 0xFD,
+    0x04, 0x8F, 0x55, 0xED, 0x69, 0xFE,
+};
+
+// gzip of text(1000, 6), with the name game.nes in the header
+static const unsigned char gzip[] = {
+    0x1F, 0x8B, 0x08, 0x08, 0x00, 0x00, 0x00, 0x00, 0x02, 0xFF, 0x67, 0x61, 0x6D, 0x65, 0x2E, 0x6E,
+    0x65, 0x73, 0x00, 0x75, 0x52, 0x5B, 0x0E, 0x83, 0x30, 0x0C, 0xFB, 0xDF, 0x29, 0x7A, 0xB5, 0x68,
+    0x63, 0x02, 0xAD, 0x0C, 0x69, 0xB0, 0x9F, 0x9D, 0x7E, 0x05, 0xA7, 0xA9, 0xD3, 0x80, 0x84, 0xDA,
+    0x92, 0x38, 0x0F, 0x3B, 0x91, 0xF4, 0x1B, 0xF2, 0x43, 0x92, 0xA4, 0x6D, 0x1C, 0xD2, 0x2A, 0xF3,
+    0x77, 0x4D, 0x79, 0x7A, 0xBF, 0xD2, 0xF2, 0xC4, 0x7D, 0x97, 0x75, 0xCB, 0xC3, 0x6D, 0xF7, 0x16,
+    0x93, 0xFE, 0x01, 0x5D, 0x23, 0x67, 0xF9, 0x4C, 0x8B, 0x9E, 0x47, 0xCC, 0xA5, 0xC3, 0xC2, 0x4B,
+    0x2A, 0x7C, 0x2D, 0x8F, 0x4B, 0xDD, 0x9A, 0x81, 0x13, 0x6F, 0x85, 0x44, 0x07, 0x17, 0x2A, 0x49,
+    0xF1, 0x70, 0x31, 0x9E, 0x46, 0xC7, 0x15, 0x78, 0x85, 0x1C, 0x16, 0x38, 0x0B, 0x12, 0x55, 0x34,
+    0x44, 0x11, 0x80, 0xC3, 0x73, 0xA0, 0x1B, 0x09, 0xAE, 0x1C, 0x4F, 0x12, 0xC7, 0x0A, 0x30, 0x01,
+    0xAA, 0x71, 0xDA, 0xB6, 0x30, 0x82, 0x55, 0xE8, 0x27, 0xA5, 0xF8, 0x96, 0xB5, 0x8E, 0x94, 0x85,
+    0xC2, 0x59, 0x7B, 0xE6, 0xB6, 0x84, 0x46, 0x6D, 0xA2, 0x7A, 0x72, 0xE2, 0x08, 0x63, 0x96, 0xA4,
+    0xDC, 0x95, 0xB8, 0xFB, 0x56, 0x78, 0x81, 0xFB, 0xD6, 0x49, 0x1A, 0x69, 0x1D, 0x07, 0xE5, 0xC8,
+    0x50, 0xB9, 0x19, 0x4F, 0xDE, 0x68, 0xF1, 0xF5, 0xD9, 0x74, 0x3A, 0xC6, 0x46, 0x3C, 0xE8, 0x1B,
+    0x12, 0x31, 0xC2, 0xCF, 0x8B, 0x3D, 0xDD, 0x8C, 0x5D, 0x16, 0xF3, 0x75, 0xB3, 0xB3, 0x76, 0x58,
+    0x9D, 0xB8, 0x4F, 0xD4, 0x9C, 0x5D, 0x61, 0x4F, 0xA1, 0xE1, 0x1F, 0x02, 0x00, 0x75, 0x16, 0xE8,
+    0x03, 0x00, 0x00,
+};
+
+// zip of readme.txt (text(100, 7), stored) and game.nes ("NES\x1A" then
+// text(1500, 8), deflated), with a comment
+static const unsigned char zip[] = {
+    0x50, 0x4B, 0x03, 0x04, 0x14, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x21, 0x00, 0xA7, 0x1E,
+    0x8D, 0x22, 0x64, 0x00, 0x00, 0x00, 0x64, 0x00, 0x00, 0x00, 0x0A, 0x00, 0x00, 0x00, 0x72, 0x65,
+    0x61, 0x64, 0x6D, 0x65, 0x2E, 0x74, 0x78, 0x74, 0x74, 0x68, 0x65, 0x20, 0x61, 0x20, 0x74, 0x68,
+    0x65, 0x20, 0x73, 0x61, 0x6D, 0x75, 0x73, 0x20, 0x7A, 0x65, 0x6C, 0x64, 0x61, 0x20, 0x6F, 0x66,
+    0x20, 0x73, 0x61, 0x6D, 0x75, 0x73, 0x20, 0x61, 0x20, 0x6C, 0x69, 0x6E, 0x6B, 0x20, 0x6C, 0x69,
+    0x6E, 0x6B, 0x20, 0x6F, 0x66, 0x20, 0x7A, 0x65, 0x6C, 0x64, 0x61, 0x20, 0x61, 0x20, 0x73, 0x61,
+    0x6D, 0x75, 0x73, 0x20, 0x6F, 0x66, 0x20, 0x73, 0x61, 0x6D, 0x75, 0x73, 0x20, 0x6C, 0x69, 0x6E,
+    0x6B, 0x20, 0x61, 0x20, 0x61, 0x20, 0x74, 0x68, 0x65, 0x20, 0x74, 0x68, 0x65, 0x20, 0x7A, 0x65,
+    0x6C, 0x64, 0x61, 0x20, 0x63, 0x61, 0x73, 0x74, 0x6C, 0x65, 0x0A, 0x73, 0x50, 0x4B, 0x03, 0x04,
+    0x14, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x21, 0x00, 0x68, 0x59, 0x5C, 0xE1, 0x35, 0x01,
+    0x00, 0x00, 0xE0, 0x05, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x67, 0x61, 0x6D, 0x65, 0x2E, 0x6E,
+    0x65, 0x73, 0x7D, 0x54, 0xCB, 0x12, 0x82, 0x30, 0x0C, 0xBC, 0xFB, 0x09, 0x9E, 0xFA, 0x33, 0x5E,
+    0xBD, 0xF8, 0x05, 0x19, 0x85, 0x91, 0x11, 0x64, 0x46, 0xF0, 0xE2, 0xD7, 0x0B, 0x4D, 0xB3, 0xDD,
+    0xB4, 0xD5, 0x41, 0x6A, 0x1F, 0x79, 0xEC, 0x66, 0x53, 0xCE, 0xA7, 0xCB, 0x71, 0x91, 0xE9, 0xBD,
+    0x84, 0x49, 0x5E, 0xC3, 0x1C, 0x74, 0x3E, 0x0E, 0xCF, 0x47, 0x58, 0xEF, 0x9D, 0x4E, 0xAE, 0xB2,
+    0xAC, 0x63, 0x77, 0xD8, 0xD7, 0x9F, 0x6E, 0xBC, 0x49, 0x98, 0xFB, 0xFD, 0x27, 0x76, 0xA0, 0x9E,
+    0x69, 0x91, 0xFE, 0x34, 0xCE, 0x66, 0x05, 0x0F, 0xEC, 0x60, 0x8E, 0x04, 0x38, 0x4A, 0xCE, 0x71,
+    0x53, 0xE2, 0xB9, 0x24, 0x5C, 0xFB, 0xDC, 0xDE, 0xCD, 0x90, 0x2C, 0x34, 0x81, 0x4B, 0x9B, 0x16,
+    0x7A, 0xA2, 0xA3, 0x46, 0x89, 0xA8, 0x01, 0x8A, 0x78, 0x65, 0x40, 0xEC, 0x54, 0xB8, 0xC6, 0xA4,
+    0xC5, 0x9E, 0x47, 0xA7, 0xEC, 0x7C, 0x25, 0x24, 0xE1, 0x8C, 0xDE, 0xAD, 0x52, 0xC1, 0xAE, 0xC1,
+    0x84, 0x47, 0x31, 0xD6, 0xCE, 0x42, 0x23, 0x4A, 0x7A, 0xB8, 0x80, 0x3E, 0xFC, 0x9F, 0xCC, 0x1C,
+    0xA8, 0x40, 0xAA, 0x12, 0x50, 0xB5, 0xD9, 0xD6, 0xE1, 0x8D, 0x36, 0x9C, 0x17, 0xC5, 0x31, 0x62,
+    0x95, 0x66, 0x6C, 0x6D, 0x4D, 0x85, 0x76, 0x81, 0x7D, 0xDD, 0x9D, 0x26, 0x05, 0x1A, 0x49, 0x60,
+    0xA6, 0xEE, 0x24, 0x07, 0xD5, 0xDE, 0x2B, 0xC8, 0x63, 0xD1, 0x8E, 0x4A, 0x9A, 0x30, 0x36, 0x84,
+    0xB1, 0x16, 0x28, 0x18, 0x73, 0xD4, 0xDA, 0x15, 0x5C, 0xD9, 0xCB, 0x09, 0xE3, 0xF5, 0xB6, 0x48,
+    0x52, 0xDD, 0x10, 0xA2, 0x6E, 0xB4, 0x00, 0x9F, 0x3B, 0x94, 0xAE, 0xB3, 0x43, 0xDC, 0x38, 0x6F,
+    0xF2, 0xA1, 0x4D, 0x0E, 0xDB, 0xB8, 0x60, 0x5C, 0x49, 0x0E, 0x02, 0x6C, 0x8E, 0xAE, 0xD4, 0x99,
+    0xA1, 0xBC, 0xA9, 0xC7, 0x11, 0x7F, 0x97, 0x36, 0x2B, 0x6E, 0x91, 0x1D, 0x44, 0x1F, 0xCC, 0x56,
+    0xD5, 0x17, 0xCD, 0xBC, 0x9C, 0xAF, 0xEF, 0xBD, 0x2C, 0x46, 0xEB, 0x5B, 0xC3, 0xC2, 0x95, 0xF7,
+    0x44, 0x3B, 0xDB, 0x57, 0x93, 0x50, 0x64, 0x55, 0x1B, 0xF4, 0xAA, 0xD2, 0xD3, 0x2D, 0xCA, 0xA4,
+    0x39, 0x3B, 0xF7, 0xC3, 0xDC, 0x7F, 0x01, 0x50, 0x4B, 0x01, 0x02, 0x14, 0x03, 0x14, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x21, 0x00, 0xA7, 0x1E, 0x8D, 0x22, 0x64, 0x00, 0x00, 0x00, 0x64,
+    0x00, 0x00, 0x00, 0x0A, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80,
+    0x01, 0x00, 0x00, 0x00, 0x00, 0x72, 0x65, 0x61, 0x64, 0x6D, 0x65, 0x2E, 0x74, 0x78, 0x74, 0x50,
+    0x4B, 0x01, 0x02, 0x14, 0x03, 0x14, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x21, 0x00, 0x68,
+    0x59, 0x5C, 0xE1, 0x35, 0x01, 0x00, 0x00, 0xE0, 0x05, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x01, 0x8C, 0x00, 0x00, 0x00, 0x67, 0x61, 0x6D,
+    0x65, 0x2E, 0x6E, 0x65, 0x73, 0x50, 0x4B, 0x05, 0x06, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x02,
+    0x00, 0x6E, 0x00, 0x00, 0x00, 0xE7, 0x01, 0x00, 0x00, 0x2E, 0x00, 0x61, 0x20, 0x7A, 0x69, 0x70,
+    0x20, 0x63, 0x6F, 0x6D, 0x6D, 0x65, 0x6E, 0x74, 0x2C, 0x20, 0x77, 0x68, 0x69, 0x63, 0x68, 0x20,
+    0x63, 0x6F, 0x6D, 0x65, 0x73, 0x20, 0x61, 0x66, 0x74, 0x65, 0x72, 0x20, 0x74, 0x68, 0x65, 0x20,
+    0x64, 0x69, 0x72, 0x65, 0x63, 0x74, 0x6F, 0x72, 0x79,
+};
+
+static Util::InflateStatus inflate(std::span<const unsigned char> in, Bytes &out, std::size_t size)
+{
+    out.assign(size, 0);
+    std::size_t written = 0;
+    auto st = Util::inflate(in, out, written);
+    out.resize(written);
+    return st;
+}
+
+static void test_stream(std::string_view name, std::span<const unsigned char> in, const Bytes &expected)
+{
+    Bytes out;
+    check(inflate(in, out, expected.size() + 100) == Util::InflateStatus::DONE && out == expected,
+          fmt::format("{}: gives the data back", name));
+
+    // into a smaller buffer: stops when it's full, with what fits
+    const std::size_t half = expected.size() / 2;
+    check(inflate(in, out, half) == Util::InflateStatus::FULL
+          && std::equal(out.begin(), out.end(), expected.begin()) && out.size() == half,
+          fmt::format("{}: fills a smaller buffer", name));
+
+    // every truncation fails; the last byte always has part of the end of block
+    bool failed = true;
+    for (std::size_t n = 0; n < in.size(); n++)
+        failed = failed && inflate(in.first(n), out, expected.size()) == Util::InflateStatus::ERROR;
+    check(failed, fmt::format("{}: truncated streams fail", name));
+
+    // corrupting any bit may or may not be noticed, but must stay in bounds
+    Bytes bad(in.begin(), in.end());
+    for (std::size_t bit = 0; bit < bad.size() * 8; bit++) {
+        bad[bit / 8] ^= 1 << bit % 8;
+        inflate(bad, out, expected.size());
+        bad[bit / 8] ^= 1 << bit % 8;
+    }
+}
+
+// a view of data through a temporary file, which goes right away
+static Util::FileView view_of(Bytes data)
+{
+    const std::string path = (std::filesystem::temp_directory_path()
+                              / fmt::format("inflate_test.{}", getpid())).string();
+    {
+        Util::File out(path, Util::File::Mode::WRITE);
+        out.bwrite(data.data(), data.size());
+    }
+    Util::File f(path, Util::File::Mode::READ);
+    std::filesystem::remove(path);
+    return f.view();
+}
+
+static Bytes contents(const Util::FileView &v)
+{
+    return Bytes(v.data(), v.data() + v.size());
+}
+
+static void test_gzip()
+{
+    const Bytes expected = text(1000, 6);
+    const Bytes gz(std::begin(gzip), std::end(gzip));
+    std::string err;
+    check(Util::is_archive(gz), "gzip: is an archive");
+    auto out = Util::unpack(view_of(gz), {}, err);
+    check(out.size() == expected.size() && contents(out) == expected, "gzip: gives the data back");
+
+    auto fails = [&](Bytes data, std::string_view what) {
+        err.clear();
+        auto v = Util::unpack(view_of(data), {}, err);
+        check(v.size() == 0 && !err.empty(), fmt::format("gzip: {} fails", what));
+    };
+    Bytes bad = gz;
+    bad[bad.size() - 8] ^= 1;
+    fails(bad, "a bad CRC");
+    bad = gz;
+    bad[bad.size() - 4]++;
+    fails(bad, "a wrong size");
+    bad = gz;
+    bad[bad.size() / 2] ^= 0x10;
+    fails(bad, "corrupted data");
+    for (std::size_t n : { 18, 30, 100, 200, 235 })
+        fails(Bytes(gz.begin(), gz.begin() + n), fmt::format("a file cut at {}", n));
+}
+
+static void test_zip()
+{
+    static const unsigned char magic[] = { 'N', 'E', 'S', 0x1A };
+    Bytes expected = { 'N', 'E', 'S', 0x1A };
+    const Bytes game = text(1500, 8);
+    expected.insert(expected.end(), game.begin(), game.end());
+    const Bytes z(std::begin(zip), std::end(zip));
+    std::string err;
+    check(Util::is_archive(z), "zip: is an archive");
+    // readme.txt comes first, but doesn't start with magic
+    auto out = Util::unpack(view_of(z), magic, err);
+    check(out.size() == expected.size() && contents(out) == expected, "zip: finds the ROM past a comment");
+
+    static const unsigned char other[] = { 'F', 'D', 'S' };
+    err.clear();
+    check(Util::unpack(view_of(z), other, err).size() == 0 && !err.empty(), "zip: no matching file fails");
+
+    auto fails = [&](Bytes data, std::string_view what) {
+        err.clear();
+        auto v = Util::unpack(view_of(data), magic, err);
+        check(v.size() == 0 && !err.empty(), fmt::format("zip: {} fails", what));
+    };
+    // the central directory entry of game.nes (the last place its name is
+    // in), and its CRC
+    static const char name[] = "game.nes";
+    const std::size_t cd = std::find_end(z.begin(), z.end(), name, name + 8) - z.begin() - 46;
+    check(z[cd] == 'P' && z[cd + 1] == 'K' && z[cd + 2] == 1 && z[cd + 3] == 2, "zip: test finds the directory");
+    Bytes bad = z;
+    bad[cd + 16] ^= 1;
+    fails(bad, "a bad CRC");
+    bad = z;
+    bad[300] ^= 0x10;
+    fails(bad, "corrupted data");
+    // no end of central directory
+    fails(Bytes(z.begin(), z.end() - 70), "a cut file");
+    check(!Util::is_archive(text(100, 9)), "text isn't an archive");
+}
+
+int main()
+{
+    test_stream("stored", stored, text(200, 1));
+    test_stream("fixed", fixed, text(600, 2));
+    test_stream("dynamic", dynamic, text(2000, 3));
+    Bytes repeats;
+    for (auto [s, n] : { std::pair<std::string_view, unsigned> { "a", 300 }, { "ab", 150 }, { "abc", 100 } })
+        for (unsigned i = 0; i < n; i++)
+            repeats.insert(repeats.end(), s.begin(), s.end());
+    const Bytes tail = text(100, 4);
+    repeats.insert(repeats.end(), tail.begin(), tail.end());
+    test_stream("overlap", overlap, repeats);
+    test_stream("flushed", flushed, text(1000, 5));
+
+    // hand made bad headers
+    Bytes out;
+    const unsigned char bad_type[] = { 0x07 };
+    check(inflate(bad_type, out, 100) == Util::InflateStatus::ERROR, "block type 3 fails");
+    const unsigned char bad_len[] = { 0x01, 0x05, 0x00, 0x00, 0x00, 1, 2, 3, 4, 5 };
+    check(inflate(bad_len, out, 100) == Util::InflateStatus::ERROR, "stored length not matching its complement fails");
+    // fixed block: a match of 3 at distance 1 before any output
+    const unsigned char too_far[] = { 0x03, 0x02, 0x00 };
+    check(inflate(too_far, out, 100) == Util::InflateStatus::ERROR, "distance too far back fails");
+    check(inflate({}, out, 100) == Util::InflateStatus::ERROR, "empty input fails");
+
+    test_gzip();
+    test_zip();
+
+    if (failures == 0)
+        fmt::print("all tests passed\n");
+    return failures != 0;
+}
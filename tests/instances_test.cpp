@@ -0,0 +1,87 @@
+/* Many emulators in one process: 64 of them, each on its own thread with its
+ * own screen and log, must all give the same frame hashes as a single one
+ * running alone, and each log must only get its own emulator's messages.
+ * Usage: instances_test ROM [frames] [threads]. Exits with 1 on failure. */
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fmt/core.h>
+#include <emu/core/emulator.hpp>
+#include <emu/util/file.hpp>
+#include <emu/video/video.hpp>
+
+using namespace Core;
+
+struct Run {
+    std::vector<Emulator::FrameHash> hashes;
+    std::vector<std::string> messages;
+    bool loaded = false;
+};
+
+static void run(const char *path, unsigned frames, unsigned id, Run &out)
+{
+    auto emu = std::make_unique<Emulator>();
+    Video::Canvas screen { SCREEN_WIDTH, SCREEN_HEIGHT };
+    emu->set_log([&out](Util::Log::Level, std::string_view msg) { out.messages.emplace_back(msg); });
+    emu->seed(id);
+    emu->set_screen(&screen);
+    Util::File romfile(path, Util::File::Mode::READ);
+    if (!emu->insert_rom(romfile))
+        return;
+    out.loaded = true;
+    emu->power();
+    for (unsigned i = 0; i < frames; i++) {
+        emu->run_frame();
+        out.hashes.push_back(emu->frame_hash());
+    }
+    // one message, which must end up in this emulator's log only
+    std::vector<uint8> bad(8, 0);
+    emu->load_state(bad);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        fmt::print("usage: {} ROM [frames] [threads]\n", argv[0]);
+        return 1;
+    }
+    const unsigned frames  = argc > 2 ? std::stoul(argv[2]) : 120;
+    const unsigned threads = argc > 3 ? std::stoul(argv[3]) : 64;
+
+    Run solo;
+    run(argv[1], frames, 0, solo);
+    if (!solo.loaded) {
+        fmt::print("can't load ROM\n");
+        return 1;
+    }
+
+    std::vector<Run> runs(threads);
+    std::vector<std::thread> workers;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < threads; i++)
+        workers.emplace_back([&, i]() { run(argv[1], frames, i, runs[i]); });
+    for (auto &t : workers)
+        t.join();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    unsigned failures = 0;
+    for (unsigned i = 0; i < threads; i++) {
+        if (!runs[i].loaded || runs[i].hashes != solo.hashes) {
+            fmt::print("FAIL: instance {} gave different frames\n", i);
+            failures++;
+        }
+        if (runs[i].messages.size() != 1 || runs[i].messages[0] != solo.messages[0]) {
+            fmt::print("FAIL: instance {} got {} messages\n", i, runs[i].messages.size());
+            failures++;
+        }
+    }
+    fmt::print("{} instances x {} frames in {:.2f}s ({:.0f} frames/s)\n",
+               threads, frames, elapsed.count(), threads * frames / elapsed.count());
+    if (failures == 0)
+        fmt::print("all tests passed\n");
+    return failures != 0;
+}
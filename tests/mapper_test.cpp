@@ -0,0 +1,176 @@
+/* Register writes of MMC1, UxROM, CNROM and AxROM: which PRG and CHR pages
+ * end up where and what mirroring is picked. For MMC1 also checks that a
+ * register only changes on the fifth write of the serial port, that the
+ * address of that write picks the register, and that bit 7 resets the
+ * port. Every 8k page of PRG and 1k page of CHR is filled with its number.
+ * Exits with 1 on failure. */
+
+#include <optional>
+#include <vector>
+#include <fmt/core.h>
+#include <fmt/ranges.h>
+#include <emu/core/mapper.hpp>
+#include <tests/check.hpp>
+
+using namespace Core;
+
+using Pages = std::vector<unsigned>;
+
+struct Board {
+    std::vector<uint8> prg, chr;
+    std::unique_ptr<Mapper> mapper;
+    std::optional<Mirroring> mirroring;
+
+    Board(unsigned number, std::size_t prgsize, std::size_t chrsize)
+        : prg(prgsize), chr(chrsize)
+    {
+        for (std::size_t i = 0; i < prg.size(); i++)
+            prg[i] = i / 0x2000;
+        for (std::size_t i = 0; i < chr.size(); i++)
+            chr[i] = i / 0x400;
+        mapper = Mapper::create(number, prg, chr, {});
+        mapper->on_mirroring_change([this](Mirroring m) { mirroring = m; });
+        mapper->power();
+    }
+
+    // checks both ends of every page, so a wrong offset shows up too
+    Pages prg_pages() const
+    {
+        Pages pages;
+        for (unsigned addr = 0x8000; addr < 0x10000; addr += 0x2000)
+            pages.push_back(mapper->read_prg(addr) == mapper->read_prg(addr + 0x1FFF) ? mapper->read_prg(addr) : ~0u);
+        return pages;
+    }
+
+    Pages chr_pages() const
+    {
+        Pages pages;
+        for (unsigned addr = 0; addr < 0x2000; addr += 0x400)
+            pages.push_back(mapper->read_chr(addr) == mapper->read_chr(addr + 0x3FF) ? mapper->read_chr(addr) : ~0u);
+        return pages;
+    }
+
+    void write(uint16 addr, uint8 data) { mapper->write_prg(addr, data); }
+
+    // the five writes of the MMC1 serial port, low bit first
+    void mmc1_write(uint16 addr, uint8 data)
+    {
+        for (unsigned i = 0; i < 5; i++)
+            write(addr, data >> i & 1);
+    }
+};
+
+static void check_pages(const Pages &got, const Pages &expected, std::string_view what)
+{
+    check(got == expected, fmt::format("{}: got pages {}, expected {}", what,
+                                       fmt::join(got, " "), fmt::join(expected, " ")));
+}
+
+static void test_mmc1()
+{
+    // 256k PRG, 128k CHR
+    Board b(1, 0x40000, 0x20000);
+    check_pages(b.prg_pages(), { 0, 1, 30, 31 }, "MMC1 power: last 16k fixed at $C000");
+    check_pages(b.chr_pages(), { 0, 1, 2, 3, 4, 5, 6, 7 }, "MMC1 power: CHR");
+    check(b.mirroring == Mirroring::SINGLE_LOW, "MMC1 power: one screen mirroring");
+
+    // nothing changes until the fifth write, whose address picks the register
+    for (unsigned i = 0; i < 4; i++)
+        b.write(0x8000, 5 >> i & 1);
+    check_pages(b.prg_pages(), { 0, 1, 30, 31 }, "MMC1: four writes change nothing");
+    b.write(0xE000, 0);
+    check_pages(b.prg_pages(), { 10, 11, 30, 31 }, "MMC1: fifth write to $E000 sets the PRG bank");
+
+    // the reset drops the bits shifted in so far
+    b.write(0xE000, 1);
+    b.write(0xE000, 1);
+    b.write(0xE000, 0x80);
+    b.mmc1_write(0xE000, 4);
+    check_pages(b.prg_pages(), { 8, 9, 30, 31 }, "MMC1: reset empties the shift register");
+
+    // 16k at $C000, first 16k fixed at $8000, vertical mirroring
+    b.mmc1_write(0x8000, 0x0A);
+    check_pages(b.prg_pages(), { 0, 1, 8, 9 }, "MMC1: PRG mode 2");
+    check(b.mirroring == Mirroring::VERT, "MMC1: vertical mirroring");
+    // the reset also goes back to PRG mode 3, leaving mirroring alone
+    b.write(0x8000, 0xFF);
+    check_pages(b.prg_pages(), { 8, 9, 30, 31 }, "MMC1: reset sets PRG mode 3");
+    check(b.mirroring == Mirroring::VERT, "MMC1: reset keeps mirroring");
+
+    // 32k mode ignores the low bit of the bank
+    b.mmc1_write(0x8000, 0x03);
+    b.mmc1_write(0xE000, 5);
+    check_pages(b.prg_pages(), { 8, 9, 10, 11 }, "MMC1: PRG mode 0");
+    check(b.mirroring == Mirroring::HORZ, "MMC1: horizontal mirroring");
+    b.mmc1_write(0x8000, 0x01);
+    check(b.mirroring == Mirroring::SINGLE_HIGH, "MMC1: one screen, upper bank");
+
+    // 8k of CHR ignores the low bit of the first register, and the second
+    b.mmc1_write(0xA000, 5);
+    b.mmc1_write(0xC000, 9);
+    check_pages(b.chr_pages(), { 16, 17, 18, 19, 20, 21, 22, 23 }, "MMC1: CHR mode 0");
+    // two 4k banks
+    b.mmc1_write(0x8000, 0x1C);
+    check_pages(b.chr_pages(), { 20, 21, 22, 23, 36, 37, 38, 39 }, "MMC1: CHR mode 1");
+
+    // SUROM: bit 4 of the first CHR register picks the 256k half of PRG
+    Board surom(1, 0x80000, 0x2000);
+    surom.mmc1_write(0xA000, 0x10);
+    surom.mmc1_write(0xE000, 2);
+    check_pages(surom.prg_pages(), { 36, 37, 62, 63 }, "SUROM: upper 256k");
+    surom.mmc1_write(0xA000, 0);
+    check_pages(surom.prg_pages(), { 4, 5, 30, 31 }, "SUROM: lower 256k");
+}
+
+static void test_uxrom()
+{
+    // 128k PRG, 8k CHR
+    Board b(2, 0x20000, 0x2000);
+    check_pages(b.prg_pages(), { 0, 1, 14, 15 }, "UxROM power");
+    b.write(0x8000, 3);
+    check_pages(b.prg_pages(), { 6, 7, 14, 15 }, "UxROM: bank 3");
+    b.write(0xFFFF, 9);
+    check_pages(b.prg_pages(), { 2, 3, 14, 15 }, "UxROM: banks wrap around the ROM");
+    check_pages(b.chr_pages(), { 0, 1, 2, 3, 4, 5, 6, 7 }, "UxROM: CHR is fixed");
+    check(!b.mirroring, "UxROM: mirroring comes from the header");
+}
+
+static void test_cnrom()
+{
+    // 16k PRG, 32k CHR
+    Board b(3, 0x4000, 0x8000);
+    check_pages(b.prg_pages(), { 0, 1, 0, 1 }, "CNROM: 16k of PRG shows up twice");
+    check_pages(b.chr_pages(), { 0, 1, 2, 3, 4, 5, 6, 7 }, "CNROM power");
+    b.write(0x8000, 2);
+    check_pages(b.chr_pages(), { 16, 17, 18, 19, 20, 21, 22, 23 }, "CNROM: CHR bank 2");
+    b.write(0xC000, 7);
+    check_pages(b.chr_pages(), { 24, 25, 26, 27, 28, 29, 30, 31 }, "CNROM: banks wrap around the ROM");
+    check_pages(b.prg_pages(), { 0, 1, 0, 1 }, "CNROM: PRG is fixed");
+    check(!b.mirroring, "CNROM: mirroring comes from the header");
+}
+
+static void test_axrom()
+{
+    // 512k PRG, more than the 3 bank bits reach, 8k CHR
+    Board b(7, 0x80000, 0x2000);
+    check_pages(b.prg_pages(), { 0, 1, 2, 3 }, "AxROM power");
+    check(b.mirroring == Mirroring::SINGLE_LOW, "AxROM power: lower screen");
+    b.write(0x8000, 0x13);
+    check_pages(b.prg_pages(), { 12, 13, 14, 15 }, "AxROM: bank 3");
+    check(b.mirroring == Mirroring::SINGLE_HIGH, "AxROM: bit 4 picks the upper screen");
+    b.write(0xFFFF, 0x0F);
+    check_pages(b.prg_pages(), { 28, 29, 30, 31 }, "AxROM: bit 3 is ignored");
+    check(b.mirroring == Mirroring::SINGLE_LOW, "AxROM: back to the lower screen");
+    check_pages(b.chr_pages(), { 0, 1, 2, 3, 4, 5, 6, 7 }, "AxROM: CHR is fixed");
+}
+
+int main()
+{
+    test_mmc1();
+    test_uxrom();
+    test_cnrom();
+    test_axrom();
+    if (failures == 0)
+        fmt::print("all tests passed\n");
+    return failures != 0;
+}
@@ -0,0 +1,135 @@
+/* Checks the MMC3 scanline counter against the PPU: the counter must be
+ * clocked once per rendered line, at the cycle where A12 rises, and the IRQ
+ * must fire on the line set by the latch. Exits with 1 on failure. */
+
+#include <vector>
+#include <fmt/core.h>
+#include <emu/core/ppu.hpp>
+#include <emu/core/bus.hpp>
+#include <emu/core/mapper.hpp>
+#include <tests/check.hpp>
+
+using namespace Core;
+
+struct Edge {
+    unsigned long line, cycle;
+};
+
+struct Board {
+    Bus cpu_bus { CPUBUS_SIZE };
+    Bus ppu_bus { PPUBUS_SIZE };
+    std::vector<uint8> prg = std::vector<uint8>(0x8000);
+    std::vector<uint8> chr = std::vector<uint8>(0x2000);
+    std::unique_ptr<Mapper> mapper = Mapper::create(4, prg, chr, {});
+    PPU ppu;
+    std::vector<Edge> rises, irqs;
+    bool irq_line = false;
+
+    Board(uint8 ctrl, uint8 mask)
+    {
+        ppu.attach_bus(&ppu_bus, &cpu_bus);
+        ppu.set_mirroring(Mirroring::VERT);
+        ppu_bus.map(PT_START, NT_START, mapper.get(),
+                [](void *m, uint16 addr)             { return static_cast<Mapper *>(m)->read_chr(addr); },
+                [](void *m, uint16 addr, uint8 data) { static_cast<Mapper *>(m)->write_chr(addr, data); });
+        ppu.set_nmi_callback([]() { });
+        ppu.set_a12_callback([this]() {
+            auto st = ppu.status();
+            rises.push_back({ st.line % 262, st.cycle % 341 });
+            mapper->a12_rise();
+        });
+        mapper->on_irq([this](bool line) {
+            auto st = ppu.status();
+            if (line)
+                irqs.push_back({ st.line % 262, st.cycle % 341 });
+            irq_line = line;
+        });
+        ppu.power();
+        cpu_bus.write(0x2000, ctrl);
+        cpu_bus.write(0x2001, mask);
+    }
+
+    void run_frame()
+    {
+        for (int i = 0; i < 262*341; i++)
+            ppu.run();
+    }
+};
+
+// rendering lines are 0-239 plus the pre-render line
+static const unsigned RISES_PER_FRAME = 241;
+
+int main()
+{
+    // background at $0000, sprites at $1000: the usual MMC3 setup.
+    // A12 rises on the first sprite pattern fetch of each line.
+    {
+        Board b(0x08, 0x18);
+        b.mapper->write_prg(0xC000, 7);
+        b.mapper->write_prg(0xC001, 0);
+        b.mapper->write_prg(0xE001, 0);
+        b.run_frame();
+        check(b.rises.size() == RISES_PER_FRAME, fmt::format("{} rises in a frame, expected {}", b.rises.size(), RISES_PER_FRAME));
+        bool same_cycle = true;
+        for (auto e : b.rises)
+            same_cycle = same_cycle && e.cycle == 262;
+        check(same_cycle, "rises should all happen at cycle 262");
+        // reload on line 0, then 7 more clocks
+        check(!b.irqs.empty() && b.irqs[0].line == 7 && b.irqs[0].cycle == 262, "first IRQ should be at line 7, cycle 262");
+        check(b.irqs.size() == RISES_PER_FRAME / 8, fmt::format("{} IRQs in a frame, expected {}", b.irqs.size(), RISES_PER_FRAME / 8));
+    }
+
+    // background at $1000, sprites at $0000: A12 goes up and down on every
+    // tile, the filter must leave only the rise after the sprite fetches.
+    // (the pre-render line gets an extra one on its first tile, after A12
+    // stayed low through vblank.)
+    {
+        Board b(0x10, 0x18);
+        b.run_frame();
+        unsigned visible = 0;
+        bool same_cycle = true;
+        for (auto e : b.rises) {
+            if (e.line < SCREEN_HEIGHT) {
+                visible++;
+                same_cycle = same_cycle && e.cycle == 326;
+            }
+        }
+        check(visible == SCREEN_HEIGHT, fmt::format("bg at $1000: {} rises in visible lines", visible));
+        check(same_cycle, "bg at $1000: rises should happen at cycle 326");
+    }
+
+    // acknowledging with $E000 drops the line and disables further IRQs
+    {
+        Board b(0x08, 0x18);
+        b.mapper->write_prg(0xC000, 3);
+        b.mapper->write_prg(0xC001, 0);
+        b.mapper->write_prg(0xE001, 0);
+        for (int i = 0; i < 5*341; i++)
+            b.ppu.run();
+        check(b.irq_line, "IRQ should be asserted after line 3");
+        b.mapper->write_prg(0xE000, 0);
+        check(!b.irq_line, "$E000 should acknowledge the IRQ");
+        b.run_frame();
+        check(b.irqs.size() == 1, "no IRQs while disabled");
+    }
+
+    // rendering off: nothing to count, except for A12 toggled through $2006
+    {
+        Board b(0x08, 0x00);
+        b.run_frame();
+        check(b.rises.empty(), "no rises with rendering disabled");
+        for (int i = 0; i < 3; i++) {
+            b.cpu_bus.write(0x2006, 0x00);
+            b.cpu_bus.write(0x2006, 0x00);
+            for (int j = 0; j < 20; j++)
+                b.ppu.run();
+            b.cpu_bus.write(0x2006, 0x10);
+            b.cpu_bus.write(0x2006, 0x00);
+        }
+        check(b.rises.size() == 3, fmt::format("{} rises through $2006, expected 3", b.rises.size()));
+    }
+
+    if (failures == 0)
+        fmt::print("all MMC3 tests passed\n");
+    return failures != 0;
+}
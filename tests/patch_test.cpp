@@ -0,0 +1,237 @@
+/* IPS, UPS and BPS patches, built here byte by byte: a correct patch of
+ * each format must give the expected ROM, and source, target and patch CRC
+ * mismatches, truncated patches and broken records must fail with an error
+ * instead of a ROM. For IPS also checks run (RLE) records, records past the
+ * end growing the ROM and the truncation extension.
+ * Exits with 1 on failure. */
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <fmt/core.h>
+#include <emu/util/file.hpp>
+#include <emu/util/hash.hpp>
+#include <emu/util/patch.hpp>
+#include <tests/check.hpp>
+
+using Bytes = std::vector<unsigned char>;
+
+static Bytes rom_data()
+{
+    Bytes rom(64);
+    for (std::size_t i = 0; i < rom.size(); i++)
+        rom[i] = i;
+    return rom;
+}
+
+static std::filesystem::path tmpdir;
+
+/* A view of data through a file of its own. The files stay until the end,
+ * so that no two of them can look like the same file to apply_patch(),
+ * which remembers the patches it has checked. */
+static Util::FileView view(Bytes data)
+{
+    static unsigned count = 0;
+    const std::string path = (tmpdir / fmt::format("{}", count++)).string();
+    {
+        Util::File out(path, Util::File::Mode::WRITE);
+        out.bwrite(data.data(), data.size());
+    }
+    Util::File f(path, Util::File::Mode::READ);
+    return f.view();
+}
+
+// true if the patch applies and gives expected
+static bool gives(const Bytes &rom, const Bytes &patch, const Bytes &expected)
+{
+    std::string err;
+    auto out = Util::apply_patch(view(rom), view(patch), err);
+    if (!out.data() && !err.empty())
+        fmt::print("  ({})\n", err);
+    return out.data() && Bytes(out.data(), out.data() + out.size()) == expected;
+}
+
+// true if the patch fails with an error containing why: a later check
+// mustn't be what catches it
+static bool fails(const Bytes &rom, const Bytes &patch, std::string_view why)
+{
+    std::string err;
+    auto out = Util::apply_patch(view(rom), view(patch), err);
+    if (!out.data() && err.find(why) == err.npos)
+        fmt::print("  ({})\n", err);
+    return !out.data() && err.find(why) != err.npos;
+}
+
+struct Writer {
+    Bytes d;
+
+    Writer(std::string_view magic) : d(magic.begin(), magic.end()) { }
+    Writer &bytes(std::initializer_list<unsigned> bs) { for (auto b : bs) d.push_back(b); return *this; }
+    Writer &be(unsigned v, unsigned n)
+    {
+        while (n--)
+            d.push_back(v >> n * 8 & 0xFF);
+        return *this;
+    }
+    Writer &le32(uint32_t v) { for (unsigned i = 0; i < 4; i++) d.push_back(v >> i * 8 & 0xFF); return *this; }
+    // UPS and BPS numbers
+    Writer &number(uint64_t v)
+    {
+        for (;;) {
+            const unsigned x = v & 0x7F;
+            v >>= 7;
+            if (v == 0) {
+                d.push_back(0x80 | x);
+                return *this;
+            }
+            d.push_back(x);
+            v--;
+        }
+    }
+    // the source and target CRCs, then the patch's own
+    Bytes finish(const Bytes &src, const Bytes &dst)
+    {
+        le32(Util::crc32(src.data(), src.size()));
+        le32(Util::crc32(dst.data(), dst.size()));
+        le32(Util::crc32(d.data(), d.size()));
+        return d;
+    }
+};
+
+static void test_ips()
+{
+    const Bytes rom = rom_data();
+    Bytes expected = rom;
+    expected[5] = 0x10; expected[6] = 0x20; expected[7] = 0x30;
+    std::fill(expected.begin() + 20, expected.begin() + 30, 0xAA);
+    expected.resize(66);
+    expected[62] = 1; expected[63] = 2; expected[64] = 3; expected[65] = 4;
+
+    auto ips = Writer("PATCH")
+        .be(5, 3).be(3, 2).bytes({ 0x10, 0x20, 0x30 })
+        .be(20, 3).be(0, 2).be(10, 2).bytes({ 0xAA })      // run
+        .be(62, 3).be(4, 2).bytes({ 1, 2, 3, 4 })           // past the end
+        .bytes({ 'E', 'O', 'F' }).d;
+    check(gives(rom, ips, expected), "IPS: records, runs and growing");
+
+    auto truncated = ips;
+    truncated.insert(truncated.end(), { 0, 0, 32 });
+    check(gives(rom, truncated, Bytes(expected.begin(), expected.begin() + 32)), "IPS: truncation after EOF");
+
+    // cut anywhere before EOF, once it's long enough to be a patch at all
+    bool all = true;
+    for (std::size_t n = 8; n < ips.size() - 3; n++)
+        all = all && fails(rom, Bytes(ips.begin(), ips.begin() + n), "cut short");
+    check(all, "IPS: cut patches fail");
+    check(fails(rom, Writer("PATCH").be(20, 3).be(0, 2).be(10, 2).d, "cut short"), "IPS: run without its value fails");
+    check(fails(rom, Writer("PATCH").be(5, 3).be(9, 2).bytes({ 1, 2, 3, 'E', 'O', 'F' }).d, "cut short"),
+          "IPS: record longer than the patch fails");
+}
+
+static void test_ups()
+{
+    const Bytes rom = rom_data();
+    Bytes expected = rom;
+    expected[3] ^= 0xFF;
+    expected[4] ^= 0x01;
+    expected[10] ^= 0x80;
+    expected.resize(70, 0);
+    expected[66] = 0x42;
+
+    // the 0 ending a hunk takes up a byte too: the second one starts at 6
+    auto body = [&]() {
+        return Writer("UPS1").number(rom.size()).number(expected.size())
+            .number(3).bytes({ 0xFF, 0x01, 0 })
+            .number(4).bytes({ 0x80, 0 })
+            .number(54).bytes({ 0x42, 0 });
+    };
+    const Bytes ups = body().finish(rom, expected);
+    check(gives(rom, ups, expected), "UPS: hunks and growing");
+    check(gives(rom, ups, expected), "UPS: applies again");
+
+    Bytes other = rom;
+    other[0] = 0xFF;
+    check(fails(other, ups, "different ROM"), "UPS: source CRC mismatch fails");
+    Bytes wrong = expected;
+    wrong[0]++;
+    check(fails(rom, body().finish(rom, wrong), "wrong result"), "UPS: target CRC mismatch fails");
+    Bytes bad = ups;
+    bad[8] ^= 1;
+    check(fails(rom, bad, "bad CRC"), "UPS: patch CRC mismatch fails");
+    // a last hunk without its 0, with the right CRCs
+    auto cut = Writer("UPS1").number(rom.size()).number(expected.size()).number(3).bytes({ 0xFF, 0x01 });
+    check(fails(rom, cut.finish(rom, expected), "cut short"), "UPS: cut patch fails");
+    check(fails(rom, Bytes(ups.begin(), ups.begin() + 15), "not an IPS, UPS or BPS"), "UPS: patch shorter than its footer fails");
+}
+
+static void test_bps()
+{
+    const Bytes rom = rom_data();
+    // source read 4, target read "xyz", target copy of 6 from 4 (it
+    // overlaps what it writes: "xyz" twice), source copy of 8 from 40,
+    // source read to 32
+    Bytes expected(rom.begin(), rom.begin() + 4);
+    expected.insert(expected.end(), { 'x', 'y', 'z', 'x', 'y', 'z', 'x', 'y', 'z' });
+    expected.insert(expected.end(), rom.begin() + 40, rom.begin() + 48);
+    const std::size_t tail = 32 - expected.size();
+    expected.insert(expected.end(), rom.begin() + expected.size(), rom.begin() + 32);
+
+    auto action = [](unsigned type, uint64_t len) { return (len - 1) << 2 | type; };
+    auto body = [&]() {
+        return Writer("BPS1").number(rom.size()).number(expected.size()).number(0)
+            .number(action(0, 4))
+            .number(action(1, 3)).bytes({ 'x', 'y', 'z' })
+            .number(action(3, 6)).number(4 << 1)
+            .number(action(2, 8)).number(40 << 1)
+            .number(action(0, tail));
+    };
+    const Bytes bps = body().finish(rom, expected);
+    check(gives(rom, bps, expected), "BPS: all four actions");
+
+    Bytes other = rom;
+    other[63] = 0;
+    check(fails(other, bps, "different ROM"), "BPS: source CRC mismatch fails");
+    Bytes wrong = expected;
+    wrong[5]++;
+    check(fails(rom, body().finish(rom, wrong), "wrong result"), "BPS: target CRC mismatch fails");
+    Bytes bad = bps;
+    bad[bad.size() - 14] ^= 1;
+    check(fails(rom, bad, "bad CRC"), "BPS: patch CRC mismatch fails");
+
+    // with the right CRCs; the others each have one action as long as the
+    // target, so they fail on the action itself
+    auto header = [&](uint64_t dst_size) { return Writer("BPS1").number(rom.size()).number(dst_size).number(0); };
+    check(fails(rom, header(expected.size()).number(action(0, 4)).number(action(1, 3)).bytes({ 'x', 'y', 'z' })
+                         .finish(rom, expected), "broken"), "BPS: cut patch fails");
+    check(fails(rom, header(3).number(action(1, 3)).bytes({ 'x' }).finish(rom, Bytes { 'x', 0, 0 }), "broken"),
+          "BPS: target read past the patch fails");
+    check(fails(rom, header(32).number(action(0, 40)).finish(rom, expected), "broken"),
+          "BPS: action past the target fails");
+    check(fails(rom, header(70).number(action(0, 70)).finish(rom, Bytes(70)), "broken"),
+          "BPS: source read past the source fails");
+    check(fails(rom, header(8).number(action(2, 8)).number(60 << 1).finish(rom, Bytes(8)), "broken"),
+          "BPS: source copy past the source fails");
+    // with the CRC of what copying the output over itself would give
+    check(fails(rom, header(4).number(action(3, 4)).number(0).finish(rom, Bytes(rom.begin(), rom.begin() + 4)),
+                "broken"),
+          "BPS: target copy of what isn't written yet fails");
+}
+
+int main()
+{
+    tmpdir = std::filesystem::temp_directory_path() / fmt::format("patch_test.{}", getpid());
+    std::filesystem::create_directory(tmpdir);
+    test_ips();
+    test_ups();
+    test_bps();
+    check(fails(rom_data(), Bytes { 'N', 'O', 'T', ' ', 'A', ' ', 'P', 'A', 'T', 'C', 'H' }, "not an IPS, UPS or BPS"), "not a patch fails");
+
+    std::filesystem::remove_all(tmpdir);
+
+    if (failures == 0)
+        fmt::print("all tests passed\n");
+    return failures != 0;
+}
@@ -0,0 +1,141 @@
+/* Random power-on memory: the same seed must give the same RAM, VRAM, OAM and
+ * palette and the same frames, another seed other ones, and without it memory
+ * must still start zeroed. Then times Util::Random against std::mt19937.
+ * Runs a tiny built-in ROM, or the ROM given on the command line.
+ * Usage: random_test [ROM]. Exits with 1 on failure. */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include <fmt/core.h>
+#include <emu/core/emulator.hpp>
+#include <emu/util/easyrandom.hpp>
+#include <emu/util/file.hpp>
+#include <tests/check.hpp>
+#include <tests/testrom.hpp>
+
+using namespace Core;
+
+// NROM: turn on rendering and loop
+static const uint8 program[] = {
+    0xA9, 0x1E,             // lda #$1E
+    0x8D, 0x01, 0x20,       // sta $2001
+    0x4C, 0x05, 0xC0,       // jmp $C005
+    0x40,                   // rti
+};
+
+struct PowerOn {
+    std::vector<uint8> memory;
+    std::vector<Emulator::FrameHash> hashes;
+};
+
+// the ROM at path, or the built-in one without it
+static PowerOn power_on(const char *path, bool randomize, uint64 seed)
+{
+    Emulator emu;
+    PowerOn out;
+    Util::File romfile;
+    if (path)
+        romfile.open(path, Util::File::Mode::READ);
+    if (path ? !emu.insert_rom(romfile) : !emu.insert_rom(test_rom(program, { .nmi = 0xC008, .reset = 0xC000, .irq = 0xC008 })))
+        return out;
+    emu.seed(seed);
+    emu.randomize_ram(randomize);
+    emu.power();
+    for (auto mem : { emu.cpu_ram(), emu.vram(), emu.oam(), emu.palette_ram() })
+        out.memory.insert(out.memory.end(), mem.begin(), mem.end());
+    for (unsigned i = 0; i < 10; i++) {
+        emu.run_frame();
+        out.hashes.push_back(emu.frame_hash());
+    }
+    return out;
+}
+
+static void tests(const char *rom)
+{
+    auto zeroed = power_on(rom, false, 1);
+    if (zeroed.memory.empty()) {
+        fmt::print("can't load ROM\n");
+        std::exit(1);
+    }
+    // except the stack, where power() pushes the reset interrupt
+    std::fill(zeroed.memory.begin() + 0x100, zeroed.memory.begin() + 0x200, 0);
+    check(std::all_of(zeroed.memory.begin(), zeroed.memory.end(), [](uint8 b) { return b == 0; }),
+          "memory starts zeroed by default");
+    check(power_on(rom, false, 2).hashes == zeroed.hashes, "without random RAM the seed doesn't matter");
+
+    auto a = power_on(rom, true, 42), b = power_on(rom, true, 42), c = power_on(rom, true, 43);
+    check(a.memory == b.memory && a.hashes == b.hashes, "the same seed gives the same run");
+    check(a.memory != c.memory, "another seed gives other memory");
+    check(std::count(a.memory.begin(), a.memory.end(), 0) < long(a.memory.size() / 64), "memory is random");
+    auto palette = std::span(a.memory).last(PAL_SIZE);
+    check(std::all_of(palette.begin(), palette.end(), [](uint8 b) { return b < 64; }), "palette entries are colours");
+
+    // fill() of any length is a prefix of a longer one
+    Util::Random r1(7), r2(7);
+    std::vector<uint8> shortfill(13), longfill(64);
+    r1.fill(shortfill);
+    r2.fill(longfill);
+    check(std::equal(shortfill.begin(), shortfill.end(), longfill.begin()), "fill is the same whatever the length");
+    Util::Random r3(7);
+    int lo = 0, hi = 0;
+    for (unsigned i = 0; i < 10000; i++) {
+        int x = r3.random_between(-3, 3);
+        lo += x == -3;
+        hi += x == 3;
+        check(x >= -3 && x <= 3, "random_between stays in range");
+    }
+    check(lo > 0 && hi > 0, "random_between reaches both ends");
+}
+
+template <typename F>
+static double bytes_per_sec(std::size_t bytes, F &&fill)
+{
+    const auto start = std::chrono::steady_clock::now();
+    fill();
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return bytes / elapsed.count();
+}
+
+int main(int argc, char *argv[])
+{
+    tests(argc > 1 ? argv[1] : nullptr);
+
+    // what power() fills, many times over
+    const std::size_t size = RAM_SIZE + VRAM_SIZE + OAM_SIZE;
+    const unsigned reps = 20000;
+    std::vector<uint8> buf(size);
+    Util::Random rng(1);
+    std::mt19937 mt(1);
+    std::uniform_int_distribution<uint16_t> dist(0, 0xFF);
+    volatile uint8 sink = 0;
+    const double fill = bytes_per_sec(size * reps, [&] {
+        for (unsigned r = 0; r < reps; r++) {
+            rng.fill(buf);
+            sink = sink + buf[r % size];
+        }
+    });
+    const double bytewise = bytes_per_sec(size * reps, [&] {
+        for (unsigned r = 0; r < reps; r++) {
+            for (auto &b : buf)
+                b = rng.random8();
+            sink = sink + buf[r % size];
+        }
+    });
+    const double mt19937 = bytes_per_sec(size * reps, [&] {
+        for (unsigned r = 0; r < reps; r++) {
+            for (auto &b : buf)
+                b = uint8(dist(mt));
+            sink = sink + buf[r % size];
+        }
+    });
+    fmt::print("Random::fill     {:8.0f} MB/s\n", fill / 1e6);
+    fmt::print("Random::random8  {:8.0f} MB/s\n", bytewise / 1e6);
+    fmt::print("std::mt19937     {:8.0f} MB/s\n", mt19937 / 1e6);
+
+    if (failures == 0)
+        fmt::print("all tests passed\n");
+    return failures != 0;
+}
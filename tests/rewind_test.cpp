@@ -0,0 +1,114 @@
+/* Rewind history: going back n snapshots must give exactly the state saved
+ * n snapshots ago, holding rewind must keep going back and inserting a ROM
+ * must empty the history. Also times rewinding one second and reports how much
+ * memory the history takes, extrapolated to an hour of play.
+ * Usage: rewind_test ROM [frames]. Exits with 1 on failure. */
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+#include <fmt/core.h>
+#include <emu/core/emulator.hpp>
+#include <emu/util/file.hpp>
+#include <tests/check.hpp>
+
+using namespace Core;
+
+static const std::size_t SIZE = 256 * 1024 * 1024;
+static const unsigned INTERVAL = 2;
+// snapshots in a second
+static const unsigned SECOND = 60 / INTERVAL;
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        fmt::print("usage: {} ROM [frames]\n", argv[0]);
+        return 1;
+    }
+    const unsigned frames = argc > 2 ? std::stoul(argv[2]) : 3000;
+    Util::File romfile(argv[1], Util::File::Mode::READ);
+    Emulator emu;
+    if (!emu.insert_rom(romfile)) {
+        fmt::print("can't load ROM\n");
+        return 1;
+    }
+    emu.enable_rewind(SIZE, INTERVAL);
+    emu.power();
+
+    // states of the last few seconds, by frame
+    std::map<unsigned long, std::vector<uint8>> saved;
+    for (unsigned i = 0; i < frames; i++) {
+        emu.run_frame();
+        if (emu.frame_count() % INTERVAL == 0 && emu.frame_count() + 10 * SECOND * INTERVAL > frames)
+            emu.save_state(saved[emu.frame_count()]);
+    }
+    const auto rs = emu.rewind_stats();
+    const double per_hour = double(rs.memory) / rs.snapshots * (3600 * 60 / INTERVAL);
+    fmt::print("{} snapshots every {} frames: {:.2f} MB, compressed {:.1f}:1, an hour would take {:.1f} MB\n",
+               rs.snapshots, INTERVAL, rs.memory / 1048576.0, rs.ratio, per_hour / 1048576.0);
+
+    using clock = std::chrono::steady_clock;
+    std::vector<uint8> state;
+    double worst = 0;
+    for (unsigned steps : { 0u, 1u, 2u, 7u, SECOND, SECOND, 3 * SECOND }) {
+        const auto t0 = clock::now();
+        const unsigned done = emu.rewind(steps);
+        const std::chrono::duration<double, std::milli> elapsed = clock::now() - t0;
+        if (steps == SECOND)
+            worst = std::max(worst, elapsed.count());
+        check(done == steps, "went back as many snapshots as asked");
+        auto it = saved.find(emu.frame_count());
+        check(it != saved.end(), "went back to a saved frame");
+        emu.save_state(state);
+        check(it != saved.end() && state == it->second, fmt::format("same state as {} snapshots back", steps));
+    }
+    fmt::print("rewinding one second: {:.3f} ms\n", worst);
+    check(worst < 5.0, "one second rewinds in less than 5 ms");
+
+    // running on after rewinding records again from there
+    const auto before = emu.frame_count();
+    for (unsigned i = 0; i < 4 * INTERVAL; i++)
+        emu.run_frame();
+    emu.rewind(2);
+    check(emu.frame_count() == before + 2 * INTERVAL, "history goes on after rewinding");
+
+    // a small ring only keeps the newest snapshots
+    Emulator small;
+    Util::File romfile2(argv[1], Util::File::Mode::READ);
+    small.insert_rom(romfile2);
+    small.enable_rewind(64 * 1024, 1);
+    small.power();
+    for (unsigned i = 0; i < 600; i++)
+        small.run_frame();
+    const auto ss = small.rewind_stats();
+    check(ss.memory <= ss.capacity + small.state_size(), "a small ring stays small");
+    const unsigned back = small.rewind(100000);
+    check(back + 1 == ss.snapshots && small.frame_count() == 600 - back, "a small ring keeps the newest snapshots");
+
+    // holding rewind: going back one snapshot and running a frame, over and
+    // over, must keep going back even when every frame is a snapshot
+    for (unsigned i = 0; i < 100; i++)
+        small.run_frame();
+    const auto held = small.frame_count();
+    for (unsigned i = 0; i < 10; i++) {
+        small.rewind(1);
+        small.run_frame();
+    }
+    // ten snapshots back, then the frame after the last one
+    check(small.frame_count() == held - 9, fmt::format("holding rewind goes back (frame {}, expected {})",
+                                                       small.frame_count(), held - 9));
+
+    // the history belongs to the ROM it was recorded with
+    Util::File romfile3(argv[1], Util::File::Mode::READ);
+    small.insert_rom(romfile3);
+    small.power();
+    check(small.rewind_stats().snapshots == 0 && small.rewind(1) == 0, "inserting a ROM empties the history");
+    small.run_frame();
+    check(small.rewind_stats().snapshots == 1, "and it records again");
+
+    if (failures == 0)
+        fmt::print("all tests passed\n");
+    return failures != 0;
+}
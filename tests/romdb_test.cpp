@@ -0,0 +1,126 @@
+/* The ROM database, with the table tools/nes20db_import and tools/romdb_gen
+ * make out of tests/romdb_test.xml: every key in it must be found with the
+ * right values, and keys that aren't there, or that the importer had to
+ * skip, must miss. Then Cartridge must take mapper,
+ * mirroring, battery and RAM sizes from the database over a wrong header,
+ * except when the database's ROM sizes don't match. Exits with 1 on failure. */
+
+#include <algorithm>
+#include <filesystem>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <fmt/core.h>
+#include <emu/core/cartridge.hpp>
+#include <emu/core/romdb.hpp>
+#include <emu/util/file.hpp>
+#include <tests/check.hpp>
+
+using namespace Core;
+
+// every CRC in tests/romdb_test.xml, but for the games at the end
+static const uint32 keys[] = {
+    0x12BFB1FB, 0xA4A63BD0, 0x04C06BB2, 0x9F767C45, 0x4164D839, 0xBDE5C099, 0x5BC8FBBC, 0xCB91CE37,
+    0xB0C11FDE, 0xF1446BEA, 0xD76D4330, 0xBD69FE29, 0xA6EB8C9E, 0xEC1D7DA0, 0x87B0B125, 0x076CE2EF,
+    0xD7210DFF, 0x77330BDB, 0xC6A53877, 0xF17FD374, 0x3FC1EA36, 0xA6233255, 0x0D464138, 0xE6A16A3B,
+    0x2827688D, 0x1CFB10F6, 0x5F2DD97F, 0x7814E8A2, 0xDE527100, 0x3F1F65A8, 0x617959CE, 0x8B33E968,
+    0x1A1AFE87, 0x92EDCF45, 0x3FD42359, 0x035B7399, 0xBB2EDB20, 0x377B9AA2, 0x687C966C, 0x478C281D,
+    0x2E9C82B1, 0xEA959C21, 0xDE11CC9D,
+};
+
+// games the importer skips: Vs. System, trainer, 8k of PRG, 3k of PRG RAM
+// and a mapper that isn't a number
+static const uint32 skipped[] = { 0x5A1E2C3B, 0x6C0FFEE1, 0x7D3E5A90, 0x8E4F6BA1, 0x9F505C12 };
+
+/* An iNES image with mapper 0, horizontal mirroring and no battery. Its
+ * PRG and CHR ROM are the bytes i * 31 + seed, which is what the CRCs in
+ * the table were computed over. */
+static std::vector<uint8> ines(uint8 prg, uint8 chr, uint8 seed)
+{
+    std::vector<uint8> rom = { 'N', 'E', 'S', 0x1A, prg, chr, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+    const std::size_t size = prg * 0x4000u + chr * 0x2000u;
+    for (std::size_t i = 0; i < size; i++)
+        rom.push_back(uint8(i * 31 + seed));
+    return rom;
+}
+
+// loads a ROM through a temporary file
+static bool load(Cartridge &cart, std::vector<uint8> rom)
+{
+    const std::string path = (std::filesystem::temp_directory_path()
+                              / fmt::format("romdb_test.{}.nes", getpid())).string();
+    {
+        Util::File out(path, Util::File::Mode::WRITE);
+        out.bwrite(rom.data(), rom.size());
+    }
+    Util::File f(path, Util::File::Mode::READ);
+    std::filesystem::remove(path);
+    return cart.parse(f);
+}
+
+static void test_lookup()
+{
+    check(romdb_size() == std::size(keys), "table has every entry");
+    bool hits = true, misses = true;
+    for (auto key : keys) {
+        hits = hits && romdb_lookup(key).has_value();
+        for (uint32 other : { key ^ 1, key ^ 0x80000000, key + 0x10000, ~key })
+            if (std::find(std::begin(keys), std::end(keys), other) == std::end(keys))
+                misses = misses && !romdb_lookup(other);
+    }
+    check(hits, "every key is found");
+    check(misses, "keys that aren't there miss");
+    check(!romdb_lookup(0) && !romdb_lookup(0xFFFFFFFF), "0 and FFFFFFFF miss");
+    check(std::none_of(std::begin(skipped), std::end(skipped), [](uint32 key) { return romdb_lookup(key); }),
+          "skipped games miss");
+
+    auto a = romdb_lookup(0x12BFB1FB);
+    check(a && a->prgrom_size == 0x4000 && a->chrrom_size == 0x2000, "ROM sizes");
+    check(a && a->mapper == 1 && a->submapper == 5, "mapper and submapper, from the first game with the CRC");
+    check(a && a->mirroring == Mirroring::VERT && !a->four_screen && a->battery, "mirroring and battery");
+    check(a && a->prgram_size == 0x2000 && a->chrram_size == 0, "RAM sizes");
+    auto b = romdb_lookup(0xA4A63BD0);
+    check(b && b->four_screen && !b->battery && b->chrrom_size == 0 && b->chrram_size == 0x8000,
+          "four screen and CHR RAM");
+    auto filler = romdb_lookup(0xBDE5C099);
+    check(filler && filler->prgrom_size == 512 * 1024 && filler->mapper == 7 && filler->prgram_size == 0x8000,
+          "a filler entry");
+    // its RAM is <prgram>, with battery="1" on the pcb
+    check(filler && filler->battery && filler->chrram_size == 0x2000, "battery from the pcb");
+}
+
+static void test_cartridge()
+{
+    Cartridge a;
+    check(load(a, ines(1, 1, 1)), "ROM A loads");
+    check(a.crc32() == 0x12BFB1FB && a.indatabase(), "ROM A is found");
+    check(a.mappertype() == 1 && a.submappertype() == 5, "ROM A gets its mapper");
+    check(a.mirroring() == Mirroring::VERT && a.hasbattery(), "ROM A gets mirroring and battery");
+    check(a.hasprgram() && a.prgramsize() == 0x2000, "ROM A gets PRG RAM");
+
+    Cartridge b;
+    check(load(b, ines(2, 0, 2)), "ROM B loads");
+    check(b.indatabase() && b.mappertype() == 2 && b.hasfourscreen(), "ROM B gets mapper and four screen");
+    check(!b.hasprgram() && b.haschrram() && b.chrramsize() == 0x8000, "ROM B gets its RAM sizes");
+
+    // the table says 32k of PRG
+    Cartridge c;
+    check(load(c, ines(1, 1, 3)), "ROM C loads");
+    check(c.crc32() == 0x04C06BB2, "ROM C has the CRC in the table");
+    check(!c.indatabase() && c.mappertype() == 0 && c.mirroring() == Mirroring::HORZ,
+          "ROM C keeps its header");
+
+    Cartridge d;
+    check(load(d, ines(1, 1, 4)), "ROM D loads");
+    check(!d.indatabase() && d.mappertype() == 0 && !d.hasbattery(), "ROM D isn't in the table");
+}
+
+int main()
+{
+    test_lookup();
+    test_cartridge();
+    if (failures == 0)
+        fmt::print("all tests passed\n");
+    return failures != 0;
+}
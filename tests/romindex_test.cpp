@@ -0,0 +1,114 @@
+/* The ROM library index: scan_roms() on a directory tree of built-in ROMs
+ * must find .nes files in any case and nothing else, record what's in their
+ * headers, and give files that aren't ROMs an invalid entry. A rescan must
+ * then look again only at files whose size or modification time changed,
+ * drop files that are gone and pick up new ones. Exits with 1 on failure. */
+
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <fmt/core.h>
+#include <unistd.h>
+#include <emu/core/romindex.hpp>
+#include <emu/util/threadpool.hpp>
+#include <tests/check.hpp>
+#include <tests/testrom.hpp>
+
+using namespace Core;
+namespace fs = std::filesystem;
+
+static const unsigned char program[] = {
+    0x4C, 0x00, 0xC0,       // jmp $C000
+};
+
+static void write(const fs::path &path, const std::vector<unsigned char> &data)
+{
+    std::FILE *f = std::fopen(path.string().c_str(), "wb");
+    std::fwrite(data.data(), 1, data.size(), f);
+    std::fclose(f);
+}
+
+static std::string stats_str(const ScanStats &s)
+{
+    return fmt::format("{} files, {} scanned, {} reused, {} invalid", s.files, s.scanned, s.reused, s.invalid);
+}
+
+static bool same(const ScanStats &a, const ScanStats &b)
+{
+    return a.files == b.files && a.scanned == b.scanned && a.reused == b.reused && a.invalid == b.invalid;
+}
+
+int main()
+{
+    const fs::path dir = fs::temp_directory_path() / fmt::format("romindex_test.{}", getpid());
+    const std::string index = (dir.string() + ".idx");
+    fs::remove_all(dir);
+    fs::create_directories(dir / "sub" / "deeper");
+
+    auto nrom = test_rom(program, { .nmi = 0xC000, .reset = 0xC000, .irq = 0xC000 });
+    auto mmc1 = test_rom(program, { .nmi = 0xC000, .reset = 0xC000, .irq = 0xC000 }, 1, 2);
+    mmc1[6] |= 1 | 2;
+    write(dir / "a.nes", nrom);
+    write(dir / "sub" / "B.NES", mmc1);
+    write(dir / "sub" / "deeper" / "c.Nes", nrom);
+    write(dir / "sub" / "broken.nes", { 'n', 'o', 't', ' ', 'a', ' ', 'R', 'O', 'M' });
+    write(dir / "readme.txt", nrom);
+
+    Util::ThreadPool pool(4);
+    ScanStats stats;
+    auto scan = [&](const ScanStats &expected, std::string_view what) {
+        check(scan_roms(dir.string(), index, pool, stats), fmt::format("{}: scans", what));
+        check(same(stats, expected), fmt::format("{}: {}, expected {}", what, stats_str(stats), stats_str(expected)));
+    };
+    scan({ .files = 4, .scanned = 4, .reused = 0, .invalid = 1 }, "first scan");
+
+    RomIndex idx;
+    check(idx.open(index) && idx.size() == 4, "the index opens");
+    const auto *a = idx.find("a.nes");
+    const auto *b = idx.find("sub/B.NES");
+    const auto *broken = idx.find("sub/broken.nes");
+    check(a && b && idx.find("sub/deeper/c.Nes") && broken, "paths are relative to the directory");
+    check(!idx.find("readme.txt"), "only ROM extensions are looked at");
+    check(a && (a->flags & RomIndex::VALID) && a->mapper == 0 && a->prgrom_size == 0x4000
+          && a->size == nrom.size(), "NROM entry");
+    check(b && b->mapper == 1 && b->prgrom_size == 0x8000 && (b->flags & RomIndex::VERT)
+          && (b->flags & RomIndex::BATTERY), "MMC1 entry");
+    check(broken && !(broken->flags & RomIndex::VALID), "a file that isn't a ROM is invalid");
+    idx = {};
+
+    scan({ .files = 4, .scanned = 0, .reused = 4, .invalid = 1 }, "unchanged rescan");
+
+    // another size, with 8k of CHR ROM, and the old time
+    auto grown = nrom;
+    grown[5] = 1;
+    grown.resize(nrom.size() + 0x2000);
+    const auto mtime = fs::last_write_time(dir / "a.nes");
+    write(dir / "a.nes", grown);
+    fs::last_write_time(dir / "a.nes", mtime);
+    scan({ .files = 4, .scanned = 1, .reused = 3, .invalid = 1 }, "rescan after a size change");
+    check(idx.open(index) && idx.find("a.nes") && idx.find("a.nes")->chrrom_size == 0x2000,
+          "the changed file is read again");
+
+    // the same size, another time
+    mmc1[6] &= ~2;
+    write(dir / "sub" / "B.NES", mmc1);
+    fs::last_write_time(dir / "sub" / "B.NES", mtime + std::chrono::seconds(5));
+    scan({ .files = 4, .scanned = 1, .reused = 3, .invalid = 1 }, "rescan after a time change");
+    check(idx.open(index) && idx.find("sub/B.NES") && !(idx.find("sub/B.NES")->flags & RomIndex::BATTERY),
+          "the touched file is read again");
+
+    fs::remove(dir / "sub" / "deeper" / "c.Nes");
+    write(dir / "sub" / "deeper" / "d.nes", nrom);
+    scan({ .files = 4, .scanned = 1, .reused = 3, .invalid = 1 }, "rescan after removing and adding");
+    check(idx.open(index) && !idx.find("sub/deeper/c.Nes") && idx.find("sub/deeper/d.nes"),
+          "removed files go, new ones come");
+
+    idx = {};
+    fs::remove_all(dir);
+    fs::remove(index);
+
+    if (failures == 0)
+        fmt::print("all tests passed\n");
+    return failures != 0;
+}
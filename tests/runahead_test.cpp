@@ -0,0 +1,86 @@
+/* Run-ahead: with N frames ahead, every frame shown must be the one a normal
+ * run shows N frames later, and the real state must stay the same as in a
+ * normal run. Checks both the single instance and the second instance, and
+ * times them. Usage: runahead_test ROM [frames]. Exits with 1 on failure. */
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <fmt/core.h>
+#include <emu/core/emulator.hpp>
+#include <emu/util/file.hpp>
+#include <tests/check.hpp>
+
+using namespace Core;
+
+static bool insert(Emulator &emu, const char *path)
+{
+    Util::File romfile(path, Util::File::Mode::READ);
+    if (!emu.insert_rom(romfile))
+        return false;
+    emu.power();
+    return true;
+}
+
+// hashes of every frame, and the state at the end
+static double run(Emulator &emu, unsigned frames, std::vector<Emulator::FrameHash> &hashes,
+                  std::vector<uint8> &state)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < frames; i++) {
+        emu.run_frame();
+        hashes.push_back(emu.frame_hash());
+    }
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    emu.save_state(state);
+    return elapsed.count() / frames;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        fmt::print("usage: {} ROM [frames]\n", argv[0]);
+        return 1;
+    }
+    const unsigned frames = argc > 2 ? std::stoul(argv[2]) : 600;
+    Emulator normal;
+    if (!insert(normal, argv[1])) {
+        fmt::print("can't load ROM\n");
+        return 1;
+    }
+    std::vector<Emulator::FrameHash> expected;
+    std::vector<uint8> expected_state, tmp;
+    const double base = run(normal, frames, expected, expected_state);
+    // frames further on, for the frames shown ahead
+    run(normal, 2, expected, tmp);
+    fmt::print("{:>16}  {:7.3f} ms/frame\n", "normal", base);
+
+    for (bool second : { false, true }) {
+        for (unsigned ahead : { 1u, 2u }) {
+            // in memory full of garbage, so that anything left uninitialized
+            // shows up as a different state
+            {
+                std::vector<uint8> garbage(sizeof(Emulator), 0xF9);
+            }
+            auto emup = std::make_unique<Emulator>();
+            Emulator &emu = *emup;
+            insert(emu, argv[1]);
+            emu.set_run_ahead(ahead, second);
+            std::vector<Emulator::FrameHash> hashes;
+            std::vector<uint8> state;
+            const double ms = run(emu, frames, hashes, state);
+            const auto what = fmt::format("{} ahead{}", ahead, second ? ", 2nd" : "");
+            fmt::print("{:>16}  {:7.3f} ms/frame\n", what, ms);
+            check(emu.frame_count() == frames, what + ": counts the real frames");
+            check(state == expected_state, what + ": same real state as a normal run");
+            check(std::equal(hashes.begin(), hashes.end(), expected.begin() + ahead),
+                  what + ": shows the frames ahead");
+        }
+    }
+
+    if (failures == 0)
+        fmt::print("all tests passed\n");
+    return failures != 0;
+}
@@ -0,0 +1,140 @@
+/* Battery saves: Util::MappedMemory must create and grow its file but never
+ * shrink it, mark only the pages written to as dirty, have assign() skip
+ * pages that don't change, and leave everything in the file once released.
+ * Then a battery backed ROM must create its .sav next to it with what the
+ * game wrote to PRG RAM, and read it back into PRG RAM when loaded again.
+ * Runs a built-in ROM. Exits with 1 on failure. */
+
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <fmt/core.h>
+#include <unistd.h>
+#include <emu/core/emulator.hpp>
+#include <emu/util/file.hpp>
+#include <tests/check.hpp>
+#include <tests/testrom.hpp>
+
+using namespace Core;
+using Util::MappedMemory;
+
+static const std::size_t PAGE = MappedMemory::PAGE;
+// a .sav has at least the 8k of PRG RAM
+static const std::size_t SAV_SIZE = 0x2000;
+
+// NROM with a battery: copies $6100 to $10, then writes $6000 and $7FFF
+static const uint8 program[] = {
+    0xAD, 0x00, 0x61,       // lda $6100
+    0x85, 0x10,             // sta $10
+    0xA9, 0x42,             // lda #$42
+    0x8D, 0x00, 0x60,       // sta $6000
+    0xA9, 0x99,             // lda #$99
+    0x8D, 0xFF, 0x7F,       // sta $7FFF
+    0x4C, 0x0F, 0xC0,       // jmp $C00F
+    0x40,                   // rti
+};
+
+static std::vector<uint8> file_contents(const std::string &path)
+{
+    std::vector<uint8> out;
+    Util::File f(path, Util::File::Mode::READ);
+    uint8 tmp[4096];
+    while (std::size_t n = f.bread(tmp, sizeof(tmp)))
+        out.insert(out.end(), tmp, tmp + n);
+    return out;
+}
+
+static unsigned count_dirty(const MappedMemory &m)
+{
+    unsigned n = 0;
+    for (std::size_t off = 0; off < m.size(); off += PAGE)
+        n += m.dirty_at(off);
+    return n;
+}
+
+static void test_mapped(const std::string &path)
+{
+    std::filesystem::remove(path);
+    {
+        MappedMemory m;
+        check(m.open(path, 3 * PAGE + 100), "creates the file");
+        check(m.file_backed() && m.size() == 3 * PAGE + 100, "file has the size asked for");
+        check(count_dirty(m) == 0, "nothing is dirty after open");
+
+        m.write(PAGE + 5, 0xAB);
+        m.write(3 * PAGE + 99, 0xCD);
+        check(count_dirty(m) == 2 && m.dirty_at(PAGE) && m.dirty_at(3 * PAGE), "writes mark their pages");
+        m.sync();
+        check(count_dirty(m) == 0, "sync() cleans every page");
+
+        // the same bytes but one in page 2
+        std::vector<uint8> src(m.data(), m.data() + m.size());
+        m.assign(src);
+        check(count_dirty(m) == 0, "assign() of the same bytes dirties nothing");
+        src[2 * PAGE + 7] = 0x11;
+        m.assign(src);
+        check(count_dirty(m) == 1 && m.dirty_at(2 * PAGE), "assign() dirties only the page that changed");
+        check(m.read(2 * PAGE + 7) == 0x11, "assign() copies");
+        // shorter than the memory: the rest stays
+        m.assign(std::span(src).first(10));
+        check(m.read(PAGE + 5) == 0xAB, "a short assign() leaves the rest");
+    }
+    auto saved = file_contents(path);
+    check(saved.size() == 3 * PAGE + 100, "the file keeps its size");
+    check(saved.size() > 3 * PAGE + 99 && saved[PAGE + 5] == 0xAB && saved[2 * PAGE + 7] == 0x11
+          && saved[3 * PAGE + 99] == 0xCD, "releasing leaves everything in the file");
+
+    MappedMemory again;
+    check(again.open(path, PAGE) && again.size() == 3 * PAGE + 100, "a smaller size doesn't shrink the file");
+    check(again.read(PAGE + 5) == 0xAB, "opening reads the file");
+}
+
+static void test_cartridge(const std::string &rompath, const std::string &savpath)
+{
+    auto rom = test_rom(program, { .nmi = 0xC012, .reset = 0xC000, .irq = 0xC012 });
+    rom[6] |= 2;
+    {
+        std::FILE *f = std::fopen(rompath.c_str(), "wb");
+        std::fwrite(rom.data(), 1, rom.size(), f);
+        std::fclose(f);
+    }
+    std::filesystem::remove(savpath);
+
+    auto run = [&](const char *what) {
+        Emulator emu;
+        Util::File romfile(rompath, Util::File::Mode::READ);
+        check(emu.insert_rom(romfile), fmt::format("{}: ROM loads", what));
+        emu.power();
+        emu.run_frame();
+        return emu.cpu_ram()[0x10];
+    };
+    run("first run");
+    auto sav = file_contents(savpath);
+    check(sav.size() == SAV_SIZE, "the .sav is created, as big as PRG RAM");
+    check(sav.size() == SAV_SIZE && sav[0] == 0x42 && sav[0x1FFF] == 0x99,
+          "the .sav has what the game wrote");
+
+    {
+        MappedMemory m;
+        m.open(savpath, 0);
+        m.write(0x100, 0x77);
+    }
+    check(run("second run") == 0x77, "the .sav is read back into PRG RAM");
+    sav = file_contents(savpath);
+    check(sav.size() == SAV_SIZE && sav[0x100] == 0x77 && sav[0] == 0x42,
+          "the .sav keeps what's in it");
+}
+
+int main()
+{
+    const auto dir = std::filesystem::temp_directory_path();
+    const std::string base = (dir / fmt::format("save_test.{}", getpid())).string();
+    test_mapped(base + ".bin");
+    test_cartridge(base + ".nes", base + ".sav");
+    for (const char *ext : { ".bin", ".nes", ".sav" })
+        std::filesystem::remove(base + ext);
+
+    if (failures == 0)
+        fmt::print("all tests passed\n");
+    return failures != 0;
+}
@@ -0,0 +1,181 @@
+/* Save state round trip: a state saved at some frame, loaded back (into the
+ * same emulator or a new one), must give the same frames and the same state
+ * as running on without it. Also times saving and loading.
+ * Runs the ROM given on the command line, or a small built-in MMC3 program
+ * that keeps changing RAM, PRG RAM, CHR RAM, OAM, the palette and the bank
+ * registers, with the scanline IRQ enabled. Exits with 1 on failure. */
+
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <fmt/core.h>
+#include <emu/core/emulator.hpp>
+#include <emu/util/file.hpp>
+#include <tests/check.hpp>
+#include <tests/testrom.hpp>
+
+using namespace Core;
+
+static const unsigned char program[] = {
+    // reset, $C000
+    0x78,                   // sei
+    0xD8,                   // cld
+    0xA2, 0xFF,             // ldx #$FF
+    0x9A,                   // txs
+    0xA9, 0x88,             // lda #$88     nmi on, sprites at $1000
+    0x8D, 0x00, 0x20,       // sta $2000
+    0xA9, 0x1E,             // lda #$1E
+    0x8D, 0x01, 0x20,       // sta $2001
+    0xA9, 0x10,             // lda #$10
+    0x8D, 0x00, 0xC0,       // sta $C000    irq latch
+    0x8D, 0x01, 0xC0,       // sta $C001
+    0x8D, 0x01, 0xE0,       // sta $E001    irq on
+    0x58,                   // cli
+    // loop, $C01B
+    0xE8,                   // inx
+    0x8A,                   // txa
+    0x65, 0x12,             // adc $12
+    0x85, 0x10,             // sta $10
+    0x9D, 0x00, 0x03,       // sta $0300,x
+    0x9D, 0x00, 0x60,       // sta $6000,x
+    0x8D, 0x04, 0x20,       // sta $2004
+    0x29, 0x07,             // and #$07
+    0x8D, 0x00, 0x80,       // sta $8000
+    0xA5, 0x10,             // lda $10
+    0x8D, 0x01, 0x80,       // sta $8001
+    0x4C, 0x1B, 0xC0,       // jmp $C01B
+    // nmi, $C037
+    0x48,                   // pha
+    0xA9, 0x3F,             // lda #$3F
+    0x8D, 0x06, 0x20,       // sta $2006
+    0xA9, 0x00,             // lda #$00
+    0x8D, 0x06, 0x20,       // sta $2006
+    0xA5, 0x10,             // lda $10
+    0x8D, 0x07, 0x20,       // sta $2007    palette
+    0xA9, 0x00,             // lda #$00
+    0x8D, 0x06, 0x20,       // sta $2006
+    0xA5, 0x11,             // lda $11
+    0x8D, 0x06, 0x20,       // sta $2006
+    0xE6, 0x11,             // inc $11
+    0xA5, 0x10,             // lda $10
+    0x8D, 0x07, 0x20,       // sta $2007    chr ram
+    0xA9, 0x00,             // lda #$00
+    0x8D, 0x05, 0x20,       // sta $2005
+    0x8D, 0x05, 0x20,       // sta $2005
+    0xA9, 0x88,             // lda #$88
+    0x8D, 0x00, 0x20,       // sta $2000
+    0x68,                   // pla
+    0x40,                   // rti
+    // irq, $C067
+    0x8D, 0x00, 0xE0,       // sta $E000
+    0x8D, 0x01, 0xE0,       // sta $E001
+    0xE6, 0x12,             // inc $12
+    0x40,                   // rti
+};
+
+static bool insert(Emulator &emu, const char *path)
+{
+    Util::File romfile;
+    if (path)
+        romfile.open(path, Util::File::Mode::READ);
+    else
+        // 32k PRG, CHR RAM, mapper 4
+        romfile.assoc(test_rom_file(test_rom(program, { .nmi = 0xC037, .reset = 0xC000, .irq = 0xC067 }, 4, 2)));
+    bool ok = emu.insert_rom(romfile);
+    if (ok)
+        emu.power();
+    return ok;
+}
+
+static std::vector<Emulator::FrameHash> run(Emulator &emu, unsigned frames)
+{
+    std::vector<Emulator::FrameHash> hashes;
+    for (unsigned i = 0; i < frames; i++) {
+        emu.run_frame();
+        hashes.push_back(emu.frame_hash());
+    }
+    return hashes;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *path = argc > 1 ? argv[1] : nullptr;
+    auto a = std::make_unique<Emulator>();
+    if (!insert(*a, path)) {
+        fmt::print("can't load ROM\n");
+        return 1;
+    }
+
+    run(*a, 30);
+    std::vector<uint8> start, end, again;
+    a->save_state(start);
+    check(start.size() == a->state_size(), "state_size() matches the saved size");
+    auto hashes = run(*a, 120);
+    a->save_state(end);
+
+    check(a->load_state(start), "load into the same emulator");
+    check(run(*a, 120) == hashes, "same frames after loading");
+    a->save_state(again);
+    check(again == end, "same state after loading");
+
+    auto b = std::make_unique<Emulator>();
+    insert(*b, path);
+    run(*b, 7);
+    check(b->load_state(start), "load into another emulator");
+    check(run(*b, 120) == hashes, "same frames in another emulator");
+    b->save_state(again);
+    check(again == end, "same state in another emulator");
+
+    check(b->load_state(end), "load again");
+    b->save_state(again);
+    check(again == end, "save after load gives the same state");
+
+    // nothing is left uninitialized: fresh emulators start out the same, even
+    // when one of them gets memory full of garbage
+    auto d = std::make_unique<Emulator>();
+    {
+        std::vector<uint8> garbage(sizeof(Emulator), 0xF9);
+    }
+    auto c = std::make_unique<Emulator>();
+    insert(*c, path);
+    insert(*d, path);
+    std::vector<uint8> sc, sd;
+    c->save_state(sc);
+    d->save_state(sd);
+    check(sc == sd, "two emulators power on in the same state");
+    run(*c, 10);
+    run(*d, 10);
+    c->save_state(sc);
+    d->save_state(sd);
+    check(sc == sd, "two emulators run to the same state");
+
+    fmt::print("expected errors:\n");
+    auto bad = end;
+    bad.pop_back();
+    check(!b->load_state(bad), "short state is rejected");
+    bad = end;
+    bad[8]++;
+    check(!b->load_state(bad), "other version is rejected");
+    bad = end;
+    bad[16]++;
+    check(!b->load_state(bad), "state for another ROM is rejected");
+    b->save_state(again);
+    check(again == end, "rejected states change nothing");
+
+    const unsigned N = 20000;
+    using clock = std::chrono::steady_clock;
+    auto t0 = clock::now();
+    for (unsigned i = 0; i < N; i++)
+        a->save_state(again);
+    auto t1 = clock::now();
+    for (unsigned i = 0; i < N; i++)
+        a->load_state(start);
+    auto t2 = clock::now();
+    auto us = [](auto d) { return std::chrono::duration<double, std::micro>(d).count() / N; };
+    fmt::print("state size {} bytes, save {:.2f}us, load {:.2f}us\n",
+               end.size(), us(t1 - t0), us(t2 - t1));
+
+    if (failures == 0)
+        fmt::print("all tests passed\n");
+    return failures != 0;
+}
@@ -0,0 +1,47 @@
+#ifndef TESTS_TESTROM_HPP_INCLUDED
+#define TESTS_TESTROM_HPP_INCLUDED
+
+/* Tiny iNES images for the tests that can run without a real ROM: program
+ * goes at $C000, the vectors at the end of PRG ROM, and there's 8k of CHR
+ * RAM. PRG ROM is prg_banks 16k banks; with more than one, $C000 is the
+ * start of the last. */
+
+#include <algorithm>
+#include <cstdio>
+#include <span>
+#include <vector>
+
+struct TestVectors {
+    unsigned nmi, reset, irq;
+};
+
+inline std::vector<unsigned char> test_rom(std::span<const unsigned char> program, TestVectors v,
+                                           unsigned mapper = 0, unsigned prg_banks = 1)
+{
+    std::vector<unsigned char> rom = {
+        'N', 'E', 'S', 0x1A, static_cast<unsigned char>(prg_banks), 0,
+        static_cast<unsigned char>(mapper << 4 & 0xF0), static_cast<unsigned char>(mapper & 0xF0),
+    };
+    rom.resize(16 + prg_banks * 0x4000);
+    std::copy(program.begin(), program.end(), rom.end() - 0x4000);
+    const unsigned char vectors[] = {
+        static_cast<unsigned char>(v.nmi),   static_cast<unsigned char>(v.nmi >> 8),
+        static_cast<unsigned char>(v.reset), static_cast<unsigned char>(v.reset >> 8),
+        static_cast<unsigned char>(v.irq),   static_cast<unsigned char>(v.irq >> 8),
+    };
+    std::copy(std::begin(vectors), std::end(vectors), rom.end() - 6);
+    return rom;
+}
+
+// the same ROM in a temporary file, for Util::File::assoc()
+inline std::FILE *test_rom_file(std::span<const unsigned char> rom)
+{
+    std::FILE *f = std::tmpfile();
+    if (f) {
+        std::fwrite(rom.data(), 1, rom.size(), f);
+        std::rewind(f);
+    }
+    return f;
+}
+
+#endif
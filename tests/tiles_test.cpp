@@ -0,0 +1,128 @@
+/* CHR RAM write tracking: a write that doesn't change a byte mustn't give
+ * its tile a new generation, changing N different tiles in a frame (each
+ * several times) must make tiles_rewritten() N for that frame and 0 for the
+ * next, and CHR RAM replaced from a state must give new generations to
+ * exactly the tiles that differ. The last part also runs through
+ * Emulator::copy_state(), with a built-in ROM that fills the first 16 tiles
+ * of CHR RAM in its first frame. Exits with 1 on failure. */
+
+#include <algorithm>
+#include <vector>
+#include <fmt/core.h>
+#include <emu/core/emulator.hpp>
+#include <emu/core/mapper.hpp>
+#include <tests/check.hpp>
+#include <tests/testrom.hpp>
+
+using namespace Core;
+
+static const unsigned TILE = Mapper::TILE_SIZE;
+
+// NROM: writes 1-255 to CHR RAM from $0000 on, then loops
+static const uint8 program[] = {
+    0xA9, 0x00,             // lda #0
+    0x8D, 0x06, 0x20,       // sta $2006
+    0x8D, 0x06, 0x20,       // sta $2006
+    0xA2, 0x00,             // ldx #0
+    0xE8,                   // inx
+    0x8E, 0x07, 0x20,       // stx $2007
+    0xD0, 0xFA,             // bne $C00A
+    0x4C, 0x10, 0xC0,       // jmp $C010
+    0x40,                   // rti
+};
+
+// tiles with a generation after gen
+static std::vector<unsigned> changed_since(const Mapper &m, uint32 gen)
+{
+    std::vector<unsigned> tiles;
+    const auto gens = m.tile_generations();
+    for (unsigned i = 0; i < gens.size(); i++)
+        if (gens[i] > gen)
+            tiles.push_back(i);
+    return tiles;
+}
+
+static void test_writes()
+{
+    std::vector<uint8> prg(0x4000), chrram(0x2000);
+    auto m = Mapper::create(0, prg, chrram, chrram);
+    check(m->tile_generations().size() == 0x2000 / TILE, "a generation for every tile");
+
+    // CHR RAM starts zeroed
+    for (unsigned addr = 0; addr < 0x2000; addr += 7)
+        m->write_chr(addr, 0);
+    m->end_frame();
+    check(m->chr_generation() == 0 && changed_since(*m, 0).empty(), "writing the same value changes no generation");
+    check(m->tiles_rewritten() == 0, "writing the same value rewrites no tile");
+
+    // 37 tiles spread out, every byte of each written twice
+    const unsigned n = 37;
+    std::vector<unsigned> tiles;
+    for (unsigned i = 0; i < n; i++)
+        tiles.push_back(i * 13 % (0x2000 / TILE));
+    std::sort(tiles.begin(), tiles.end());
+    for (unsigned pass = 1; pass <= 2; pass++)
+        for (auto t : tiles)
+            for (unsigned b = 0; b < TILE; b++)
+                m->write_chr(t * TILE + b, pass + b);
+    check(m->chr_generation() == 2 * n * TILE, "every write that changes a byte is a generation");
+    check(changed_since(*m, 0) == tiles, "only the tiles written have new generations");
+    check(m->tiles_rewritten() == 0, "tiles_rewritten() is for the last whole frame");
+    m->end_frame();
+    check(m->tiles_rewritten() == n, fmt::format("{} tiles rewritten, expected {}", m->tiles_rewritten(), n));
+    m->end_frame();
+    check(m->tiles_rewritten() == 0, "a frame without writes rewrites nothing");
+
+    // replacing CHR RAM with a copy that differs in 3 tiles, one of them by
+    // its last byte only
+    const uint32 before = m->chr_generation();
+    std::vector<uint8> copy = chrram;
+    copy[5 * TILE] ^= 1;
+    copy[100 * TILE + 3] ^= 0x80;
+    copy[511 * TILE + TILE - 1] = 9;
+    m->chrram_replaced(copy);
+    std::copy(copy.begin(), copy.end(), chrram.begin());
+    check(changed_since(*m, before) == std::vector<unsigned> { 5, 100, 511 }, "a replaced CHR RAM marks the tiles that differ");
+    m->end_frame();
+    check(m->tiles_rewritten() == 3, "replaced tiles count as rewritten");
+    m->chrram_replaced(copy);
+    check(m->chr_generation() == before + 3, "replacing with the same CHR RAM marks nothing");
+
+    // CHR ROM
+    std::vector<uint8> chrrom(0x2000, 0x55);
+    auto rom = Mapper::create(0, prg, chrrom, {});
+    rom->write_chr(0, 1);
+    check(rom->tile_generations().empty() && rom->chr_generation() == 0 && rom->read_chr(0) == 0x55,
+          "CHR ROM has no generations and ignores writes");
+}
+
+static void test_copy_state()
+{
+    const auto rom = test_rom(program, { .nmi = 0xC013, .reset = 0xC000, .irq = 0xC013 });
+    Emulator a, b;
+    check(a.insert_rom(rom) && b.insert_rom(rom), "ROM loads");
+    a.power();
+    b.power();
+    a.run_frame();
+    check(a.tiles_rewritten() == 16, fmt::format("the ROM rewrites 16 tiles ({})", a.tiles_rewritten()));
+    a.run_frame();
+    check(a.tiles_rewritten() == 0, "and then none");
+
+    // b hasn't run: its CHR RAM is still zeroed
+    check(b.copy_state(a), "copy_state() works");
+    b.run_frame();
+    check(b.tiles_rewritten() == 16, fmt::format("copy_state() marks the 16 tiles that changed ({})", b.tiles_rewritten()));
+    check(b.copy_state(a), "copy_state() works again");
+    b.run_frame();
+    check(b.tiles_rewritten() == 0, "copying the same CHR RAM marks nothing");
+}
+
+int main()
+{
+    test_writes();
+    test_copy_state();
+
+    if (failures == 0)
+        fmt::print("all tests passed\n");
+    return failures != 0;
+}
@@ -0,0 +1,149 @@
+/* VecEmulator: actions must reach each environment's controller, stepping
+ * together must give what stepping alone gives, and episodes must restart
+ * from the start state. Then reports environment frames per second, in all
+ * and per thread. Runs a tiny built-in ROM that reads the controller every
+ * frame, or the ROM given on the command line for the timing.
+ * Usage: vecemu_bench [ROM] [envs] [steps]. Exits with 1 on failure. */
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fmt/core.h>
+#include <emu/core/vecemulator.hpp>
+#include <emu/util/easyrandom.hpp>
+#include <emu/util/file.hpp>
+#include <tests/check.hpp>
+#include <tests/testrom.hpp>
+
+using namespace Core;
+
+// NROM. Every NMI reads the buttons into $00, adds them to $01 and counts
+// frames in $02.
+static const unsigned char program[] = {
+    0xA9, 0x80,             // lda #$80
+    0x8D, 0x00, 0x20,       // sta $2000
+    0x4C, 0x05, 0xC0,       // jmp $C005
+    0xA9, 0x01,             // nmi: lda #1
+    0x8D, 0x16, 0x40,       // sta $4016
+    0xA9, 0x00,             // lda #0
+    0x8D, 0x16, 0x40,       // sta $4016
+    0xA2, 0x08,             // ldx #8
+    0xAD, 0x16, 0x40,       // lda $4016
+    0x4A,                   // lsr a
+    0x66, 0x00,             // ror $00
+    0xCA,                   // dex
+    0xD0, 0xF7,             // bne $C014
+    0xA5, 0x00,             // lda $00
+    0x18,                   // clc
+    0x65, 0x01,             // adc $01
+    0x85, 0x01,             // sta $01
+    0xE6, 0x02,             // inc $02
+    0x40,                   // rti
+};
+
+static bool insert(Emulator &emu, Util::File &romfile)
+{
+    if (!emu.insert_rom(romfile))
+        return false;
+    emu.power();
+    emu.run_frame();
+    return true;
+}
+
+static void tests(const Emulator &emu)
+{
+    const unsigned n = 8;
+    auto vec = VecEmulator::create(emu, n, { .downsample = 4, .max_frames = 100 });
+    check(vec && vec->frame_width() == 64 && vec->frame_height() == 60, "creates all environments");
+    if (!vec)
+        return;
+    check(vec->observations().size() == n * (RAM_SIZE + 64 * 60 + 1), "observations are in one buffer");
+
+    // one environment on its own, with the same actions as environment 3
+    auto alone = emu.clone();
+    Util::Random rng;
+    std::vector<uint8> actions(n);
+    bool reached = true;
+    for (unsigned step = 1; step <= 99; step++) {
+        for (auto &a : actions)
+            a = rng.random8();
+        vec->step(actions);
+        alone->set_buttons(0, actions[3]);
+        alone->run_frame();
+        // the game reads the controller at the start of the frame
+        for (unsigned i = 0; i < n && step > 1; i++)
+            reached = reached && vec->ram()[i * RAM_SIZE] == actions[i];
+    }
+    check(reached, "actions reach the controllers");
+    check(std::equal(alone->cpu_ram().begin(), alone->cpu_ram().end(), vec->ram().begin() + 3 * RAM_SIZE),
+          "an environment has the same RAM as one running alone");
+    check(std::none_of(vec->dones().begin(), vec->dones().end(), [](uint8 d) { return d; }), "no episode ended yet");
+
+    vec->step(actions);
+    check(std::all_of(vec->dones().begin(), vec->dones().end(), [](uint8 d) { return d == 1; }),
+          "episodes end after max_frames");
+    check(std::equal(emu.cpu_ram().begin(), emu.cpu_ram().end(), vec->ram().begin() + 5 * RAM_SIZE),
+          "an ended episode shows the start state");
+    std::vector<uint8> a, b;
+    vec->env(5).save_state(a);
+    emu.save_state(b);
+    check(a == b, "an ended episode restarts from the start state");
+
+    // ends when the sum of the buttons in $01 wraps around; only press on odd envs
+    auto vec2 = VecEmulator::create(emu, n, { .done = [](std::span<const uint8> ram) { return ram[1] >= 0xF0; } });
+    for (unsigned i = 0; i < n; i++)
+        actions[i] = i % 2 ? 0x10 : 0;
+    bool odd_ended = false, even_ended = false;
+    for (unsigned step = 0; step < 20; step++) {
+        vec2->step(actions);
+        for (unsigned i = 0; i < n; i++)
+            (i % 2 ? odd_ended : even_ended) |= vec2->dones()[i];
+    }
+    check(odd_ended && !even_ended, "episodes end on their own condition");
+}
+
+int main(int argc, char *argv[])
+{
+    Util::File romfile;
+    if (argc > 1)
+        romfile.open(argv[1], Util::File::Mode::READ);
+    Util::File builtin;
+    builtin.assoc(test_rom_file(test_rom(program, { .nmi = 0xC008, .reset = 0xC000, .irq = 0xC026 })));
+    Emulator emu;
+    if (!insert(emu, builtin)) {
+        fmt::print("can't load the built-in ROM\n");
+        return 1;
+    }
+    tests(emu);
+
+    Emulator timed;
+    if (argc > 1 && !insert(timed, romfile)) {
+        fmt::print("can't load ROM\n");
+        return 1;
+    }
+    const unsigned n     = argc > 2 ? std::stoul(argv[2]) : 64;
+    const unsigned steps = argc > 3 ? std::stoul(argv[3]) : 60;
+    const unsigned cores = std::max(std::thread::hardware_concurrency(), 1u);
+    for (unsigned threads : { 1u, cores }) {
+        auto vec = VecEmulator::create(argc > 1 ? timed : emu, n, { .max_frames = 1000, .threads = threads });
+        std::vector<uint8> actions(n);
+        Util::Random rng;
+        const auto start = std::chrono::steady_clock::now();
+        for (unsigned s = 0; s < steps; s++) {
+            for (auto &a : actions)
+                a = rng.random8();
+            vec->step(actions);
+        }
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        const double fps = double(n) * steps / elapsed.count();
+        fmt::print("{} envs on {} threads: {:.0f} env-frames/s, {:.0f} per thread\n", n, threads, fps, fps / threads);
+        if (cores == 1)
+            break;
+    }
+
+    if (failures == 0)
+        fmt::print("all tests passed\n");
+    return failures != 0;
+}
@@ -0,0 +1,200 @@
+/* Converts the NES 2.0 database (nes20db.xml) to the format of
+ * data/romdb.txt. Usage: nes20db_import <nes20db.xml> <romdb.txt>
+ *
+ * The comment lines at the top of the output file are kept; everything
+ * after them is replaced by the imported games, sorted by CRC. Games that
+ * don't fit the table are skipped and counted:
+ *  - games for other consoles (Vs. System, PlayChoice-10, ...);
+ *  - ROMs with a trainer or other ROM besides PRG and CHR, whose CRC isn't
+ *    the one Cartridge computes;
+ *  - ROM sizes that aren't multiples of 16k (PRG) and 8k (CHR), and RAM
+ *    sizes that aren't 64 << n;
+ *  - a CRC that's already there: the first game with it wins. */
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fmt/core.h>
+
+struct Game {
+    unsigned long crc;
+    std::string line;
+};
+
+// value of attribute name in the first <tag ...> of a game
+static std::optional<std::string> attr(std::string_view game, std::string_view tag, std::string_view name)
+{
+    const std::string open = fmt::format("<{} ", tag);
+    const auto start = game.find(open);
+    if (start == game.npos)
+        return std::nullopt;
+    const auto elem = game.substr(start, game.find('>', start) - start);
+    const std::string key = fmt::format(" {}=\"", name);
+    const auto pos = elem.find(key);
+    if (pos == elem.npos)
+        return std::nullopt;
+    const auto value = pos + key.size();
+    const auto end = elem.find('"', value);
+    if (end == elem.npos)
+        return std::nullopt;
+    return std::string(elem.substr(value, end - value));
+}
+
+// a number attribute, 0 if the element or attribute isn't there
+static std::optional<unsigned long> number(std::string_view game, std::string_view tag, std::string_view name,
+                                           int base = 10)
+{
+    auto s = attr(game, tag, name);
+    if (!s)
+        return 0;
+    try {
+        std::size_t end;
+        unsigned long n = std::stoul(*s, &end, base);
+        if (end == s->size())
+            return n;
+    } catch (...) { }
+    return std::nullopt;
+}
+
+// the comment has the file's path: keep the name without the extension
+static std::string title(std::string_view game)
+{
+    const auto start = game.find("<!--");
+    const auto end = game.find("-->");
+    if (start == game.npos || end == game.npos || end < start)
+        return "";
+    auto path = game.substr(start + 4, end - start - 4);
+    if (auto slash = path.find_last_of("/\\"); slash != path.npos)
+        path.remove_prefix(slash + 1);
+    if (auto dot = path.rfind('.'); dot != path.npos)
+        path = path.substr(0, dot);
+    while (!path.empty() && path.front() == ' ')
+        path.remove_prefix(1);
+    while (!path.empty() && path.back() == ' ')
+        path.remove_suffix(1);
+    return std::string(path);
+}
+
+// "32k" when it can, like the sizes written by hand
+static std::string size_str(unsigned long size)
+{
+    return size % 1024 == 0 && size != 0 ? fmt::format("{}k", size / 1024) : fmt::format("{}", size);
+}
+
+static bool ram_ok(unsigned long size)
+{
+    for (int n = 1; n < 16; n++)
+        if (64ul << n == size)
+            return true;
+    return size == 0;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 3) {
+        fmt::print(stderr, "usage: {} <nes20db.xml> <romdb.txt>\n", argv[0]);
+        return 1;
+    }
+    std::ifstream in(argv[1]);
+    if (!in) {
+        fmt::print(stderr, "can't open {}\n", argv[1]);
+        return 1;
+    }
+    std::stringstream ss;
+    ss << in.rdbuf();
+    const std::string xml = ss.str();
+
+    std::string header;
+    if (std::ifstream old(argv[2]); old)
+        for (std::string line; std::getline(old, line) && (line.empty() || line[0] == '#'); )
+            header += line + '\n';
+
+    std::map<std::string, unsigned> skipped;
+    std::vector<Game> games;
+    unsigned total = 0;
+    for (std::size_t pos = 0; (pos = xml.find("<game>", pos)) != xml.npos; ) {
+        const auto end = xml.find("</game>", pos);
+        if (end == xml.npos) {
+            fmt::print(stderr, "{}: <game> at offset {} isn't closed\n", argv[1], pos);
+            return 1;
+        }
+        const std::string_view game = std::string_view(xml).substr(pos, end - pos);
+        pos = end;
+        total++;
+
+        auto rom       = number(game, "rom",      "size");
+        auto crc       = number(game, "rom",      "crc32", 16);
+        auto prg       = number(game, "prgrom",   "size");
+        auto chr       = number(game, "chrrom",   "size");
+        auto prgram    = number(game, "prgram",   "size");
+        auto prgnvram  = number(game, "prgnvram", "size");
+        auto chrram    = number(game, "chrram",   "size");
+        auto chrnvram  = number(game, "chrnvram", "size");
+        auto mapper    = number(game, "pcb",      "mapper");
+        auto submapper = number(game, "pcb",      "submapper");
+        auto battery   = number(game, "pcb",      "battery");
+        auto console   = number(game, "console",  "type");
+        auto mirroring = attr(game, "pcb", "mirroring");
+        if (!rom || !crc || !prg || !chr || !prgram || !prgnvram || !chrram || !chrnvram
+         || !mapper || !submapper || !battery || !console || !mirroring || !attr(game, "rom", "crc32")
+         || *mapper > 0xFFF || *submapper > 0xF) {
+            skipped["missing or bad values"]++;
+            continue;
+        }
+        if (*console != 0) {
+            skipped["not for the NES or Famicom"]++;
+            continue;
+        }
+        if (*rom != *prg + *chr) {
+            skipped["trainer or other ROM"]++;
+            continue;
+        }
+        if (*prg == 0 || *prg % 0x4000 != 0 || *chr % 0x2000 != 0) {
+            skipped["odd ROM sizes"]++;
+            continue;
+        }
+        // one size each in Cartridge, battery backed or not
+        const unsigned long prgram_size = std::max(*prgram, *prgnvram);
+        const unsigned long chrram_size = std::max(*chrram, *chrnvram);
+        if (!ram_ok(prgram_size) || !ram_ok(chrram_size)) {
+            skipped["odd RAM sizes"]++;
+            continue;
+        }
+
+        const std::string mapper_str = *submapper ? fmt::format("{}.{}", *mapper, *submapper)
+                                                  : fmt::format("{}", *mapper);
+        // "H", "V" or "4"; anything else is up to the mapper
+        const std::string mirr = *mirroring == "V" || *mirroring == "4" ? *mirroring : "H";
+        games.push_back({ *crc, fmt::format("{:08X}    {:<6} {:<5} {:<7} {:<4} {:<3} {:<6} {:<6} {}",
+            *crc, size_str(*prg), size_str(*chr), mapper_str, mirr, *battery || *prgnvram || *chrnvram ? 1 : 0,
+            size_str(prgram_size), size_str(chrram_size), title(game)) });
+    }
+
+    std::stable_sort(games.begin(), games.end(), [](const Game &a, const Game &b) { return a.crc < b.crc; });
+    auto dup = std::unique(games.begin(), games.end(), [](const Game &a, const Game &b) { return a.crc == b.crc; });
+    if (dup != games.end()) {
+        skipped["CRC already there"] += games.end() - dup;
+        games.erase(dup, games.end());
+    }
+
+    std::FILE *out = std::fopen(argv[2], "w");
+    if (!out) {
+        fmt::print(stderr, "can't write {}\n", argv[2]);
+        return 1;
+    }
+    fmt::print(out, "{}", header);
+    for (const auto &g : games)
+        fmt::print(out, "{}\n", g.line);
+    std::fclose(out);
+
+    fmt::print(stderr, "{} games, {} imported\n", total, games.size());
+    for (const auto &[why, count] : skipped)
+        fmt::print(stderr, "{:6} skipped: {}\n", count, why);
+    return 0;
+}
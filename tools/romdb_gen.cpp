@@ -0,0 +1,222 @@
+/* Builds emu/core/romdb_table.inc out of data/romdb.txt (see that file for
+ * the format). Usage: romdb_gen <input> <output>
+ *
+ * The table is a hash-and-displace perfect hash: keys are first split into
+ * buckets, then, biggest bucket first, each bucket gets the first seed that
+ * sends all of its keys to free slots. A lookup only has to hash the key
+ * twice. */
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <fmt/core.h>
+#include <emu/core/romdb.hpp>
+
+using Core::romdb_hash;
+
+struct Game {
+    uint32 crc;
+    unsigned prg, chr, mapper, ram, flags;
+    std::string title;
+};
+
+static int errors = 0;
+
+template <typename... T>
+static void error_at(const std::string &file, int line, fmt::format_string<T...> fmt, T&&... args)
+{
+    fmt::print(stderr, "{}:{}: ", file, line);
+    fmt::print(stderr, fmt, std::forward<T>(args)...);
+    fmt::print(stderr, "\n");
+    errors++;
+}
+
+// "256k", "8192" -> bytes. returns false on garbage.
+static bool parse_size(const std::string &s, unsigned long &out)
+{
+    std::size_t end;
+    try {
+        out = std::stoul(s, &end, 10);
+    } catch (...) {
+        return false;
+    }
+    if (end < s.size() && (s[end] == 'k' || s[end] == 'K')) {
+        out *= 1024;
+        end++;
+    }
+    return end == s.size();
+}
+
+// NES 2.0 style shift count: 0 for none, otherwise size = 64 << n.
+static int ram_shift(unsigned long size)
+{
+    if (size == 0)
+        return 0;
+    for (int n = 1; n < 16; n++)
+        if (64ul << n == size)
+            return n;
+    return -1;
+}
+
+static std::vector<Game> read_db(const std::string &filename)
+{
+    std::ifstream in(filename);
+    if (!in) {
+        fmt::print(stderr, "can't open {}\n", filename);
+        std::exit(1);
+    }
+    std::vector<Game> games;
+    std::string line;
+    for (int lineno = 1; std::getline(in, line); lineno++) {
+        auto start = line.find_first_not_of(" \t");
+        if (start == line.npos || line[start] == '#')
+            continue;
+        std::istringstream ss(line);
+        std::string crc, prg, chr, mapper, mirroring, battery, prgram, chrram;
+        if (!(ss >> crc >> prg >> chr >> mapper >> mirroring >> battery >> prgram >> chrram)) {
+            error_at(filename, lineno, "expected 8 fields");
+            continue;
+        }
+        Game g;
+        std::getline(ss >> std::ws, g.title);
+
+        unsigned long val = 0;
+        std::size_t end = 0;
+        try { val = std::stoul(crc, &end, 16); } catch (...) { }
+        if (crc.size() != 8 || end != 8) {
+            error_at(filename, lineno, "bad crc \"{}\"", crc);
+            continue;
+        }
+        g.crc = val;
+
+        unsigned long prg_bytes, chr_bytes, prgram_bytes, chrram_bytes;
+        if (!parse_size(prg, prg_bytes) || prg_bytes == 0 || prg_bytes % 0x4000 != 0 || prg_bytes / 0x4000 > 0xFFFF)
+            error_at(filename, lineno, "bad PRG ROM size \"{}\", must be a non-zero multiple of 16k", prg);
+        if (!parse_size(chr, chr_bytes) || chr_bytes % 0x2000 != 0 || chr_bytes / 0x2000 > 0xFFFF)
+            error_at(filename, lineno, "bad CHR ROM size \"{}\", must be a multiple of 8k", chr);
+        if (!parse_size(prgram, prgram_bytes) || ram_shift(prgram_bytes) < 0)
+            error_at(filename, lineno, "bad PRG RAM size \"{}\", must be 0 or 64 << n", prgram);
+        if (!parse_size(chrram, chrram_bytes) || ram_shift(chrram_bytes) < 0)
+            error_at(filename, lineno, "bad CHR RAM size \"{}\", must be 0 or 64 << n", chrram);
+
+        unsigned long mapper_num = 0, submapper = 0;
+        auto dot = mapper.find('.');
+        try {
+            mapper_num = std::stoul(mapper.substr(0, dot));
+            if (dot != mapper.npos)
+                submapper = std::stoul(mapper.substr(dot + 1));
+        } catch (...) {
+            mapper_num = 0x1000;
+        }
+        if (mapper_num > 0xFFF || submapper > 0xF)
+            error_at(filename, lineno, "bad mapper \"{}\"", mapper);
+
+        g.flags = 0;
+        if (mirroring == "V")
+            g.flags |= 1;
+        else if (mirroring == "4")
+            g.flags |= 2;
+        else if (mirroring != "H")
+            error_at(filename, lineno, "mirroring must be H, V or 4");
+        if (battery == "1")
+            g.flags |= 4;
+        else if (battery != "0")
+            error_at(filename, lineno, "battery must be 0 or 1");
+
+        if (errors)
+            continue;
+        g.prg = prg_bytes / 0x4000;
+        g.chr = chr_bytes / 0x2000;
+        g.mapper = mapper_num | submapper << 12;
+        g.ram = ram_shift(prgram_bytes) | ram_shift(chrram_bytes) << 4;
+        games.push_back(g);
+    }
+    std::sort(games.begin(), games.end(), [](const Game &a, const Game &b) { return a.crc < b.crc; });
+    for (std::size_t i = 1; i < games.size(); i++) {
+        if (games[i].crc == games[i-1].crc) {
+            fmt::print(stderr, "{}: crc {:08X} is there twice ({}, {})\n", filename,
+                       games[i].crc, games[i-1].title, games[i].title);
+            errors++;
+        }
+    }
+    return games;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 3) {
+        fmt::print(stderr, "usage: {} <romdb.txt> <romdb_table.inc>\n", argv[0]);
+        return 1;
+    }
+    auto games = read_db(argv[1]);
+    if (errors)
+        return 1;
+
+    // ~3 keys per bucket and a load factor of 0.9 keep the seed search short.
+    const std::size_t nbuckets = std::max<std::size_t>(games.size() / 3, 1);
+    const std::size_t nslots   = games.size() + games.size() / 8 + 1;
+    std::vector<std::vector<const Game *>> buckets(nbuckets);
+    for (const auto &g : games)
+        buckets[romdb_hash(g.crc, 0) % nbuckets].push_back(&g);
+    std::vector<std::size_t> order(nbuckets);
+    for (std::size_t i = 0; i < nbuckets; i++)
+        order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) {
+        return buckets[a].size() > buckets[b].size();
+    });
+
+    std::vector<uint16> seeds(nbuckets, 0);
+    std::vector<const Game *> slots(nslots, nullptr);
+    std::vector<std::size_t> picked;
+    for (auto b : order) {
+        if (buckets[b].empty())
+            break;
+        uint32 seed;
+        for (seed = 1; seed <= 0xFFFF; seed++) {
+            picked.clear();
+            for (auto *g : buckets[b]) {
+                auto s = romdb_hash(g->crc, seed) % nslots;
+                if (slots[s] || std::find(picked.begin(), picked.end(), s) != picked.end())
+                    break;
+                picked.push_back(s);
+            }
+            if (picked.size() == buckets[b].size())
+                break;
+        }
+        if (seed > 0xFFFF) {
+            fmt::print(stderr, "couldn't place bucket {} ({} keys), try a lower load factor\n", b, buckets[b].size());
+            return 1;
+        }
+        seeds[b] = seed;
+        for (std::size_t i = 0; i < picked.size(); i++)
+            slots[picked[i]] = buckets[b][i];
+    }
+
+    std::FILE *out = std::fopen(argv[2], "w");
+    if (!out) {
+        fmt::print(stderr, "can't write {}\n", argv[2]);
+        return 1;
+    }
+    fmt::print(out, "// generated by tools/romdb_gen from {}, don't edit.\n\n", argv[1]);
+    fmt::print(out, "static const unsigned ROMDB_SIZE    = {};\n", games.size());
+    fmt::print(out, "static const unsigned ROMDB_BUCKETS = {};\n", nbuckets);
+    fmt::print(out, "static const unsigned ROMDB_SLOTS   = {};\n\n", nslots);
+    fmt::print(out, "static const uint16 romdb_seeds[] = {{");
+    for (std::size_t i = 0; i < nbuckets; i++)
+        fmt::print(out, "{}{},", i % 16 == 0 ? "\n    " : " ", seeds[i]);
+    fmt::print(out, "\n}};\n\n");
+    fmt::print(out, "static const Entry romdb_entries[] = {{\n");
+    for (auto *g : slots) {
+        if (g)
+            fmt::print(out, "    {{ 0x{:08X}, {:4}, {:4}, 0x{:04X}, 0x{:02X}, {} }}, // {}\n",
+                       g->crc, g->prg, g->chr, g->mapper, g->ram, g->flags, g->title);
+        else
+            fmt::print(out, "    {{ }},\n");
+    }
+    fmt::print(out, "}};\n");
+    std::fclose(out);
+    return 0;
+}